@@ -113,6 +113,8 @@
 #include "Net/GameServer.h"
 #include "Net/Protocol/NetProtocol.h"
 #include "System/SafeUtil.h"
+#include "System/FileSystem/DataDirsAccess.h"
+#include "System/FileSystem/FileQueryFlags.h"
 #include "System/FileSystem/FileSystem.h"
 #include "System/LoadSave/LoadSaveHandler.h"
 #include "System/LoadSave/DemoRecorder.h"
@@ -135,6 +137,7 @@ CONFIG(bool, ShowSpeed).defaultValue(false).description("Displays current game s
 CONFIG(int, ShowPlayerInfo).defaultValue(1).headlessValue(0);
 CONFIG(float, GuiOpacity).defaultValue(0.8f).minimumValue(0.0f).maximumValue(1.0f).description("Sets the opacity of the built-in Spring UI. Generally has no effect on LuaUI widgets. Can be set in-game using shift+, to decrease and shift+. to increase.");
 CONFIG(std::string, InputTextGeo).defaultValue("");
+CONFIG(std::string, ProfilerTraceFile).defaultValue("").description("If set, all profiler timers (including those of worker threads) are written to this file in Chrome trace-event format while a game runs, for viewing in chrome://tracing or ui.perfetto.dev.");
 
 
 CGame* game = nullptr;
@@ -280,6 +283,9 @@ CGame::CGame(const std::string& mapName, const std::string& modName, ILoadSaveHa
 	ParseInputTextGeometry("default");
 	ParseInputTextGeometry(configHandler->GetString("InputTextGeo"));
 
+	if (!configHandler->GetString("ProfilerTraceFile").empty())
+		profiler.StartTrace(dataDirsAccess.LocateFile(configHandler->GetString("ProfilerTraceFile"), FileQueryFlags::WRITE));
+
 	// clear left-over receivers in case we reloaded
 	commandConsole.ResetState();
 
@@ -324,6 +330,8 @@ CGame::~CGame()
 	KillInterface();
 	KillSimulation();
 
+	profiler.StopTrace();
+
 	LOG("[Game::%s][2]", __func__);
 	spring::SafeDelete(saveFile); // ILoadSaveHandler, depends on vfsHandler via ~IArchive
 
@@ -1050,6 +1058,8 @@ bool CGame::Update()
 	jobDispatcher.Update();
 	clientNet->Update();
 
+	profiler.MergeTimes();
+
 	// When video recording do step by step simulation, so each simframe gets a corresponding videoframe
 	// FIXME: SERVER ALREADY DOES THIS BY ITSELF
 	if (playing && globalRendering->isVideoCapturing && gameServer != nullptr)
@@ -1581,6 +1591,8 @@ void CGame::SimFrame() {
 	// everything from here is simulation
 	{
 		SCOPED_SPECIAL_TIMER("Sim");
+		// may rebuild the grid, so keep this at the frame boundary
+		quadField->Update(gs->frameNum);
 		{
 			SCOPED_TIMER("Sim::GameFrame");
 			eventHandler.GameFrame(gs->frameNum);
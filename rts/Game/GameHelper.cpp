@@ -45,8 +45,34 @@ static CGameHelper gGameHelper;
 CGameHelper* helper = &gGameHelper;
 
 
+// enemy units found in the quads around a weapon by GenerateWeaponTargets
+// co-located weapons (eg. all weapons of one unit, or units in a blob) query
+// the same quads, so their candidates are only gathered once as long as no
+// unit has entered or left any quad and no alliance has changed in the meantime
+struct WeaponTargetCandidates {
+	std::vector<int> quads;
+	std::vector<CUnit*> units;
+
+	int allyTeam = -1;
+	unsigned int quadsVersion = 0;
+	unsigned int alliesVersion = 0;
+
+	// number of GenerateWeaponTargets calls up the stack iterating this entry
+	int numReaders = 0;
+};
+
+static std::array<WeaponTargetCandidates, 256> weaponTargetCandidates;
+
+
 void CGameHelper::Init()
 {
+	for (WeaponTargetCandidates& wtc: weaponTargetCandidates) {
+		wtc.quads.clear();
+		wtc.units.clear();
+		wtc.allyTeam = -1;
+		wtc.numReaders = 0;
+	}
+
 	for (auto& wdVec: waitingDamages) {
 		wdVec.clear();
 		wdVec.reserve(32);
@@ -630,6 +656,69 @@ namespace {
 } // end of namespace
 
 
+static void GatherWeaponTargetCandidates(const std::vector<int>& quads, int allyTeam, std::vector<CUnit*>& units)
+{
+	const int tempNum = gs->GetTempNum();
+
+	for (int t = 0; t < teamHandler->ActiveAllyTeams(); ++t) {
+		if (teamHandler->Ally(allyTeam, t))
+			continue;
+
+		for (const int qi: quads) {
+			for (CUnit* targetUnit: quadField->GetQuad(qi).teamUnits[t]) {
+				if (targetUnit->tempNum == tempNum)
+					continue;
+
+				targetUnit->tempNum = tempNum;
+				units.push_back(targetUnit);
+			}
+		}
+	}
+}
+
+static const std::vector<CUnit*>& GetWeaponTargetCandidates(
+	const std::vector<int>& quads,
+	int allyTeam,
+	std::vector<CUnit*>& uncachedUnits,
+	WeaponTargetCandidates*& cacheEntry
+) {
+	unsigned int hash = allyTeam * 2654435761u;
+
+	for (const int qi: quads) {
+		hash = (hash ^ qi) * 16777619u;
+	}
+
+	WeaponTargetCandidates& wtc = weaponTargetCandidates[hash % weaponTargetCandidates.size()];
+
+	const unsigned int quadsVersion = quadField->GetUnitQuadsVersion();
+	const unsigned int alliesVersion = teamHandler->GetAlliesVersion();
+
+	if (wtc.allyTeam == allyTeam && wtc.quadsVersion == quadsVersion && wtc.alliesVersion == alliesVersion && wtc.quads == quads) {
+		cacheEntry = &wtc;
+		return wtc.units;
+	}
+
+	// a search further up the stack (GenerateWeaponTargets calls Lua, which
+	// can indirectly start another one) is still iterating this entry
+	if (wtc.numReaders > 0) {
+		cacheEntry = nullptr;
+		GatherWeaponTargetCandidates(quads, allyTeam, uncachedUnits);
+		return uncachedUnits;
+	}
+
+	wtc.quads = quads;
+	wtc.units.clear();
+
+	wtc.allyTeam = allyTeam;
+	wtc.quadsVersion = quadsVersion;
+	wtc.alliesVersion = alliesVersion;
+
+	GatherWeaponTargetCandidates(quads, allyTeam, wtc.units);
+
+	cacheEntry = &wtc;
+	return wtc.units;
+}
+
 void CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* avoidUnit, std::vector<std::pair<float, CUnit*>>& targets)
 {
 	const CUnit* owner    = weapon->owner;
@@ -645,92 +734,87 @@ void CGameHelper::GenerateWeaponTargets(const CWeapon* weapon, const CUnit* avoi
 	const float secDamage = weapon->damages->GetDefault() * weapon->salvoSize / weapon->reloadTime * GAME_SPEED;
 	const bool paralyzer  = (weapon->damages->paralyzeDamageTime != 0);
 
-	// copy on purpose since the below calls lua
 	QuadFieldQuery qfQuery;
 	quadField->GetQuads(qfQuery, pos, radius + (aHeight - std::max(0.0f, readMap->GetInitMinHeight())) * heightMod);
-	const int tempNum = gs->GetTempNum();
 
-	for (int t = 0; t < teamHandler->ActiveAllyTeams(); ++t) {
-		if (teamHandler->Ally(owner->allyteam, t))
-			continue;
+	// the below calls lua, which can (indirectly) cause another search;
+	// the entry is marked as being read so that search can not overwrite
+	// it (candidates are unique, so lua messing with tempNum is harmless)
+	std::vector<CUnit*> uncachedCandidates;
+	WeaponTargetCandidates* cacheEntry = nullptr;
 
-		for (const int qi: *qfQuery.quads) {
-			const std::vector<CUnit*>& allyTeamUnits = quadField->GetQuad(qi).teamUnits[t];
+	const std::vector<CUnit*>& candidates = GetWeaponTargetCandidates(*qfQuery.quads, owner->allyteam, uncachedCandidates, cacheEntry);
 
-			for (CUnit* targetUnit: allyTeamUnits) {
-				if (targetUnit->tempNum == tempNum)
-					continue;
+	if (cacheEntry != nullptr)
+		cacheEntry->numReaders++;
 
-				targetUnit->tempNum = tempNum;
+	for (CUnit* targetUnit: candidates) {
+		float targetPriority = 1.0f;
 
-				float targetPriority = 1.0f;
+		if (!weapon->TestTarget(float3(), SWeaponTarget(targetUnit)))
+			continue;
 
-				if (!weapon->TestTarget(float3(), SWeaponTarget(targetUnit)))
-					continue;
+		if (targetUnit == avoidUnit)
+			targetPriority *= 10.0f;
 
-				if (targetUnit == avoidUnit)
-					targetPriority *= 10.0f;
+		float3 targPos;
+		const unsigned short targetLOSState = targetUnit->losStatus[owner->allyteam];
 
-				float3 targPos;
-				const unsigned short targetLOSState = targetUnit->losStatus[owner->allyteam];
+		if (targetLOSState & LOS_INLOS) {
+			targPos = targetUnit->aimPos;
+		} else if (targetLOSState & LOS_INRADAR) {
+			targPos = weapon->GetUnitPositionWithError(targetUnit);
+			targetPriority *= 10.0f;
+		} else {
+			continue;
+		}
 
-				if (targetLOSState & LOS_INLOS) {
-					targPos = targetUnit->aimPos;
-				} else if (targetLOSState & LOS_INRADAR) {
-					targPos = weapon->GetUnitPositionWithError(targetUnit);
-					targetPriority *= 10.0f;
-				} else {
-					continue;
-				}
+		const float modRange = radius + (aHeight - targPos.y) * heightMod;
 
-				const float modRange = radius + (aHeight - targPos.y) * heightMod;
+		if (pos.SqDistance2D(targPos) > modRange * modRange)
+			continue;
 
-				if (pos.SqDistance2D(targPos) > modRange * modRange)
-					continue;
+		const float dist2D = (pos - targPos).Length2D();
+		const float rangeMul = (dist2D * weaponDef->proximityPriority + modRange * 0.4f + 100.0f);
+		const float damageMul = weapon->damages->Get(targetUnit->armorType) * targetUnit->curArmorMultiple;
 
-				const float dist2D = (pos - targPos).Length2D();
-				const float rangeMul = (dist2D * weaponDef->proximityPriority + modRange * 0.4f + 100.0f);
-				const float damageMul = weapon->damages->Get(targetUnit->armorType) * targetUnit->curArmorMultiple;
+		targetPriority *= rangeMul;
 
-				targetPriority *= rangeMul;
+		if (targetLOSState & LOS_INLOS) {
+			targetPriority *= (secDamage + targetUnit->health);
 
-				if (targetLOSState & LOS_INLOS) {
-					targetPriority *= (secDamage + targetUnit->health);
+			if (paralyzer && targetUnit->paralyzeDamage > (modInfo.paralyzeOnMaxHealth? targetUnit->maxHealth: targetUnit->health))
+				targetPriority *= 4.0f;
 
-					if (paralyzer && targetUnit->paralyzeDamage > (modInfo.paralyzeOnMaxHealth? targetUnit->maxHealth: targetUnit->health))
-						targetPriority *= 4.0f;
+			if (weapon->hasTargetWeight)
+				targetPriority *= weapon->TargetWeight(targetUnit);
 
-					if (weapon->hasTargetWeight)
-						targetPriority *= weapon->TargetWeight(targetUnit);
+		} else {
+			targetPriority *= (secDamage + 10000.0f);
+		}
 
-				} else {
-					targetPriority *= (secDamage + 10000.0f);
-				}
+		if (targetLOSState & LOS_PREVLOS) {
+			targetPriority /= (damageMul * targetUnit->power * (0.7f + gsRNG.NextFloat() * 0.6f));
 
-				if (targetLOSState & LOS_PREVLOS) {
-					targetPriority /= (damageMul * targetUnit->power * (0.7f + gsRNG.NextFloat() * 0.6f));
+			if (targetUnit->category & weapon->badTargetCategory)
+				targetPriority *= 100.0f;
 
-					if (targetUnit->category & weapon->badTargetCategory)
-						targetPriority *= 100.0f;
+			if (targetUnit->IsCrashing())
+				targetPriority *= 1000.0f;
 
-					if (targetUnit->IsCrashing())
-						targetPriority *= 1000.0f;
+			if (targetUnit == lastAttacker)
+				targetPriority *= 0.5f;
+		}
 
-					if (targetUnit == lastAttacker)
-						targetPriority *= 0.5f;
-				}
+		if (!eventHandler.AllowWeaponTarget(owner->id, targetUnit->id, weapon->weaponNum, weaponDef->id, &targetPriority))
+			continue;
 
-				const bool allow = eventHandler.AllowWeaponTarget(owner->id, targetUnit->id, weapon->weaponNum, weaponDef->id, &targetPriority);
-				//Lua call may have changed tempNum, so needs to be set again.
-				targetUnit->tempNum = tempNum;
+		targets.push_back(std::pair<float, CUnit*>(targetPriority, targetUnit));
+	}
 
-				if (!allow)
-					continue;
+	if (cacheEntry != nullptr)
+		cacheEntry->numReaders--;
 
-				targets.push_back(std::pair<float, CUnit*>(targetPriority, targetUnit));
-			}
-		}
-	}
 	std::stable_sort(targets.begin(), targets.end(), [](const std::pair<float, CUnit*>& a, const std::pair<float, CUnit*>& b) { return (a.first < b.first); });
 
 #ifdef TRACE_SYNC
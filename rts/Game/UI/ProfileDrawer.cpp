@@ -135,7 +135,7 @@ static void DrawThreadBarcode()
 	}
 	{
 		// need to lock; DrawTimeSlice pop_back()'s old entries from
-		// threadProf while ~ScopedMtTimer can modify it concurrently
+		// threadProf while MergeTimes can append to it
 		profiler.ToggleLock(true);
 
 		// bars
@@ -88,6 +88,16 @@ enum UnitAllegiance {
 	EnemyUnits = -4
 };
 
+// fields filled by GetUnitsStateArrays
+enum UnitStateField {
+	UnitStatePosition  = (1 << 0),
+	UnitStateVelocity  = (1 << 1),
+	UnitStateDirection = (1 << 2),
+	UnitStateHealth    = (1 << 3),
+	UnitStateTeam      = (1 << 4),
+	UnitStateDefID     = (1 << 5),
+};
+
 
 /******************************************************************************/
 /******************************************************************************/
@@ -100,6 +110,14 @@ bool LuaSyncedRead::PushEntries(lua_State* L)
 	LuaPushNamedNumber(L, "ALLY_UNITS",  AllyUnits);
 	LuaPushNamedNumber(L, "ENEMY_UNITS", EnemyUnits);
 
+	// unit-state field constants
+	LuaPushNamedNumber(L, "UNIT_STATE_POSITION",  UnitStatePosition);
+	LuaPushNamedNumber(L, "UNIT_STATE_VELOCITY",  UnitStateVelocity);
+	LuaPushNamedNumber(L, "UNIT_STATE_DIRECTION", UnitStateDirection);
+	LuaPushNamedNumber(L, "UNIT_STATE_HEALTH",    UnitStateHealth);
+	LuaPushNamedNumber(L, "UNIT_STATE_TEAM",      UnitStateTeam);
+	LuaPushNamedNumber(L, "UNIT_STATE_DEFID",     UnitStateDefID);
+
 	// READ routines, sync safe
 	REGISTER_LUA_CFUNC(IsCheatingEnabled);
 	REGISTER_LUA_CFUNC(IsGodModeEnabled);
@@ -170,6 +188,8 @@ bool LuaSyncedRead::PushEntries(lua_State* L)
 	REGISTER_LUA_CFUNC(GetUnitsInSphere);
 	REGISTER_LUA_CFUNC(GetUnitsInCylinder);
 
+	REGISTER_LUA_CFUNC(GetUnitsStateArrays);
+
 	REGISTER_LUA_CFUNC(GetFeaturesInRectangle);
 	REGISTER_LUA_CFUNC(GetFeaturesInSphere);
 	REGISTER_LUA_CFUNC(GetFeaturesInCylinder);
@@ -2370,6 +2390,235 @@ int LuaSyncedRead::GetUnitsInPlanes(lua_State* L)
 }
 
 
+/******************************************************************************/
+/******************************************************************************/
+//
+//  Bulk Unit State Queries
+//
+
+struct UnitStateArray {
+	const char* name;
+	int field;
+	int stride;
+};
+
+static const UnitStateArray unitStateArrays[] = {
+	{"position",  UnitStatePosition,  3}, // x, y, z
+	{"velocity",  UnitStateVelocity,  4}, // x, y, z, speed
+	{"direction", UnitStateDirection, 3}, // x, y, z
+	{"health",    UnitStateHealth,    5}, // health, maxHealth, paralyzeDamage, captureProgress, buildProgress
+	{"team",      UnitStateTeam,      2}, // teamID, allyTeamID
+	{"unitDefID", UnitStateDefID,     1},
+};
+
+
+static bool IsUnitInAllegiance(lua_State* L, const CUnit* unit, int allegiance)
+{
+	switch (allegiance) {
+		case AllUnits  : { return true; } break;
+		case MyUnits   : { return (unit->team == CLuaHandle::GetHandleReadTeam(L)); } break;
+		case AllyUnits : { return (unit->allyteam == CLuaHandle::GetHandleReadAllyTeam(L)); } break;
+		case EnemyUnits: { return (unit->allyteam != CLuaHandle::GetHandleReadAllyTeam(L)); } break;
+		default        : {} break;
+	}
+
+	return (unit->team == allegiance);
+}
+
+// true iff each per-unit getter for the requested fields would return data
+// (GetUnitHealth does for hideDamage enemies, see GetUnitsStateArrays)
+static bool IsUnitStateReadable(lua_State* L, const CUnit* unit, int fields)
+{
+	if (!IsUnitVisible(L, unit))
+		return false;
+
+	if ((fields & (UnitStateVelocity | UnitStateDirection | UnitStateHealth)) != 0 && !IsUnitInLos(L, unit))
+		return false;
+	if ((fields & UnitStateDefID) != 0 && !IsUnitTyped(L, unit))
+		return false;
+
+	return true;
+}
+
+// leaves out[name] on the stack and returns its index, creates it if needed
+static int PushUnitStateArray(lua_State* L, int outIndex, const char* name, int size)
+{
+	lua_getfield(L, outIndex, name);
+
+	if (lua_istable(L, -1))
+		return (lua_gettop(L));
+
+	lua_pop(L, 1);
+	lua_createtable(L, size, 0);
+	lua_pushvalue(L, -1);
+	lua_setfield(L, outIndex, name);
+	return (lua_gettop(L));
+}
+
+static inline void SetUnitStateValue(lua_State* L, int arrayIndex, int valueIndex, float value)
+{
+	lua_pushnumber(L, value);
+	lua_rawseti(L, arrayIndex, valueIndex);
+}
+
+
+int LuaSyncedRead::GetUnitsStateArrays(lua_State* L)
+{
+	QuadFieldQuery qfQuery;
+
+	std::vector<CUnit*> listUnits;
+	const std::vector<CUnit*>* units = &listUnits;
+
+	int allegiance = AllUnits;
+	int fieldsIndex = 2;
+	int outIndex = 3;
+
+	if (lua_istable(L, 1)) {
+		const int numUnitIDs = lua_objlen(L, 1);
+
+		listUnits.reserve(numUnitIDs);
+
+		for (int i = 1; i <= numUnitIDs; i++) {
+			lua_rawgeti(L, 1, i);
+
+			if (!lua_isnumber(L, -1))
+				luaL_error(L, "[%s] unitID (entry #%d) not a number\n", __func__, i);
+
+			CUnit* unit = unitHandler->GetUnit(lua_toint(L, -1));
+
+			lua_pop(L, 1);
+
+			if (unit == nullptr)
+				continue;
+
+			listUnits.push_back(unit);
+		}
+	} else {
+		const float3 mins(luaL_checkfloat(L, 1), 0.0f, luaL_checkfloat(L, 2));
+		const float3 maxs(luaL_checkfloat(L, 3), 0.0f, luaL_checkfloat(L, 4));
+
+		fieldsIndex = 5;
+		outIndex = 7;
+		allegiance = ParseAllegiance(L, __func__, 6);
+
+		quadField->GetUnitsExact(qfQuery, mins, maxs);
+		units = qfQuery.units;
+	}
+
+	const int fields = luaL_checkint(L, fieldsIndex);
+
+	// reuse the caller's arrays if given
+	lua_settop(L, outIndex);
+
+	if (!lua_istable(L, outIndex)) {
+		lua_pop(L, 1);
+		lua_createtable(L, 0, 1 + (sizeof(unitStateArrays) / sizeof(unitStateArrays[0])));
+	}
+
+	const int unitIDsIndex = PushUnitStateArray(L, outIndex, "unitIDs", units->size());
+
+	// stack indices of the requested arrays, in unitStateArrays order
+	int arrayIndices[sizeof(unitStateArrays) / sizeof(unitStateArrays[0])] = {0};
+	int count = 0;
+
+	for (size_t n = 0; n < (sizeof(unitStateArrays) / sizeof(unitStateArrays[0])); n++) {
+		if ((fields & unitStateArrays[n].field) == 0)
+			continue;
+
+		arrayIndices[n] = PushUnitStateArray(L, outIndex, unitStateArrays[n].name, units->size() * unitStateArrays[n].stride);
+	}
+
+	for (const CUnit* unit: *units) {
+		if (!IsUnitInAllegiance(L, unit, allegiance))
+			continue;
+		if (!IsUnitStateReadable(L, unit, fields))
+			continue;
+
+		SetUnitStateValue(L, unitIDsIndex, ++count, unit->id);
+
+		if ((fields & UnitStatePosition) != 0) {
+			float3 errorVec;
+
+			// same radar error as GetUnitPosition
+			if (!IsAllyUnit(L, unit))
+				errorVec = unit->GetLuaErrorVector(CLuaHandle::GetHandleReadAllyTeam(L), CLuaHandle::GetHandleFullRead(L));
+
+			const int i = (count - 1) * 3;
+
+			SetUnitStateValue(L, arrayIndices[0], i + 1, unit->pos.x + errorVec.x);
+			SetUnitStateValue(L, arrayIndices[0], i + 2, unit->pos.y + errorVec.y);
+			SetUnitStateValue(L, arrayIndices[0], i + 3, unit->pos.z + errorVec.z);
+		}
+		if ((fields & UnitStateVelocity) != 0) {
+			const int i = (count - 1) * 4;
+
+			SetUnitStateValue(L, arrayIndices[1], i + 1, unit->speed.x);
+			SetUnitStateValue(L, arrayIndices[1], i + 2, unit->speed.y);
+			SetUnitStateValue(L, arrayIndices[1], i + 3, unit->speed.z);
+			SetUnitStateValue(L, arrayIndices[1], i + 4, unit->speed.w);
+		}
+		if ((fields & UnitStateDirection) != 0) {
+			const int i = (count - 1) * 3;
+
+			SetUnitStateValue(L, arrayIndices[2], i + 1, unit->frontdir.x);
+			SetUnitStateValue(L, arrayIndices[2], i + 2, unit->frontdir.y);
+			SetUnitStateValue(L, arrayIndices[2], i + 3, unit->frontdir.z);
+		}
+		if ((fields & UnitStateHealth) != 0) {
+			const UnitDef* ud = unit->unitDef;
+
+			// same decoy scaling as GetUnitHealth
+			const bool enemyUnit = IsEnemyUnit(L, unit);
+			const float scale = (!enemyUnit || ud->decoyDef == nullptr)? 1.0f: (ud->decoyDef->health / ud->health);
+
+			const int i = (count - 1) * 5;
+
+			if (ud->hideDamage && enemyUnit) {
+				// GetUnitHealth returns nil for these, arrays can not hold holes
+				SetUnitStateValue(L, arrayIndices[3], i + 1, -1.0f);
+				SetUnitStateValue(L, arrayIndices[3], i + 2, -1.0f);
+				SetUnitStateValue(L, arrayIndices[3], i + 3, -1.0f);
+			} else {
+				SetUnitStateValue(L, arrayIndices[3], i + 1, scale * unit->health);
+				SetUnitStateValue(L, arrayIndices[3], i + 2, scale * unit->maxHealth);
+				SetUnitStateValue(L, arrayIndices[3], i + 3, scale * unit->paralyzeDamage);
+			}
+			SetUnitStateValue(L, arrayIndices[3], i + 4, unit->captureProgress);
+			SetUnitStateValue(L, arrayIndices[3], i + 5, unit->buildProgress);
+		}
+		if ((fields & UnitStateTeam) != 0) {
+			const int i = (count - 1) * 2;
+
+			SetUnitStateValue(L, arrayIndices[4], i + 1, unit->team);
+			SetUnitStateValue(L, arrayIndices[4], i + 2, unit->allyteam);
+		}
+		if ((fields & UnitStateDefID) != 0) {
+			SetUnitStateValue(L, arrayIndices[5], count, EffectiveUnitDef(L, unit)->id);
+		}
+	}
+
+	// clear whatever a previous call left behind in reused arrays
+	for (int i = count + 1, n = lua_objlen(L, unitIDsIndex); i <= n; i++) {
+		lua_pushnil(L);
+		lua_rawseti(L, unitIDsIndex, i);
+	}
+
+	for (size_t a = 0; a < (sizeof(unitStateArrays) / sizeof(unitStateArrays[0])); a++) {
+		if (arrayIndices[a] == 0)
+			continue;
+
+		for (int i = count * unitStateArrays[a].stride + 1, n = lua_objlen(L, arrayIndices[a]); i <= n; i++) {
+			lua_pushnil(L);
+			lua_rawseti(L, arrayIndices[a], i);
+		}
+	}
+
+	lua_settop(L, outIndex);
+	lua_pushnumber(L, count);
+	return 2;
+}
+
+
 /******************************************************************************/
 
 int LuaSyncedRead::GetUnitNearestAlly(lua_State* L)
@@ -849,7 +849,7 @@ int LuaUnsyncedRead::GetVisibleUnits(lua_State* L)
 	static CVisUnitQuadDrawer unitQuadIter;
 
 	unitQuadIter.ResetState();
-	readMap->GridVisibility(nullptr, &unitQuadIter, 1e9, CQuadField::BASE_QUAD_SIZE / SQUARE_SIZE);
+	readMap->GridVisibility(nullptr, &unitQuadIter, 1e9, quadField->GetQuadSizeX() / SQUARE_SIZE);
 
 	// Even though we're in unsynced it's ok to use gs->tempNum since its exact value
 	// doesn't matter
@@ -929,7 +929,7 @@ int LuaUnsyncedRead::GetVisibleFeatures(lua_State* L)
 	static CVisFeatureQuadDrawer featureQuadIter;
 
 	featureQuadIter.ResetState();
-	readMap->GridVisibility(nullptr, &featureQuadIter, 1e9, CQuadField::BASE_QUAD_SIZE / SQUARE_SIZE);
+	readMap->GridVisibility(nullptr, &featureQuadIter, 1e9, quadField->GetQuadSizeX() / SQUARE_SIZE);
 
 	// Even though we're in unsynced it's ok to use gs->tempNum since its exact value
 	// doesn't matter
@@ -993,7 +993,7 @@ int LuaUnsyncedRead::GetVisibleProjectiles(lua_State* L)
 
 
 	projQuadIter.ResetState();
-	readMap->GridVisibility(nullptr, &projQuadIter, 1e9, CQuadField::BASE_QUAD_SIZE / SQUARE_SIZE);
+	readMap->GridVisibility(nullptr, &projQuadIter, 1e9, quadField->GetQuadSizeX() / SQUARE_SIZE);
 
 	// Even though we're in unsynced it's ok to use gs->tempNum since its exact value
 	// doesn't matter
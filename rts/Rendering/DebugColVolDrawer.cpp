@@ -353,7 +353,7 @@ namespace DebugColVolDrawer
 			static CDebugColVolQuadDrawer drawer;
 
 			drawer.ResetState();
-			readMap->GridVisibility(nullptr, &drawer, 1e9, CQuadField::BASE_QUAD_SIZE / SQUARE_SIZE);
+			readMap->GridVisibility(nullptr, &drawer, 1e9, quadField->GetQuadSizeX() / SQUARE_SIZE);
 
 			glLineWidth(1.0f);
 		glPopAttrib();
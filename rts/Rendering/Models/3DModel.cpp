@@ -301,6 +301,21 @@ void LocalModel::SetModel(const S3DModel* model, bool initialize)
 	assert(pieces.size() == model->numPieces);
 }
 
+void LocalModel::UpdatePieceMatrices() const
+{
+	// pieces are created depth-first, so each parent is updated before its
+	// children; SetDirty also marks all children of a dirty piece, hence
+	// the result is the same as on-demand updates via UpdateParentMatricesRec
+	for (const LocalModelPiece& lmp: pieces) {
+		assert(lmp.parent == nullptr || lmp.parent < &lmp);
+
+		if (!lmp.IsDirty())
+			continue;
+
+		lmp.UpdateMatrices();
+	}
+}
+
 LocalModelPiece* LocalModel::CreateLocalModelPieces(const S3DModelPiece* mpParent)
 {
 	LocalModelPiece* lmpChild = nullptr;
@@ -462,6 +477,11 @@ void LocalModelPiece::UpdateParentMatricesRec() const
 	if (parent != nullptr && parent->dirty)
 		parent->UpdateParentMatricesRec();
 
+	UpdateMatrices();
+}
+
+void LocalModelPiece::UpdateMatrices() const
+{
 	dirty = false;
 
 	pieceSpaceMat = std::move(CalcPieceSpaceMatrix(pos, rot, original->scales));
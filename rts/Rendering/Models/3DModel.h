@@ -331,6 +331,8 @@ struct LocalModelPiece
 	// on-demand functions
 	void UpdateChildMatricesRec(bool updateChildMatrices) const;
 	void UpdateParentMatricesRec() const;
+	// non-recursive, the parent's matrices must be up-to-date
+	void UpdateMatrices() const;
 
 	CMatrix44f CalcPieceSpaceMatrixRaw(const float3& p, const float3& r, const float3& s) const { return (original->ComposeTransform(p, r, s)); }
 	CMatrix44f CalcPieceSpaceMatrix(const float3& p, const float3& r, const float3& s) const {
@@ -346,6 +348,7 @@ struct LocalModelPiece
 
 
 	void SetDirty();
+	bool IsDirty() const { return dirty; }
 	void SetPosOrRot(const float3& src, float3& dst); // anim-script only
 	void SetPosition(const float3& p) { SetPosOrRot(p, pos); } // anim-script only
 	void SetRotation(const float3& r) { SetPosOrRot(r, rot); } // anim-script only
@@ -445,6 +448,8 @@ struct LocalModel
 	void SetModel(const S3DModel* model, bool initialize = true);
 	void SetLODCount(unsigned int lodCount);
 	void UpdateBoundingVolume();
+	// recalculates the matrices of all dirty pieces in one top-down pass
+	void UpdatePieceMatrices() const;
 
 	void GetBoundingBoxVerts(std::vector<float3>& verts) const {
 		verts.resize(8 + 2); GetBoundingBoxVerts(&verts[0]);
@@ -51,13 +51,14 @@ void QTPFSPathDrawer::DrawAll() const {
 }
 
 void QTPFSPathDrawer::DrawNodeTree(const MoveDef* md) const {
-	QTPFS::QTNode* nt = pm->nodeTrees[md->pathType];
+	const QTPFS::NodeLayer& nl = pm->nodeLayers[md->pathType];
+	const QTPFS::QTNode* nt = nl.GetRootNode();
 	CVertexArray* va = GetVertexArray();
 
 	std::vector<const QTPFS::QTNode*> nodes;
 	std::vector<const QTPFS::QTNode*>::const_iterator nodesIt;
 
-	GetVisibleNodes(nt, nodes);
+	GetVisibleNodes(nl, nt, nodes);
 
 	va->Initialize();
 	va->EnlargeArrays(nodes.size() * 4, 0, VA_SIZE_C);
@@ -74,6 +75,7 @@ void QTPFSPathDrawer::DrawNodeTree(const MoveDef* md) const {
 }
 
 void QTPFSPathDrawer::DrawNodeTreeRec(
+	const QTPFS::NodeLayer& nl,
 	const QTPFS::QTNode* nt,
 	const MoveDef* md,
 	CVertexArray* va
@@ -81,32 +83,32 @@ void QTPFSPathDrawer::DrawNodeTreeRec(
 	if (nt->IsLeaf()) {
 		DrawNode(nt, md, va, false, true, false);
 	} else {
-		for (unsigned int i = 0; i < nt->children.size(); i++) {
-			const QTPFS::QTNode* n = nt->children[i];
+		for (unsigned int i = 0; i < QTNODE_CHILD_COUNT; i++) {
+			const QTPFS::QTNode* n = nl.GetPoolNode(nt->GetChildIndex(i));
 			const float3 mins = float3(n->xmin() * SQUARE_SIZE, 0.0f, n->zmin() * SQUARE_SIZE);
 			const float3 maxs = float3(n->xmax() * SQUARE_SIZE, 0.0f, n->zmax() * SQUARE_SIZE);
 
 			if (!camera->InView(mins, maxs))
 				continue;
 
-			DrawNodeTreeRec(nt->children[i], md, va);
+			DrawNodeTreeRec(nl, n, md, va);
 		}
 	}
 }
 
-void QTPFSPathDrawer::GetVisibleNodes(const QTPFS::QTNode* nt, std::vector<const QTPFS::QTNode*>& nodes) const {
+void QTPFSPathDrawer::GetVisibleNodes(const QTPFS::NodeLayer& nl, const QTPFS::QTNode* nt, std::vector<const QTPFS::QTNode*>& nodes) const {
 	if (nt->IsLeaf()) {
 		nodes.push_back(nt);
 	} else {
-		for (unsigned int i = 0; i < nt->children.size(); i++) {
-			const QTPFS::QTNode* n = nt->children[i];
+		for (unsigned int i = 0; i < QTNODE_CHILD_COUNT; i++) {
+			const QTPFS::QTNode* n = nl.GetPoolNode(nt->GetChildIndex(i));
 			const float3 mins = float3(n->xmin() * SQUARE_SIZE, 0.0f, n->zmin() * SQUARE_SIZE);
 			const float3 maxs = float3(n->xmax() * SQUARE_SIZE, 0.0f, n->zmax() * SQUARE_SIZE);
 
 			if (!camera->InView(mins, maxs))
 				continue;
 
-			GetVisibleNodes(nt->children[i], nodes);
+			GetVisibleNodes(nl, n, nodes);
 		}
 	}
 }
@@ -14,6 +14,7 @@ namespace QTPFS {
 	class PathManager;
 
 	struct QTNode;
+	struct NodeLayer;
 	struct IPath;
 	struct PathSearch;
 
@@ -38,12 +39,13 @@ private:
 
 	void DrawNodeTree(const MoveDef* md) const;
 	void DrawNodeTreeRec(
+		const QTPFS::NodeLayer& nl,
 		const QTPFS::QTNode* nt,
 		const MoveDef* md,
 		CVertexArray* va
 	) const;
 
-	void GetVisibleNodes(const QTPFS::QTNode* nt, std::vector<const QTPFS::QTNode*>& nodes) const;
+	void GetVisibleNodes(const QTPFS::NodeLayer& nl, const QTPFS::QTNode* nt, std::vector<const QTPFS::QTNode*>& nodes) const;
 
 	void DrawPaths(const MoveDef* md) const;
 	void DrawPath(const QTPFS::IPath* path, CVertexArray* va) const;
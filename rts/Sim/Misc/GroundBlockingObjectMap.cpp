@@ -1,5 +1,6 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
+#include <algorithm>
 #include <assert.h>
 
 #include "GroundBlockingObjectMap.h"
@@ -8,15 +9,143 @@
 #include "Sim/Path/IPathManager.h"
 #include "System/creg/STL_Map.h"
 #include "System/Sync/HsiehHash.h"
-#include "System/ContainerUtil.h"
 
 CGroundBlockingObjectMap* groundBlockingObjectMap = nullptr;
 
 CR_BIND(CGroundBlockingObjectMap, (1))
 CR_REG_METADATA(CGroundBlockingObjectMap, (
-	CR_MEMBER(groundBlockingMap)
+	CR_MEMBER(cellSpanIndices),
+	CR_MEMBER(cellSpans),
+	CR_MEMBER(cellObjects),
+	CR_MEMBER(freeSpanIndices),
+	CR_MEMBER(freeObjectRanges)
 ))
 
+CR_BIND(CGroundBlockingObjectMap::CellSpan, )
+CR_REG_METADATA_SUB(CGroundBlockingObjectMap, CellSpan, (
+	CR_MEMBER(offset),
+	CR_MEMBER(size),
+	CR_MEMBER(sizeClass)
+))
+
+
+// squares rarely hold more than a few objects; the smallest
+// range fits two so units crossing a square edge do not grow
+static constexpr unsigned int MIN_SIZE_CLASS = 1;
+static constexpr unsigned int NUM_SIZE_CLASSES = 32;
+
+
+CGroundBlockingObjectMap::CGroundBlockingObjectMap(int numSquares)
+{
+	cellSpanIndices.clear();
+	cellSpanIndices.resize(numSquares, 0);
+
+	// span 0 is shared by all empty squares
+	cellSpans.clear();
+	cellSpans.push_back({0, 0, 0});
+	cellObjects.clear();
+
+	freeSpanIndices.clear();
+	freeObjectRanges.clear();
+	freeObjectRanges.resize(NUM_SIZE_CLASSES);
+}
+
+
+unsigned int CGroundBlockingObjectMap::AllocObjectRange(unsigned int sizeClass)
+{
+	std::vector<unsigned int>& freeRanges = freeObjectRanges[sizeClass];
+
+	if (!freeRanges.empty()) {
+		const unsigned int offset = freeRanges.back();
+		freeRanges.pop_back();
+		return offset;
+	}
+
+	const unsigned int offset = cellObjects.size();
+	cellObjects.resize(offset + (1u << sizeClass), nullptr);
+	return offset;
+}
+
+void CGroundBlockingObjectMap::FreeObjectRange(unsigned int offset, unsigned int sizeClass)
+{
+	// ranges are always released empty (all slots nullptr), which
+	// keeps stale pointers out of cellObjects for serialization
+	freeObjectRanges[sizeClass].push_back(offset);
+}
+
+
+// same semantics as spring::VectorInsertUnique(cell, object, true)
+void CGroundBlockingObjectMap::InsertObject(unsigned int mapSquare, CSolidObject* object)
+{
+	unsigned int spanIdx = cellSpanIndices[mapSquare];
+
+	if (spanIdx == 0) {
+		if (freeSpanIndices.empty()) {
+			spanIdx = cellSpans.size();
+			cellSpans.emplace_back();
+		} else {
+			spanIdx = freeSpanIndices.back();
+			freeSpanIndices.pop_back();
+		}
+
+		cellSpans[spanIdx] = {AllocObjectRange(MIN_SIZE_CLASS), 0, MIN_SIZE_CLASS};
+		cellSpanIndices[mapSquare] = spanIdx;
+	} else {
+		const CellSpan& span = cellSpans[spanIdx];
+		const auto beg = cellObjects.begin() + span.offset;
+
+		if (std::find(beg, beg + span.size, object) != (beg + span.size))
+			return;
+	}
+
+	CellSpan& span = cellSpans[spanIdx];
+
+	if (span.size == (1u << span.sizeClass)) {
+		// full, move objects to a range twice as large
+		const unsigned int offset = AllocObjectRange(span.sizeClass + 1);
+
+		for (unsigned int i = 0; i < span.size; i++) {
+			cellObjects[offset + i] = cellObjects[span.offset + i];
+			cellObjects[span.offset + i] = nullptr;
+		}
+
+		FreeObjectRange(span.offset, span.sizeClass);
+
+		span.offset = offset;
+		span.sizeClass += 1;
+	}
+
+	cellObjects[span.offset + (span.size++)] = object;
+}
+
+// same semantics as spring::VectorErase(cell, object)
+void CGroundBlockingObjectMap::EraseObject(unsigned int mapSquare, CSolidObject* object)
+{
+	const unsigned int spanIdx = cellSpanIndices[mapSquare];
+
+	if (spanIdx == 0)
+		return;
+
+	CellSpan& span = cellSpans[spanIdx];
+
+	const auto beg = cellObjects.begin() + span.offset;
+	const auto end = beg + span.size;
+	const auto it = std::find(beg, end, object);
+
+	if (it == end)
+		return;
+
+	*it = *(end - 1);
+	*(end - 1) = nullptr;
+
+	if ((span.size -= 1) != 0)
+		return;
+
+	FreeObjectRange(span.offset, span.sizeClass);
+
+	freeSpanIndices.push_back(spanIdx);
+	cellSpanIndices[mapSquare] = 0;
+}
 
 
 void CGroundBlockingObjectMap::AddGroundBlockingObject(CSolidObject* object)
@@ -39,7 +168,7 @@ void CGroundBlockingObjectMap::AddGroundBlockingObject(CSolidObject* object)
 
 	for (int zSqr = minZSqr; zSqr < maxZSqr; zSqr++) {
 		for (int xSqr = minXSqr; xSqr < maxXSqr; xSqr++) {
-			spring::VectorInsertUnique(GetCellUnsafe(xSqr + zSqr * mapDims.mapx), object, true);
+			InsertObject(xSqr + zSqr * mapDims.mapx, object);
 		}
 	}
 
@@ -67,7 +196,7 @@ void CGroundBlockingObjectMap::AddGroundBlockingObject(CSolidObject* object, con
 			const float3 testPos = float3(x, 0.0f, z) * SQUARE_SIZE;
 
 			if (object->GetGroundBlockingMaskAtPos(testPos) & mask) {
-				spring::VectorInsertUnique(GetCellUnsafe(x + (z) * mapDims.mapx), object, true);
+				InsertObject(x + z * mapDims.mapx, object);
 			}
 		}
 	}
@@ -90,7 +219,7 @@ void CGroundBlockingObjectMap::RemoveGroundBlockingObject(CSolidObject* object)
 
 	for (int z = bz; z < bz + sz; ++z) {
 		for (int x = bx; x < bx + sx; ++x) {
-			spring::VectorErase(GetCellUnsafe(z * mapDims.mapx + x), object);
+			EraseObject(z * mapDims.mapx + x, object);
 		}
 	}
 
@@ -122,14 +251,14 @@ bool CGroundBlockingObjectMap::GroundBlocked(int x, int z, const CSolidObject* i
 	if ((unsigned)x >= mapDims.mapx || (unsigned)z >= mapDims.mapy)
 		return false;
 
-	const BlockingMapCell& cell = GetCellUnsafeConst(z * mapDims.mapx + x);
+	const BlockingMapCell cell = GetCellUnsafeConst(z * mapDims.mapx + x);
 
 	if (cell.empty())
 		return false;
 
 	// check if the first object in <cell> is NOT the ignoree
 	// if so the ground is definitely blocked at this location
-	if (*(cell.cbegin()) != ignoreObj)
+	if (*(cell.begin()) != ignoreObj)
 		return true;
 
 	// otherwise the ground is considered blocked only if there
@@ -205,8 +334,8 @@ unsigned int CGroundBlockingObjectMap::CalcChecksum() const
 {
 	unsigned int checksum = 666;
 
-	for (unsigned int i = 0; i < groundBlockingMap.size(); ++i) {
-		if (!groundBlockingMap[i].empty()) {
+	for (unsigned int i = 0; i < cellSpanIndices.size(); ++i) {
+		if (cellSpanIndices[i] != 0) {
 			checksum = HsiehHash(&i, sizeof(i), checksum);
 		}
 	}
@@ -10,19 +10,33 @@
 #include "System/float3.h"
 
 
-typedef std::vector<CSolidObject*> BlockingMapCell;
-typedef std::vector<BlockingMapCell> BlockingMap;
+// read-only view of the objects blocking a single map-square; only
+// valid until the next object is added to or removed from the map
+struct BlockingMapCell {
+public:
+	BlockingMapCell(CSolidObject* const* objs, unsigned int size): objects(objs), numObjects(size) {}
+
+	CSolidObject* const* begin() const { return objects; }
+	CSolidObject* const* end() const { return (objects + numObjects); }
+
+	CSolidObject* operator [] (unsigned int i) const { return objects[i]; }
+
+	unsigned int size() const { return numObjects; }
+	bool empty() const { return (numObjects == 0); }
+
+private:
+	CSolidObject* const* objects;
+	unsigned int numObjects;
+};
 
 
 class CGroundBlockingObjectMap
 {
 	CR_DECLARE_STRUCT(CGroundBlockingObjectMap)
+	CR_DECLARE_SUB(CellSpan)
 
 public:
-	CGroundBlockingObjectMap(int numSquares) {
-		groundBlockingMap.clear();
-		groundBlockingMap.resize(numSquares);
-	}
+	CGroundBlockingObjectMap(int numSquares);
 
 	unsigned int CalcChecksum() const;
 
@@ -43,7 +57,7 @@ public:
 
 	// same as GroundBlocked(), but does not bounds-check mapSquare
 	CSolidObject* GroundBlockedUnsafe(unsigned int mapSquare) const {
-		const BlockingMapCell& cell = GetCellUnsafeConst(mapSquare);
+		const BlockingMapCell cell = GetCellUnsafeConst(mapSquare);
 
 		if (cell.empty())
 			return nullptr;
@@ -56,29 +70,50 @@ public:
 	bool GroundBlocked(const float3& pos, const CSolidObject* ignoreObj) const;
 
 	bool ObjectInCell(unsigned int mapSquare, const CSolidObject* obj) const {
-		if (mapSquare >= groundBlockingMap.size())
+		if (mapSquare >= cellSpanIndices.size())
 			return false;
 
-		const BlockingMapCell& cell = GetCellUnsafeConst(mapSquare);
-		const auto it = std::find(cell.cbegin(), cell.cend(), obj);
-		return (it != cell.cend());
+		const BlockingMapCell cell = GetCellUnsafeConst(mapSquare);
+		const auto it = std::find(cell.begin(), cell.end(), obj);
+		return (it != cell.end());
 	}
 
 
-	const BlockingMapCell& GetCellUnsafeConst(unsigned int mapSquare) const {
-		assert(mapSquare < groundBlockingMap.size());
-		return groundBlockingMap[mapSquare];
-	}
-
-	BlockingMapCell& GetCellUnsafe(unsigned int mapSquare) {
-		return (const_cast<BlockingMapCell&>(GetCellUnsafeConst(mapSquare)));
+	BlockingMapCell GetCellUnsafeConst(unsigned int mapSquare) const {
+		assert(mapSquare < cellSpanIndices.size());
+		// empty squares all share span 0, no branch needed
+		const CellSpan& span = cellSpans[cellSpanIndices[mapSquare]];
+		return {cellObjects.data() + span.offset, span.size};
 	}
 
 private:
 	bool CheckYard(CSolidObject* yardUnit, const YardMapStatus& mask) const;
 
+	void InsertObject(unsigned int mapSquare, CSolidObject* object);
+	void EraseObject(unsigned int mapSquare, CSolidObject* object);
+
+	unsigned int AllocObjectRange(unsigned int sizeClass);
+	void FreeObjectRange(unsigned int offset, unsigned int sizeClass);
+
 private:
-	BlockingMap groundBlockingMap;
+	// range of cellObjects holding the objects of a map-square
+	struct CellSpan {
+		CR_DECLARE_STRUCT(CellSpan)
+
+		unsigned int offset;
+		unsigned int size;
+		unsigned int sizeClass; // capacity is (1 << sizeClass)
+	};
+
+	// per map-square index into cellSpans, 0 if the square is empty
+	std::vector<unsigned int> cellSpanIndices;
+
+	std::vector<CellSpan> cellSpans;
+	std::vector<CSolidObject*> cellObjects;
+
+	// recycled cellSpans indices and cellObjects ranges (per size-class)
+	std::vector<unsigned int> freeSpanIndices;
+	std::vector< std::vector<unsigned int> > freeObjectRanges;
 };
 
 extern CGroundBlockingObjectMap* groundBlockingObjectMap;
@@ -15,6 +15,8 @@
 #include "System/Threading/ThreadPool.h"
 #include "System/TimeProfiler.h"
 
+#include <algorithm>
+
 #define USE_STAGGERED_UPDATES 0
 
 
@@ -40,7 +42,10 @@ CR_REG_METADATA(CLosHandler,(
 	CR_MEMBER(baseRadarErrorSize),
 	CR_MEMBER(baseRadarErrorMult),
 	CR_MEMBER(radarErrorSizes),
-	CR_IGNORED(losTypes)
+	CR_IGNORED(losTypes),
+	CR_IGNORED(dirtyBlocksSize),
+	CR_IGNORED(dirtyBlocks),
+	CR_IGNORED(dirtyAllyTeams)
 ))
 
 
@@ -85,6 +90,7 @@ ILosType::ILosType(const int mipLevel_, LosType type_)
 	, algoType((type == LOS_TYPE_LOS || type == LOS_TYPE_RADAR) ? LOS_ALGO_RAYCAST : LOS_ALGO_CIRCLE)
 	, losMaps(teamHandler->ActiveAllyTeams(),
 		CLosMap(size, type == LOS_TYPE_LOS, readMap->GetMIPHeightMapSynced(mipLevel_), int2(mapDims.mapx, mapDims.mapy)))
+	, dirtyRects(teamHandler->ActiveAllyTeams())
 {
 }
 
@@ -239,6 +245,8 @@ inline void ILosType::LosAdd(SLosInstance* li)
 	} else {
 		losMaps[li->allyteam].AddCircle(li, 1);
 	}
+
+	AddDirtyRect(li);
 }
 
 
@@ -249,6 +257,26 @@ inline void ILosType::LosRemove(SLosInstance* li)
 	} else {
 		losMaps[li->allyteam].AddCircle(li, -1);
 	}
+
+	AddDirtyRect(li);
+}
+
+
+inline void ILosType::AddDirtyRect(const SLosInstance* li)
+{
+	// both algorithms only touch squares within <radius> of basePos
+	const int2 p = li->basePos;
+	const int r = li->radius;
+
+	dirtyRects[li->allyteam].emplace_back(p.x - r, p.y - r, p.x + r + 1, p.y + r + 1);
+}
+
+
+void ILosType::ClearDirtyRects()
+{
+	for (std::vector<SRectangle>& rects: dirtyRects) {
+		rects.clear();
+	}
 }
 
 
@@ -513,6 +541,13 @@ void ILosType::Update()
 
 	// raycast terrain
 	if (algoType == LOS_ALGO_RAYCAST)  {
+		// instances are independent, but their cost grows with radius^2; start
+		// the largest first s.t. they do not end up as the serial tail of the
+		// parallel loop (e.g. after a terraform touched many radar instances)
+		std::sort(losRecalc.begin(), losRecalc.end(), [](const SLosInstance* a, const SLosInstance* b) {
+			return (a->radius > b->radius);
+		});
+
 		for_mt(0, losRecalc.size(), [&](const int idx) {
 			auto li = losRecalc[idx];
 			assert(li->refCount > 0);
@@ -625,6 +660,10 @@ CLosHandler::CLosHandler()
 	, baseRadarErrorSize(defBaseRadarErrorSize)
 	, baseRadarErrorMult(defBaseRadarErrorMult)
 	, radarErrorSizes(teamHandler->ActiveAllyTeams(), defBaseRadarErrorSize)
+
+	, dirtyBlocksSize((mapDims.mapx * SQUARE_SIZE + DIRTY_BLOCK_SIZE - 1) / DIRTY_BLOCK_SIZE, (mapDims.mapy * SQUARE_SIZE + DIRTY_BLOCK_SIZE - 1) / DIRTY_BLOCK_SIZE)
+	, dirtyBlocks(teamHandler->ActiveAllyTeams() * dirtyBlocksSize.x * dirtyBlocksSize.y, 0)
+	, dirtyAllyTeams(teamHandler->ActiveAllyTeams(), 0)
 {
 	losTypes.reserve(ILosType::LOS_TYPE_COUNT);
 	losTypes.push_back(&los);
@@ -727,6 +766,86 @@ void CLosHandler::Update()
 
 		lt->Update();
 	});
+
+	UpdateDirtyBlocks();
+}
+
+
+void CLosHandler::UpdateDirtyBlocks()
+{
+	for (ILosType* lt: losTypes) {
+		// seismic coverage does not influence unit LOS-statuses
+		if (lt->type == ILosType::LOS_TYPE_SEISMIC) {
+			lt->ClearDirtyRects();
+			continue;
+		}
+
+		// jammer maps are indexed by the allyteam of the jammed unit (or
+		// shared by all of them), so their changes can affect every status
+		const bool jammerType = (lt->type == ILosType::LOS_TYPE_JAMMER || lt->type == ILosType::LOS_TYPE_SONAR_JAMMER);
+
+		for (int allyTeam = 0; allyTeam < lt->losMaps.size(); ++allyTeam) {
+			for (const SRectangle& rect: lt->GetDirtyRects(allyTeam)) {
+				if (!jammerType) {
+					AddDirtyBlocks(rect, lt->divisor, allyTeam);
+					continue;
+				}
+
+				for (int at = 0; at < dirtyAllyTeams.size(); ++at) {
+					AddDirtyBlocks(rect, lt->divisor, at);
+				}
+			}
+		}
+
+		lt->ClearDirtyRects();
+	}
+}
+
+
+void CLosHandler::AddDirtyBlocks(const SRectangle& rect, int divisor, int allyTeam)
+{
+	// <rect> is in LOS-squares with exclusive maxima, blocks are inclusive
+	const int x1 = Clamp((rect.x1 * divisor    ) / DIRTY_BLOCK_SIZE, 0, dirtyBlocksSize.x - 1);
+	const int z1 = Clamp((rect.z1 * divisor    ) / DIRTY_BLOCK_SIZE, 0, dirtyBlocksSize.y - 1);
+	const int x2 = Clamp((rect.x2 * divisor - 1) / DIRTY_BLOCK_SIZE, 0, dirtyBlocksSize.x - 1);
+	const int z2 = Clamp((rect.z2 * divisor - 1) / DIRTY_BLOCK_SIZE, 0, dirtyBlocksSize.y - 1);
+
+	for (int z = z1; z <= z2; ++z) {
+		unsigned char* row = &dirtyBlocks[(allyTeam * dirtyBlocksSize.y + z) * dirtyBlocksSize.x];
+
+		for (int x = x1; x <= x2; ++x) {
+			row[x] = 1;
+		}
+	}
+
+	dirtyAllyTeams[allyTeam] = 1;
+}
+
+
+void CLosHandler::ClearDirtyBlocks()
+{
+	const size_t numBlocks = dirtyBlocksSize.x * dirtyBlocksSize.y;
+
+	for (int allyTeam = 0; allyTeam < dirtyAllyTeams.size(); ++allyTeam) {
+		if (dirtyAllyTeams[allyTeam] == 0)
+			continue;
+
+		std::fill(dirtyBlocks.begin() + allyTeam * numBlocks, dirtyBlocks.begin() + (allyTeam + 1) * numBlocks, 0);
+		dirtyAllyTeams[allyTeam] = 0;
+	}
+}
+
+
+bool CLosHandler::InSameSquares(const UnitLosState& a, const UnitLosState& b) const
+{
+	for (const ILosType* lt: losTypes) {
+		if (lt->PosToSquare(a.pos) != lt->PosToSquare(b.pos))
+			return false;
+		if (lt->PosToSquare(a.pos + a.speed) != lt->PosToSquare(b.pos + b.speed))
+			return false;
+	}
+
+	return true;
 }
 
 
@@ -738,7 +857,7 @@ void CLosHandler::UpdateHeightMapSynced(SRectangle rect)
 }
 
 
-bool CLosHandler::InLos(const CUnit* unit, int allyTeam) const
+bool CLosHandler::InLos(const UnitLosState& state, int allyTeam) const
 {
 	// NOTE: units are treated differently than world objects in two ways:
 	//   1. they can be cloaked (has to be checked BEFORE all other cases)
@@ -747,34 +866,34 @@ bool CLosHandler::InLos(const CUnit* unit, int allyTeam) const
 	//      is enabled --> underwater units can NOT BE SEEN AT ALL without
 	//      active radar!
 	if (modInfo.alwaysVisibleOverridesCloaked) {
-		if (unit->alwaysVisible)
+		if (state.HasBit(UnitLosState::LOS_BIT_ALWAYSVISIBLE))
 			return true;
-		if (unit->isCloaked && unit->allyteam != allyTeam)
+		if (state.HasBit(UnitLosState::LOS_BIT_CLOAKED) && state.allyTeam != allyTeam)
 			return false;
 	} else {
-		if (unit->isCloaked && unit->allyteam != allyTeam)
+		if (state.HasBit(UnitLosState::LOS_BIT_CLOAKED) && state.allyTeam != allyTeam)
 			return false;
-		if (unit->alwaysVisible)
+		if (state.HasBit(UnitLosState::LOS_BIT_ALWAYSVISIBLE))
 			return true;
 	}
 
 	// isCloaked always overrides globalLOS
 	if (globalLOS[allyTeam])
 		return true;
-	if (unit->useAirLos)
-		return (InAirLos(unit->pos, allyTeam) || InAirLos(unit->pos + unit->speed, allyTeam));
+	if (state.HasBit(UnitLosState::LOS_BIT_USEAIRLOS))
+		return (InAirLos(state.pos, allyTeam) || InAirLos(state.pos + state.speed, allyTeam));
 
 	if (modInfo.requireSonarUnderWater) {
-		if (unit->IsUnderWater() && !InRadar(unit, allyTeam)) {
+		if (state.HasBit(UnitLosState::LOS_BIT_UNDERWATER) && !InRadar(state, allyTeam)) {
 			return false;
 		}
 	}
 
-	return (InLos(unit->pos, allyTeam) || InLos(unit->pos + unit->speed, allyTeam));
+	return (InLos(state.pos, allyTeam) || InLos(state.pos + state.speed, allyTeam));
 }
 
 
-bool CLosHandler::InAirLos(const CUnit* unit, int allyTeam) const
+bool CLosHandler::InAirLos(const UnitLosState& state, int allyTeam) const
 {
 	// NOTE: units are treated differently than world objects in two ways:
 	//   1. they can be cloaked (has to be checked BEFORE all other cases)
@@ -783,14 +902,14 @@ bool CLosHandler::InAirLos(const CUnit* unit, int allyTeam) const
 	//      is enabled --> underwater units can NOT BE SEEN AT ALL without
 	//      active radar!
 	if (modInfo.alwaysVisibleOverridesCloaked) {
-		if (unit->alwaysVisible)
+		if (state.HasBit(UnitLosState::LOS_BIT_ALWAYSVISIBLE))
 			return true;
-		if (unit->isCloaked && unit->allyteam != allyTeam)
+		if (state.HasBit(UnitLosState::LOS_BIT_CLOAKED) && state.allyTeam != allyTeam)
 			return false;
 	} else {
-		if (unit->isCloaked && unit->allyteam != allyTeam)
+		if (state.HasBit(UnitLosState::LOS_BIT_CLOAKED) && state.allyTeam != allyTeam)
 			return false;
-		if (unit->alwaysVisible)
+		if (state.HasBit(UnitLosState::LOS_BIT_ALWAYSVISIBLE))
 			return true;
 	}
 
@@ -799,12 +918,12 @@ bool CLosHandler::InAirLos(const CUnit* unit, int allyTeam) const
 		return true;
 
 	if (modInfo.requireSonarUnderWater) {
-		if (unit->IsUnderWater() && !InRadar(unit, allyTeam)) {
+		if (state.HasBit(UnitLosState::LOS_BIT_UNDERWATER) && !InRadar(state, allyTeam)) {
 			return false;
 		}
 	}
 
-	return airLos.InSight(unit->pos, allyTeam);
+	return airLos.InSight(state.pos, allyTeam);
 }
 
 
@@ -820,25 +939,27 @@ bool CLosHandler::InRadar(const float3 pos, int allyTeam) const
 }
 
 
-bool CLosHandler::InRadar(const CUnit* unit, int allyTeam) const
+bool CLosHandler::InRadar(const UnitLosState& state, int allyTeam) const
 {
+	const bool beingBuilt = state.HasBit(UnitLosState::LOS_BIT_BEINGBUILT);
+
 	// unit is discoverable by sonar
-	if (unit->IsInWater()) {
-		if ((!unit->sonarStealth || unit->beingBuilt) &&
-		    sonar.InSight(unit->pos, allyTeam) &&
-		    !InJammer(unit, allyTeam))
+	if (state.HasBit(UnitLosState::LOS_BIT_INWATER)) {
+		if ((!state.HasBit(UnitLosState::LOS_BIT_SONARSTEALTH) || beingBuilt) &&
+		    sonar.InSight(state.pos, allyTeam) &&
+		    !InJammer(state, allyTeam))
 			return true;
 	}
 
 	// unit is completely submerged, only sonar can see it
-	if (unit->IsUnderWater())
+	if (state.HasBit(UnitLosState::LOS_BIT_UNDERWATER))
 		return false;
 
 	// radar stealth
-	if (unit->stealth && !unit->beingBuilt)
+	if (state.HasBit(UnitLosState::LOS_BIT_STEALTH) && !beingBuilt)
 		return false;
 
-	return (radar.InSight(unit->pos, allyTeam) && !InJammer(unit, allyTeam));
+	return (radar.InSight(state.pos, allyTeam) && !InJammer(state, allyTeam));
 }
 
 
@@ -853,18 +974,18 @@ bool CLosHandler::InJammer(const float3 pos, int allyTeam) const
 }
 
 
-bool CLosHandler::InJammer(const CUnit* unit, int allyTeam) const
+bool CLosHandler::InJammer(const UnitLosState& state, int allyTeam) const
 {
-	if (allyTeam == unit->allyteam) {
+	if (allyTeam == state.allyTeam) {
 		return false;
 	}
 
 	//TODO handle ingame alliances
 
-	const int jammerAlly = modInfo.separateJammers ? unit->allyteam : 0;
+	const int jammerAlly = modInfo.separateJammers ? state.allyTeam : 0;
 
-	if (unit->IsUnderWater()) {
-		return sonarJammer.InSight(unit->pos, jammerAlly);
+	if (state.HasBit(UnitLosState::LOS_BIT_UNDERWATER)) {
+		return sonarJammer.InSight(state.pos, jammerAlly);
 	}
-	return jammer.InSight(unit->pos, jammerAlly);
+	return jammer.InSight(state.pos, jammerAlly);
 }
@@ -132,11 +132,17 @@ public:
 	void RemoveUnit(CUnit* unit, bool delayed = false);
 	void UpdateUnit(CUnit* unit, bool ignore = false);
 
+	// rectangles (in LOS-squares) per allyteam whose coverage may have
+	// changed since the last ClearDirtyRects call, see CLosHandler::Update
+	const std::vector<SRectangle>& GetDirtyRects(int allyTeam) const { return dirtyRects[allyTeam]; }
+	void ClearDirtyRects();
+
 private:
 	//void PostLoad();
 
 	void LosAdd(SLosInstance* instance);
 	void LosRemove(SLosInstance* instance);
+	void AddDirtyRect(const SLosInstance* instance);
 
 	void RefInstance(SLosInstance* instance);
 	void UnrefInstance(SLosInstance* instance);
@@ -189,6 +195,8 @@ private:
 	std::vector<SLosInstance*> losDeleted;
 	std::vector<SLosInstance*> losRecalc;
 
+	std::vector< std::vector<SRectangle> > dirtyRects;
+
 	static constexpr int CACHE_SIZE = 4096;
 };
 
@@ -208,7 +216,8 @@ public:
 	~CLosHandler();
 
 	// the Interface
-	bool InLos(const CUnit* unit, int allyTeam) const;
+	bool InLos(const CUnit* unit, int allyTeam) const { return (InLos(unit->GetLosState(), allyTeam)); }
+	bool InLos(const UnitLosState& state, int allyTeam) const;
 	bool InLos(const CWorldObject* obj, int allyTeam) const {
 		if (obj->alwaysVisible || globalLOS[allyTeam])
 			return true;
@@ -227,7 +236,8 @@ public:
 	}
 
 
-	bool InAirLos(const CUnit* unit, int allyTeam) const;
+	bool InAirLos(const CUnit* unit, int allyTeam) const { return (InAirLos(unit->GetLosState(), allyTeam)); }
+	bool InAirLos(const UnitLosState& state, int allyTeam) const;
 	bool InAirLos(const CWorldObject* obj, int allyTeam) const {
 		if (obj->alwaysVisible || globalLOS[allyTeam])
 			return true;
@@ -242,19 +252,36 @@ public:
 
 
 	bool InRadar(const float3 pos, int allyTeam) const;
-	bool InRadar(const CUnit* unit, int allyTeam) const;
+	bool InRadar(const CUnit* unit, int allyTeam) const { return (InRadar(unit->GetLosState(), allyTeam)); }
+	bool InRadar(const UnitLosState& state, int allyTeam) const;
 
 
 	// returns whether a square is being radar- or sonar-jammed
 	// (even when the square is not in radar- or sonar-coverage)
 	bool InJammer(const float3 pos, int allyTeam) const;
-	bool InJammer(const CUnit* unit, int allyTeam) const;
+	bool InJammer(const CUnit* unit, int allyTeam) const { return (InJammer(unit->GetLosState(), allyTeam)); }
+	bool InJammer(const UnitLosState& state, int allyTeam) const;
 
 
 	bool InSeismicDistance(const CUnit* unit, int allyTeam) const {
 		return seismic.InSight(unit->pos, allyTeam);
 	}
 
+public:
+	// whether any coverage sampled by InLos(unit) or InRadar(unit) may have
+	// changed around <pos> for <allyTeam> since the last ClearDirtyBlocks
+	bool IsDirty(const float3 pos, int allyTeam) const {
+		const int bx = Clamp(int(pos.x) / DIRTY_BLOCK_SIZE, 0, dirtyBlocksSize.x - 1);
+		const int bz = Clamp(int(pos.z) / DIRTY_BLOCK_SIZE, 0, dirtyBlocksSize.y - 1);
+		return (dirtyBlocks[(allyTeam * dirtyBlocksSize.y + bz) * dirtyBlocksSize.x + bx] != 0);
+	}
+	bool HaveDirtyBlocks(int allyTeam) const { return (dirtyAllyTeams[allyTeam] != 0); }
+
+	// whether both states sample the same squares of every LOS-type
+	bool InSameSquares(const UnitLosState& a, const UnitLosState& b) const;
+
+	void ClearDirtyBlocks();
+
 public:
 	// default operations for targeting-facilities
 	void IncreaseAllyTeamRadarErrorSize(int allyTeam) { radarErrorSizes[allyTeam] *= baseRadarErrorMult; }
@@ -286,6 +313,10 @@ public:
 	void Update() override;
 	void UpdateHeightMapSynced(SRectangle rect);
 
+private:
+	void UpdateDirtyBlocks();
+	void AddDirtyBlocks(const SRectangle& rect, int divisor, int allyTeam);
+
 public:
 	/**
 	* @brief global line-of-sight
@@ -307,10 +338,18 @@ private:
 	static constexpr float defBaseRadarErrorSize = 96.0f;
 	static constexpr float defBaseRadarErrorMult = 2.0f;
 
+	// size (in elmos) of the squares of the dirty-block grid
+	static constexpr int DIRTY_BLOCK_SIZE = SQUARE_SIZE * 64;
+
 	float baseRadarErrorSize;
 	float baseRadarErrorMult;
 	std::vector<float> radarErrorSizes;
 	std::vector<ILosType*> losTypes;
+
+	int2 dirtyBlocksSize;
+	// [allyTeam][z][x]
+	std::vector<unsigned char> dirtyBlocks;
+	std::vector<unsigned char> dirtyAllyTeams;
 };
 
 
@@ -2,6 +2,7 @@
 
 #include "LosMap.h"
 #include "LosHandler.h"
+#include "LosRaycast.h"
 #include "Map/ReadMap.h"
 #include "System/myMath.h"
 #include "System/float3.h"
@@ -14,7 +15,8 @@
 #include <algorithm>
 #include <array>
 
-constexpr float LOS_BONUS_HEIGHT = 5.0f;
+using LosRaycast::LOS_BONUS_HEIGHT;
+using LosRaycast::ToAngleMapIdx;
 
 
 
@@ -102,22 +104,14 @@ void MidpointCircleAlgoPerLine(int radius, F func)
 class CLosTableHelper
 {
 public:
-	typedef std::vector<int2> LosLine;
-	typedef std::vector<LosLine> LosTable;
+	typedef LosRaycast::LosLine LosLine;
+	typedef LosRaycast::LosTable LosTable;
 
 	// only generates table if not in cache
 	void GenerateForLosSize(size_t losSize);
 
-	const int2 GetLosTableRaySquare(size_t losSize, size_t rayIndex, size_t squareIdx) {
-		return losTables[losSize][rayIndex][squareIdx];
-	}
-
-	size_t GetLosTableRaySize(size_t losSize, size_t rayIndex) {
-		return losTables[losSize][rayIndex].size();
-	}
-
-	size_t GetLosTableSize(size_t losSize) {
-		return losTables[losSize].size();
+	const LosTable& GetLosTable(size_t losSize) const {
+		return losTables[losSize];
 	}
 
 private:
@@ -491,34 +485,6 @@ void CLosMap::LosAdd(SLosInstance* li) const
 }
 
 
-inline static constexpr size_t ToAngleMapIdx(const int2 p, const int radius)
-{
-	// [-radius, +radius]^2 -> [0, +2*radius]^2 -> idx
-	return (p.y + radius) * (2*radius + 1) + (p.x + radius);
-}
-
-
-inline void CastLos(float* prevAng, float* maxAng, const int2& off, std::vector<char>& squaresMap, std::vector<float>& anglesMap, int radius, int threadNum)
-{
-	// check if we got a new maxAngle
-	const size_t oidx = ToAngleMapIdx(off, radius);
-	if (anglesMap[oidx] < *maxAng) {
-		squaresMap[oidx] = false;
-		return;
-	}
-
-	if (anglesMap[oidx] < *prevAng) {
-		const float invR = isqrtTableLookup(off.x*off.x + off.y*off.y, threadNum);
-		*maxAng = *prevAng - LOS_BONUS_HEIGHT * invR;
-		if (anglesMap[oidx] < *maxAng) {
-			squaresMap[oidx] = false;
-			return;
-		}
-	}
-	*prevAng = anglesMap[oidx];
-}
-
-
 void CLosMap::AddSquaresToInstance(SLosInstance* li, const std::vector<char>& squaresMap) const
 {
 	const int2 pos   = li->basePos;
@@ -603,22 +569,8 @@ void CLosMap::UnsafeLosAdd(SLosInstance* li) const
 
 	// Cast the Rays
 	squaresMap[ToAngleMapIdx(int2(0,0), radius)] = true;
-	const size_t numRays = helper.GetLosTableSize(radius);
-	for (size_t i = 0; i < numRays; ++i) {
-		float maxAng[4] = {-1e7, -1e7, -1e7, -1e7};
-		float prevAng[4] = {-1e7, -1e7, -1e7, -1e7};
-
-		const size_t numSquares = helper.GetLosTableRaySize(radius, i);
 
-		for (size_t n = 0; n < numSquares; n++) {
-			const int2 square = helper.GetLosTableRaySquare(radius, i, n);
-
-			CastLos(&prevAng[0], &maxAng[0], square,                    squaresMap, anglesMap, radius, threadNum);
-			CastLos(&prevAng[1], &maxAng[1], -square,                   squaresMap, anglesMap, radius, threadNum);
-			CastLos(&prevAng[2], &maxAng[2], int2(square.y, -square.x), squaresMap, anglesMap, radius, threadNum);
-			CastLos(&prevAng[3], &maxAng[3], int2(-square.y, square.x), squaresMap, anglesMap, radius, threadNum);
-		}
-	}
+	LosRaycast::CastRays<LosRaycast::CLIP_NONE>(helper.GetLosTable(radius), &squaresMap[0], &anglesMap[0], &isqrtTables[threadNum][0], radius, pos, SRectangle(0, 0, size.x, size.y));
 
 	// translate visible square indices to map square idx + RLE
 	AddSquaresToInstance(li, squaresMap);
@@ -677,75 +629,13 @@ void CLosMap::SafeLosAdd(SLosInstance* li) const
 
 
 	// Cast the Rays
-	const size_t numRays = helper.GetLosTableSize(radius);
-
 	if (safeRect.Inside(pos)) {
 		squaresMap[ToAngleMapIdx(int2(0,0), radius)] = true;
 
-		for (size_t i = 0; i < numRays; ++i) {
-			float maxAng[4] = {-1e7, -1e7, -1e7, -1e7};
-			float prevAng[4] = {-1e7, -1e7, -1e7, -1e7};
-
-			const size_t numSquares = helper.GetLosTableRaySize(radius, i);
-
-			for (size_t n = 0; n < numSquares; n++) {
-				const int2 square = helper.GetLosTableRaySquare(radius, i, n);
-
-				if (!safeRect.Inside(pos + square))
-					break;
-
-				CastLos(&prevAng[0], &maxAng[0], square,                    squaresMap, anglesMap, radius, threadNum);
-			}
-			for (size_t n = 0; n < numSquares; n++) {
-				const int2 square = helper.GetLosTableRaySquare(radius, i, n);
-
-				if (!safeRect.Inside(pos - square))
-					break;
-
-				CastLos(&prevAng[1], &maxAng[1], -square,                   squaresMap, anglesMap, radius, threadNum);
-			}
-			for (size_t n = 0; n < numSquares; n++) {
-				const int2 square = helper.GetLosTableRaySquare(radius, i, n);
-
-				if (!safeRect.Inside(pos + int2(square.y, -square.x)))
-					break;
-
-				CastLos(&prevAng[2], &maxAng[2], int2(square.y, -square.x), squaresMap, anglesMap, radius, threadNum);
-			}
-			for (size_t n = 0; n < numSquares; n++) {
-				const int2 square = helper.GetLosTableRaySquare(radius, i, n);
-
-				if (!safeRect.Inside(pos + int2(-square.y, square.x)))
-					break;
-
-				CastLos(&prevAng[3], &maxAng[3], int2(-square.y, square.x), squaresMap, anglesMap, radius, threadNum);
-			}
-		}
+		LosRaycast::CastRays<LosRaycast::CLIP_RAYS>(helper.GetLosTable(radius), &squaresMap[0], &anglesMap[0], &isqrtTables[threadNum][0], radius, pos, safeRect);
 	} else {
 		// emit position outside the map
-		for (size_t i = 0; i < numRays; ++i) {
-			float maxAng[4] = {-1e7, -1e7, -1e7, -1e7};
-			float prevAng[4] = {-1e7, -1e7, -1e7, -1e7};
-
-			const size_t numSquares = helper.GetLosTableRaySize(radius, i);
-
-			for (size_t n = 0; n < numSquares; n++) {
-				const int2 square = helper.GetLosTableRaySquare(radius, i, n);
-
-				if (safeRect.Inside(pos + square)) {
-					CastLos(&prevAng[0], &maxAng[0], square,                    squaresMap, anglesMap, radius, threadNum);
-				}
-				if (safeRect.Inside(pos - square)) {
-					CastLos(&prevAng[1], &maxAng[1], -square,                   squaresMap, anglesMap, radius, threadNum);
-				}
-				if (safeRect.Inside(pos + int2(square.y, -square.x))) {
-					CastLos(&prevAng[2], &maxAng[2], int2(square.y, -square.x), squaresMap, anglesMap, radius, threadNum);
-				}
-				if (safeRect.Inside(pos + int2(-square.y, square.x))) {
-					CastLos(&prevAng[3], &maxAng[3], int2(-square.y, square.x), squaresMap, anglesMap, radius, threadNum);
-				}
-			}
-		}
+		LosRaycast::CastRays<LosRaycast::CLIP_SQUARES>(helper.GetLosTable(radius), &squaresMap[0], &anglesMap[0], &isqrtTables[threadNum][0], radius, pos, safeRect);
 	}
 
 	// translate visible square indices to map square idx + RLE
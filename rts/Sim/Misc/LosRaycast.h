@@ -0,0 +1,296 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef LOS_RAYCAST_H
+#define LOS_RAYCAST_H
+
+#include <algorithm>
+#include <vector>
+
+#include "System/type2.h"
+#include "System/Rectangle.h"
+
+#ifndef DEDICATED_NOSSE
+#include <xmmintrin.h>
+#endif
+
+
+/**
+ * Ray-marching kernels for CLosMap's raycast algorithm.
+ *
+ * Every ray of a LosTable (which only covers one quadrant) is cast in four
+ * rotations. Each rotation tracks the highest angle seen so far and hides
+ * all squares below it; since a ray only ever *clears* entries in squaresMap
+ * the rotations (and rays) are independent of each other, and the SSE kernel
+ * casts all four rotations of a ray per iteration. It performs the same float
+ * operations per lane as the scalar kernel, so both produce bit-identical
+ * squaresMaps.
+ */
+namespace LosRaycast {
+	typedef std::vector<int2> LosLine;
+	typedef std::vector<LosLine> LosTable;
+
+	static constexpr float LOS_BONUS_HEIGHT = 5.0f;
+	static constexpr float MIN_RAY_ANGLE = -1e7f;
+
+	enum ClipMode {
+		CLIP_NONE,    ///< all squares of all rays lie on the map
+		CLIP_RAYS,    ///< emitter is on the map, rays end at their first square off it
+		CLIP_SQUARES, ///< emitter is off the map, squares off it are skipped
+	};
+
+
+	inline static constexpr size_t ToAngleMapIdx(const int2 p, const int radius)
+	{
+		// [-radius, +radius]^2 -> [0, +2*radius]^2 -> idx
+		return (p.y + radius) * (2*radius + 1) + (p.x + radius);
+	}
+
+	inline static int2 RotateSquare(const int2 square, const int rotation)
+	{
+		switch (rotation) {
+			case  0: return (             square             );
+			case  1: return (            -square             );
+			case  2: return (int2( square.y, -square.x));
+			default: return (int2(-square.y,  square.x));
+		}
+	}
+
+
+	inline static void CastLos(float* prevAng, float* maxAng, const int2& off, char* squaresMap, const float* anglesMap, const float* isqrtTable, int radius)
+	{
+		// check if we got a new maxAngle
+		const size_t oidx = ToAngleMapIdx(off, radius);
+		if (anglesMap[oidx] < *maxAng) {
+			squaresMap[oidx] = false;
+			return;
+		}
+
+		if (anglesMap[oidx] < *prevAng) {
+			const float invR = isqrtTable[off.x*off.x + off.y*off.y];
+			*maxAng = *prevAng - LOS_BONUS_HEIGHT * invR;
+			if (anglesMap[oidx] < *maxAng) {
+				squaresMap[oidx] = false;
+				return;
+			}
+		}
+		*prevAng = anglesMap[oidx];
+	}
+
+
+	template<ClipMode clipMode>
+	inline void CastRaysScalar(
+		const LosTable& rays,
+		char* squaresMap,
+		const float* anglesMap,
+		const float* isqrtTable,
+		const int radius,
+		const int2 pos,
+		const SRectangle& mapRect
+	) {
+		for (size_t i = 0; i < rays.size(); ++i) {
+			for (int rot = 0; rot < 4; ++rot) {
+				float maxAng = MIN_RAY_ANGLE;
+				float prevAng = MIN_RAY_ANGLE;
+
+				for (const int2 square: rays[i]) {
+					const int2 off = RotateSquare(square, rot);
+
+					if (clipMode != CLIP_NONE && !mapRect.Inside(pos + off)) {
+						if (clipMode == CLIP_RAYS)
+							break;
+
+						continue;
+					}
+
+					CastLos(&prevAng, &maxAng, off, squaresMap, anglesMap, isqrtTable, radius);
+				}
+			}
+		}
+	}
+
+
+	/**
+	 * Returns the index-range [x, y) of the squares of the rotated ray that
+	 * lie on the map. Both coordinates of a ray's squares grow monotonically
+	 * (see CLosTableHelper::GetRay), so each bound of <mapRect> is crossed at
+	 * most once and the on-map squares always form one contiguous range.
+	 */
+	template<ClipMode clipMode>
+	inline static int2 GetOnMapRange(const LosLine& ray, const int rot, const int2 pos, const SRectangle& mapRect)
+	{
+		int2 range = {0, int(ray.size())};
+
+		if (clipMode == CLIP_NONE || ray.empty())
+			return range;
+
+		const auto ClipRange = [&](const auto& onMapSide) {
+			const bool frontOnMap = onMapSide(RotateSquare(ray.front(), rot));
+			const bool backOnMap = onMapSide(RotateSquare(ray.back(), rot));
+
+			if (frontOnMap == backOnMap) {
+				if (!frontOnMap)
+					range = {0, 0};
+
+				return;
+			}
+
+			if (backOnMap) {
+				// entering the map
+				const auto iter = std::partition_point(ray.begin(), ray.end(), [&](const int2 sq) { return !onMapSide(RotateSquare(sq, rot)); });
+				range.x = std::max(range.x, int(iter - ray.begin()));
+			} else {
+				// leaving the map
+				const auto iter = std::partition_point(ray.begin(), ray.end(), [&](const int2 sq) { return onMapSide(RotateSquare(sq, rot)); });
+				range.y = std::min(range.y, int(iter - ray.begin()));
+			}
+		};
+
+		ClipRange([&](const int2 off) { return ((pos.x + off.x) >= mapRect.x1); });
+		ClipRange([&](const int2 off) { return ((pos.x + off.x) <  mapRect.x2); });
+		ClipRange([&](const int2 off) { return ((pos.y + off.y) >= mapRect.y1); });
+		ClipRange([&](const int2 off) { return ((pos.y + off.y) <  mapRect.y2); });
+
+		// if the emitter is on the map, range.x is always 0 and range.y is
+		// the first square off it (where CLIP_RAYS would stop the ray)
+		range.y = std::max(range.x, range.y);
+		return range;
+	}
+
+	// bit <k> of the result is set iff the k-th rotation of the n-th square is on the map
+	inline static int GetOnMapLanes(const int2* ranges, const int n)
+	{
+		int lanes = 0;
+
+		for (int rot = 0; rot < 4; ++rot) {
+			lanes |= (int(n >= ranges[rot].x && n < ranges[rot].y) << rot);
+		}
+
+		return lanes;
+	}
+
+
+#ifndef DEDICATED_NOSSE
+	inline static __m128 SelectSSE(const __m128 mask, const __m128 a, const __m128 b)
+	{
+		return (_mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)));
+	}
+
+	inline static __m128 LaneMaskSSE(const int lanes)
+	{
+		const __m128 bits = _mm_setr_ps(lanes & 1, lanes & 2, lanes & 4, lanes & 8);
+		return (_mm_cmpneq_ps(bits, _mm_setzero_ps()));
+	}
+
+	// the four lanes of <ang> are the four rotations of the same square and
+	// hence share the same distance (and bonus) to the emitter; lanes not in
+	// <active> are left untouched
+	template<bool allLanes>
+	inline static void CastLosSSE(
+		__m128& prevAng,
+		__m128& maxAng,
+		const __m128 ang,
+		const float bonus,
+		const int active,
+		const size_t* oidx,
+		char* squaresMap
+	) {
+		const __m128 activeMask = allLanes? _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps()): LaneMaskSSE(active);
+
+		const __m128 belowMax  = _mm_cmplt_ps(ang, maxAng);
+		const __m128 belowPrev = _mm_and_ps(_mm_andnot_ps(belowMax, _mm_cmplt_ps(ang, prevAng)), activeMask);
+
+		maxAng = SelectSSE(belowPrev, _mm_sub_ps(prevAng, _mm_set1_ps(bonus)), maxAng);
+
+		const __m128 belowNewMax = _mm_and_ps(belowPrev, _mm_cmplt_ps(ang, maxAng));
+		const __m128 hidden = _mm_and_ps(_mm_or_ps(belowMax, belowNewMax), activeMask);
+
+		prevAng = SelectSSE(_mm_andnot_ps(hidden, activeMask), ang, prevAng);
+
+		// branchless; inactive lanes point at valid squares and are never hidden
+		const int hiddenLanes = _mm_movemask_ps(hidden);
+
+		for (int k = 0; k < 4; ++k) {
+			squaresMap[oidx[k]] &= (((hiddenLanes >> k) & 1) ^ 1);
+		}
+	}
+
+	template<ClipMode clipMode>
+	inline void CastRaysSSE(
+		const LosTable& rays,
+		char* squaresMap,
+		const float* anglesMap,
+		const float* isqrtTable,
+		const int radius,
+		const int2 pos,
+		const SRectangle& mapRect
+	) {
+		for (size_t i = 0; i < rays.size(); ++i) {
+			const LosLine& ray = rays[i];
+
+			const int2 ranges[4] = {
+				GetOnMapRange<clipMode>(ray, 0, pos, mapRect),
+				GetOnMapRange<clipMode>(ray, 1, pos, mapRect),
+				GetOnMapRange<clipMode>(ray, 2, pos, mapRect),
+				GetOnMapRange<clipMode>(ray, 3, pos, mapRect),
+			};
+
+			const int first = std::min(std::min(ranges[0].x, ranges[1].x), std::min(ranges[2].x, ranges[3].x));
+			const int last  = std::max(std::max(ranges[0].y, ranges[1].y), std::max(ranges[2].y, ranges[3].y));
+
+			__m128 maxAng = _mm_set1_ps(MIN_RAY_ANGLE);
+			__m128 prevAng = _mm_set1_ps(MIN_RAY_ANGLE);
+
+			for (int n = first; n < last; ++n) {
+				const int2 square = ray[n];
+				const int activeLanes = (clipMode == CLIP_NONE)? 0xF: GetOnMapLanes(ranges, n);
+
+				if (activeLanes == 0)
+					continue;
+
+				const size_t oidx[4] = {
+					ToAngleMapIdx(RotateSquare(square, 0), radius),
+					ToAngleMapIdx(RotateSquare(square, 1), radius),
+					ToAngleMapIdx(RotateSquare(square, 2), radius),
+					ToAngleMapIdx(RotateSquare(square, 3), radius),
+				};
+
+				const __m128 ang = _mm_setr_ps(anglesMap[oidx[0]], anglesMap[oidx[1]], anglesMap[oidx[2]], anglesMap[oidx[3]]);
+				const float bonus = LOS_BONUS_HEIGHT * isqrtTable[square.x*square.x + square.y*square.y];
+
+				if (activeLanes == 0xF) {
+					CastLosSSE<true>(prevAng, maxAng, ang, bonus, activeLanes, oidx, squaresMap);
+				} else {
+					CastLosSSE<false>(prevAng, maxAng, ang, bonus, activeLanes, oidx, squaresMap);
+				}
+			}
+		}
+	}
+#endif
+
+
+
+
+	/**
+	 * Casts all (rotated) rays of <rays> from the center of the angles-map and
+	 * clears the entries of every square in <squaresMap> that is hidden by the
+	 * terrain in front of it. <pos> and <mapRect> are only used for clipping.
+	 */
+	template<ClipMode clipMode>
+	inline void CastRays(
+		const LosTable& rays,
+		char* squaresMap,
+		const float* anglesMap,
+		const float* isqrtTable,
+		const int radius,
+		const int2 pos,
+		const SRectangle& mapRect
+	) {
+	#ifndef DEDICATED_NOSSE
+		CastRaysSSE<clipMode>(rays, squaresMap, anglesMap, isqrtTable, radius, pos, mapRect);
+	#else
+		CastRaysScalar<clipMode>(rays, squaresMap, anglesMap, isqrtTable, radius, pos, mapRect);
+	#endif
+	}
+}
+
+#endif
@@ -80,6 +80,7 @@ void CModInfo::ResetState()
 	pathFinderSystem = PFS_TYPE_DEFAULT;
 	pfRawDistMult    = 1.25f;
 	pfUpdateRate     = 0.007f;
+	pfQueueDelay     = 1;
 
 	allowTake = true;
 }
@@ -117,6 +118,7 @@ void CModInfo::Init(const char* modArchive)
 		pathFinderSystem = system.GetInt("pathFinderSystem", PFS_TYPE_DEFAULT) % PFS_NUM_TYPES;
 		pfRawDistMult = system.GetFloat("pathFinderRawDistMult", pfRawDistMult);
 		pfUpdateRate = system.GetFloat("pathFinderUpdateRate", pfUpdateRate);
+		pfQueueDelay = std::max(0, system.GetInt("pathFinderQueueDelay", pfQueueDelay));
 
 		allowTake = system.GetBool("allowTake", true);
 	}
@@ -147,6 +147,8 @@ public:
 	int pathFinderSystem;
 	float pfRawDistMult;
 	float pfUpdateRate;
+	/// number of sim-frames by which (default PFS) path-searches for units are deferred, 0 to disable
+	int pfQueueDelay;
 
 	bool allowTake;
 };
@@ -8,13 +8,12 @@
 #include "Sim/Misc/GlobalSynced.h"
 #include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/TeamHandler.h"
-
-#ifndef UNIT_TEST
-	#include "Sim/Features/Feature.h"
-	#include "Sim/Projectiles/Projectile.h"
-	#include "Sim/Units/Unit.h"
-	#include "Sim/Weapons/PlasmaRepulser.h"
-#endif
+#include "Sim/Features/Feature.h"
+#include "Sim/Projectiles/Projectile.h"
+#include "Sim/Units/Unit.h"
+#include "Sim/Weapons/PlasmaRepulser.h"
+#include "System/ContainerUtil.h"
+#include "System/Log/ILog.h"
 
 CR_BIND(CQuadField, (int2(1,1), 1))
 CR_REG_METADATA(CQuadField, (
@@ -24,11 +23,8 @@ CR_REG_METADATA(CQuadField, (
 	CR_MEMBER(quadSizeX),
 	CR_MEMBER(quadSizeZ),
 
-	CR_IGNORED(tempUnits),
-	CR_IGNORED(tempFeatures),
-	CR_IGNORED(tempProjectiles),
-	CR_IGNORED(tempSolids),
-	CR_IGNORED(tempQuads)
+	CR_IGNORED(unitQuadsVersion),
+	CR_IGNORED(solidQuadsVersion)
 ))
 
 CR_BIND(CQuadField::Quad, )
@@ -38,6 +34,7 @@ CR_REG_METADATA_SUB(CQuadField, Quad, (
 	CR_MEMBER(features),
 	CR_MEMBER(projectiles),
 	CR_MEMBER(repulsers),
+	CR_IGNORED(solidsVersion),
 
 	CR_POSTLOAD(PostLoad)
 ))
@@ -45,77 +42,149 @@ CR_REG_METADATA_SUB(CQuadField, Quad, (
 CQuadField* quadField = NULL;
 
 
-#ifndef UNIT_TEST
-/*
-void CQuadField::Resize(int quad_size)
+int CQuadField::GetResizedQuadSize(int quadSize, int maxQuadLoad, int2 mapSize)
 {
-	CQuadField* oldQuadField = quadField;
-	CQuadField* newQuadField = new CQuadField(int2(mapDims.mapx, mapDims.mapy), quad_size);
+	const auto IsValidSize = [&](int size) {
+		if (size < int(MIN_QUAD_SIZE) || size > int(BASE_QUAD_SIZE))
+			return false;
+		if ((mapSize.x % size) != 0 || (mapSize.y % size) != 0)
+			return false;
 
-	quadField = NULL;
+		return ((mapSize.x / size) * (mapSize.y / size) <= MAX_NUM_QUADS);
+	};
 
-	for (int zq = 0; zq < oldQuadField->GetNumQuadsZ(); zq++) {
-		for (int xq = 0; xq < oldQuadField->GetNumQuadsX(); xq++) {
-			const CQuadField::Quad& quad = oldQuadField->GetQuadAt(xq, zq);
+	if (maxQuadLoad > MAX_QUAD_LOAD && IsValidSize(quadSize >> 1))
+		return (quadSize >> 1);
 
-			// COPY the object lists because the Remove* functions modify them
-			// NOTE:
-			//   teamUnits is updated internally by RemoveUnit and MovedUnit
-			//
-			//   if a unit exists in multiple quads in the old field, it will
-			//   be removed from all of them and there is no danger of double
-			//   re-insertion (important if new grid has higher resolution)
-			const std::vector<CUnit*      > units       = quad.units;
-			const std::vector<CFeature*   > features    = quad.features;
-			const std::vector<CProjectile*> projectiles = quad.projectiles;
+	// doubling the size can at most quadruple the load, so the
+	// threshold for growing has to be well below MAX_QUAD_LOAD/4
+	// to not immediately trigger another split
+	if (maxQuadLoad < (MAX_QUAD_LOAD >> 3) && IsValidSize(quadSize << 1))
+		return (quadSize << 1);
 
-			for (auto it = units.cbegin(); it != units.cend(); ++it) {
-				oldQuadField->RemoveUnit(*it);
-				newQuadField->MovedUnit(*it); // handles addition
-			}
+	return quadSize;
+}
 
-			for (auto it = features.cbegin(); it != features.cend(); ++it) {
-				oldQuadField->RemoveFeature(*it);
-				newQuadField->AddFeature(*it);
-			}
 
-			for (auto it = projectiles.cbegin(); it != projectiles.cend(); ++it) {
-				oldQuadField->RemoveProjectile(*it);
-				newQuadField->AddProjectile(*it);
-			}
+void CQuadField::Update(int frameNum)
+{
+	if ((frameNum % RESIZE_CHECK_RATE) != 0)
+		return;
+
+	size_t maxQuadLoad = 0;
+
+	for (const Quad& quad: baseQuads) {
+		maxQuadLoad = std::max(maxQuadLoad, quad.units.size());
+	}
+
+	const int2 mapSize = int2(numQuadsX * quadSizeX, numQuadsZ * quadSizeZ);
+	const int newQuadSize = GetResizedQuadSize(quadSizeX, int(maxQuadLoad), mapSize);
+
+	if (newQuadSize == quadSizeX)
+		return;
+
+	LOG_L(L_DEBUG, "[QuadField::%s] resizing quads from %d to %d elmos (max. load %d units)", __func__, quadSizeX, newQuadSize, int(maxQuadLoad));
+	Resize(newQuadSize);
+}
+
+void CQuadField::Resize(int quadSize)
+{
+	std::vector<CUnit*> units;
+	std::vector<CFeature*> features;
+	std::vector<CProjectile*> projectiles;
+	std::vector<CPlasmaRepulser*> repulsers;
+
+	// gather every object exactly once; objects that span multiple
+	// quads are collected the first time they are encountered
+	const int tempNum = gs->GetTempNum();
+
+	for (const Quad& quad: baseQuads) {
+		for (CUnit* u: quad.units) {
+			if (u->tempNum == tempNum)
+				continue;
+
+			u->tempNum = tempNum;
+			units.push_back(u);
+		}
+		for (CFeature* f: quad.features) {
+			if (f->tempNum == tempNum)
+				continue;
+
+			f->tempNum = tempNum;
+			features.push_back(f);
+		}
+		for (CProjectile* p: quad.projectiles) {
+			if (p->tempNum == tempNum)
+				continue;
+
+			p->tempNum = tempNum;
+			projectiles.push_back(p);
+		}
+		for (CPlasmaRepulser* r: quad.repulsers) {
+			if (r->tempNum == tempNum)
+				continue;
+
+			r->tempNum = tempNum;
+			repulsers.push_back(r);
 		}
 	}
 
-	quadField = newQuadField;
+	numQuadsX = (numQuadsX * quadSizeX) / quadSize;
+	numQuadsZ = (numQuadsZ * quadSizeZ) / quadSize;
+	quadSizeX = quadSize;
+	quadSizeZ = quadSize;
 
-	// do this last so pointer is never dangling
-	delete oldQuadField;
+	assert(numQuadsX >= 1);
+	assert(numQuadsZ >= 1);
+
+	baseQuads.clear();
+	baseQuads.resize(numQuadsX * numQuadsZ);
+
+	// all cached quad-indices refer to the old grid
+	for (CUnit* u: units) {
+		u->quads.clear();
+		MovedUnit(u);
+	}
+	for (CFeature* f: features) {
+		AddFeature(f);
+	}
+	for (CProjectile* p: projectiles) {
+		AddProjectile(p);
+	}
+	for (CPlasmaRepulser* r: repulsers) {
+		r->quads.clear();
+		MovedRepulser(r);
+	}
+
+	unitQuadsVersion++;
+	solidQuadsVersion++;
+
+	// quad-indices cached by others refer to the old grid as well
+	for (Quad& quad: baseQuads) {
+		quad.solidsVersion = solidQuadsVersion;
+	}
 }
-*/
-#endif
 
 
 CQuadField::Quad::Quad()
 {
-#ifndef UNIT_TEST
 	teamUnits.resize(teamHandler->ActiveAllyTeams());
 	assert(teamUnits.capacity() == teamHandler->ActiveAllyTeams());
-#endif
 }
 
 void CQuadField::Quad::PostLoad()
 {
-#ifndef UNIT_TEST
 	for (CUnit* unit: units) {
 		spring::VectorInsertUnique(teamUnits[unit->allyteam], unit, false);
 	}
-#endif
 }
 
 CQuadField::CQuadField(int2 mapDims, int quad_size)
 {
 	quadSizeX = quad_size;
 	quadSizeZ = quad_size;
+	unitQuadsVersion = 0;
+	solidQuadsVersion = 0;
 	numQuadsX = (mapDims.x * SQUARE_SIZE) / quad_size;
 	numQuadsZ = (mapDims.y * SQUARE_SIZE) / quad_size;
 
@@ -133,6 +202,15 @@ CQuadField::~CQuadField()
 }
 
 
+CQuadField::QueryScratch& CQuadField::GetQueryScratch()
+{
+	// not indexed by ThreadPool::GetThreadNum, which is shared by the sync
+	// and async workers and is 0 for every thread outside the pool
+	static thread_local QueryScratch queryScratch;
+	return queryScratch;
+}
+
+
 int2 CQuadField::WorldPosToQuadField(const float3 p) const
 {
 	return int2(
@@ -148,12 +226,11 @@ int CQuadField::WorldPosToQuadFieldIdx(const float3 p) const
 }
 
 
-#ifndef UNIT_TEST
 void CQuadField::GetQuads(QuadFieldQuery& qfq, float3 pos, float radius)
 {
 	pos.AssertNaNs();
 	pos.ClampInBounds();
-	qfq.quads = tempQuads.GetVector();
+	qfq.quads = GetQueryScratch().tempQuads.GetVector();
 
 	const int2 min = WorldPosToQuadField(pos - radius);
 	const int2 max = WorldPosToQuadField(pos + radius);
@@ -183,7 +260,7 @@ void CQuadField::GetQuadsRectangle(QuadFieldQuery& qfq, const float3& mins, cons
 {
 	mins.AssertNaNs();
 	maxs.AssertNaNs();
-	qfq.quads = tempQuads.GetVector();
+	qfq.quads = GetQueryScratch().tempQuads.GetVector();
 
 	const int2 min = WorldPosToQuadField(mins);
 	const int2 max = WorldPosToQuadField(maxs);
@@ -201,7 +278,6 @@ void CQuadField::GetQuadsRectangle(QuadFieldQuery& qfq, const float3& mins, cons
 
 	return;
 }
-#endif // UNIT_TEST
 
 
 /// note: this function got an UnitTest, check the tests/ folder!
@@ -209,7 +285,7 @@ void CQuadField::GetQuadsOnRay(QuadFieldQuery& qfq, const float3& start, const f
 {
 	dir.AssertNaNs();
 	start.AssertNaNs();
-	qfq.quads = tempQuads.GetVector();
+	qfq.quads = GetQueryScratch().tempQuads.GetVector();
 
 	const float3 to = start + (dir * length);
 	const float3 invQuadSize = float3(1.0f / quadSizeX, 1.0f, 1.0f / quadSizeZ);
@@ -280,7 +356,33 @@ void CQuadField::GetQuadsOnRay(QuadFieldQuery& qfq, const float3& start, const f
 }
 
 
-#ifndef UNIT_TEST
+void CQuadField::SolidQuadsChanged(const std::vector<int>& quads, const std::vector<int>& moreQuads)
+{
+	solidQuadsVersion++;
+
+	for (const int qi: quads) {
+		baseQuads[qi].solidsVersion = solidQuadsVersion;
+	}
+	for (const int qi: moreQuads) {
+		baseQuads[qi].solidsVersion = solidQuadsVersion;
+	}
+}
+
+bool CQuadField::SolidQuadsChangedSince(const std::vector<int>& quads, unsigned int version) const
+{
+	for (const int qi: quads) {
+		// the grid was resized, <quads> is not even valid anymore
+		if (unsigned(qi) >= baseQuads.size())
+			return true;
+		// wrap-around safe version of solidsVersion > version
+		if (int(baseQuads[qi].solidsVersion - version) > 0)
+			return true;
+	}
+
+	return false;
+}
+
+
 void CQuadField::MovedUnit(CUnit* unit)
 {
 	QuadFieldQuery qfQuery;
@@ -303,7 +405,10 @@ void CQuadField::MovedUnit(CUnit* unit)
 		spring::VectorInsertUnique(baseQuads[qi].teamUnits[unit->allyteam], unit, false);
 	}
 
+	SolidQuadsChanged(unit->quads, *qfQuery.quads);
+
 	unit->quads = std::move(*qfQuery.quads);
+	unitQuadsVersion++;
 }
 
 void CQuadField::RemoveUnit(CUnit* unit)
@@ -313,7 +418,10 @@ void CQuadField::RemoveUnit(CUnit* unit)
 		spring::VectorErase(baseQuads[qi].teamUnits[unit->allyteam], unit);
 	}
 
+	SolidQuadsChanged(unit->quads);
+
 	unit->quads.clear();
+	unitQuadsVersion++;
 
 	#ifdef DEBUG_QUADFIELD
 	for (const Quad& q: baseQuads) {
@@ -347,6 +455,8 @@ void CQuadField::MovedRepulser(CPlasmaRepulser* repulser)
 		spring::VectorInsertUnique(baseQuads[qi].repulsers, repulser, false);
 	}
 
+	SolidQuadsChanged(repulser->quads, *qfQuery.quads);
+
 	repulser->quads = std::move(*qfQuery.quads);
 }
 
@@ -356,6 +466,8 @@ void CQuadField::RemoveRepulser(CPlasmaRepulser* repulser)
 		spring::VectorErase(baseQuads[qi].repulsers, repulser);
 	}
 
+	SolidQuadsChanged(repulser->quads);
+
 	repulser->quads.clear();
 
 	#ifdef DEBUG_QUADFIELD
@@ -376,6 +488,8 @@ void CQuadField::AddFeature(CFeature* feature)
 	for (const int qi: *qfQuery.quads) {
 		spring::VectorInsertUnique(baseQuads[qi].features, feature, false);
 	}
+
+	SolidQuadsChanged(*qfQuery.quads);
 }
 
 void CQuadField::RemoveFeature(CFeature* feature)
@@ -387,6 +501,8 @@ void CQuadField::RemoveFeature(CFeature* feature)
 		spring::VectorErase(baseQuads[qi].features, feature);
 	}
 
+	SolidQuadsChanged(*qfQuery.quads);
+
 	#ifdef DEBUG_QUADFIELD
 	for (const Quad& q: baseQuads) {
 		for (CFeature* f: q.features) {
@@ -453,15 +569,15 @@ void CQuadField::GetUnits(QuadFieldQuery& qfq, const float3& pos, float radius)
 {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.units = tempUnits.GetVector();
+	QueryScratch& scratch = GetQueryScratch();
+	scratch.BeginQuery();
+	qfq.units = scratch.tempUnits.GetVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* u: baseQuads[qi].units) {
-			if (u->tempNum == tempNum)
+			if (!scratch.Visit(scratch.unitMarks, u->id))
 				continue;
 
-			u->tempNum = tempNum;
 			qfq.units->push_back(u);
 		}
 	}
@@ -473,16 +589,15 @@ void CQuadField::GetUnitsExact(QuadFieldQuery& qfq, const float3& pos, float rad
 {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.units = tempUnits.GetVector();
+	QueryScratch& scratch = GetQueryScratch();
+	scratch.BeginQuery();
+	qfq.units = scratch.tempUnits.GetVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* u: baseQuads[qi].units) {
-			if (u->tempNum == tempNum)
+			if (!scratch.Visit(scratch.unitMarks, u->id))
 				continue;
 
-			u->tempNum = tempNum;
-
 			const float totRad       = radius + u->radius;
 			const float totRadSq     = totRad * totRad;
 			const float posUnitDstSq = spherical?
@@ -503,17 +618,16 @@ void CQuadField::GetUnitsExact(QuadFieldQuery& qfq, const float3& mins, const fl
 {
 	QuadFieldQuery qfQuery;
 	GetQuadsRectangle(qfQuery, mins, maxs);
-	const int tempNum = gs->GetTempNum();
-	qfq.units = tempUnits.GetVector();
+	QueryScratch& scratch = GetQueryScratch();
+	scratch.BeginQuery();
+	qfq.units = scratch.tempUnits.GetVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* unit: baseQuads[qi].units) {
 
-			if (unit->tempNum == tempNum)
+			if (!scratch.Visit(scratch.unitMarks, unit->id))
 				continue;
 
-			unit->tempNum = tempNum;
-
 			const float3& pos = unit->pos;
 			if (pos.x < mins.x || pos.x > maxs.x)
 				continue;
@@ -532,16 +646,15 @@ void CQuadField::GetFeaturesExact(QuadFieldQuery& qfq, const float3& pos, float
 {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.features = tempFeatures.GetVector();
+	QueryScratch& scratch = GetQueryScratch();
+	scratch.BeginQuery();
+	qfq.features = scratch.tempFeatures.GetVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CFeature* f: baseQuads[qi].features) {
-			if (f->tempNum == tempNum)
+			if (!scratch.Visit(scratch.featureMarks, f->id))
 				continue;
 
-			f->tempNum = tempNum;
-
 			const float totRad       = radius + f->radius;
 			const float totRadSq     = totRad * totRad;
 			const float posDstSq = spherical?
@@ -562,16 +675,15 @@ void CQuadField::GetFeaturesExact(QuadFieldQuery& qfq, const float3& mins, const
 {
 	QuadFieldQuery qfQuery;
 	GetQuadsRectangle(qfQuery, mins, maxs);
-	const int tempNum = gs->GetTempNum();
-	qfq.features = tempFeatures.GetVector();
+	QueryScratch& scratch = GetQueryScratch();
+	scratch.BeginQuery();
+	qfq.features = scratch.tempFeatures.GetVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CFeature* feature: baseQuads[qi].features) {
-			if (feature->tempNum == tempNum)
+			if (!scratch.Visit(scratch.featureMarks, feature->id))
 				continue;
 
-			feature->tempNum = tempNum;
-
 			const float3& pos = feature->pos;
 			if (pos.x < mins.x || pos.x > maxs.x)
 				continue;
@@ -591,16 +703,15 @@ void CQuadField::GetProjectilesExact(QuadFieldQuery& qfq, const float3& pos, flo
 {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.projectiles = tempProjectiles.GetVector();
+	QueryScratch& scratch = GetQueryScratch();
+	scratch.BeginQuery();
+	qfq.projectiles = scratch.tempProjectiles.GetVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CProjectile* p: baseQuads[qi].projectiles) {
-			if (p->tempNum == tempNum)
+			if (!scratch.Visit(scratch.projectileMarks, p->id))
 				continue;
 
-			p->tempNum = tempNum;
-
 			if (pos.SqDistance(p->pos) >= Square(radius + p->radius))
 				continue;
 
@@ -615,16 +726,15 @@ void CQuadField::GetProjectilesExact(QuadFieldQuery& qfq, const float3& mins, co
 {
 	QuadFieldQuery qfQuery;
 	GetQuadsRectangle(qfQuery, mins, maxs);
-	const int tempNum = gs->GetTempNum();
-	qfq.projectiles = tempProjectiles.GetVector();
+	QueryScratch& scratch = GetQueryScratch();
+	scratch.BeginQuery();
+	qfq.projectiles = scratch.tempProjectiles.GetVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CProjectile* p: baseQuads[qi].projectiles) {
-			if (p->tempNum == tempNum)
+			if (!scratch.Visit(scratch.projectileMarks, p->id))
 				continue;
 
-			p->tempNum = tempNum;
-
 			const float3& pos = p->pos;
 			if (pos.x < mins.x || pos.x > maxs.x)
 				continue;
@@ -649,16 +759,15 @@ void CQuadField::GetSolidsExact(
 ) {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
-	qfq.solids = tempSolids.GetVector();
+	QueryScratch& scratch = GetQueryScratch();
+	scratch.BeginQuery();
+	qfq.solids = scratch.tempSolids.GetVector();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* u: baseQuads[qi].units) {
-			if (u->tempNum == tempNum)
+			if (!scratch.Visit(scratch.unitMarks, u->id))
 				continue;
 
-			u->tempNum = tempNum;
-
 			if (!u->HasPhysicalStateBit(physicalStateBits))
 				continue;
 			if (!u->HasCollidableStateBit(collisionStateBits))
@@ -670,11 +779,9 @@ void CQuadField::GetSolidsExact(
 		}
 
 		for (CFeature* f: baseQuads[qi].features) {
-			if (f->tempNum == tempNum)
+			if (!scratch.Visit(scratch.featureMarks, f->id))
 				continue;
 
-			f->tempNum = tempNum;
-
 			if (!f->HasPhysicalStateBit(physicalStateBits))
 				continue;
 			if (!f->HasCollidableStateBit(collisionStateBits))
@@ -698,15 +805,14 @@ bool CQuadField::NoSolidsExact(
 ) {
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	const int tempNum = gs->GetTempNum();
+	QueryScratch& scratch = GetQueryScratch();
+	scratch.BeginQuery();
 
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* u: baseQuads[qi].units) {
-			if (u->tempNum == tempNum)
+			if (!scratch.Visit(scratch.unitMarks, u->id))
 				continue;
 
-			u->tempNum = tempNum;
-
 			if (!u->HasPhysicalStateBit(physicalStateBits))
 				continue;
 			if (!u->HasCollidableStateBit(collisionStateBits))
@@ -718,11 +824,9 @@ bool CQuadField::NoSolidsExact(
 		}
 
 		for (CFeature* f: baseQuads[qi].features) {
-			if (f->tempNum == tempNum)
+			if (!scratch.Visit(scratch.featureMarks, f->id))
 				continue;
 
-			f->tempNum = tempNum;
-
 			if (!f->HasPhysicalStateBit(physicalStateBits))
 				continue;
 			if (!f->HasCollidableStateBit(collisionStateBits))
@@ -739,6 +843,18 @@ bool CQuadField::NoSolidsExact(
 
 
 // optimization specifically for projectile collisions
+static bool InColVolRange(const float3& pos, float radius, const CSolidObject* o, const CollisionVolume* colvol)
+{
+	const float totRad = radius + colvol->GetBoundingRadius();
+	return (pos.SqDistance(colvol->GetWorldSpacePos(o)) < (totRad * totRad));
+}
+
+static bool InRepulserRange(const float3& pos, float radius, const CPlasmaRepulser* r)
+{
+	const float totRad = radius + r->collisionVolume.GetBoundingRadius();
+	return (pos.SqDistance(r->weaponMuzzlePos) < (totRad * totRad));
+}
+
 void CQuadField::GetUnitsAndFeaturesColVol(
 	const float3& pos,
 	const float radius,
@@ -746,26 +862,23 @@ void CQuadField::GetUnitsAndFeaturesColVol(
 	std::vector<CFeature*>& features,
 	std::vector<CPlasmaRepulser*>* repulsers
 ) {
-	const int tempNum = gs->GetTempNum();
+	QueryScratch& scratch = GetQueryScratch();
+	scratch.BeginQuery();
+
+	// start counting from the previous object-cache sizes
+	const size_t numRepulsers = (repulsers != nullptr)? repulsers->size(): 0;
 
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, pos, radius);
-	// start counting from the previous object-cache sizes
 
 	for (const int qi: *qfQuery.quads) {
 		const Quad& quad = baseQuads[qi];
 
 		for (CUnit* u: quad.units) {
 			// prevent double adding
-			if (u->tempNum == tempNum)
+			if (!scratch.Visit(scratch.unitMarks, u->id))
 				continue;
-
-			u->tempNum = tempNum;
-
-			const auto* colvol = &u->collisionVolume;
-			const float totRad = radius + colvol->GetBoundingRadius();
-
-			if (pos.SqDistance(colvol->GetWorldSpacePos(u)) >= (totRad * totRad))
+			if (!InColVolRange(pos, radius, u, &u->collisionVolume))
 				continue;
 
 			units.push_back(u);
@@ -773,31 +886,21 @@ void CQuadField::GetUnitsAndFeaturesColVol(
 
 		for (CFeature* f: quad.features) {
 			// prevent double adding
-			if (f->tempNum == tempNum)
+			if (!scratch.Visit(scratch.featureMarks, f->id))
 				continue;
-
-			f->tempNum = tempNum;
-
-			const auto* colvol = &f->collisionVolume;
-			const float totRad = radius + colvol->GetBoundingRadius();
-
-			if (pos.SqDistance(colvol->GetWorldSpacePos(f)) >= (totRad * totRad))
+			if (!InColVolRange(pos, radius, f, &f->collisionVolume))
 				continue;
 
 			features.push_back(f);
 		}
 		if (repulsers != nullptr) {
 			for (CPlasmaRepulser* r: quad.repulsers) {
-				// prevent double adding
-				if (r->tempNum == tempNum)
+				if (!InRepulserRange(pos, radius, r))
 					continue;
 
-				r->tempNum = tempNum;
-
-				const auto* colvol = &r->collisionVolume;
-				const float totRad = radius + colvol->GetBoundingRadius();
-
-				if (pos.SqDistance(r->weaponMuzzlePos) >= (totRad * totRad))
+				// prevent double adding; repulsers have no id to mark,
+				// but they are few enough for a linear search
+				if (std::find(repulsers->begin() + numRepulsers, repulsers->end(), r) != repulsers->end())
 					continue;
 
 				repulsers->push_back(r);
@@ -805,4 +908,58 @@ void CQuadField::GetUnitsAndFeaturesColVol(
 		}
 	}
 }
-#endif // UNIT_TEST
+
+void CQuadField::GetUnitsAndFeaturesInQuads(
+	const float3& pos,
+	const float radius,
+	std::vector<int>& quads,
+	std::vector<CUnit*>& units,
+	std::vector<CFeature*>& features,
+	std::vector<CPlasmaRepulser*>& repulsers
+) {
+	QueryScratch& scratch = GetQueryScratch();
+	scratch.BeginQuery();
+
+	const size_t numRepulsers = repulsers.size();
+
+	QuadFieldQuery qfQuery;
+	GetQuads(qfQuery, pos, radius);
+
+	for (const int qi: *qfQuery.quads) {
+		const Quad& quad = baseQuads[qi];
+
+		for (CUnit* u: quad.units) {
+			if (!scratch.Visit(scratch.unitMarks, u->id))
+				continue;
+
+			units.push_back(u);
+		}
+		for (CFeature* f: quad.features) {
+			if (!scratch.Visit(scratch.featureMarks, f->id))
+				continue;
+
+			features.push_back(f);
+		}
+		for (CPlasmaRepulser* r: quad.repulsers) {
+			if (std::find(repulsers.begin() + numRepulsers, repulsers.end(), r) != repulsers.end())
+				continue;
+
+			repulsers.push_back(r);
+		}
+	}
+
+	quads.insert(quads.end(), qfQuery.quads->begin(), qfQuery.quads->end());
+}
+
+void CQuadField::FilterUnitsAndFeaturesColVol(
+	const float3& pos,
+	const float radius,
+	std::vector<CUnit*>& units,
+	std::vector<CFeature*>& features,
+	std::vector<CPlasmaRepulser*>& repulsers
+) {
+	// std::remove_if keeps the order
+	units.erase(std::remove_if(units.begin(), units.end(), [&](const CUnit* u) { return !InColVolRange(pos, radius, u, &u->collisionVolume); }), units.end());
+	features.erase(std::remove_if(features.begin(), features.end(), [&](const CFeature* f) { return !InColVolRange(pos, radius, f, &f->collisionVolume); }), features.end());
+	repulsers.erase(std::remove_if(repulsers.begin(), repulsers.end(), [&](const CPlasmaRepulser* r) { return !InRepulserRange(pos, radius, r); }), repulsers.end());
+}
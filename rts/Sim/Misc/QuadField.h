@@ -3,10 +3,12 @@
 #ifndef QUAD_FIELD_H
 #define QUAD_FIELD_H
 
+#include <algorithm>
 #include <array>
 #include <vector>
 #include "System/Misc/NonCopyable.h"
 
+#include "Sim/Misc/GlobalConstants.h"
 #include "System/creg/creg_cond.h"
 #include "System/float3.h"
 #include "System/type2.h"
@@ -22,8 +24,8 @@ template<typename T>
 class ExclusiveVectors {
 public:
 	// There should at most be 2 concurrent users of each vector type
-	// using 3 to be safe, increase this number if the assertions below
-	// fail
+	// per thread, using 3 to be safe, increase this number if the
+	// assertions below fail
 	static constexpr int MAX_CONCURRENT_VECTORS = 3;
 	ExclusiveVectors() {
 		for (auto& v: vectors){
@@ -69,17 +71,28 @@ class CQuadField : spring::noncopyable
 
 public:
 
-/*
-needed to support dynamic resizing (not used yet)
-      in large games the average loading factor (number of objects per quad)
-      can grow too large to maintain amortized constant performance so more
-      quads are needed
-*/
-//	static void Resize(int quad_size);
-
 	CQuadField(int2 mapDims, int quad_size);
 	~CQuadField();
 
+	/**
+	 * In large games the loading factor (number of objects per quad) of
+	 * the quads covering a battle can grow too large to maintain constant
+	 * query performance, so more (smaller) quads are needed there. Every
+	 * RESIZE_CHECK_RATE frames this halves the quad-size when the most
+	 * loaded quad exceeds MAX_QUAD_LOAD units, and doubles it again once
+	 * the load has dropped far enough (see GetResizedQuadSize).
+	 * Must be called at the start of a sim-frame.
+	 */
+	void Update(int frameNum);
+	/**
+	 * Rebuilds the grid with quads of size <quadSize> (which has to divide
+	 * the map-size) and re-inserts every object in the order it was found
+	 * in the old grid, so this is deterministic across clients
+	 */
+	void Resize(int quadSize);
+
+	static int GetResizedQuadSize(int quadSize, int maxQuadLoad, int2 mapSize);
+
 	void GetQuads(QuadFieldQuery& qfq, float3 pos, float radius);
 	void GetQuadsRectangle(QuadFieldQuery& qfq, const float3& mins, const float3& maxs);
 	void GetQuadsOnRay(QuadFieldQuery& qfq, const float3& start, const float3& dir, float length);
@@ -91,6 +104,32 @@ needed to support dynamic resizing (not used yet)
 		std::vector<CFeature*>& features,
 		std::vector<CPlasmaRepulser*>* repulsers = nullptr
 	);
+	/**
+	 * GetUnitsAndFeaturesColVol in two steps, such that the first can run
+	 * before objects are moved: this appends every unit, feature and
+	 * repulser in the quads around @c pos, in the same order, and those
+	 * quads. The result stays valid until SolidQuadsChangedSince(quads)
+	 * returns true for the solid-quads version at the time of the call.
+	 */
+	void GetUnitsAndFeaturesInQuads(
+		const float3& pos,
+		const float radius,
+		std::vector<int>& quads,
+		std::vector<CUnit*>& units,
+		std::vector<CFeature*>& features,
+		std::vector<CPlasmaRepulser*>& repulsers
+	);
+	/**
+	 * The second step; drops every candidate whose collision-volume is
+	 * not within @c radius of @c pos, based on the objects' current state
+	 */
+	static void FilterUnitsAndFeaturesColVol(
+		const float3& pos,
+		const float radius,
+		std::vector<CUnit*>& units,
+		std::vector<CFeature*>& features,
+		std::vector<CPlasmaRepulser*>& repulsers
+	);
 
 	/**
 	 * Returns all units within @c radius of @c pos,
@@ -151,11 +190,11 @@ needed to support dynamic resizing (not used yet)
 	void MovedRepulser(CPlasmaRepulser* repulser);
 	void RemoveRepulser(CPlasmaRepulser* repulser);
 
-	void ReleaseVector(std::vector<CUnit*>* v       ) { tempUnits.ReleaseVector(v); }
-	void ReleaseVector(std::vector<CFeature*>* v    ) { tempFeatures.ReleaseVector(v); }
-	void ReleaseVector(std::vector<CProjectile*>* v ) { tempProjectiles.ReleaseVector(v); }
-	void ReleaseVector(std::vector<CSolidObject*>* v) { tempSolids.ReleaseVector(v); }
-	void ReleaseVector(std::vector<int>* v          ) { tempQuads.ReleaseVector(v); }
+	void ReleaseVector(std::vector<CUnit*>* v       ) { GetQueryScratch().tempUnits.ReleaseVector(v); }
+	void ReleaseVector(std::vector<CFeature*>* v    ) { GetQueryScratch().tempFeatures.ReleaseVector(v); }
+	void ReleaseVector(std::vector<CProjectile*>* v ) { GetQueryScratch().tempProjectiles.ReleaseVector(v); }
+	void ReleaseVector(std::vector<CSolidObject*>* v) { GetQueryScratch().tempSolids.ReleaseVector(v); }
+	void ReleaseVector(std::vector<int>* v          ) { GetQueryScratch().tempQuads.ReleaseVector(v); }
 
 	struct Quad {
 		CR_DECLARE_STRUCT(Quad)
@@ -166,6 +205,9 @@ needed to support dynamic resizing (not used yet)
 		std::vector<CProjectile*> projectiles;
 		std::vector<CPlasmaRepulser*> repulsers;
 
+		// solid-quads version of the last change to units, features or repulsers
+		unsigned int solidsVersion = 0;
+
 		void PostLoad();
 	};
 
@@ -185,7 +227,19 @@ needed to support dynamic resizing (not used yet)
 	int GetQuadSizeX() const { return quadSizeX; }
 	int GetQuadSizeZ() const { return quadSizeZ; }
 
+	/// changes whenever any unit enters or leaves a quad
+	unsigned int GetUnitQuadsVersion() const { return unitQuadsVersion; }
+	/// changes whenever any unit, feature or repulser enters or leaves a quad
+	unsigned int GetSolidQuadsVersion() const { return solidQuadsVersion; }
+	/// true if any unit, feature or repulser entered or left one of <quads> after GetSolidQuadsVersion returned <version>
+	bool SolidQuadsChangedSince(const std::vector<int>& quads, unsigned int version) const;
+
 	const static unsigned int BASE_QUAD_SIZE =  128;
+	const static unsigned int  MIN_QUAD_SIZE =   32;
+
+	const static int MAX_QUAD_LOAD = 64;
+	const static int MAX_NUM_QUADS = 1 << 16;
+	const static int RESIZE_CHECK_RATE = GAME_SPEED * 4;
 
 private:
 	// optimized functions, somewhat less userfriendly
@@ -199,21 +253,70 @@ private:
 	int2 WorldPosToQuadField(const float3 p) const;
 	int WorldPosToQuadFieldIdx(const float3 p) const;
 
+	void SolidQuadsChanged(const std::vector<int>& quads, const std::vector<int>& moreQuads = {});
+
 private:
-	std::vector<Quad> baseQuads;
+	/**
+	 * Query state owned by one thread (see GetQueryScratch), such that
+	 * any number of threads can query the (unchanging) quads concurrently
+	 * during read-only sim phases. Objects that span multiple quads are skipped via per-thread
+	 * marks indexed by object-id rather than via their tempNum, which is
+	 * shared; results are still in the order objects are first found in.
+	 */
+	struct QueryScratch {
+	public:
+		// invalidates all marks set by the previous query on this thread
+		void BeginQuery() {
+			if ((++queryNum) != 0)
+				return;
+
+			std::fill(unitMarks.begin(), unitMarks.end(), 0);
+			std::fill(featureMarks.begin(), featureMarks.end(), 0);
+			std::fill(projectileMarks.begin(), projectileMarks.end(), 0);
+
+			queryNum = 1;
+		}
+
+		// returns false if <id> was already visited by the current query
+		bool Visit(std::vector<unsigned int>& marks, unsigned int id) {
+			if (id >= marks.size())
+				marks.resize(std::max(id + 1, unsigned(marks.size() * 2)), 0);
+
+			if (marks[id] == queryNum)
+				return false;
 
-	// preallocated vectors for Get*Exact functions
-	ExclusiveVectors<CUnit*> tempUnits;
-	ExclusiveVectors<CFeature*> tempFeatures;
-	ExclusiveVectors<CProjectile*> tempProjectiles;
-	ExclusiveVectors<CSolidObject*> tempSolids;
-	ExclusiveVectors<int> tempQuads;
+			marks[id] = queryNum;
+			return true;
+		}
+
+	public:
+		// preallocated vectors for Get*Exact functions
+		ExclusiveVectors<CUnit*> tempUnits;
+		ExclusiveVectors<CFeature*> tempFeatures;
+		ExclusiveVectors<CProjectile*> tempProjectiles;
+		ExclusiveVectors<CSolidObject*> tempSolids;
+		ExclusiveVectors<int> tempQuads;
+
+		std::vector<unsigned int> unitMarks;
+		std::vector<unsigned int> featureMarks;
+		std::vector<unsigned int> projectileMarks;
+
+		unsigned int queryNum = 0;
+	};
+
+	QueryScratch& GetQueryScratch();
+
+private:
+	std::vector<Quad> baseQuads;
 
 	int numQuadsX;
 	int numQuadsZ;
 
 	int quadSizeX;
 	int quadSizeZ;
+
+	unsigned int unitQuadsVersion;
+	unsigned int solidQuadsVersion;
 };
 
 extern CQuadField* quadField;
@@ -15,6 +15,7 @@ CR_BIND(CTeamHandler, )
 CR_REG_METADATA(CTeamHandler, (
 	CR_MEMBER(gaiaTeamID),
 	CR_MEMBER(gaiaAllyTeamID),
+	CR_MEMBER(alliesVersion),
 	CR_MEMBER(teams),
 	CR_MEMBER(allyTeams)
 ))
@@ -25,7 +26,8 @@ CTeamHandler* teamHandler = NULL;
 
 CTeamHandler::CTeamHandler():
 	gaiaTeamID(-1),
-	gaiaAllyTeamID(-1)
+	gaiaAllyTeamID(-1),
+	alliesVersion(0)
 {
 }
 
@@ -91,7 +91,7 @@ public:
 	 *
 	 * Sets team's ally team
 	 */
-	void SetAllyTeam(int team, int allyteam) { teams[team].teamAllyteam = allyteam; }
+	void SetAllyTeam(int team, int allyteam) { teams[team].teamAllyteam = allyteam; alliesVersion++; }
 
 	/**
 	 * @brief set ally
@@ -101,7 +101,10 @@ public:
 	 *
 	 * Sets two allyteams to be allied or not
 	 */
-	void SetAlly(int allyteamA, int allyteamB, bool allied) { allyTeams[allyteamA].allies[allyteamB] = allied; }
+	void SetAlly(int allyteamA, int allyteamB, bool allied) { allyTeams[allyteamA].allies[allyteamB] = allied; alliesVersion++; }
+
+	/// bumped whenever an alliance or a team's allyteam changes, for caches keyed on allyteams
+	unsigned int GetAlliesVersion() const { return alliesVersion; }
 
 	// accessors
 	int GaiaTeamID() const { return gaiaTeamID; }
@@ -153,6 +156,8 @@ private:
 	 */
 	int gaiaAllyTeamID;
 
+	unsigned int alliesVersion;
+
 	/**
 	 * @brief teams
 	 *
@@ -123,7 +123,7 @@ CMoveMath::BlockType CMoveMath::IsBlockedNoSpeedModCheck(const MoveDef& moveDef,
 	for (int z = zmin; z <= zmax; z += FOOTPRINT_ZSTEP) {
 		const int zOffset = z * mapDims.mapx;
 		for (int x = xmin; x <= xmax; x += FOOTPRINT_XSTEP) {
-			const BlockingMapCell& cell = groundBlockingObjectMap->GetCellUnsafeConst(zOffset + x);
+			const BlockingMapCell cell = groundBlockingObjectMap->GetCellUnsafeConst(zOffset + x);
 			for (const CSolidObject* collidee: cell) {
 				ret |= ObjectBlockType(moveDef, collidee, collider);
 				if (ret & BLOCK_STRUCTURE)
@@ -254,7 +254,7 @@ CMoveMath::BlockType CMoveMath::SquareIsBlocked(const MoveDef& moveDef, int xSqu
 
 	BlockType r = BLOCK_NONE;
 
-	const BlockingMapCell& cell = groundBlockingObjectMap->GetCellUnsafeConst(zSquare * mapDims.mapx + xSquare);
+	const BlockingMapCell cell = groundBlockingObjectMap->GetCellUnsafeConst(zSquare * mapDims.mapx + xSquare);
 
 	for (const CSolidObject* collidee: cell) {
 		r |= ObjectBlockType(moveDef, collidee, collider);
@@ -280,7 +280,7 @@ CMoveMath::BlockType CMoveMath::RangeIsBlocked(const MoveDef& moveDef, int xmin,
 		const int zOffset = z * mapDims.mapx;
 
 		for (int x = xmin; x <= xmax; x += FOOTPRINT_XSTEP) {
-			const BlockingMapCell& cell = groundBlockingObjectMap->GetCellUnsafeConst(zOffset + x);
+			const BlockingMapCell cell = groundBlockingObjectMap->GetCellUnsafeConst(zOffset + x);
 
 			for (CSolidObject* collidee: cell) {
 				if (collidee->tempNum == tempNum)
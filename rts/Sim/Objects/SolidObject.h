@@ -321,7 +321,7 @@ public:
 	int team;                                   ///< team that "owns" this object
 	int allyteam;                               ///< allyteam that this->team is part of
 
-	int tempNum;                                ///< used to check if object has already been processed (in QuadField queries, etc)
+	int tempNum;                                ///< used to check if object has already been processed (in GameHelper queries, etc)
 	int lastHitPieceFrame;                      ///< frame in which lastHitPiece was hit
 
 
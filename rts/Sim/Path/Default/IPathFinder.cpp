@@ -145,6 +145,12 @@ IPath::SearchResult IPathFinder::GetPath(
 		return ci.result;
 	}
 
+	// group-requests for a common goal can share one search
+	if (GetGoalFieldPath(moveDef, pfDef, owner, path)) {
+		AddCache(&path, IPath::Ok, mStartBlock, goalBlock, pfDef.sqGoalRadius, moveDef.pathType, pfDef.synced);
+		return IPath::Ok;
+	}
+
 	// start up a new search
 	const IPath::SearchResult result = InitSearch(moveDef, pfDef, owner);
 
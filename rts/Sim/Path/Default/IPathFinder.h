@@ -81,6 +81,12 @@ protected:
 	virtual IPath::SearchResult DoRawSearch(const MoveDef&, const CPathFinderDef&, const CSolidObject* owner) { return IPath::Error; }
 	virtual IPath::SearchResult DoSearch(const MoveDef&, const CPathFinderDef&, const CSolidObject* owner) = 0;
 
+	/**
+	 * Serves the request from a search shared with other requests for the
+	 * same goal, if possible. Returns false when a regular search is needed.
+	 */
+	virtual bool GetGoalFieldPath(const MoveDef&, const CPathFinderDef&, const CSolidObject* owner, IPath::Path& path) { return false; }
+
 	/**
 	 * Test the availability and value of a block,
 	 * and possibly add it to the queue of open blocks.
@@ -5,6 +5,7 @@
 #include "minizip/zip.h"
 
 #include "PathEstimator.h"
+#include "PathEstimatorCacheFile.h"
 #include "PathFinder.h"
 #include "PathFinderDef.h"
 // #include "PathFlowMap.hpp"
@@ -25,16 +26,25 @@
 #include "System/FileSystem/DataDirsAccess.h"
 #include "System/FileSystem/FileSystem.h"
 #include "System/FileSystem/FileQueryFlags.h"
+#include "System/FileSystem/MemoryMappedFile.h"
 #include "System/Platform/Threading.h"
 #include "System/SafeUtil.h"
 #include "System/StringUtil.h"
 #include "System/Sync/HsiehHash.h"
 #include "System/Sync/SHA512.hpp"
 
+#include <fstream>
+
 #define ENABLE_NETLOG_CHECKSUM 1
 
+// number of distinct goals (per synced-state) whose fields are kept until the next update
+#define MAX_GOAL_FIELDS 4
+// goals with a radius wider than this (in blocks) are not considered for sharing
+#define MAX_GOAL_FIELD_RADIUS 8
+
 
 CONFIG(int, MaxPathCostsMemoryFootPrint).defaultValue(512).minimumValue(64).description("Maximum memusage (in MByte) of multithreaded pathcache generator at loading time.");
+CONFIG(int, PathCacheFormat).defaultValue(1).minimumValue(0).maximumValue(1).description("Format of the cached path-estimator data. 0: compressed zip-archive, 1: uncompressed flat file which is memory-mapped on load (larger, but much faster to read).");
 
 PCMemPool pcMemPool;
 PEMemPool peMemPool;
@@ -64,7 +74,11 @@ CPathEstimator::CPathEstimator(IPathFinder* pf, unsigned int BLOCK_SIZE, const s
 	, parentPathFinder(pf)
 	, nextPathEstimator(nullptr)
 	, blockUpdatePenalty(0)
+	, nextGoalFieldSlot{0, 0}
 {
+	goalFieldSlots[0].resize(MAX_GOAL_FIELDS);
+	goalFieldSlots[1].resize(MAX_GOAL_FIELDS);
+
 	vertexCosts.resize(moveDefHandler->GetNumMoveDefs() * blockStates.GetSize() * PATH_DIRECTION_VERTICES, PATHCOST_INFINITY);
 	maxSpeedMods.resize(moveDefHandler->GetNumMoveDefs(), 0.001f);
 
@@ -284,7 +298,7 @@ void CPathEstimator::EstimatePathCosts(unsigned int blockIdx, unsigned int threa
 		if (md->udRefCount == 0)
 			continue;
 
-		CalcVertexPathCosts(*md, blockPos, threadNum);
+		CalcVertexPathCosts(*md, blockPos, pathFinders[threadNum]);
 	}
 }
 
@@ -352,22 +366,22 @@ int2 CPathEstimator::FindBlockPosOffset(const MoveDef& moveDef, unsigned int blo
 /**
  * Calculate costs of paths to all vertices connected from the given block
  */
-void CPathEstimator::CalcVertexPathCosts(const MoveDef& moveDef, int2 block, unsigned int threadNum)
+void CPathEstimator::CalcVertexPathCosts(const MoveDef& moveDef, int2 block, IPathFinder* pathFinder)
 {
 	// see GetBlockVertexOffset(); costs are bi-directional and only
 	// calculated for *half* the outgoing edges (while costs for the
 	// other four directions are stored at the adjacent vertices)
-	CalcVertexPathCost(moveDef, block, PATHDIR_LEFT,     threadNum);
-	CalcVertexPathCost(moveDef, block, PATHDIR_LEFT_UP,  threadNum);
-	CalcVertexPathCost(moveDef, block, PATHDIR_UP,       threadNum);
-	CalcVertexPathCost(moveDef, block, PATHDIR_RIGHT_UP, threadNum);
+	CalcVertexPathCost(moveDef, block, PATHDIR_LEFT,     pathFinder);
+	CalcVertexPathCost(moveDef, block, PATHDIR_LEFT_UP,  pathFinder);
+	CalcVertexPathCost(moveDef, block, PATHDIR_UP,       pathFinder);
+	CalcVertexPathCost(moveDef, block, PATHDIR_RIGHT_UP, pathFinder);
 }
 
 void CPathEstimator::CalcVertexPathCost(
 	const MoveDef& moveDef,
 	int2 parentBlockPos,
 	unsigned int pathDir,
-	unsigned int threadNum
+	IPathFinder* pathFinder
 ) {
 	const int2 childBlockPos = parentBlockPos + PE_DIRECTION_VECTORS[pathDir];
 
@@ -412,9 +426,9 @@ void CPathEstimator::CalcVertexPathCost(
 	// find path from parent to child block
 	//
 	// since CPathFinder::GetPath() is not thread-safe, use
-	// this thread's "private" CPathFinder instance (rather
-	// than locking parentPathFinder->GetPath()) if we are
-	// invoked in one
+	// the calling thread's "private" CPathFinder instance
+	// (rather than locking parentPathFinder->GetPath()) if
+	// we are invoked in one
 	pfDef.skipSubSearches = true;
 	pfDef.testMobile      = false;
 	pfDef.needPath        = false;
@@ -422,7 +436,7 @@ void CPathEstimator::CalcVertexPathCost(
 	pfDef.dirIndependent  = true;
 
 	IPath::Path path;
-	IPath::SearchResult result = pathFinders[threadNum]->GetPath(moveDef, pfDef, nullptr, startPos, path, MAX_SEARCHED_NODES_PF >> 2);
+	IPath::SearchResult result = pathFinder->GetPath(moveDef, pfDef, nullptr, startPos, path, MAX_SEARCHED_NODES_PF >> 2);
 
 	// store the result
 	if (result == IPath::Ok) {
@@ -472,6 +486,10 @@ void CPathEstimator::Update()
 	pathCache[0]->Update();
 	pathCache[1]->Update();
 
+	// vertex costs and block offsets may change below
+	InvalidateGoalFields(false);
+	InvalidateGoalFields(true);
+
 	const unsigned int numMoveDefs = moveDefHandler->GetNumMoveDefs();
 
 	if (numMoveDefs == 0)
@@ -552,11 +570,27 @@ void CPathEstimator::Update()
 		});
 	}
 
-	// CalcVertexPathCosts (not threadsafe)
+	// CalcVertexPathCosts (threadsafe given one PF per thread)
 	{
 		SCOPED_TIMER("Sim::Path::Estimator::CalcVertexPathCosts");
-		for (unsigned int n = 0; n < consumedBlocks.size(); ++n) {
-			CalcVertexPathCosts(*consumedBlocks[n].moveDef, consumedBlocks[n].blockPos);
+
+		if (workerPathFinders.empty()) {
+			// parent is another estimator, which keeps per-search state
+			for (unsigned int n = 0; n < consumedBlocks.size(); ++n) {
+				CalcVertexPathCosts(*consumedBlocks[n].moveDef, consumedBlocks[n].blockPos, pathFinders[0]);
+			}
+		} else {
+			// every block only writes its own vertices and each cost only depends
+			// on the map-state (frozen during Update) and the offsets calculated
+			// above, so the results are identical regardless of which thread or
+			// worker PF computed them
+			std::atomic<unsigned int> nextBlockIdx = {0};
+
+			for_mt(0, workerPathFinders.size(), [&](const int i) {
+				for (unsigned int n = nextBlockIdx++; n < consumedBlocks.size(); n = nextBlockIdx++) {
+					CalcVertexPathCosts(*consumedBlocks[n].moveDef, consumedBlocks[n].blockPos, workerPathFinders[i]);
+				}
+			});
 		}
 	}
 }
@@ -921,10 +955,249 @@ void CPathEstimator::FinishSearch(const MoveDef& moveDef, const CPathFinderDef&
 }
 
 
+/**
+ * Serve a request from the goal-field shared by all requests (between
+ * two updates) with the same goal, such that a group move-order costs
+ * one backward search instead of one forward search per unit
+ */
+bool CPathEstimator::GetGoalFieldPath(const MoveDef& moveDef, const CPathFinderDef& peDef, const CSolidObject* owner, IPath::Path& path)
+{
+	// only plain searches for which DoSearch would be the sole source of results
+	if (!peDef.needPath || !peDef.allowDefPath || peDef.allowRawPath)
+		return false;
+	if (!peDef.constraintDisabled || peDef.skipSubSearches)
+		return false;
+
+	const int2 startSquare = blockStates.peNodeOffsets[moveDef.pathType][mStartBlockIdx];
+
+	// leave the special cases of InitSearch and DoSearch to them
+	if (peDef.IsGoal(startSquare.x, startSquare.y))
+		return false;
+
+	std::vector<GoalFieldSlot>& slots = goalFieldSlots[peDef.synced];
+
+	const auto iter = std::find_if(slots.begin(), slots.end(), [&](const GoalFieldSlot& slot) {
+		if (slot.pathType != moveDef.pathType || slot.sqGoalRadius != peDef.sqGoalRadius)
+			return false;
+
+		// exact comparison, float3::operator== has a tolerance
+		return (slot.goalPos.x == peDef.wsGoalPos.x && slot.goalPos.y == peDef.wsGoalPos.y && slot.goalPos.z == peDef.wsGoalPos.z);
+	});
+
+	if (iter == slots.end()) {
+		// first request for this goal; a field only pays off once shared, so
+		// just remember the goal and let this request run a regular search
+		GoalFieldSlot& slot = slots[(nextGoalFieldSlot[peDef.synced]++) % MAX_GOAL_FIELDS];
+
+		slot.goalPos = peDef.wsGoalPos;
+		slot.sqGoalRadius = peDef.sqGoalRadius;
+		slot.pathType = moveDef.pathType;
+		slot.initialized = false;
+		slot.usable = false;
+		return false;
+	}
+
+	GoalFieldSlot& slot = *iter;
+
+	const bool initGoalField = !slot.initialized;
+
+	if (initGoalField) {
+		slot.initialized = true;
+		slot.usable = InitGoalField(moveDef, peDef, owner, slot);
+	}
+
+	if (!slot.usable)
+		return false;
+
+	const unsigned int vertexBaseIdx = moveDef.pathType * nbrOfBlocks.x * nbrOfBlocks.y * PATH_DIRECTION_VERTICES;
+
+	// DoSearch replaces impassable edges out of the start-block by sub-searches
+	// from the exact start position, which a shared field can not account for
+	for (unsigned int pathDir = 0; pathDir < PATH_DIRECTIONS; pathDir++) {
+		const int2 nextBlockPos = mStartBlock + PE_DIRECTION_VECTORS[pathDir];
+
+		if (static_cast<unsigned int>(nextBlockPos.x) >= static_cast<unsigned int>(nbrOfBlocks.x))
+			continue;
+		if (static_cast<unsigned int>(nextBlockPos.y) >= static_cast<unsigned int>(nbrOfBlocks.y))
+			continue;
+
+		if (vertexCosts[vertexBaseIdx + mStartBlockIdx * PATH_DIRECTION_VERTICES + GetBlockVertexOffset(pathDir, nbrOfBlocks.x)] >= PATHCOST_INFINITY)
+			return false;
+	}
+
+	// same transition-costs as TestBlock
+	const auto EdgeCost = [&](unsigned int prevBlockIdx, unsigned int pathDir, unsigned int nextBlockIdx) {
+		if (nextBlockIdx == slot.goalBlockIdx && !slot.goalBlockEnterable)
+			return PATHCOST_INFINITY;
+
+		const float vertexCost = vertexCosts[vertexBaseIdx + prevBlockIdx * PATH_DIRECTION_VERTICES + GetBlockVertexOffset(pathDir, nbrOfBlocks.x)];
+
+		if (vertexCost >= PATHCOST_INFINITY)
+			return PATHCOST_INFINITY;
+
+		const int2 nextSquare = blockStates.peNodeOffsets[moveDef.pathType][nextBlockIdx];
+
+		return (vertexCost + blockStates.GetNodeExtraCost(nextSquare.x, nextSquare.y, peDef.synced));
+	};
+
+	if (!slot.field.Expand(mStartBlockIdx, EdgeCost))
+		return false;
+
+	goalFieldBlocks.clear();
+	slot.field.GetPathBlocks(mStartBlockIdx, goalFieldBlocks);
+
+	if (!initGoalField && !CheckGoalFieldPath(moveDef, peDef, owner, slot))
+		return false;
+
+	// same waypoint order as FinishSearch, from the goal back to the start
+	path.path.reserve(goalFieldBlocks.size());
+
+	for (auto it = goalFieldBlocks.rbegin(); it != goalFieldBlocks.rend(); ++it) {
+		const int2 square = blockStates.peNodeOffsets[moveDef.pathType][*it];
+
+		path.path.emplace_back(square.x * SQUARE_SIZE, CMoveMath::yLevel(moveDef, square.x, square.y), square.y * SQUARE_SIZE);
+	}
+
+	const int2 goalSquare = blockStates.peNodeOffsets[moveDef.pathType][goalFieldBlocks.back()];
+
+	path.pathGoal = path.path[0];
+	path.pathCost = slot.field.GetBlockCost(mStartBlockIdx) + peDef.Heuristic(goalSquare.x, goalSquare.y, BLOCK_SIZE) * maxSpeedMods[moveDef.pathType];
+	return true;
+}
+
+/**
+ * Seed the field of <slot> with every block DoSearch would accept as goal
+ */
+bool CPathEstimator::InitGoalField(const MoveDef& moveDef, const CPathFinderDef& peDef, const CSolidObject* owner, GoalFieldSlot& slot)
+{
+	const int2 goalBlockPos = {int(peDef.goalSquareX / BLOCK_SIZE), int(peDef.goalSquareZ / BLOCK_SIZE)};
+	const int2 goalSqrOffset = peDef.GoalSquareOffset(BLOCK_SIZE);
+
+	const int goalRadius = math::sqrt(peDef.sqGoalRadius) / BLOCK_PIXEL_SIZE + 1;
+
+	if (goalRadius > MAX_GOAL_FIELD_RADIUS)
+		return false;
+
+	slot.goalBlockIdx = BlockPosToIdx(goalBlockPos);
+	slot.field.Init(nbrOfBlocks, &PE_DIRECTION_VECTORS[0]);
+	slot.searchedGoalBlocks.clear();
+
+	{
+		// see TestBlock, the goal-block may only be entered if its goal can be reached from there
+		const int2 goalBlockSquare = blockStates.peNodeOffsets[moveDef.pathType][slot.goalBlockIdx];
+		const float3 sWorldPos = SquareToFloat3(goalBlockSquare.x, goalBlockSquare.y);
+
+		slot.goalBlockSearched = (sWorldPos.SqDistance2D(peDef.wsGoalPos) > peDef.sqGoalRadius);
+		slot.goalBlockEnterable = (!slot.goalBlockSearched || DoBlockSearch(owner, moveDef, sWorldPos, peDef.wsGoalPos) == IPath::Ok);
+	}
+
+	bool haveGoalBlocks = false;
+
+	for (int z = std::max(goalBlockPos.y - goalRadius, 0); z <= std::min(goalBlockPos.y + goalRadius, nbrOfBlocks.y - 1); z++) {
+		for (int x = std::max(goalBlockPos.x - goalRadius, 0); x <= std::min(goalBlockPos.x + goalRadius, nbrOfBlocks.x - 1); x++) {
+			const int2 blockPos = {x, z};
+			const unsigned int blockIdx = BlockPosToIdx(blockPos);
+
+			if (blockIdx == slot.goalBlockIdx && !slot.goalBlockEnterable)
+				continue;
+
+			// same goal-test as DoSearch
+			const int2 bSquare = blockStates.peNodeOffsets[moveDef.pathType][blockIdx];
+			const int2 gSquare = blockPos * BLOCK_SIZE + goalSqrOffset;
+
+			if (!peDef.IsGoal(bSquare.x, bSquare.y)) {
+				if (!peDef.IsGoal(gSquare.x, gSquare.y))
+					continue;
+				if (DoBlockSearch(owner, moveDef, bSquare, gSquare) != IPath::Ok)
+					continue;
+
+				slot.searchedGoalBlocks.push_back(blockIdx);
+			}
+
+			slot.field.AddGoalBlock(blockIdx);
+			haveGoalBlocks = true;
+		}
+	}
+
+	return haveGoalBlocks;
+}
+
+/**
+ * The goal-blocks of a field were tested with the owner of the request that
+ * seeded it, and the result of DoBlockSearch depends on that owner; re-test
+ * those the path in <goalFieldBlocks> relies on for the owner of this one
+ */
+bool CPathEstimator::CheckGoalFieldPath(const MoveDef& moveDef, const CPathFinderDef& peDef, const CSolidObject* owner, const GoalFieldSlot& slot)
+{
+	const unsigned int pathGoalBlockIdx = goalFieldBlocks.back();
+
+	if (std::binary_search(slot.searchedGoalBlocks.begin(), slot.searchedGoalBlocks.end(), pathGoalBlockIdx)) {
+		const int2 blockPos = {int(pathGoalBlockIdx % nbrOfBlocks.x), int(pathGoalBlockIdx / nbrOfBlocks.x)};
+		const int2 bSquare = blockStates.peNodeOffsets[moveDef.pathType][pathGoalBlockIdx];
+		const int2 gSquare = blockPos * BLOCK_SIZE + peDef.GoalSquareOffset(BLOCK_SIZE);
+
+		if (DoBlockSearch(owner, moveDef, bSquare, gSquare) != IPath::Ok)
+			return false;
+	}
+
+	if (!slot.goalBlockSearched)
+		return true;
+
+	// the start-block is never entered
+	if (std::find(goalFieldBlocks.begin() + 1, goalFieldBlocks.end(), slot.goalBlockIdx) == goalFieldBlocks.end())
+		return true;
+
+	const int2 goalBlockSquare = blockStates.peNodeOffsets[moveDef.pathType][slot.goalBlockIdx];
+	const float3 sWorldPos = SquareToFloat3(goalBlockSquare.x, goalBlockSquare.y);
+
+	return (DoBlockSearch(owner, moveDef, sWorldPos, peDef.wsGoalPos) == IPath::Ok);
+}
+
+void CPathEstimator::InvalidateGoalFields(bool synced)
+{
+	for (GoalFieldSlot& slot: goalFieldSlots[synced]) {
+		slot.pathType = -1;
+	}
+}
+
+
 /**
  * Try to read offset and vertices data from file, return false on failure
  */
 bool CPathEstimator::ReadFile(const std::string& baseFileName, const std::string& mapName)
+{
+	if (configHandler->GetInt("PathCacheFormat") == 0)
+		return (ReadZipFile(baseFileName, mapName));
+
+	if (ReadFlatFile(baseFileName, mapName))
+		return true;
+
+	if (!ReadZipFile(baseFileName, mapName))
+		return false;
+
+	// convert a cache written by an earlier run so the next load can map it
+	WriteFlatFile(baseFileName, mapName);
+	return true;
+}
+
+/**
+ * Try to write offset and vertex data to file.
+ */
+void CPathEstimator::WriteFile(const std::string& baseFileName, const std::string& mapName)
+{
+	// we need this directory to exist
+	if (!FileSystem::CreateDirectory(GetPathCacheDir()))
+		return;
+
+	if (configHandler->GetInt("PathCacheFormat") == 0) {
+		WriteZipFile(baseFileName, mapName);
+	} else {
+		WriteFlatFile(baseFileName, mapName);
+	}
+}
+
+
+bool CPathEstimator::ReadZipFile(const std::string& baseFileName, const std::string& mapName)
 {
 	const std::string hashHexString = IntToString(fileHashCode, "%x");
 	const std::string cacheFileName = GetPathCacheDir() + mapName + "." + baseFileName + "-" + hashHexString + ".zip";
@@ -992,15 +1265,8 @@ bool CPathEstimator::ReadFile(const std::string& baseFileName, const std::string
 }
 
 
-/**
- * Try to write offset and vertex data to file.
- */
-void CPathEstimator::WriteFile(const std::string& baseFileName, const std::string& mapName)
+void CPathEstimator::WriteZipFile(const std::string& baseFileName, const std::string& mapName)
 {
-	// we need this directory to exist
-	if (!FileSystem::CreateDirectory(GetPathCacheDir()))
-		return;
-
 	const std::string hashHexString = IntToString(fileHashCode, "%x");
 	const std::string cacheFileName = GetPathCacheDir() + mapName + "." + baseFileName + "-" + hashHexString + ".zip";
 
@@ -1043,6 +1309,80 @@ void CPathEstimator::WriteFile(const std::string& baseFileName, const std::strin
 }
 
 
+bool CPathEstimator::ReadFlatFile(const std::string& baseFileName, const std::string& mapName)
+{
+	const std::string hashHexString = IntToString(fileHashCode, "%x");
+	const std::string cacheFileName = GetPathCacheDir() + mapName + "." + baseFileName + "-" + hashHexString + ".bin";
+
+	LOG("[PathEstimator::%s] hash=%s file=\"%s\" (exists=%d)", __func__, hashHexString.c_str(), cacheFileName.c_str(), FileSystem::FileExists(cacheFileName));
+
+	if (!FileSystem::FileExists(cacheFileName))
+		return false;
+
+	char calcMsg[512];
+	sprintf(calcMsg, "Reading Estimate PathCosts [%d]", BLOCK_SIZE);
+	loadscreen->SetLoadMessage(calcMsg);
+
+	const PECacheFile::Header header = PECacheFile::MakeHeader(fileHashCode, BLOCK_SIZE, moveDefHandler->GetNumMoveDefs(), blockStates.GetSize(), vertexCosts.size());
+
+	{
+		const CMemoryMappedFile file(dataDirsAccess.LocateFile(cacheFileName));
+
+		// also catches files truncated by an interrupted WriteFlatFile
+		if (PECacheFile::IsValid(file.GetData(), file.GetSize(), header)) {
+			const std::uint8_t* offsets = file.GetData() + sizeof(PECacheFile::Header);
+			const std::uint8_t* costs = offsets + PECacheFile::GetOffsetsSize(header);
+
+			for (int pathType = 0; pathType < moveDefHandler->GetNumMoveDefs(); ++pathType) {
+				std::memcpy(&blockStates.peNodeOffsets[pathType][0], offsets + pathType * header.numBlocks * PECacheFile::OFFSET_SIZE, header.numBlocks * PECacheFile::OFFSET_SIZE);
+			}
+
+			std::memcpy(&vertexCosts[0], costs, PECacheFile::GetCostsSize(header));
+			return true;
+		}
+	}
+
+	// only after the file is unmapped, Windows can not remove mapped files
+	FileSystem::Remove(cacheFileName);
+	return false;
+}
+
+
+void CPathEstimator::WriteFlatFile(const std::string& baseFileName, const std::string& mapName)
+{
+	const std::string hashHexString = IntToString(fileHashCode, "%x");
+	const std::string cacheFileName = GetPathCacheDir() + mapName + "." + baseFileName + "-" + hashHexString + ".bin";
+
+	LOG("[PathEstimator::%s] hash=%s file=\"%s\" (exists=%d)", __func__, hashHexString.c_str(), cacheFileName.c_str(), FileSystem::FileExists(cacheFileName));
+
+	std::ofstream file(dataDirsAccess.LocateFile(cacheFileName, FileQueryFlags::WRITE), std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if (!file.is_open())
+		return;
+
+	PECacheFile::Header header = PECacheFile::MakeHeader(fileHashCode, BLOCK_SIZE, moveDefHandler->GetNumMoveDefs(), blockStates.GetSize(), vertexCosts.size());
+
+	// payload is not contiguous in memory, so chain the offset-hashes as CalcChecksum does
+	for (const auto& pathTypeOffsets: blockStates.peNodeOffsets) {
+		header.dataChecksum = HsiehHash(pathTypeOffsets.data(), pathTypeOffsets.size() * sizeof(short2), header.dataChecksum);
+	}
+
+	header.dataChecksum = HsiehHash(vertexCosts.data(), vertexCosts.size() * sizeof(float), header.dataChecksum);
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	for (const auto& pathTypeOffsets: blockStates.peNodeOffsets) {
+		file.write(reinterpret_cast<const char*>(pathTypeOffsets.data()), pathTypeOffsets.size() * sizeof(short2));
+	}
+
+	file.write(reinterpret_cast<const char*>(vertexCosts.data()), vertexCosts.size() * sizeof(float));
+	file.close();
+
+	if (file.fail())
+		FileSystem::Remove(cacheFileName);
+}
+
+
 std::uint32_t CPathEstimator::CalcChecksum() const
 {
 	std::uint32_t cs = 0;
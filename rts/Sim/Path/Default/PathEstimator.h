@@ -13,6 +13,7 @@
 #include "IPathFinder.h"
 #include "PathConstants.h"
 #include "PathDataTypes.h"
+#include "PathGoalField.h"
 #include "System/float3.h"
 #include "System/Threading/SpringThreading.h"
 
@@ -59,6 +60,13 @@ public:
 
 	IPathFinder* GetParent() override { return parentPathFinder; }
 
+	/**
+	 * Thread-safe PF's that Update may use to recalculate vertex-costs
+	 * concurrently; only valid if the parent is the max-res PF, since
+	 * any other parent (an estimator) would give different costs
+	 */
+	void SetWorkerPathFinders(const std::vector<CPathFinder*>& pfs) { workerPathFinders = pfs; }
+
 	/**
 	 * Returns a checksum that can be used to check if every player has the same
 	 * path data.
@@ -72,6 +80,8 @@ protected: // IPathFinder impl
 	IPath::SearchResult DoBlockSearch(const CSolidObject* owner, const MoveDef& moveDef, const float3 sw, const float3 gw);
 	IPath::SearchResult DoSearch(const MoveDef&, const CPathFinderDef&, const CSolidObject* owner) override;
 
+	bool GetGoalFieldPath(const MoveDef&, const CPathFinderDef&, const CSolidObject* owner, IPath::Path& path) override;
+
 	bool TestBlock(
 		const MoveDef& moveDef,
 		const CPathFinderDef& pfDef,
@@ -110,11 +120,15 @@ private:
 	void EstimatePathCosts(unsigned int, unsigned int);
 
 	int2 FindBlockPosOffset(const MoveDef&, unsigned int, unsigned int) const;
-	void CalcVertexPathCosts(const MoveDef&, int2, unsigned int threadNum = 0);
-	void CalcVertexPathCost(const MoveDef&, int2, unsigned int pathDir, unsigned int threadNum = 0);
+	void CalcVertexPathCosts(const MoveDef&, int2, IPathFinder* pathFinder);
+	void CalcVertexPathCost(const MoveDef&, int2, unsigned int pathDir, IPathFinder* pathFinder);
 
 	bool ReadFile(const std::string& baseFileName, const std::string& mapName);
 	void WriteFile(const std::string& baseFileName, const std::string& mapName);
+	bool ReadZipFile(const std::string& baseFileName, const std::string& mapName);
+	void WriteZipFile(const std::string& baseFileName, const std::string& mapName);
+	bool ReadFlatFile(const std::string& baseFileName, const std::string& mapName);
+	void WriteFlatFile(const std::string& baseFileName, const std::string& mapName);
 
 	std::uint32_t CalcChecksum() const;
 	std::uint32_t CalcHash(const char* caller) const;
@@ -139,6 +153,7 @@ private:
 	CPathCache* pathCache[2]; // [0] = !synced, [1] = synced
 
 	std::vector<IPathFinder*> pathFinders; // InitEstimator helpers
+	std::vector<CPathFinder*> workerPathFinders; // Update helpers, owned by CPathManager
 	std::vector<spring::thread> threads;
 
 	std::vector<float> maxSpeedMods;
@@ -161,6 +176,34 @@ private:
 
 	std::vector<SingleBlock> consumedBlocks;
 	std::vector<SOffsetBlock> offsetBlocksSortedByCost;
+
+	/// requests that share a goal between two estimator updates
+	struct GoalFieldSlot {
+		float3 goalPos;
+		float sqGoalRadius = 0.0f;
+		int pathType = -1;
+
+		unsigned int goalBlockIdx = 0;
+		bool goalBlockEnterable = false;
+		bool initialized = false;
+		bool usable = false;
+
+		// whether goalBlockEnterable, and which goal-blocks (sorted), depend on
+		// a DoBlockSearch run with the owner of the request that seeded <field>
+		bool goalBlockSearched = false;
+		std::vector<unsigned int> searchedGoalBlocks;
+
+		PathGoalField field;
+	};
+
+	std::vector<GoalFieldSlot> goalFieldSlots[2]; // [0] = !synced, [1] = synced
+	std::vector<unsigned int> goalFieldBlocks;
+
+	unsigned int nextGoalFieldSlot[2];
+
+	bool InitGoalField(const MoveDef&, const CPathFinderDef&, const CSolidObject* owner, GoalFieldSlot& slot);
+	bool CheckGoalFieldPath(const MoveDef&, const CPathFinderDef&, const CSolidObject* owner, const GoalFieldSlot& slot);
+	void InvalidateGoalFields(bool synced);
 };
 
 #endif
@@ -0,0 +1,94 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef PATHESTIMATOR_CACHE_FILE_HDR
+#define PATHESTIMATOR_CACHE_FILE_HDR
+
+#include <cinttypes>
+#include <cstring>
+
+#include "System/Sync/HsiehHash.h"
+
+// uncompressed alternative to the PE's zip-cache; the file is a header
+// followed by every pathType's center-offsets (short2's, pathType-major)
+// and then all vertex-costs (floats), exactly as laid out in memory so it
+// can be memory-mapped and copied out without a decompression pass
+namespace PECacheFile {
+	static constexpr char MAGIC[8] = {'S', 'P', 'R', 'I', 'N', 'G', 'P', 'E'};
+	static constexpr std::uint32_t VERSION = 1;
+
+	struct Header {
+		char magic[8];
+
+		std::uint32_t version;
+		// PE::fileHashCode, identifies the map and movedef-set
+		std::uint32_t dataHash;
+		std::uint32_t blockSize;
+		std::uint32_t numPathTypes;
+		std::uint32_t numBlocks;
+		// HsiehHash over the payload, chained like PE::CalcChecksum
+		std::uint32_t dataChecksum;
+		std::uint64_t numVertexCosts;
+	};
+
+	static_assert(sizeof(Header) == 40, "");
+
+	// size of each element in the offset- and cost-sections
+	static constexpr std::uint64_t OFFSET_SIZE = sizeof(std::int16_t) * 2;
+	static constexpr std::uint64_t COST_SIZE = sizeof(float);
+
+
+	static inline Header MakeHeader(std::uint32_t dataHash, std::uint32_t blockSize, std::uint32_t numPathTypes, std::uint32_t numBlocks, std::uint64_t numVertexCosts) {
+		Header h;
+		std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+
+		h.version = VERSION;
+		h.dataHash = dataHash;
+		h.blockSize = blockSize;
+		h.numPathTypes = numPathTypes;
+		h.numBlocks = numBlocks;
+		h.dataChecksum = 0;
+		h.numVertexCosts = numVertexCosts;
+		return h;
+	}
+
+	static inline std::uint64_t GetOffsetsSize(const Header& h) { return (h.numPathTypes * (h.numBlocks * OFFSET_SIZE)); }
+	static inline std::uint64_t GetCostsSize(const Header& h) { return (h.numVertexCosts * COST_SIZE); }
+	static inline std::uint64_t GetFileSize(const Header& h) { return (sizeof(Header) + GetOffsetsSize(h) + GetCostsSize(h)); }
+
+	// <offsets> points to the first pathType's offsets, the others must follow contiguously
+	static inline std::uint32_t CalcChecksum(const Header& h, const std::uint8_t* offsets, const std::uint8_t* costs) {
+		std::uint32_t cs = 0;
+
+		for (std::uint32_t pathType = 0; pathType < h.numPathTypes; pathType++) {
+			cs = HsiehHash(offsets + pathType * h.numBlocks * OFFSET_SIZE, h.numBlocks * OFFSET_SIZE, cs);
+		}
+
+		return (HsiehHash(costs, GetCostsSize(h), cs));
+	}
+
+	// checks a (mapped) file against the header the reader expects; returns
+	// false on any mismatch, including truncated files and corrupted payload
+	static inline bool IsValid(const std::uint8_t* data, std::uint64_t size, const Header& expected) {
+		if (data == nullptr || size < sizeof(Header))
+			return false;
+
+		Header h;
+		std::memcpy(&h, data, sizeof(Header));
+
+		if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0)
+			return false;
+		if (h.version != VERSION || h.dataHash != expected.dataHash || h.blockSize != expected.blockSize)
+			return false;
+		if (h.numPathTypes != expected.numPathTypes || h.numBlocks != expected.numBlocks || h.numVertexCosts != expected.numVertexCosts)
+			return false;
+		if (size != GetFileSize(h))
+			return false;
+
+		const std::uint8_t* offsets = data + sizeof(Header);
+		const std::uint8_t* costs = offsets + GetOffsetsSize(h);
+
+		return (CalcChecksum(h, offsets, costs) == h.dataChecksum);
+	}
+}
+
+#endif
@@ -0,0 +1,154 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef PATH_GOAL_FIELD_H
+#define PATH_GOAL_FIELD_H
+
+#include <algorithm>
+#include <cinttypes>
+#include <vector>
+
+#include "PathConstants.h"
+#include "System/type2.h"
+
+
+/**
+ * Backward (goal-to-start) Dijkstra search over the block-graph of an
+ * estimator, used to serve many path-requests that share a goal (e.g.
+ * large group move-orders) from a single search instead of one search
+ * per request.
+ *
+ * The field is expanded lazily, only as far as needed to settle the
+ * start-block of each request it serves. Settled costs and directions
+ * are final and ties are broken by block-index, so the path handed to
+ * a request does not depend on the order in which requests arrived or
+ * on how far the field had already been expanded (which makes it safe
+ * to use for synced requests).
+ */
+class PathGoalField {
+public:
+	void Init(int2 numBlocks, const int2* dirVectors) {
+		const size_t size = numBlocks.x * numBlocks.y;
+
+		nbrOfBlocks = numBlocks;
+		directionVectors = dirVectors;
+
+		blockCosts.clear();
+		blockCosts.resize(size, PATHCOST_INFINITY);
+		blockDirs.clear();
+		blockDirs.resize(size, PATH_DIRECTIONS);
+		settledBlocks.clear();
+		settledBlocks.resize(size, 0);
+
+		openBlocks.clear();
+	}
+
+	void AddGoalBlock(unsigned int blockIdx) {
+		blockCosts[blockIdx] = 0.0f;
+		PushOpenBlock(0.0f, blockIdx);
+	}
+
+	/**
+	 * Expands the field until <blockIdx> is settled or no open blocks
+	 * remain; returns true iff a path from <blockIdx> to the goal exists.
+	 * <EdgeCost(fromIdx, pathDir, toIdx)> returns the cost of stepping
+	 * from block <fromIdx> in direction <pathDir>, or PATHCOST_INFINITY
+	 * if that step is not possible.
+	 */
+	template<typename EdgeCostFunc>
+	bool Expand(unsigned int blockIdx, const EdgeCostFunc& EdgeCost) {
+		while (settledBlocks[blockIdx] == 0 && !openBlocks.empty()) {
+			std::pop_heap(openBlocks.begin(), openBlocks.end(), OpenBlockCmp());
+
+			const OpenBlock ob = openBlocks.back();
+			openBlocks.pop_back();
+
+			// stale entry, block was reached more cheaply after it was pushed
+			if (settledBlocks[ob.blockIdx] != 0)
+				continue;
+
+			settledBlocks[ob.blockIdx] = 1;
+			numSettledBlocks += 1;
+
+			const int2 blockPos = int2(ob.blockIdx % nbrOfBlocks.x, ob.blockIdx / nbrOfBlocks.x);
+
+			for (unsigned int pathDir = 0; pathDir < PATH_DIRECTIONS; pathDir++) {
+				// the block from which a step in <pathDir> leads to <ob>
+				const int2 prevPos = blockPos - directionVectors[pathDir];
+
+				if (static_cast<unsigned int>(prevPos.x) >= static_cast<unsigned int>(nbrOfBlocks.x))
+					continue;
+				if (static_cast<unsigned int>(prevPos.y) >= static_cast<unsigned int>(nbrOfBlocks.y))
+					continue;
+
+				const unsigned int prevIdx = prevPos.y * nbrOfBlocks.x + prevPos.x;
+
+				if (settledBlocks[prevIdx] != 0)
+					continue;
+
+				const float prevCost = ob.cost + EdgeCost(prevIdx, pathDir, ob.blockIdx);
+
+				if (prevCost >= blockCosts[prevIdx])
+					continue;
+
+				blockCosts[prevIdx] = prevCost;
+				blockDirs[prevIdx] = pathDir;
+
+				PushOpenBlock(prevCost, prevIdx);
+			}
+		}
+
+		return (settledBlocks[blockIdx] != 0);
+	}
+
+	/**
+	 * Appends the blocks on the path from (settled) <blockIdx> to the
+	 * goal to <pathBlocks>, starting with <blockIdx> itself.
+	 */
+	void GetPathBlocks(unsigned int blockIdx, std::vector<unsigned int>& pathBlocks) const {
+		pathBlocks.push_back(blockIdx);
+
+		while (blockDirs[blockIdx] != PATH_DIRECTIONS) {
+			const int2 blockPos = int2(blockIdx % nbrOfBlocks.x, blockIdx / nbrOfBlocks.x) + directionVectors[blockDirs[blockIdx]];
+
+			blockIdx = blockPos.y * nbrOfBlocks.x + blockPos.x;
+			pathBlocks.push_back(blockIdx);
+		}
+	}
+
+	float GetBlockCost(unsigned int blockIdx) const { return blockCosts[blockIdx]; }
+	size_t GetNumSettledBlocks() const { return numSettledBlocks; }
+
+private:
+	struct OpenBlock {
+		float cost;
+		unsigned int blockIdx;
+	};
+
+	// min-heap on cost, then index
+	struct OpenBlockCmp {
+		bool operator () (const OpenBlock& a, const OpenBlock& b) const {
+			if (a.cost != b.cost)
+				return (a.cost > b.cost);
+
+			return (a.blockIdx > b.blockIdx);
+		}
+	};
+
+	void PushOpenBlock(float cost, unsigned int blockIdx) {
+		openBlocks.push_back({cost, blockIdx});
+		std::push_heap(openBlocks.begin(), openBlocks.end(), OpenBlockCmp());
+	}
+
+private:
+	int2 nbrOfBlocks;
+	const int2* directionVectors = nullptr;
+
+	std::vector<float> blockCosts;
+	std::vector<std::uint8_t> blockDirs;
+	std::vector<std::uint8_t> settledBlocks;
+	std::vector<OpenBlock> openBlocks;
+
+	size_t numSettledBlocks = 0;
+};
+
+#endif
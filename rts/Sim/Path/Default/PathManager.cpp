@@ -9,12 +9,17 @@
 #include "PathLog.h"
 #include "PathMemPool.h"
 #include "Map/MapInfo.h"
+#include "Sim/Misc/GlobalSynced.h"
 #include "Sim/Misc/ModInfo.h"
 #include "Sim/Objects/SolidObject.h"
 #include "Sim/MoveTypes/MoveDefHandler.h"
+#include "System/Config/ConfigHandler.h"
 #include "System/Log/ILog.h"
+#include "System/Threading/ThreadPool.h" // for_mt
 #include "System/TimeProfiler.h"
 
+#include <atomic>
+
 
 
 CPathManager::CPathManager()
@@ -43,6 +48,10 @@ CPathManager::CPathManager()
 
 CPathManager::~CPathManager()
 {
+	for (CPathFinder* pf: workerPFs) {
+		pfMemPool.free(pf);
+	}
+
 	peMemPool.free(lowResPE);
 	peMemPool.free(medResPE);
 	pfMemPool.free(maxResPF);
@@ -61,6 +70,23 @@ std::int64_t CPathManager::Finalize() {
 		medResPE = peMemPool.alloc<CPathEstimator>(maxResPF, MEDRES_PE_BLOCKSIZE, "pe",  mapInfo->map.name);
 		lowResPE = peMemPool.alloc<CPathEstimator>(medResPE, LOWRES_PE_BLOCKSIZE, "pe2", mapInfo->map.name);
 
+		// one thread-safe PF per thread executing queued searches, limited by
+		// the same memory-budget as the PF threads used for PE initialization
+		const size_t numThreads = ThreadPool::GetNumThreads();
+		const size_t minMemFootPrint = sizeof(CPathFinder) + maxResPF->GetMemFootPrint();
+		const size_t maxMemFootPrint = configHandler->GetInt("MaxPathCostsMemoryFootPrint") * size_t(1024 * 1024);
+
+		workerPFs.resize(Clamp(maxMemFootPrint / minMemFootPrint, size_t(1), numThreads), nullptr);
+
+		for (CPathFinder*& pf: workerPFs) {
+			pf = pfMemPool.alloc<CPathFinder>(true);
+		}
+
+		// the med-res PE also uses these to refresh its vertex-costs after
+		// terrain changes (the low-res PE's parent is the med-res PE, whose
+		// searches can not run concurrently)
+		medResPE->SetWorkerPathFinders(workerPFs);
+
 		// make cached path data checksum part of synced state
 		// so that when any client has a corrupted / incorrect
 		// cache it desyncs from the start, not minutes later
@@ -109,87 +135,134 @@ void CPathManager::FinalizePath(MultiPath* path, const float3 startPos, const fl
 }
 
 
+// MAX_SEARCHED_NODES_PF is 65536, MAXRES_SEARCH_DISTANCE is 50 squares
+// the circular-constraint area therefore is PI*50*50 squares (i.e. 7854
+// rounded up to nearest integer) which means MAX_SEARCHED_NODES_*>>3 is
+// only slightly larger (8192) so the constraint has no purpose even for
+// max-res queries (!)
+static_assert(MAX_SEARCHED_NODES_PF <= 65536u, "");
+static_assert(MAXRES_SEARCH_DISTANCE <= 50.0f, "");
+
+static constexpr unsigned int PATH_NODE_LIMITS[] = {MAX_SEARCHED_NODES_PE >> 3, MAX_SEARCHED_NODES_PE >> 3, MAX_SEARCHED_NODES_PF >> 3};
+static constexpr float PATH_SEARCH_DISTANCES[] = {std::numeric_limits<float>::max(), MEDRES_SEARCH_DISTANCE, MAXRES_SEARCH_DISTANCE};
+
+enum {
+	PATH_LOW_RES = 0,
+	PATH_MED_RES = 1,
+	PATH_MAX_RES = 2,
+};
+
+
 IPath::SearchResult CPathManager::ArrangePath(
 	MultiPath* newPath,
 	const MoveDef* moveDef,
 	const float3& startPos,
 	const float3& goalPos,
 	CSolidObject* caller
+) const {
+	const IPath::SearchResult maxResResult = ArrangeMaxResPath(newPath, startPos, goalPos, caller, maxResPF);
+	const IPath::SearchResult bestResult = ArrangeEstimatedPath(newPath, startPos, goalPos, caller, maxResResult);
+
+	return bestResult;
+}
+
+// choose the PF or the PE depending on the projected 2D goal-distance
+// NOTE: this distance can be far smaller than the actual path length!
+// NOTE: take height difference into consideration for "special" cases
+// (unit at top of cliff, goal at bottom or vv.)
+static float GetHeurGoalDist2D(const CPathFinderDef* pfDef, const float3& startPos, const float3& goalPos) {
+	return (pfDef->Heuristic(startPos.x / SQUARE_SIZE, startPos.z / SQUARE_SIZE, 1) + math::fabs(goalPos.y - startPos.y) / SQUARE_SIZE);
+}
+
+/*
+The max-res part of ArrangePath; touches no estimator state, so requests can
+run this concurrently given a (thread-safe) CPathFinder instance per thread.
+*/
+IPath::SearchResult CPathManager::ArrangeMaxResPath(
+	MultiPath* newPath,
+	const float3& startPos,
+	const float3& goalPos,
+	const CSolidObject* caller,
+	CPathFinder* pathFinder
 ) const {
 	CPathFinderDef* pfDef = &newPath->peDef;
+	IPath::Path* pathObject = &newPath->maxResPath;
 
-	// choose the PF or the PE depending on the projected 2D goal-distance
-	// NOTE: this distance can be far smaller than the actual path length!
-	// NOTE: take height difference into consideration for "special" cases
-	// (unit at top of cliff, goal at bottom or vv.)
-	const float heurGoalDist2D = pfDef->Heuristic(startPos.x / SQUARE_SIZE, startPos.z / SQUARE_SIZE, 1) + math::fabs(goalPos.y - startPos.y) / SQUARE_SIZE;
-	const float searchDistances[] = {std::numeric_limits<float>::max(), MEDRES_SEARCH_DISTANCE, MAXRES_SEARCH_DISTANCE};
+	const MoveDef* moveDef = newPath->moveDef;
+	const float heurGoalDist2D = GetHeurGoalDist2D(pfDef, startPos, goalPos);
 
-	// MAX_SEARCHED_NODES_PF is 65536, MAXRES_SEARCH_DISTANCE is 50 squares
-	// the circular-constraint area therefore is PI*50*50 squares (i.e. 7854
-	// rounded up to nearest integer) which means MAX_SEARCHED_NODES_*>>3 is
-	// only slightly larger (8192) so the constraint has no purpose even for
-	// max-res queries (!)
-	assert(MAX_SEARCHED_NODES_PF <= 65536u);
-	assert(MAXRES_SEARCH_DISTANCE <= 50.0f);
+	IPath::SearchResult bestResult = IPath::Error;
 
-	constexpr unsigned int nodeLimits[] = {MAX_SEARCHED_NODES_PE >> 3, MAX_SEARCHED_NODES_PE >> 3, MAX_SEARCHED_NODES_PF >> 3};
+	if (heurGoalDist2D <= (MAXRES_SEARCH_DISTANCE * modInfo.pfRawDistMult)) {
+		pfDef->AllowRawPathSearch( true);
+		pfDef->AllowDefPathSearch(false); // block default search
 
-	constexpr bool useConstraints[] = {false, false, false};
-	constexpr bool allowRawSearch[] = {false, false, false};
+		// only the max-res CPathFinder implements DoRawSearch
+		bestResult = pathFinder->GetPath(*moveDef, *pfDef, caller, startPos, *pathObject, PATH_NODE_LIMITS[PATH_MAX_RES]);
 
-	IPathFinder* pathFinders[] = {lowResPE, medResPE, maxResPF};
-	IPath::Path* pathObjects[] = {&newPath->lowResPath, &newPath->medResPath, &newPath->maxResPath};
+		pfDef->AllowRawPathSearch(false);
+		pfDef->AllowDefPathSearch( true);
+	}
 
-	IPath::SearchResult bestResult = IPath::Error;
+	if (bestResult == IPath::Ok)
+		return bestResult;
 
-#if 1
+	// distance-limits are in ascending order
+	if (heurGoalDist2D > PATH_SEARCH_DISTANCES[PATH_MAX_RES])
+		return bestResult;
 
-	unsigned int bestSearch = -1u; // index
+	// constraints are disabled for all three pathfinders since these break
+	// search completeness (CPU usage is still limited by MAX_SEARCHED_NODES_*)
+	pfDef->DisableConstraint(true);
+	pfDef->AllowRawPathSearch(false);
 
-	enum {
-		PATH_LOW_RES = 0,
-		PATH_MED_RES = 1,
-		PATH_MAX_RES = 2,
-	};
+	return (std::min(bestResult, pathFinder->GetPath(*moveDef, *pfDef, caller, startPos, *pathObject, PATH_NODE_LIMITS[PATH_MAX_RES])));
+}
 
-	{
-		if (heurGoalDist2D <= (MAXRES_SEARCH_DISTANCE * modInfo.pfRawDistMult)) {
-			pfDef->AllowRawPathSearch( true);
-			pfDef->AllowDefPathSearch(false); // block default search
+/*
+The estimator part of ArrangePath, continuing from the result of ArrangeMaxResPath.
+*/
+IPath::SearchResult CPathManager::ArrangeEstimatedPath(
+	MultiPath* newPath,
+	const float3& startPos,
+	const float3& goalPos,
+	CSolidObject* caller,
+	IPath::SearchResult maxResResult
+) const {
+	CPathFinderDef* pfDef = &newPath->peDef;
 
-			// only the max-res CPathFinder implements DoRawSearch
-			bestResult = pathFinders[PATH_MAX_RES]->GetPath(*moveDef, *pfDef, caller, startPos, *pathObjects[PATH_MAX_RES], nodeLimits[PATH_MAX_RES]);
-			bestSearch = PATH_MAX_RES;
+	const MoveDef* moveDef = newPath->moveDef;
+	const float heurGoalDist2D = GetHeurGoalDist2D(pfDef, startPos, goalPos);
 
-			pfDef->AllowRawPathSearch(false);
-			pfDef->AllowDefPathSearch( true);
-		}
+	IPathFinder* pathFinders[] = {lowResPE, medResPE, maxResPF};
+	IPath::Path* pathObjects[] = {&newPath->lowResPath, &newPath->medResPath, &newPath->maxResPath};
 
-		if (bestResult != IPath::Ok) {
-			// try each pathfinder in order from MAX to LOW limited by distance,
-			// with constraints disabled for all three since these break search
-			// completeness (CPU usage is still limited by MAX_SEARCHED_NODES_*)
-			for (int n = PATH_MAX_RES; n >= PATH_LOW_RES; n--) {
-				// distance-limits are in ascending order
-				if (heurGoalDist2D > searchDistances[n])
-					continue;
+	IPath::SearchResult bestResult = maxResResult;
 
-				pfDef->DisableConstraint(!useConstraints[n]);
-				pfDef->AllowRawPathSearch(allowRawSearch[n]);
+	// any max-res result is better than none
+	unsigned int bestSearch = (bestResult != IPath::Error)? PATH_MAX_RES: -1u;
 
-				const IPath::SearchResult currResult = pathFinders[n]->GetPath(*moveDef, *pfDef, caller, startPos, *pathObjects[n], nodeLimits[n]);
+	if (bestResult != IPath::Ok) {
+		// try each estimator in order from MED to LOW limited by distance
+		for (int n = PATH_MED_RES; n >= PATH_LOW_RES; n--) {
+			// distance-limits are in ascending order
+			if (heurGoalDist2D > PATH_SEARCH_DISTANCES[n])
+				continue;
 
-				// note: GEQ s.t. MED-OK will be preferred over LOW-OK, etc
-				if (currResult >= bestResult)
-					continue;
+			pfDef->DisableConstraint(true);
+			pfDef->AllowRawPathSearch(false);
 
-				bestResult = currResult;
-				bestSearch = n;
+			const IPath::SearchResult currResult = pathFinders[n]->GetPath(*moveDef, *pfDef, caller, startPos, *pathObjects[n], PATH_NODE_LIMITS[n]);
 
-				if (currResult == IPath::Ok)
-					break;
-			}
+			// note: GEQ s.t. MED-OK will be preferred over LOW-OK, etc
+			if (currResult >= bestResult)
+				continue;
+
+			bestResult = currResult;
+			bestSearch = n;
+
+			if (currResult == IPath::Ok)
+				break;
 		}
 	}
 
@@ -207,125 +280,17 @@ IPath::SearchResult CPathManager::ArrangePath(
 	// constraints enabled, run a final unconstrained fallback
 	// MED search (unconstrained MAX search is not useful with
 	// current node limits and could kill performance without)
-	if (heurGoalDist2D > searchDistances[PATH_MED_RES]) {
+	if (heurGoalDist2D > PATH_SEARCH_DISTANCES[PATH_MED_RES]) {
 		pfDef->DisableConstraint(true);
 
 		// we can only have a low-res result at this point
 		pathObjects[PATH_LOW_RES]->path.clear();
 		pathObjects[PATH_LOW_RES]->squares.clear();
 
-		bestResult = std::min(bestResult, pathFinders[PATH_MED_RES]->GetPath(*moveDef, *pfDef, caller, startPos, *pathObjects[PATH_MED_RES], nodeLimits[PATH_MED_RES]));
-	}
-
-	return bestResult;
-
-
-#else
-
-
-	enum {
-		PATH_MAX_RES = 0,
-		PATH_MED_RES = 1,
-		PATH_LOW_RES = 3
-	};
-
-	int origPathRes = PATH_LOW_RES;
-
-	// first attempt - use ideal pathfinder (performance-wise)
-	{
-		if (heurGoalDist2D < MAXRES_SEARCH_DISTANCE) {
-			origPathRes = PATH_MAX_RES;
-		} else if (heurGoalDist2D < MEDRES_SEARCH_DISTANCE) {
-			origPathRes = PATH_MED_RES;
-		//} else {
-		//	origPathRes = PATH_LOW_RES;
-		}
-
-		switch (origPathRes) {
-			case PATH_MAX_RES: bestResult = maxResPF->GetPath(*moveDef, *pfDef, caller, startPos, newPath->maxResPath, nodeLimits[2]); break;
-			case PATH_MED_RES: bestResult = medResPE->GetPath(*moveDef, *pfDef, caller, startPos, newPath->medResPath, nodeLimits[1]); break;
-			case PATH_LOW_RES: bestResult = lowResPE->GetPath(*moveDef, *pfDef, caller, startPos, newPath->lowResPath, nodeLimits[0]); break;
-		}
-
-		if (bestResult == IPath::Ok) {
-			return bestResult;
-		}
-	}
-
-	// second attempt - try to reverse path
-	/*{
-		CCircularSearchConstraint reversedPfDef(goalPos, startPos, pfDef->sqGoalRadius, 7.0f, 8000);
-		switch (pathres) {
-			case PATH_MAX_RES: bestResult = maxResPF->GetPath(*moveDef, reversedPfDef, caller, goalPos, newPath->maxResPath, nodeLimits[2]); break;
-			case PATH_MED_RES: bestResult = medResPE->GetPath(*moveDef, reversedPfDef, caller, goalPos, newPath->medResPath, nodeLimits[1]); break;
-			case PATH_LOW_RES: bestResult = lowResPE->GetPath(*moveDef, reversedPfDef, caller, goalPos, newPath->lowResPath, nodeLimits[0]); break;
-		}
-
-		if (bestResult == IPath::Ok) {
-			assert(false);
-
-			float3 midPos;
-			switch (pathres) {
-				case PATH_MAX_RES: midPos = newPath->maxResPath.path.back(); break;
-				case PATH_MED_RES: midPos = newPath->medResPath.path.back(); break;
-				case PATH_LOW_RES: midPos = newPath->lowResPath.path.back(); break;
-			}
-
-			CCircularSearchConstraint midPfDef(startPos, midPos, pfDef->sqGoalRadius, 3.0f, 8000);
-			bestResult = maxResPF->GetPath(*moveDef, midPfDef, caller, startPos, newPath->maxResPath, MAX_SEARCHED_NODES_PF >> 3);
-
-			CCircularSearchConstraint restPfDef(midPos, goalPos, pfDef->sqGoalRadius, 7.0f, 8000);
-			switch (pathres) {
-				case PATH_MAX_RES:
-				case PATH_MED_RES: bestResult = medResPE->GetPath(*moveDef, restPfDef, caller, startPos, newPath->medResPath, nodeLimits[1]); break;
-				case PATH_LOW_RES: bestResult = lowResPE->GetPath(*moveDef, restPfDef, caller, startPos, newPath->lowResPath, nodeLimits[0]); break;
-			}
-
-			return bestResult;
-
-		}
-	}*/
-
-	// third attempt - use better pathfinder
-	{
-		int advPathRes = origPathRes;
-		int maxRes = (heurGoalDist2D < (MAXRES_SEARCH_DISTANCE * 2.0f)) ? PATH_MAX_RES : PATH_MED_RES;
-
-		while (--advPathRes >= maxRes) {
-			switch (advPathRes) {
-				case PATH_MAX_RES: bestResult = maxResPF->GetPath(*moveDef, *pfDef, caller, startPos, newPath->maxResPath, nodeLimits[2]); break;
-				case PATH_MED_RES: bestResult = medResPE->GetPath(*moveDef, *pfDef, caller, startPos, newPath->medResPath, nodeLimits[1]); break;
-				case PATH_LOW_RES: bestResult = lowResPE->GetPath(*moveDef, *pfDef, caller, startPos, newPath->lowResPath, nodeLimits[0]); break;
-			}
-
-			if (bestResult == IPath::Ok) {
-				return bestResult;
-			}
-		}
+		bestResult = std::min(bestResult, pathFinders[PATH_MED_RES]->GetPath(*moveDef, *pfDef, caller, startPos, *pathObjects[PATH_MED_RES], PATH_NODE_LIMITS[PATH_MED_RES]));
 	}
 
-	// fourth attempt - unconstrained search radius (performance heavy, esp. on max_res)
-	pfDef->DisableConstraint(true);
-	if (origPathRes > PATH_MAX_RES) {
-		int advPathRes = origPathRes;
-		int maxRes = PATH_MED_RES;
-
-		while (--advPathRes >= maxRes) {
-			switch (advPathRes) {
-				case PATH_MAX_RES: bestResult = maxResPF->GetPath(*moveDef, *pfDef, caller, startPos, newPath->maxResPath, nodeLimits[2]); break;
-				case PATH_MED_RES: bestResult = medResPE->GetPath(*moveDef, *pfDef, caller, startPos, newPath->medResPath, nodeLimits[1]); break;
-				case PATH_LOW_RES: bestResult = lowResPE->GetPath(*moveDef, *pfDef, caller, startPos, newPath->lowResPath, nodeLimits[0]); break;
-			}
-
-			if (bestResult == IPath::Ok) {
-				return bestResult;
-			}
-		}
-	}
-
-	LOG_L(L_DEBUG, "PathManager: no path found");
 	return bestResult;
-	#endif
 }
 
 
@@ -357,6 +322,17 @@ unsigned int CPathManager::RequestPath(
 	newPath.caller = caller;
 	newPath.peDef.synced = synced;
 
+	// searches for units are deferred to the start of a later frame and
+	// executed there in parallel with other queued searches (see Update)
+	if (caller != nullptr && synced && modInfo.pfQueueDelay > 0) {
+		newPath.queued = true;
+
+		const unsigned int pathID = Store(newPath);
+
+		queuedSearches.push_back({gs->frameNum + modInfo.pfQueueDelay, pathID});
+		return pathID;
+	}
+
 	if (caller != nullptr)
 		caller->UnBlock();
 
@@ -368,7 +344,7 @@ unsigned int CPathManager::RequestPath(
 		if (newPath.maxResPath.path.empty()) {
 			if (result != IPath::CantGetCloser) {
 				LowRes2MedRes(newPath, startPos, caller, synced);
-				MedRes2MaxRes(newPath, startPos, caller, synced);
+				MedRes2MaxRes(newPath, startPos, caller, synced, maxResPF);
 			} else {
 				// add one dummy waypoint so that the calling MoveType
 				// does not consider this request a failure, which can
@@ -395,7 +371,7 @@ unsigned int CPathManager::RequestPath(
 
 
 // converts part of a med-res path into a max-res path
-void CPathManager::MedRes2MaxRes(MultiPath& multiPath, const float3& startPos, const CSolidObject* owner, bool synced) const
+void CPathManager::MedRes2MaxRes(MultiPath& multiPath, const float3& startPos, const CSolidObject* owner, bool synced, CPathFinder* pathFinder) const
 {
 	assert(IsFinalized());
 
@@ -428,7 +404,7 @@ void CPathManager::MedRes2MaxRes(MultiPath& multiPath, const float3& startPos, c
 	// Perform the search.
 	// If this is the final improvement of the path, then use the original goal.
 	const auto& pfd = (medResPath.path.empty() && lowResPath.path.empty()) ? multiPath.peDef : rangedGoalDef;
-	const IPath::SearchResult result = maxResPF->GetPath(*multiPath.moveDef, pfd, owner, startPos, maxResPath, MAX_SEARCHED_NODES_ON_REFINE);
+	const IPath::SearchResult result = pathFinder->GetPath(*multiPath.moveDef, pfd, owner, startPos, maxResPath, MAX_SEARCHED_NODES_ON_REFINE);
 
 	// If no refined path could be found, set goal as desired goal.
 	if (result == IPath::CantGetCloser || result == IPath::Error) {
@@ -508,6 +484,14 @@ float3 CPathManager::NextWayPoint(
 	if (numRetries > MAX_PATH_REFINEMENT_DEPTH)
 		return (multiPath->finalGoal);
 
+	if (multiPath->queued) {
+		// search has not executed yet; like QTPFS, set the unit off toward
+		// its goal and mark the waypoint as temporary (negative y) so GMT
+		// does not consider it idle while waiting
+		const float3 targetDirec = ((multiPath->finalGoal - callerPos) * XZVector).SafeNormalize() * SQUARE_SIZE;
+		return float3(callerPos.x + targetDirec.x, -1.0f, callerPos.z + targetDirec.z);
+	}
+
 	IPath::Path& maxResPath = multiPath->maxResPath;
 	IPath::Path& medResPath = multiPath->medResPath;
 	IPath::Path& lowResPath = multiPath->lowResPath;
@@ -532,7 +516,7 @@ float3 CPathManager::NextWayPoint(
 		if (extendMedResPath)
 			LowRes2MedRes(*multiPath, callerPos, owner, synced);
 
-		MedRes2MaxRes(*multiPath, callerPos, owner, synced);
+		MedRes2MaxRes(*multiPath, callerPos, owner, synced, maxResPF);
 
 		if (multiPath->caller != nullptr)
 			multiPath->caller->Block();
@@ -605,6 +589,104 @@ void CPathManager::Update()
 
 	medResPE->Update();
 	lowResPE->Update();
+
+	ExecuteQueuedSearches();
+}
+
+/*
+Executes the searches queued by RequestPath which are due this frame. Only
+the max-res stages run concurrently since each thread can be given its own
+CPathFinder, the estimators keep per-search state and caches and therefore
+run serially (in path-ID order). The results do not depend on which thread
+executed a search, so this is sync-safe.
+*/
+void CPathManager::ExecuteQueuedSearches()
+{
+	executedSearches.clear();
+
+	while (!queuedSearches.empty() && queuedSearches.front().frameNum <= gs->frameNum) {
+		const unsigned int pathID = queuedSearches.front().pathID;
+
+		queuedSearches.pop_front();
+
+		MultiPath* multiPath = GetMultiPath(pathID);
+
+		// path might have been deleted before its search executed
+		if (multiPath == nullptr)
+			continue;
+
+		executedSearches.push_back({pathID, multiPath, IPath::Error});
+	}
+
+	if (executedSearches.empty())
+		return;
+
+	SCOPED_TIMER("Sim::Path::QueuedSearches");
+
+	std::atomic<unsigned int> nextSearchIdx = {0};
+
+	const auto ForEachSearch = [&](const auto& func) {
+		nextSearchIdx = 0;
+
+		for_mt(0, workerPFs.size(), [&](const int i) {
+			for (unsigned int n = nextSearchIdx++; n < executedSearches.size(); n = nextSearchIdx++) {
+				func(executedSearches[n], workerPFs[i]);
+			}
+		});
+	};
+
+	// NOTE:
+	//   searches neither UnBlock nor Block their caller (which would modify
+	//   the blocking-map concurrently), the caller is ignored by block-checks
+	//   since it is passed as owner anyway
+	ForEachSearch([&](ExecutedSearch& es, CPathFinder* pf) {
+		MultiPath* mp = es.multiPath;
+		es.result = ArrangeMaxResPath(mp, mp->start, mp->finalGoal, mp->caller, pf);
+	});
+
+	for (ExecutedSearch& es: executedSearches) {
+		MultiPath* mp = es.multiPath;
+		es.result = ArrangeEstimatedPath(mp, mp->start, mp->finalGoal, mp->caller, es.result);
+
+		if (es.result == IPath::Error || es.result == IPath::CantGetCloser)
+			continue;
+		if (!mp->maxResPath.path.empty())
+			continue;
+
+		LowRes2MedRes(*mp, mp->start, mp->caller, true);
+	}
+
+	ForEachSearch([&](ExecutedSearch& es, CPathFinder* pf) {
+		MultiPath* mp = es.multiPath;
+
+		if (es.result == IPath::Error || es.result == IPath::CantGetCloser)
+			return;
+		if (!mp->maxResPath.path.empty())
+			return;
+
+		MedRes2MaxRes(*mp, mp->start, mp->caller, true, pf);
+	});
+
+	// deliver results in path-ID order, same as RequestPath would have
+	for (ExecutedSearch& es: executedSearches) {
+		MultiPath* mp = es.multiPath;
+
+		if (es.result == IPath::Error) {
+			// NextWayPoint will return an error-vector for this ID
+			DeletePath(es.pathID);
+			continue;
+		}
+
+		if (es.result == IPath::CantGetCloser && mp->maxResPath.path.empty()) {
+			mp->maxResPath.path.push_back(mp->start);
+			mp->maxResPath.squares.push_back(int2(mp->start.x / SQUARE_SIZE, mp->start.z / SQUARE_SIZE));
+		}
+
+		FinalizePath(mp, mp->start, mp->finalGoal, es.result == IPath::CantGetCloser);
+
+		mp->searchResult = es.result;
+		mp->queued = false;
+	}
 }
 
 // used to deposit heat on the heat-map as a unit moves along its path
@@ -722,6 +804,13 @@ bool CPathManager::SetNodeExtraCost(unsigned int x, unsigned int z, float cost,
 	maxResBuf.SetNodeExtraCost(x, z, cost, synced);
 	medResBuf.SetNodeExtraCost(x, z, cost, synced);
 	lowResBuf.SetNodeExtraCost(x, z, cost, synced);
+
+	for (CPathFinder* pf: workerPFs) {
+		pf->GetNodeStateBuffer().SetNodeExtraCost(x, z, cost, synced);
+	}
+
+	medResPE->InvalidateGoalFields(synced);
+	lowResPE->InvalidateGoalFields(synced);
 	return true;
 }
 
@@ -740,6 +829,13 @@ bool CPathManager::SetNodeExtraCosts(const float* costs, unsigned int sizex, uns
 	maxResBuf.SetNodeExtraCosts(costs, sizex, sizez, synced);
 	medResBuf.SetNodeExtraCosts(costs, sizex, sizez, synced);
 	lowResBuf.SetNodeExtraCosts(costs, sizex, sizez, synced);
+
+	for (CPathFinder* pf: workerPFs) {
+		pf->GetNodeStateBuffer().SetNodeExtraCosts(costs, sizex, sizez, synced);
+	}
+
+	medResPE->InvalidateGoalFields(synced);
+	lowResPE->InvalidateGoalFields(synced);
 	return true;
 }
 
@@ -4,6 +4,8 @@
 #define PATHMANAGER_H
 
 #include <cinttypes>
+#include <deque>
+#include <vector>
 
 #include "Sim/Path/IPathManager.h"
 #include "IPath.h"
@@ -96,6 +98,7 @@ private:
 		MultiPath(): moveDef(nullptr), caller(nullptr) {}
 		MultiPath(const MoveDef* moveDef, const float3& startPos, const float3& goalPos, float goalRadius)
 			: searchResult(IPath::Error)
+			, queued(false)
 			, start(startPos)
 			, peDef(startPos, goalPos, goalRadius, 3.0f, 2000)
 			, moveDef(moveDef)
@@ -112,6 +115,7 @@ private:
 			maxResPath = std::move(mp.maxResPath);
 
 			searchResult = mp.searchResult;
+			queued = mp.queued;
 
 			start = mp.start;
 			finalGoal = mp.finalGoal;
@@ -132,6 +136,9 @@ private:
 
 		IPath::SearchResult searchResult;
 
+		// true until the (deferred) search for this path has executed
+		bool queued;
+
 		// request definition; start is const after ctor
 		float3 start;
 		float3 finalGoal;
@@ -152,6 +159,22 @@ private:
 		const float3& goalPos,
 		CSolidObject* caller
 	) const;
+	IPath::SearchResult ArrangeMaxResPath(
+		MultiPath* newPath,
+		const float3& startPos,
+		const float3& goalPos,
+		const CSolidObject* caller,
+		CPathFinder* pathFinder
+	) const;
+	IPath::SearchResult ArrangeEstimatedPath(
+		MultiPath* newPath,
+		const float3& startPos,
+		const float3& goalPos,
+		CSolidObject* caller,
+		IPath::SearchResult maxResResult
+	) const;
+
+	void ExecuteQueuedSearches();
 
 	MultiPath* GetMultiPath(int pathID) { return (const_cast<MultiPath*>(GetMultiPathConst(pathID))); }
 
@@ -171,7 +194,7 @@ private:
 	static void FinalizePath(MultiPath* path, const float3 startPos, const float3 goalPos, const bool cantGetCloser);
 
 	void LowRes2MedRes(MultiPath& path, const float3& startPos, const CSolidObject* owner, bool synced) const;
-	void MedRes2MaxRes(MultiPath& path, const float3& startPos, const CSolidObject* owner, bool synced) const;
+	void MedRes2MaxRes(MultiPath& path, const float3& startPos, const CSolidObject* owner, bool synced, CPathFinder* pathFinder) const;
 
 	bool IsFinalized() const { return (maxResPF != nullptr); }
 
@@ -183,8 +206,26 @@ private:
 	PathFlowMap* pathFlowMap;
 	PathHeatMap* pathHeatMap;
 
+	// thread-safe max-res pathfinders for executing queued searches
+	std::vector<CPathFinder*> workerPFs;
+
 	spring::unordered_map<unsigned int, MultiPath> pathMap;
 
+	struct QueuedSearch {
+		int frameNum; // frame at which the path is delivered
+		unsigned int pathID;
+	};
+
+	struct ExecutedSearch {
+		unsigned int pathID;
+		MultiPath* multiPath;
+		IPath::SearchResult result;
+	};
+
+	// requests made by units, in ID order
+	std::deque<QueuedSearch> queuedSearches;
+	std::vector<ExecutedSearch> executedSearches;
+
 	unsigned int nextPathID;
 };
 
@@ -1,6 +1,8 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <limits>
 
 #include "lib/streflop/streflop_cond.h"
@@ -191,6 +193,7 @@ void QTPFS::QTNode::InitStatic() {
 QTPFS::QTNode::QTNode(
 	const QTNode* parent,
 	unsigned int nn,
+	unsigned int ni,
 	unsigned int x1, unsigned int z1,
 	unsigned int x2, unsigned int z2
 ) {
@@ -198,6 +201,7 @@ QTPFS::QTNode::QTNode(
 	assert(MIN_SIZE_Z > 0);
 
 	nodeNumber = nn;
+	nodeIndex = ni;
 	heapIndex = -1u;
 
 	searchState  =   0;
@@ -221,42 +225,42 @@ QTPFS::QTNode::QTNode(
 	speedModAvg =  0.0f;
 	moveCostAvg = -1.0f;
 
-	prevNode = NULL;
+	prevNodeIdx = -1u;
+	entryPoint = ZeroVector;
 
-	// for leafs, all children remain NULL
-	children.fill(NULL);
+	// for leafs, the children remain unallocated
+	childBaseIdx = -1u;
+
+	ngbsOffset = 0;
+	ngbsSizeClass = -1u;
+	numNeighbors = 0;
 }
 
-void QTPFS::QTNode::Delete() {
+void QTPFS::QTNode::Delete(NodeLayer& nl) {
 	if (!IsLeaf()) {
-		for (unsigned int i = 0; i < children.size(); i++) {
-			children[i]->Delete(); children[i] = NULL;
+		for (unsigned int i = 0; i < QTNODE_CHILD_COUNT; i++) {
+			nl.GetPoolNode(GetChildIndex(i))->Delete(nl);
 		}
+
+		nl.FreeNodeGroup(childBaseIdx);
+		childBaseIdx = -1u;
 	}
 
-	delete this;
+	FreeNeighbors(nl);
 }
 
+void QTPFS::QTNode::FreeNeighbors(NodeLayer& nl) {
+	if (ngbsSizeClass != -1u)
+		nl.FreeNeighbors(ngbsOffset, ngbsSizeClass);
 
+	ngbsOffset = 0;
+	ngbsSizeClass = -1u;
+	numNeighbors = 0;
+}
 
-std::uint64_t QTPFS::QTNode::GetMemFootPrint() const {
-	std::uint64_t memFootPrint = sizeof(QTNode);
-
-	if (IsLeaf()) {
-		memFootPrint += (neighbors.size() * sizeof(INode*));
-		// already counted; std::array<> statically allocates
-		// memFootPrint += (children.size() * sizeof(QTNode*));
-		memFootPrint += (netpoints.size() * sizeof(float3));
-	} else {
-		for (unsigned int i = 0; i < children.size(); i++) {
-			memFootPrint += (children[i]->GetMemFootPrint());
-		}
-	}
 
-	return memFootPrint;
-}
 
-std::uint64_t QTPFS::QTNode::GetCheckSum() const {
+std::uint64_t QTPFS::QTNode::GetCheckSum(const NodeLayer& nl) const {
 	std::uint64_t sum = 0;
 
 	{
@@ -283,8 +287,8 @@ std::uint64_t QTPFS::QTNode::GetCheckSum() const {
 	}
 
 	if (!IsLeaf()) {
-		for (unsigned int n = 0; n < children.size(); n++) {
-			sum ^= (((nodeNumber << 8) + 1) * children[n]->GetCheckSum());
+		for (unsigned int n = 0; n < QTNODE_CHILD_COUNT; n++) {
+			sum ^= (((nodeNumber << 8) + 1) * nl.GetPoolNode(GetChildIndex(n))->GetCheckSum(nl));
 		}
 	}
 
@@ -294,12 +298,7 @@ std::uint64_t QTPFS::QTNode::GetCheckSum() const {
 
 
 bool QTPFS::QTNode::IsLeaf() const {
-	assert(children.size() == QTNODE_CHILD_COUNT);
-	assert(
-		(children[0] == NULL && children[1] == NULL && children[2] == NULL && children[3] == NULL) ||
-		(children[0] != NULL && children[1] != NULL && children[2] != NULL && children[3] != NULL)
-	);
-	return (children[0] == NULL);
+	return (childBaseIdx == -1u);
 }
 
 bool QTPFS::QTNode::CanSplit(bool forced) const {
@@ -330,19 +329,18 @@ bool QTPFS::QTNode::Split(NodeLayer& nl, bool forced) {
 	if (!CanSplit(forced))
 		return false;
 
-	neighbors.clear();
-	netpoints.clear();
+	FreeNeighbors(nl);
+
+	// can only split leaf-nodes (ie. nodes without children)
+	assert(IsLeaf());
 
-	// can only split leaf-nodes (ie. nodes with NULL-children)
-	assert(children[NODE_IDX_TL] == NULL);
-	assert(children[NODE_IDX_TR] == NULL);
-	assert(children[NODE_IDX_BR] == NULL);
-	assert(children[NODE_IDX_BL] == NULL);
+	// NOTE: pool-chunks are never moved, so <this> stays valid
+	childBaseIdx = nl.AllocNodeGroup();
 
-	children[NODE_IDX_TL] = new QTNode(this, GetChildID(NODE_IDX_TL),  xmin(), zmin(),  xmid(), zmid());
-	children[NODE_IDX_TR] = new QTNode(this, GetChildID(NODE_IDX_TR),  xmid(), zmin(),  xmax(), zmid());
-	children[NODE_IDX_BR] = new QTNode(this, GetChildID(NODE_IDX_BR),  xmid(), zmid(),  xmax(), zmax());
-	children[NODE_IDX_BL] = new QTNode(this, GetChildID(NODE_IDX_BL),  xmin(), zmid(),  xmid(), zmax());
+	*nl.GetPoolNode(GetChildIndex(NODE_IDX_TL)) = QTNode(this, GetChildID(NODE_IDX_TL), GetChildIndex(NODE_IDX_TL),  xmin(), zmin(),  xmid(), zmid());
+	*nl.GetPoolNode(GetChildIndex(NODE_IDX_TR)) = QTNode(this, GetChildID(NODE_IDX_TR), GetChildIndex(NODE_IDX_TR),  xmid(), zmin(),  xmax(), zmid());
+	*nl.GetPoolNode(GetChildIndex(NODE_IDX_BR)) = QTNode(this, GetChildID(NODE_IDX_BR), GetChildIndex(NODE_IDX_BR),  xmid(), zmid(),  xmax(), zmax());
+	*nl.GetPoolNode(GetChildIndex(NODE_IDX_BL)) = QTNode(this, GetChildID(NODE_IDX_BL), GetChildIndex(NODE_IDX_BL),  xmin(), zmid(),  xmid(), zmax());
 
 	nl.SetNumLeafNodes(nl.GetNumLeafNodes() + (4 - 1));
 	assert(!IsLeaf());
@@ -354,13 +352,16 @@ bool QTPFS::QTNode::Merge(NodeLayer& nl) {
 		return false;
 	}
 
-	neighbors.clear();
+	FreeNeighbors(nl);
 
 	// get rid of our children completely, but not of <this>!
-	for (unsigned int i = 0; i < children.size(); i++) {
-		children[i]->Delete(); children[i] = NULL;
+	for (unsigned int i = 0; i < QTNODE_CHILD_COUNT; i++) {
+		nl.GetPoolNode(GetChildIndex(i))->Delete(nl);
 	}
 
+	nl.FreeNodeGroup(childBaseIdx);
+	childBaseIdx = -1u;
+
 	nl.SetNumLeafNodes(nl.GetNumLeafNodes() - (4 - 1));
 	assert(IsLeaf());
 	return true;
@@ -383,10 +384,12 @@ bool QTPFS::QTNode::Merge(NodeLayer& nl) {
 		bool cont = false;
 
 		if (!IsLeaf()) {
-			for (unsigned int i = 0; i < children.size(); i++) {
-				if ((cont |= (children[i]->GetRectangleRelation(r) == REL_RECT_INTERIOR_NODE))) {
+			for (unsigned int i = 0; i < QTNODE_CHILD_COUNT; i++) {
+				QTNode* cn = nl.GetPoolNode(GetChildIndex(i));
+
+				if ((cont |= (cn->GetRectangleRelation(r) == REL_RECT_INTERIOR_NODE))) {
 					// only need to descend down one branch
-					children[i]->PreTesselate(nl, r, ur);
+					cn->PreTesselate(nl, r, ur);
 					break;
 				}
 			}
@@ -440,8 +443,8 @@ bool QTPFS::QTNode::Merge(NodeLayer& nl) {
 			return;
 		}
 
-		for (unsigned int i = 0; i < children.size(); i++) {
-			children[i]->PreTesselate(nl, cr, ur);
+		for (unsigned int i = 0; i < QTNODE_CHILD_COUNT; i++) {
+			nl.GetPoolNode(GetChildIndex(i))->PreTesselate(nl, cr, ur);
 		}
 	}
 
@@ -487,8 +490,8 @@ void QTPFS::QTNode::Tesselate(NodeLayer& nl, const SRectangle& r) {
 	if ((wantSplit && Split(nl, false)) || (needSplit && Split(nl, true))) {
 		registerNode = false;
 
-		for (unsigned int i = 0; i < children.size(); i++) {
-			QTNode* cn = children[i];
+		for (unsigned int i = 0; i < QTNODE_CHILD_COUNT; i++) {
+			QTNode* cn = nl.GetPoolNode(GetChildIndex(i));
 			SRectangle cr = cn->ClipRectangle(r);
 
 			cn->Tesselate(nl, cr);
@@ -641,71 +644,74 @@ unsigned int QTPFS::QTNode::GetMaxNumNeighbors() const {
 
 
 
-void QTPFS::QTNode::Serialize(std::fstream& fStream, NodeLayer& nodeLayer, unsigned int* streamSize, bool readMode) {
-	// overwritten when de-serializing
-	unsigned int numChildren = QTNODE_CHILD_COUNT * (1 - int(IsLeaf()));
+namespace QTPFS {
+	// one per node in a layer's cache-image; child ID's and
+	// extents follow from the parent so need not be stored
+	struct NodeImageRecord {
+		std::uint32_t numChildren;
 
-	(*streamSize) += (2 * sizeof(unsigned int));
-	(*streamSize) += (3 * sizeof(float));
-
-	if (readMode) {
-		fStream.read(reinterpret_cast<char*>(&nodeNumber), sizeof(unsigned int));
-		fStream.read(reinterpret_cast<char*>(&numChildren), sizeof(unsigned int));
+		float speedModAvg;
+		float speedModSum;
+		float moveCostAvg;
+	};
+}
 
-		fStream.read(reinterpret_cast<char*>(&speedModAvg), sizeof(float));
-		fStream.read(reinterpret_cast<char*>(&speedModSum), sizeof(float));
-		fStream.read(reinterpret_cast<char*>(&moveCostAvg), sizeof(float));
+void QTPFS::QTNode::Serialize(std::vector<std::uint8_t>& image, const NodeLayer& nl) const {
+	const NodeImageRecord rec = {QTNODE_CHILD_COUNT * (1 - int(IsLeaf())), speedModAvg, speedModSum, moveCostAvg};
 
-		if (numChildren > 0) {
-			// re-create child nodes
-			assert(IsLeaf());
-			Split(nodeLayer, true);
-		} else {
-			// node was a leaf in an earlier life, register it
-			nodeLayer.RegisterNode(this);
-		}
-	} else {
-		fStream.write(reinterpret_cast<const char*>(&nodeNumber), sizeof(unsigned int));
-		fStream.write(reinterpret_cast<const char*>(&numChildren), sizeof(unsigned int));
+	image.resize(image.size() + sizeof(rec));
+	std::memcpy(&image[image.size() - sizeof(rec)], &rec, sizeof(rec));
 
-		fStream.write(reinterpret_cast<const char*>(&speedModAvg), sizeof(float));
-		fStream.write(reinterpret_cast<const char*>(&speedModSum), sizeof(float));
-		fStream.write(reinterpret_cast<const char*>(&moveCostAvg), sizeof(float));
-	}
-
-	for (unsigned int i = 0; i < numChildren; i++) {
-		children[i]->Serialize(fStream, nodeLayer, streamSize, readMode);
+	for (unsigned int i = 0; i < rec.numChildren; i++) {
+		nl.GetPoolNode(GetChildIndex(i))->Serialize(image, nl);
 	}
 }
 
-unsigned int QTPFS::QTNode::GetNeighbors(const std::vector<INode*>& nodes, std::vector<INode*>& ngbs) {
-	#ifdef QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
-	UpdateNeighborCache(nodes);
-	#endif
+bool QTPFS::QTNode::Deserialize(const std::uint8_t*& image, const std::uint8_t* imageEnd, NodeLayer& nl) {
+	NodeImageRecord rec;
+
+	if ((imageEnd - image) < std::ptrdiff_t(sizeof(rec)))
+		return false;
+
+	std::memcpy(&rec, image, sizeof(rec));
+	image += sizeof(rec);
 
-	if (!neighbors.empty()) {
-		ngbs.clear();
-		ngbs.resize(neighbors.size());
+	speedModAvg = rec.speedModAvg;
+	speedModSum = rec.speedModSum;
+	moveCostAvg = rec.moveCostAvg;
 
-		std::copy(neighbors.begin(), neighbors.end(), ngbs.begin());
+	assert(IsLeaf());
+
+	switch (rec.numChildren) {
+		case 0: {
+			// node was a leaf in an earlier life, register it
+			nl.RegisterNode(this);
+			return true;
+		} break;
+		case QTNODE_CHILD_COUNT: {
+			// re-create child nodes; fails if the image is deeper than
+			// this map allows (should have been caught by the checksum)
+			if (!Split(nl, true))
+				return false;
+		} break;
+		default: {
+			return false;
+		} break;
 	}
 
-	return (neighbors.size());
-}
+	for (unsigned int i = 0; i < rec.numChildren; i++) {
+		if (!nl.GetPoolNode(GetChildIndex(i))->Deserialize(image, imageEnd, nl))
+			return false;
+	}
 
-const std::vector<QTPFS::INode*>& QTPFS::QTNode::GetNeighbors(const std::vector<INode*>& nodes) {
-	#ifdef QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
-	UpdateNeighborCache(nodes);
-	#endif
-	return neighbors;
+	return true;
 }
 
-// this is *either* called from ::GetNeighbors when the conservative
+// this is *either* called from PathSearch::IterateNodes when the conservative
 // update-scheme is enabled, *or* from PM::ExecQueuedNodeLayerUpdates
 // (never both)
-bool QTPFS::QTNode::UpdateNeighborCache(const std::vector<INode*>& nodes) {
+bool QTPFS::QTNode::UpdateNeighborCache(NodeLayer& nl) {
 	assert(IsLeaf());
-	assert(!nodes.empty());
 
 	if (prevMagicNum != currMagicNum) {
 		prevMagicNum = currMagicNum;
@@ -715,14 +721,14 @@ bool QTPFS::QTNode::UpdateNeighborCache(const std::vector<INode*>& nodes) {
 
 		// regenerate our neighbor cache
 		if (maxNgbs > 0) {
-			neighbors.clear();
-			neighbors.reserve(maxNgbs + 4);
+			// gather into the layer's scratch-buffers first, the
+			// final number of neighbors is not known in advance
+			std::vector<unsigned int>& neighbors = nl.GetTempNeighborIndices();
+			std::vector<float3>& netpoints = nl.GetTempNeighborPoints();
 
+			neighbors.clear();
 			netpoints.clear();
-			netpoints.reserve(1 + maxNgbs * QTPFS_MAX_NETPOINTS_PER_NODE_EDGE + 4);
 			// NOTE: caching ETP's breaks QTPFS_ORTHOPROJECTED_EDGE_TRANSITIONS
-			// NOTE: [0] is a reserved index and must always be valid
-			netpoints.push_back(float3());
 
 			INode* ngb = NULL;
 
@@ -731,10 +737,10 @@ bool QTPFS::QTNode::UpdateNeighborCache(const std::vector<INode*>& nodes) {
 
 				// walk along EDGE_L (west) neighbors
 				for (unsigned int hmz = zmin(); hmz < zmax(); ) {
-					ngb = nodes[hmz * mapDims.mapx + hmx];
+					ngb = nl.GetNode(hmx, hmz);
 					hmz = ngb->zmax();
 
-					neighbors.push_back(ngb);
+					neighbors.push_back(ngb->GetIndex());
 
 					for (unsigned int i = 0; i < QTPFS_MAX_NETPOINTS_PER_NODE_EDGE; i++) {
 						netpoints.push_back(INode::GetNeighborEdgeTransitionPoint(ngb, float3(), QTPFS_NETPOINT_EDGE_SPACING_SCALE * (i + 1)));
@@ -748,10 +754,10 @@ bool QTPFS::QTNode::UpdateNeighborCache(const std::vector<INode*>& nodes) {
 
 				// walk along EDGE_R (east) neighbors
 				for (unsigned int hmz = zmin(); hmz < zmax(); ) {
-					ngb = nodes[hmz * mapDims.mapx + hmx];
+					ngb = nl.GetNode(hmx, hmz);
 					hmz = ngb->zmax();
 
-					neighbors.push_back(ngb);
+					neighbors.push_back(ngb->GetIndex());
 
 					for (unsigned int i = 0; i < QTPFS_MAX_NETPOINTS_PER_NODE_EDGE; i++) {
 						netpoints.push_back(INode::GetNeighborEdgeTransitionPoint(ngb, float3(), QTPFS_NETPOINT_EDGE_SPACING_SCALE * (i + 1)));
@@ -766,10 +772,10 @@ bool QTPFS::QTNode::UpdateNeighborCache(const std::vector<INode*>& nodes) {
 
 				// walk along EDGE_T (north) neighbors
 				for (unsigned int hmx = xmin(); hmx < xmax(); ) {
-					ngb = nodes[hmz * mapDims.mapx + hmx];
+					ngb = nl.GetNode(hmx, hmz);
 					hmx = ngb->xmax();
 
-					neighbors.push_back(ngb);
+					neighbors.push_back(ngb->GetIndex());
 
 					for (unsigned int i = 0; i < QTPFS_MAX_NETPOINTS_PER_NODE_EDGE; i++) {
 						netpoints.push_back(INode::GetNeighborEdgeTransitionPoint(ngb, float3(), QTPFS_NETPOINT_EDGE_SPACING_SCALE * (i + 1)));
@@ -783,10 +789,10 @@ bool QTPFS::QTNode::UpdateNeighborCache(const std::vector<INode*>& nodes) {
 
 				// walk along EDGE_B (south) neighbors
 				for (unsigned int hmx = xmin(); hmx < xmax(); ) {
-					ngb = nodes[hmz * mapDims.mapx + hmx];
+					ngb = nl.GetNode(hmx, hmz);
 					hmx = ngb->xmax();
 
-					neighbors.push_back(ngb);
+					neighbors.push_back(ngb->GetIndex());
 
 					for (unsigned int i = 0; i < QTPFS_MAX_NETPOINTS_PER_NODE_EDGE; i++) {
 						netpoints.push_back(INode::GetNeighborEdgeTransitionPoint(ngb, float3(), QTPFS_NETPOINT_EDGE_SPACING_SCALE * (i + 1)));
@@ -800,14 +806,14 @@ bool QTPFS::QTNode::UpdateNeighborCache(const std::vector<INode*>& nodes) {
 			// top- and bottom-left corners
 			if ((ngbRels & REL_NGB_EDGE_L) != 0) {
 				if ((ngbRels & REL_NGB_EDGE_T) != 0) {
-					const INode* ngbL = nodes[(zmin() + 0) * mapDims.mapx + (xmin() - 1)];
-					const INode* ngbT = nodes[(zmin() - 1) * mapDims.mapx + (xmin() + 0)];
-						  INode* ngbC = nodes[(zmin() - 1) * mapDims.mapx + (xmin() - 1)];
+					const INode* ngbL = nl.GetNode(xmin() - 1, zmin() + 0);
+					const INode* ngbT = nl.GetNode(xmin() + 0, zmin() - 1);
+						  INode* ngbC = nl.GetNode(xmin() - 1, zmin() - 1);
 
 					// VERT_TL ngb must be distinct from EDGE_L and EDGE_T ngbs
 					if (ngbC != ngbL && ngbC != ngbT) {
 						if (ngbL->AllSquaresAccessible() && ngbT->AllSquaresAccessible()) {
-							neighbors.push_back(ngbC);
+							neighbors.push_back(ngbC->GetIndex());
 
 							for (unsigned int i = 0; i < QTPFS_MAX_NETPOINTS_PER_NODE_EDGE; i++) {
 								netpoints.push_back(INode::GetNeighborEdgeTransitionPoint(ngbC, float3(), QTPFS_NETPOINT_EDGE_SPACING_SCALE * (i + 1)));
@@ -816,14 +822,14 @@ bool QTPFS::QTNode::UpdateNeighborCache(const std::vector<INode*>& nodes) {
 					}
 				}
 				if ((ngbRels & REL_NGB_EDGE_B) != 0) {
-					const INode* ngbL = nodes[(zmax() - 1) * mapDims.mapx + (xmin() - 1)];
-					const INode* ngbB = nodes[(zmax() + 0) * mapDims.mapx + (xmin() + 0)];
-						  INode* ngbC = nodes[(zmax() + 0) * mapDims.mapx + (xmin() - 1)];
+					const INode* ngbL = nl.GetNode(xmin() - 1, zmax() - 1);
+					const INode* ngbB = nl.GetNode(xmin() + 0, zmax() + 0);
+						  INode* ngbC = nl.GetNode(xmin() - 1, zmax() + 0);
 
 					// VERT_BL ngb must be distinct from EDGE_L and EDGE_B ngbs
 					if (ngbC != ngbL && ngbC != ngbB) {
 						if (ngbL->AllSquaresAccessible() && ngbB->AllSquaresAccessible()) {
-							neighbors.push_back(ngbC);
+							neighbors.push_back(ngbC->GetIndex());
 
 							for (unsigned int i = 0; i < QTPFS_MAX_NETPOINTS_PER_NODE_EDGE; i++) {
 								netpoints.push_back(INode::GetNeighborEdgeTransitionPoint(ngbC, float3(), QTPFS_NETPOINT_EDGE_SPACING_SCALE * (i + 1)));
@@ -836,14 +842,14 @@ bool QTPFS::QTNode::UpdateNeighborCache(const std::vector<INode*>& nodes) {
 			// top- and bottom-right corners
 			if ((ngbRels & REL_NGB_EDGE_R) != 0) {
 				if ((ngbRels & REL_NGB_EDGE_T) != 0) {
-					const INode* ngbR = nodes[(zmin() + 0) * mapDims.mapx + (xmax() + 0)];
-					const INode* ngbT = nodes[(zmin() - 1) * mapDims.mapx + (xmax() - 1)];
-						  INode* ngbC = nodes[(zmin() - 1) * mapDims.mapx + (xmax() + 0)];
+					const INode* ngbR = nl.GetNode(xmax() + 0, zmin() + 0);
+					const INode* ngbT = nl.GetNode(xmax() - 1, zmin() - 1);
+						  INode* ngbC = nl.GetNode(xmax() + 0, zmin() - 1);
 
 					// VERT_TR ngb must be distinct from EDGE_R and EDGE_T ngbs
 					if (ngbC != ngbR && ngbC != ngbT) {
 						if (ngbR->AllSquaresAccessible() && ngbT->AllSquaresAccessible()) {
-							neighbors.push_back(ngbC);
+							neighbors.push_back(ngbC->GetIndex());
 
 							for (unsigned int i = 0; i < QTPFS_MAX_NETPOINTS_PER_NODE_EDGE; i++) {
 								netpoints.push_back(INode::GetNeighborEdgeTransitionPoint(ngbC, float3(), QTPFS_NETPOINT_EDGE_SPACING_SCALE * (i + 1)));
@@ -852,14 +858,14 @@ bool QTPFS::QTNode::UpdateNeighborCache(const std::vector<INode*>& nodes) {
 					}
 				}
 				if ((ngbRels & REL_NGB_EDGE_B) != 0) {
-					const INode* ngbR = nodes[(zmax() - 1) * mapDims.mapx + (xmax() + 0)];
-					const INode* ngbB = nodes[(zmax() + 0) * mapDims.mapx + (xmax() - 1)];
-						  INode* ngbC = nodes[(zmax() + 0) * mapDims.mapx + (xmax() + 0)];
+					const INode* ngbR = nl.GetNode(xmax() + 0, zmax() - 1);
+					const INode* ngbB = nl.GetNode(xmax() - 1, zmax() + 0);
+						  INode* ngbC = nl.GetNode(xmax() + 0, zmax() + 0);
 
 					// VERT_BR ngb must be distinct from EDGE_R and EDGE_B ngbs
 					if (ngbC != ngbR && ngbC != ngbB) {
 						if (ngbR->AllSquaresAccessible() && ngbB->AllSquaresAccessible()) {
-							neighbors.push_back(ngbC);
+							neighbors.push_back(ngbC->GetIndex());
 
 							for (unsigned int i = 0; i < QTPFS_MAX_NETPOINTS_PER_NODE_EDGE; i++) {
 								netpoints.push_back(INode::GetNeighborEdgeTransitionPoint(ngbC, float3(), QTPFS_NETPOINT_EDGE_SPACING_SCALE * (i + 1)));
@@ -870,11 +876,18 @@ bool QTPFS::QTNode::UpdateNeighborCache(const std::vector<INode*>& nodes) {
 			}
 			#endif
 
-			// NOTE: gcc 4.7 should FINALLY define __cplusplus properly (and accept -std=c++11)
-			#if (__cplusplus >= 201103L)
-			// neighbors.shrink_to_fit();
-			// netpoints.shrink_to_fit();
-			#endif
+			// re-use our current range if it is still large enough
+			if (ngbsSizeClass == -1u || (1u << ngbsSizeClass) < neighbors.size()) {
+				FreeNeighbors(nl);
+
+				ngbsSizeClass = NodeLayer::NeighborPool::GetSizeClass(neighbors.size());
+				ngbsOffset = nl.AllocNeighbors(ngbsSizeClass);
+			}
+
+			numNeighbors = neighbors.size();
+
+			std::copy(neighbors.begin(), neighbors.end(), nl.GetNeighborIndices(this));
+			std::copy(netpoints.begin(), netpoints.end(), nl.GetNeighborPoints(this));
 		}
 
 		return true;
@@ -3,9 +3,7 @@
 #ifndef QTPFS_NODE_HDR
 #define QTPFS_NODE_HDR
 
-#include <array>
 #include <vector>
-#include <fstream>
 #include <cinttypes>
 
 #include "PathEnums.hpp"
@@ -37,13 +35,12 @@ namespace QTPFS {
 		bool operator >= (const INode* n) const { return (fCost >= n->fCost); }
 
 		#ifdef QTPFS_VIRTUAL_NODE_FUNCTIONS
-		virtual void Serialize(std::fstream&, NodeLayer&, unsigned int*, bool) = 0;
-		virtual unsigned int GetNeighbors(const std::vector<INode*>&, std::vector<INode*>&) = 0;
-		virtual const std::vector<INode*>& GetNeighbors(const std::vector<INode*>& v) = 0;
-		virtual bool UpdateNeighborCache(const std::vector<INode*>& nodes) = 0;
+		virtual void Serialize(std::vector<std::uint8_t>&, const NodeLayer&) const = 0;
+		virtual bool Deserialize(const std::uint8_t*&, const std::uint8_t*, NodeLayer&) = 0;
+		virtual bool UpdateNeighborCache(NodeLayer& nl) = 0;
 
-		virtual void SetNeighborEdgeTransitionPoint(unsigned int ngbIdx, const float3& point) = 0;
-		virtual const float3& GetNeighborEdgeTransitionPoint(unsigned int ngbIdx) const = 0;
+		virtual unsigned int GetNumNeighbors() const = 0;
+		virtual unsigned int GetNeighborsOffset() const = 0;
 		#endif
 
 		unsigned int GetNeighborRelation(const INode* ngb) const;
@@ -81,8 +78,12 @@ namespace QTPFS {
 		const float* GetPathCosts() const { return &fCost; }
 		float GetPathCost(unsigned int type) const;
 
-		void SetPrevNode(INode* n) { prevNode = n; }
-		INode* GetPrevNode() { return prevNode; }
+		void SetPrevNodeIndex(unsigned int i) { prevNodeIdx = i; }
+		unsigned int GetPrevNodeIndex() const { return prevNodeIdx; }
+		unsigned int GetIndex() const { return nodeIndex; }
+
+		void SetEntryPoint(const float3& p) { entryPoint = p; }
+		const float3& GetEntryPoint() const { return entryPoint; }
 
 	protected:
 		// NOTE:
@@ -95,8 +96,14 @@ namespace QTPFS {
 		float gCost;
 		float hCost;
 
-		// points back to previous node in path
-		INode* prevNode;
+		// index of this node in its layer's node-pool
+		unsigned int nodeIndex;
+		// points back to previous node in path (-1 if none)
+		unsigned int prevNodeIdx;
+
+		// point on the edge through which a search entered this node
+		// (the source-point if this node is where the search started)
+		float3 entryPoint;
 
 	#ifdef QTPFS_VIRTUAL_NODE_FUNCTIONS
 	};
@@ -108,9 +115,11 @@ namespace QTPFS {
 	struct QTNode: public INode {
 	#endif
 	public:
+		QTNode() = default;
 		QTNode(
 			const QTNode* parent,
 			unsigned int nn,
+			unsigned int ni,
 			unsigned int x1, unsigned int z1,
 			unsigned int x2, unsigned int z2
 		);
@@ -122,14 +131,18 @@ namespace QTPFS {
 		//     <i> is a NODE_IDX index in [0, 3]
 		unsigned int GetChildID(unsigned int i) const { return (nodeNumber << 2) + (i + 1); }
 		unsigned int GetParentID() const { return ((nodeNumber - 1) >> 2); }
+		// children occupy consecutive slots in the node-pool
+		unsigned int GetChildIndex(unsigned int i) const { return (childBaseIdx + i); }
 
-		std::uint64_t GetMemFootPrint() const;
-		std::uint64_t GetCheckSum() const;
+		std::uint64_t GetCheckSum(const NodeLayer& nl) const;
 
-		void Delete();
+		void Delete(NodeLayer& nl);
 		void PreTesselate(NodeLayer& nl, const SRectangle& r, SRectangle& ur);
 		void Tesselate(NodeLayer& nl, const SRectangle& r);
-		void Serialize(std::fstream& fStream, NodeLayer& nodeLayer, unsigned int* streamSize, bool readMode);
+		// append the subtree rooted at this node to <image> (pre-order), or
+		// rebuild it from <image> which is advanced past the read records
+		void Serialize(std::vector<std::uint8_t>& image, const NodeLayer& nl) const;
+		bool Deserialize(const std::uint8_t*& image, const std::uint8_t* imageEnd, NodeLayer& nl);
 
 		bool IsLeaf() const;
 		bool CanSplit(bool forced) const;
@@ -138,12 +151,12 @@ namespace QTPFS {
 		bool Merge(NodeLayer& nl);
 
 		unsigned int GetMaxNumNeighbors() const;
-		unsigned int GetNeighbors(const std::vector<INode*>&, std::vector<INode*>&);
-		const std::vector<INode*>& GetNeighbors(const std::vector<INode*>&);
-		bool UpdateNeighborCache(const std::vector<INode*>& nodes);
+		bool UpdateNeighborCache(NodeLayer& nl);
 
-		void SetNeighborEdgeTransitionPoint(unsigned int ngbIdx, const float3& point) { netpoints[ngbIdx] = point; }
-		const float3& GetNeighborEdgeTransitionPoint(unsigned int ngbIdx) const { return netpoints[ngbIdx]; }
+		// neighbors (and their edge transition-points) are stored in the
+		// layer's neighbor-pool, see NodeLayer::GetNeighbor{Indices,Points}
+		unsigned int GetNumNeighbors() const { return numNeighbors; }
+		unsigned int GetNeighborsOffset() const { return ngbsOffset; }
 
 		unsigned int xmin() const { return (_xminxmax  & 0xFFFF); }
 		unsigned int zmin() const { return (_zminzmax  & 0xFFFF); }
@@ -173,6 +186,8 @@ namespace QTPFS {
 		static unsigned int MinSizeZ() { return MIN_SIZE_Z; }
 
 	private:
+		void FreeNeighbors(NodeLayer& nl);
+
 		bool UpdateMoveCost(
 			const NodeLayer& nl,
 			const SRectangle& r,
@@ -199,13 +214,13 @@ namespace QTPFS {
 		unsigned int currMagicNum;
 		unsigned int prevMagicNum;
 
-		std::array<QTNode*, QTNODE_CHILD_COUNT> children;
-		std::vector<INode*> neighbors;
+		// pool-index of the first child, -1 for leaves
+		unsigned int childBaseIdx;
 
-		// NOTE:
-		//   these should be float2's, but profiling shows float3's to be *faster* and
-		//   float3's are also more convenient to work with (so we take the memory hit)
-		std::vector<float3> netpoints;
+		// range in the layer's neighbor-pool (size-class -1 if none allocated)
+		unsigned int ngbsOffset;
+		unsigned int ngbsSizeClass;
+		unsigned int numNeighbors;
 	};
 }
 
@@ -11,6 +11,7 @@
 #include "Sim/MoveTypes/MoveDefHandler.h"
 #include "Sim/MoveTypes/MoveMath/MoveMath.h"
 #include "System/myMath.h"
+#include "System/Sync/HsiehHash.h"
 
 unsigned int QTPFS::NodeLayer::NUM_SPEEDMOD_BINS;
 float        QTPFS::NodeLayer::MIN_SPEEDMOD_VALUE;
@@ -38,7 +39,7 @@ void QTPFS::NodeLayer::InitStatic() {
 void QTPFS::NodeLayer::RegisterNode(INode* n) {
 	for (unsigned int hmz = n->zmin(); hmz < n->zmax(); hmz++) {
 		for (unsigned int hmx = n->xmin(); hmx < n->xmax(); hmx++) {
-			nodeGrid[hmz * xsize + hmx] = n;
+			nodeGrid[hmz * xsize + hmx] = n->GetIndex();
 		}
 	}
 }
@@ -53,16 +54,38 @@ void QTPFS::NodeLayer::Init(unsigned int layerNum) {
 	xsize = mapDims.mapx;
 	zsize = mapDims.mapy;
 
-	nodeGrid.resize(xsize * zsize, NULL);
+	nodeGrid.resize(xsize * zsize, 0);
 
 	curSpeedMods.resize(xsize * zsize,  0);
 	oldSpeedMods.resize(xsize * zsize,  0);
 	oldSpeedBins.resize(xsize * zsize, -1);
 	curSpeedBins.resize(xsize * zsize, -1);
+
+	// the root always occupies the first pool-slot
+	const unsigned int rootIdx = nodePool.AllocGroup();
+
+	nodePool[rootIdx] = QTNode(nullptr, 0, rootIdx, 0, 0, xsize, zsize);
+	RegisterNode(&nodePool[rootIdx]);
+}
+
+std::uint32_t QTPFS::NodeLayer::CalcDataCheckSum() const {
+	const unsigned int dims[] = {xsize, zsize, QTNode::MinSizeX(), QTNode::MinSizeZ(), NUM_SPEEDMOD_BINS};
+
+	std::uint32_t sum = 0;
+
+	sum = HsiehHash(&dims[0], sizeof(dims), sum);
+	sum = HsiehHash(curSpeedMods.data(), curSpeedMods.size() * sizeof(SpeedModType), sum);
+	sum = HsiehHash(curSpeedBins.data(), curSpeedBins.size() * sizeof(SpeedBinType), sum);
+	return sum;
 }
 
 void QTPFS::NodeLayer::Clear() {
 	nodeGrid.clear();
+	nodePool.Clear();
+	ngbPool.Clear();
+
+	tmpNgbIndices.clear();
+	tmpNgbPoints.clear();
 
 	curSpeedMods.clear();
 	oldSpeedMods.clear();
@@ -249,8 +272,8 @@ void QTPFS::NodeLayer::ExecNodeNeighborCacheUpdate(unsigned int currFrameNum, un
 		// top-left quadrant: [0, mapDims.mapx >> 1) x [0, mapDims.mapy >> 1)
 		//
 		// update an 8x8 block of squares per quadrant per frame
-		// in row-major order; every GetNeighbors() call invokes
-		// UpdateNeighborCache if the magic numbers do not match
+		// in row-major order; every UpdateNeighborCache() call
+		// is a no-op if the magic numbers already match
 		// (nodes can be visited multiple times per block update)
 		const int xmin =         (xoff +           0                   ), zmin =         (zoff +           0                   );
 		const int xmax = std::min(xmin + SQUARE_SIZE, mapDims.mapx >> 1), zmax = std::min(zmin + SQUARE_SIZE, mapDims.mapy >> 1);
@@ -259,14 +282,14 @@ void QTPFS::NodeLayer::ExecNodeNeighborCacheUpdate(unsigned int currFrameNum, un
 			unsigned int zspan = zsize;
 
 			for (int x = xmin; x < xmax; ) {
-				n = nodeGrid[z * xsize + x];
+				n = GetNode(x, z);
 				x = n->xmax();
 
 				zspan = std::min(zspan, n->zmax() - z);
 				zspan = std::max(zspan, 1u);
 
 				n->SetMagicNumber(currMagicNum);
-				n->GetNeighbors(nodeGrid);
+				n->UpdateNeighborCache(*this);
 			}
 
 			z += zspan;
@@ -281,14 +304,14 @@ void QTPFS::NodeLayer::ExecNodeNeighborCacheUpdate(unsigned int currFrameNum, un
 			unsigned int zspan = zsize;
 
 			for (int x = xmin; x < xmax; ) {
-				n = nodeGrid[z * xsize + x];
+				n = GetNode(x, z);
 				x = n->xmax();
 
 				zspan = std::min(zspan, n->zmax() - z);
 				zspan = std::max(zspan, 1u);
 
 				n->SetMagicNumber(currMagicNum);
-				n->GetNeighbors(nodeGrid);
+				n->UpdateNeighborCache(*this);
 			}
 
 			z += zspan;
@@ -303,14 +326,14 @@ void QTPFS::NodeLayer::ExecNodeNeighborCacheUpdate(unsigned int currFrameNum, un
 			unsigned int zspan = zsize;
 
 			for (int x = xmin; x < xmax; ) {
-				n = nodeGrid[z * xsize + x];
+				n = GetNode(x, z);
 				x = n->xmax();
 
 				zspan = std::min(zspan, n->zmax() - z);
 				zspan = std::max(zspan, 1u);
 
 				n->SetMagicNumber(currMagicNum);
-				n->GetNeighbors(nodeGrid);
+				n->UpdateNeighborCache(*this);
 			}
 
 			z += zspan;
@@ -325,14 +348,14 @@ void QTPFS::NodeLayer::ExecNodeNeighborCacheUpdate(unsigned int currFrameNum, un
 			unsigned int zspan = zsize;
 
 			for (int x = xmin; x < xmax; ) {
-				n = nodeGrid[z * xsize + x];
+				n = GetNode(x, z);
 				x = n->xmax();
 
 				zspan = std::min(zspan, n->zmax() - z);
 				zspan = std::max(zspan, 1u);
 
 				n->SetMagicNumber(currMagicNum);
-				n->GetNeighbors(nodeGrid);
+				n->UpdateNeighborCache(*this);
 			}
 
 			z += zspan;
@@ -356,7 +379,7 @@ void QTPFS::NodeLayer::ExecNodeNeighborCacheUpdates(const SRectangle& ur, unsign
 		unsigned int zspan = zsize;
 
 		for (int x = xmin; x < xmax; ) {
-			n = nodeGrid[z * xsize + x];
+			n = GetNode(x, z);
 			x = n->xmax();
 
 			// calculate largest safe z-increment along this row
@@ -367,7 +390,7 @@ void QTPFS::NodeLayer::ExecNodeNeighborCacheUpdates(const SRectangle& ur, unsign
 			//   during initialization, currMagicNum == 0 which nodes start with already 
 			//   (does not matter because prevMagicNum == -1, so updates are not no-ops)
 			n->SetMagicNumber(currMagicNum);
-			n->UpdateNeighborCache(nodeGrid);
+			n->UpdateNeighborCache(*this);
 		}
 
 		z += zspan;
@@ -8,13 +8,15 @@
 #include <deque> // for QTPFS_STAGGERED_LAYER_UPDATES
 #include <cinttypes>
 
+#include "System/float3.h"
 #include "System/Rectangle.h"
 #include "PathDefines.hpp"
+#include "Node.hpp"
+#include "NodePool.hpp"
 
 struct MoveDef;
 
 namespace QTPFS {
-	struct INode;
 
 	#ifdef QTPFS_STAGGERED_LAYER_UPDATES
 	struct LayerUpdate {
@@ -32,6 +34,9 @@ namespace QTPFS {
 		typedef unsigned char SpeedModType;
 		typedef unsigned char SpeedBinType;
 
+		typedef NodePool<QTNode, QTNODE_CHILD_COUNT> NodePoolType;
+		typedef NodeNeighborPool<float3, QTPFS_MAX_NETPOINTS_PER_NODE_EDGE> NeighborPool;
+
 		static void InitStatic();
 		static size_t MaxSpeedModTypeValue() { return (std::numeric_limits<SpeedModType>::max()); }
 		static size_t MaxSpeedBinTypeValue() { return (std::numeric_limits<SpeedBinType>::max()); }
@@ -61,17 +66,39 @@ namespace QTPFS {
 		void ExecNodeNeighborCacheUpdates(const SRectangle& ur, unsigned int currMagicNum);
 
 		float GetNodeRatio() const { return (numLeafNodes / std::max(1.0f, float(xsize * zsize))); }
-		const INode* GetNode(unsigned int x, unsigned int z) const { return nodeGrid[z * xsize + x]; }
-		      INode* GetNode(unsigned int x, unsigned int z)       { return nodeGrid[z * xsize + x]; }
-		const INode* GetNode(unsigned int i) const { return nodeGrid[i]; }
-		      INode* GetNode(unsigned int i)       { return nodeGrid[i]; }
+		const INode* GetNode(unsigned int x, unsigned int z) const { return &nodePool[nodeGrid[z * xsize + x]]; }
+		      INode* GetNode(unsigned int x, unsigned int z)       { return &nodePool[nodeGrid[z * xsize + x]]; }
+		const INode* GetNode(unsigned int i) const { return &nodePool[nodeGrid[i]]; }
+		      INode* GetNode(unsigned int i)       { return &nodePool[nodeGrid[i]]; }
+
+		// lookup by node-pool index (INode::GetIndex, QTNode::GetChildIndex)
+		const QTNode* GetPoolNode(unsigned int i) const { return &nodePool[i]; }
+		      QTNode* GetPoolNode(unsigned int i)       { return &nodePool[i]; }
+		const QTNode* GetRootNode() const { return &nodePool[0]; }
+		      QTNode* GetRootNode()       { return &nodePool[0]; }
+
+		unsigned int AllocNodeGroup() { return (nodePool.AllocGroup()); }
+		void FreeNodeGroup(unsigned int i) { nodePool.FreeGroup(i); }
+
+		unsigned int AllocNeighbors(unsigned int sizeClass) { return (ngbPool.Alloc(sizeClass)); }
+		void FreeNeighbors(unsigned int offset, unsigned int sizeClass) { ngbPool.Free(offset, sizeClass); }
+
+		// pool-indices of the neighbors of <n>, GetNumNeighbors() many
+		const unsigned int* GetNeighborIndices(const INode* n) const { return (ngbPool.GetIndices(n->GetNeighborsOffset())); }
+		      unsigned int* GetNeighborIndices(const INode* n)       { return (ngbPool.GetIndices(n->GetNeighborsOffset())); }
+		// QTPFS_MAX_NETPOINTS_PER_NODE_EDGE transition-points per neighbor of <n>
+		const float3* GetNeighborPoints(const INode* n) const { return (ngbPool.GetPoints(n->GetNeighborsOffset())); }
+		      float3* GetNeighborPoints(const INode* n)       { return (ngbPool.GetPoints(n->GetNeighborsOffset())); }
+
+		// scratch-space for QTNode::UpdateNeighborCache
+		std::vector<unsigned int>& GetTempNeighborIndices() { return tmpNgbIndices; }
+		std::vector<float3>& GetTempNeighborPoints() { return tmpNgbPoints; }
 
 		const std::vector<SpeedBinType>& GetOldSpeedBins() const { return oldSpeedBins; }
 		const std::vector<SpeedBinType>& GetCurSpeedBins() const { return curSpeedBins; }
 		const std::vector<SpeedModType>& GetOldSpeedMods() const { return oldSpeedMods; }
 		const std::vector<SpeedModType>& GetCurSpeedMods() const { return curSpeedMods; }
 
-		std::vector<INode*>& GetNodes() { return nodeGrid; }
 		void RegisterNode(INode* n);
 
 		void SetNumLeafNodes(unsigned int n) { numLeafNodes = n; }
@@ -82,18 +109,37 @@ namespace QTPFS {
 
 		SpeedBinType GetSpeedModBin(float absSpeedMod, float relSpeedMod) const;
 
+		// hash over everything a from-scratch tesselation depends on
+		// (the binned speed-modifiers and node-size limits), used to
+		// validate cached tree images
+		std::uint32_t CalcDataCheckSum() const;
+
 		std::uint64_t GetMemFootPrint() const {
 			std::uint64_t memFootPrint = sizeof(NodeLayer);
 			memFootPrint += (curSpeedMods.size() * sizeof(SpeedModType));
 			memFootPrint += (oldSpeedMods.size() * sizeof(SpeedModType));
 			memFootPrint += (curSpeedBins.size() * sizeof(SpeedBinType));
 			memFootPrint += (oldSpeedBins.size() * sizeof(SpeedBinType));
-			memFootPrint += (nodeGrid.size() * sizeof(INode*));
+			memFootPrint += (nodeGrid.size() * sizeof(unsigned int));
+			memFootPrint += nodePool.GetMemFootPrint();
+			memFootPrint += ngbPool.GetMemFootPrint();
 			return memFootPrint;
 		}
 
 	private:
-		std::vector<INode*> nodeGrid;
+		NodePoolType nodePool;
+
+		// NOTE:
+		//   transition-points should be float2's, but profiling shows float3's to be
+		//   *faster* and float3's are also more convenient to work with (so we take
+		//   the memory hit)
+		NeighborPool ngbPool;
+
+		std::vector<unsigned int> tmpNgbIndices;
+		std::vector<float3> tmpNgbPoints;
+
+		// pool-index of the leaf covering each square
+		std::vector<unsigned int> nodeGrid;
 
 		std::vector<SpeedModType> curSpeedMods;
 		std::vector<SpeedModType> oldSpeedMods;
@@ -0,0 +1,156 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef QTPFS_NODEPOOL_HDR
+#define QTPFS_NODEPOOL_HDR
+
+#include <cassert>
+#include <cinttypes>
+#include <memory>
+#include <vector>
+
+namespace QTPFS {
+	// per-layer node storage; nodes live in fixed-size chunks so their
+	// addresses remain stable while a tree is split or merged, and are
+	// handed out in groups of GROUP_SIZE consecutive indices (one group
+	// per set of siblings, so a parent only has to store one index)
+	template<typename TNode, unsigned int GROUP_SIZE, unsigned int CHUNK_SIZE = 4096>
+	struct NodePool {
+	public:
+		static_assert((CHUNK_SIZE % GROUP_SIZE) == 0, "");
+		static_assert((CHUNK_SIZE & (CHUNK_SIZE - 1)) == 0, "");
+
+		NodePool() = default;
+		NodePool(const NodePool& p) = delete;
+		NodePool(NodePool&& p) = default;
+
+		NodePool& operator = (const NodePool& p) = delete;
+		NodePool& operator = (NodePool&& p) = default;
+
+		void Clear() {
+			chunks.clear();
+			freeGroups.clear();
+
+			numSlots = 0;
+		}
+
+		unsigned int AllocGroup() {
+			if (!freeGroups.empty()) {
+				const unsigned int idx = freeGroups.back();
+				freeGroups.pop_back();
+				return idx;
+			}
+
+			if ((numSlots % CHUNK_SIZE) == 0)
+				chunks.emplace_back(new TNode[CHUNK_SIZE]);
+
+			const unsigned int idx = numSlots;
+			numSlots += GROUP_SIZE;
+			return idx;
+		}
+
+		void FreeGroup(unsigned int idx) {
+			assert((idx % GROUP_SIZE) == 0);
+			freeGroups.push_back(idx);
+		}
+
+		const TNode& operator [] (unsigned int idx) const {
+			assert(idx < numSlots);
+			return chunks[idx / CHUNK_SIZE][idx % CHUNK_SIZE];
+		}
+		TNode& operator [] (unsigned int idx) {
+			assert(idx < numSlots);
+			return chunks[idx / CHUNK_SIZE][idx % CHUNK_SIZE];
+		}
+
+		unsigned int GetNumSlots() const { return numSlots; }
+		unsigned int GetNumUsedSlots() const { return (numSlots - freeGroups.size() * GROUP_SIZE); }
+
+		std::uint64_t GetMemFootPrint() const {
+			std::uint64_t memFootPrint = 0;
+			memFootPrint += (chunks.size() * CHUNK_SIZE * sizeof(TNode));
+			memFootPrint += (chunks.capacity() * sizeof(std::unique_ptr<TNode[]>));
+			memFootPrint += (freeGroups.capacity() * sizeof(unsigned int));
+			return memFootPrint;
+		}
+
+	private:
+		std::vector< std::unique_ptr<TNode[]> > chunks;
+		std::vector<unsigned int> freeGroups;
+
+		unsigned int numSlots = 0;
+	};
+
+
+	// packed per-node neighbor lists: each leaf owns a range of neighbor
+	// node-indices (plus POINTS_PER_NGB edge transition-points for every
+	// neighbor) whose capacity is a power of two; ranges are recycled via
+	// per-size-class free-lists when a node's neighbor-set changes
+	template<typename TPoint, unsigned int POINTS_PER_NGB>
+	struct NodeNeighborPool {
+	public:
+		static constexpr unsigned int NUM_SIZE_CLASSES = 32;
+
+		static unsigned int GetSizeClass(unsigned int numNgbs) {
+			unsigned int sizeClass = 0;
+
+			while ((1u << sizeClass) < numNgbs)
+				sizeClass++;
+
+			return sizeClass;
+		}
+
+		NodeNeighborPool(): freeRanges(NUM_SIZE_CLASSES) {}
+
+		void Clear() {
+			indices.clear();
+			points.clear();
+			freeRanges.clear();
+			freeRanges.resize(NUM_SIZE_CLASSES);
+		}
+
+		unsigned int Alloc(unsigned int sizeClass) {
+			std::vector<unsigned int>& ranges = freeRanges[sizeClass];
+
+			if (!ranges.empty()) {
+				const unsigned int offset = ranges.back();
+				ranges.pop_back();
+				return offset;
+			}
+
+			const unsigned int offset = indices.size();
+
+			indices.resize(offset + (1u << sizeClass), -1u);
+			points.resize(indices.size() * POINTS_PER_NGB);
+			return offset;
+		}
+
+		void Free(unsigned int offset, unsigned int sizeClass) {
+			freeRanges[sizeClass].push_back(offset);
+		}
+
+		const unsigned int* GetIndices(unsigned int offset) const { return (indices.data() + offset); }
+		      unsigned int* GetIndices(unsigned int offset)       { return (indices.data() + offset); }
+		const TPoint* GetPoints(unsigned int offset) const { return (points.data() + offset * POINTS_PER_NGB); }
+		      TPoint* GetPoints(unsigned int offset)       { return (points.data() + offset * POINTS_PER_NGB); }
+
+		std::uint64_t GetMemFootPrint() const {
+			std::uint64_t memFootPrint = 0;
+			memFootPrint += (indices.capacity() * sizeof(unsigned int));
+			memFootPrint += (points.capacity() * sizeof(TPoint));
+
+			for (const std::vector<unsigned int>& ranges: freeRanges) {
+				memFootPrint += (ranges.capacity() * sizeof(unsigned int));
+			}
+
+			return memFootPrint;
+		}
+
+	private:
+		std::vector<unsigned int> indices;
+		std::vector<TPoint> points;
+		std::vector< std::vector<unsigned int> > freeRanges;
+	};
+}
+
+#endif
+
@@ -20,12 +20,19 @@
 #include "System/Config/ConfigHandler.h"
 #include "System/FileSystem/ArchiveScanner.h"
 #include "System/FileSystem/FileSystem.h"
+#include "System/FileSystem/MemoryMappedFile.h"
 #include "System/Log/ILog.h"
 #include "System/Platform/Threading.h"
 #include "System/Threading/SpringThreading.h"
 #include "System/Rectangle.h"
 #include "System/TimeProfiler.h"
+#include "System/UnorderedSet.hpp"
 #include "System/StringUtil.h"
+#include "System/Sync/HsiehHash.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 
 #ifdef GetTempPath
 #undef GetTempPath
@@ -102,7 +109,6 @@ QTPFS::PathManager::PathManager() {
 
 QTPFS::PathManager::~PathManager() {
 	for (unsigned int layerNum = 0; layerNum < nodeLayers.size(); layerNum++) {
-		nodeTrees[layerNum]->Delete();
 		nodeLayers[layerNum].Clear();
 
 		for (auto searchesIt = pathSearches[layerNum].begin(); searchesIt != pathSearches[layerNum].end(); ++searchesIt) {
@@ -115,10 +121,10 @@ QTPFS::PathManager::~PathManager() {
 		delete (tracesIt->second);
 	}
 
-	nodeTrees.clear();
 	nodeLayers.clear();
 	pathCaches.clear();
 	pathSearches.clear();
+	searchBatches.clear();
 	pathTypes.clear();
 	pathTraces.clear();
 
@@ -177,10 +183,10 @@ void QTPFS::PathManager::Load() {
 	numPathRequests   = 0;
 	maxNumLeafNodes   = 0;
 
-	nodeTrees.resize(moveDefHandler->GetNumMoveDefs(), NULL);
 	nodeLayers.resize(moveDefHandler->GetNumMoveDefs());
 	pathCaches.resize(moveDefHandler->GetNumMoveDefs());
 	pathSearches.resize(moveDefHandler->GetNumMoveDefs());
+	searchBatches.resize(moveDefHandler->GetNumMoveDefs());
 
 	// add one extra element for object-less requests
 	numCurrExecutedSearches.resize(teamHandler->ActiveTeams() + 1, 0);
@@ -189,14 +195,14 @@ void QTPFS::PathManager::Load() {
 	{
 		const std::uint32_t mapCheckSum = archiveScanner->GetArchiveCompleteChecksum(gameSetup->mapName);
 		const std::uint32_t modCheckSum = archiveScanner->GetArchiveCompleteChecksum(gameSetup->modName);
-		const std::string& cacheDirName = GetCacheDirName(mapCheckSum, modCheckSum);
 
 		{
+			cacheDirName = GetCacheDirName(mapCheckSum, modCheckSum);
+			numCachedLayers = 0;
 			layersInited = false;
-			haveCacheDir = FileSystem::DirExists(cacheDirName);
 
+			FileSystem::CreateDirectory(cacheDirName);
 			InitNodeLayersThreaded(MAP_RECTANGLE);
-			Serialize(cacheDirName);
 
 			layersInited = true;
 		}
@@ -215,14 +221,7 @@ void QTPFS::PathManager::Load() {
 			if (moveDefHandler->GetMoveDefByPathType(layerNum)->udRefCount == 0)
 				continue;
 
-			#ifndef QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
-			if (haveCacheDir) {
-				// if cache-dir exists, must set node relations after de-serializing its trees
-				nodeLayers[layerNum].ExecNodeNeighborCacheUpdates(MAP_RECTANGLE, numTerrainChanges);
-			}
-			#endif
-
-			pfsCheckSum ^= nodeTrees[layerNum]->GetCheckSum();
+			pfsCheckSum ^= nodeLayers[layerNum].GetRootNode()->GetCheckSum(nodeLayers[layerNum]);
 			maxNumLeafNodes = std::max(nodeLayers[layerNum].GetNumLeafNodes(), maxNumLeafNodes);
 		}
 
@@ -244,7 +243,6 @@ std::uint64_t QTPFS::PathManager::GetMemFootPrint() const {
 
 	for (unsigned int i = 0; i < nodeLayers.size(); i++) {
 		memFootPrint += nodeLayers[i].GetMemFootPrint();
-		memFootPrint += nodeTrees[i]->GetMemFootPrint();
 	}
 
 	// convert to megabytes
@@ -271,11 +269,12 @@ void QTPFS::PathManager::InitNodeLayersThreaded(const SRectangle& rect) {
 	streflop::streflop_init<streflop::Simple>();
 
 	char loadMsg[512] = {'\0'};
-	const char* fmtString = "[PathManager::%s] using %u threads for %u node-layers (%s)";
+	const char* fmtString = "[PathManager::%s] using %u threads for %u node-layers";
+	const char* sumString = "[PathManager::%s] loaded %u of %u node-layers from cache";
 
 	#ifdef QTPFS_OPENMP_ENABLED
 	{
-		sprintf(loadMsg, fmtString, __FUNCTION__, ThreadPool::GetNumThreads(), nodeLayers.size(), (haveCacheDir? "cached": "uncached"));
+		sprintf(loadMsg, fmtString, __FUNCTION__, ThreadPool::GetNumThreads(), nodeLayers.size());
 		pmLoadScreen.AddLoadMessage(loadMsg);
 
 		#ifndef NDEBUG
@@ -289,18 +288,10 @@ void QTPFS::PathManager::InitNodeLayersThreaded(const SRectangle& rect) {
 			pmLoadScreen.AddLoadMessage(loadMsg);
 			#endif
 
-			// construct each tree from scratch IFF no cache-dir exists
-			// (if it does, we only need to initialize speed{Mods, Bins}
-			// since Serialize will fill in the branches)
-			// NOTE:
-			//     silently assumes trees either ALL exist or ALL do not
-			//     (if >= 1 are missing for some player in MP, we desync)
 			InitNodeLayer(layerNum, rect);
-			UpdateNodeLayer(layerNum, rect);
 
-			const QTNode* tree = nodeTrees[layerNum];
 			const NodeLayer& layer = nodeLayers[layerNum];
-			const unsigned int mem = (tree->GetMemFootPrint() + layer.GetMemFootPrint()) / (1024 * 1024);
+			const unsigned int mem = layer.GetMemFootPrint() / (1024 * 1024);
 
 			#ifndef NDEBUG
 			sprintf(loadMsg, pstFmtStr, layerNum, mem, layer.GetNumLeafNodes(), layer.GetNodeRatio());
@@ -310,13 +301,16 @@ void QTPFS::PathManager::InitNodeLayersThreaded(const SRectangle& rect) {
 	}
 	#else
 	{
-		sprintf(loadMsg, fmtString, __FUNCTION__, GetNumThreads(), nodeLayers.size(), (haveCacheDir? "cached": "uncached"));
+		sprintf(loadMsg, fmtString, __FUNCTION__, GetNumThreads(), nodeLayers.size());
 		pmLoadScreen.AddLoadMessage(loadMsg);
 
 		SpawnSpringThreads(&PathManager::InitNodeLayersThread, rect);
 	}
 	#endif
 
+	sprintf(loadMsg, sumString, __FUNCTION__, numCachedLayers.load(), nodeLayers.size());
+	pmLoadScreen.AddLoadMessage(loadMsg);
+
 	streflop::streflop_init<streflop::Simple>();
 }
 
@@ -346,11 +340,9 @@ void QTPFS::PathManager::InitNodeLayersThread(
 		#endif
 
 		InitNodeLayer(layerNum, rect);
-		UpdateNodeLayer(layerNum, rect);
 
-		const QTNode* tree = nodeTrees[layerNum];
 		const NodeLayer& layer = nodeLayers[layerNum];
-		const unsigned int mem = (tree->GetMemFootPrint() + layer.GetMemFootPrint()) / (1024 * 1024);
+		const unsigned int mem = layer.GetMemFootPrint() / (1024 * 1024);
 
 		#ifndef NDEBUG
 		sprintf(loadMsg, pstFmtStr, layerNum, mem, layer.GetNumLeafNodes(), layer.GetNodeRatio());
@@ -360,13 +352,36 @@ void QTPFS::PathManager::InitNodeLayersThread(
 }
 
 void QTPFS::PathManager::InitNodeLayer(unsigned int layerNum, const SRectangle& r) {
-	nodeTrees[layerNum] = new QTPFS::QTNode(NULL,  0,  r.x1, r.z1,  r.x2, r.z2);
-
 	if (moveDefHandler->GetMoveDefByPathType(layerNum)->udRefCount == 0)
 		return;
 
-	nodeLayers[layerNum].Init(layerNum);
-	nodeLayers[layerNum].RegisterNode(nodeTrees[layerNum]);
+	NodeLayer& layer = nodeLayers[layerNum];
+
+	// also allocates the layer's root-node (covering the whole map)
+	layer.Init(layerNum);
+
+	// bins the speed-modifiers; these are needed either way and
+	// tell us whether the cached tree image (if any) still holds
+	const bool needTesselation = UpdateNodeLayer(layerNum, r);
+
+	// only layers whose map-data or MoveDef changed since their
+	// image was written need to be tesselated from scratch, this
+	// is decided per layer so a cache-miss on one does not force
+	// rebuilding all others (nor causes a desync between players)
+	if (ReadNodeLayerCache(layerNum)) {
+		numCachedLayers += 1;
+	} else {
+		SRectangle ur = r;
+
+		if (needTesselation)
+			layer.GetRootNode()->PreTesselate(layer, r, ur);
+
+		WriteNodeLayerCache(layerNum);
+	}
+
+	#ifndef QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
+	layer.ExecNodeNeighborCacheUpdates(r, numTerrainChanges);
+	#endif
 }
 
 
@@ -409,13 +424,15 @@ void QTPFS::PathManager::UpdateNodeLayersThread(
 
 // called in the non-staggered (#ifndef QTPFS_STAGGERED_LAYER_UPDATES)
 // layer update scheme and during initialization; see ::TerrainChange
-void QTPFS::PathManager::UpdateNodeLayer(unsigned int layerNum, const SRectangle& r) {
+// returns true if any speed-bins changed, tesselation is only done here
+// after initialization (InitNodeLayer takes care of it before that)
+bool QTPFS::PathManager::UpdateNodeLayer(unsigned int layerNum, const SRectangle& r) {
 	const MoveDef* md = moveDefHandler->GetMoveDefByPathType(layerNum);
 
 	if (!IsFinalized())
-		return;
+		return false;
 	if (md->udRefCount == 0)
-		return;
+		return false;
 
 	// NOTE:
 	//     this is needed for IsBlocked* --> SquareIsBlocked --> IsNonBlocking
@@ -439,17 +456,18 @@ void QTPFS::PathManager::UpdateNodeLayer(unsigned int layerNum, const SRectangle
 	ur.x2 = mr.x2;
 	ur.z2 = mr.z2;
 
-	const bool wantTesselation = (layersInited || !haveCacheDir);
 	const bool needTesselation = nodeLayers[layerNum].Update(mr, md);
 
-	if (needTesselation && wantTesselation) {
-		nodeTrees[layerNum]->PreTesselate(nodeLayers[layerNum], mr, ur);
+	if (needTesselation && layersInited) {
+		nodeLayers[layerNum].GetRootNode()->PreTesselate(nodeLayers[layerNum], mr, ur);
 		pathCaches[layerNum].MarkDeadPaths(mr);
 
 		#ifndef QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
 		nodeLayers[layerNum].ExecNodeNeighborCacheUpdates(ur, numTerrainChanges);
 		#endif
 	}
+
+	return needTesselation;
 }
 
 
@@ -492,7 +510,7 @@ void QTPFS::PathManager::ExecQueuedNodeLayerUpdates(unsigned int layerNum, bool
 		SRectangle ur = mr;
 
 		if (nodeLayers[layerNum].ExecQueuedUpdate()) {
-			nodeTrees[layerNum]->PreTesselate(nodeLayers[layerNum], mr, ur);
+			nodeLayers[layerNum].GetRootNode()->PreTesselate(nodeLayers[layerNum], mr, ur);
 			pathCaches[layerNum].MarkDeadPaths(mr);
 
 			#ifndef QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
@@ -535,90 +553,120 @@ std::string QTPFS::PathManager::GetCacheDirName(std::uint32_t mapCheckSum, std::
 	return dir;
 }
 
-void QTPFS::PathManager::Serialize(const std::string& cacheFileDir) {
-	std::vector<std::string> fileNames(nodeTrees.size(), "");
-	std::vector<std::fstream*> fileStreams(nodeTrees.size(), NULL);
-	std::vector<unsigned int> fileSizes(nodeTrees.size(), 0);
+namespace QTPFS {
+	struct NodeLayerCacheHeader {
+		char magic[4];
+
+		std::uint32_t version;
+		std::uint32_t layerNum;
+		// NodeLayer::CalcDataCheckSum at the time the image was written
+		std::uint32_t dataCheckSum;
+		// HsiehHash over the image (the QTNode records following us)
+		std::uint32_t imageCheckSum;
+		std::uint32_t imageSize;
+	};
 
-	if (!haveCacheDir) {
-		FileSystem::CreateDirectory(cacheFileDir);
-		assert(FileSystem::DirExists(cacheFileDir));
-	}
+	static constexpr char NODE_LAYER_CACHE_MAGIC[4] = {'Q', 'T', 'N', 'L'};
+}
 
-	#ifndef NDEBUG
-	char loadMsg[512] = {'\0'};
-	const char* fmtString = "[PathManager::%s] serializing node-tree %u (%s)";
-	#endif
+std::string QTPFS::PathManager::GetNodeLayerCacheFileName(unsigned int layerNum) const {
+	const MoveDef* md = moveDefHandler->GetMoveDefByPathType(layerNum);
+	return (cacheDirName + "tree" + IntToString(layerNum, "%02x") + "-" + md->name + ".bin");
+}
 
-	// TODO: compress the tree cache-files?
-	for (unsigned int i = 0; i < nodeTrees.size(); i++) {
-		const MoveDef* md = moveDefHandler->GetMoveDefByPathType(i);
+// called concurrently for different layers during initialization
+bool QTPFS::PathManager::ReadNodeLayerCache(unsigned int layerNum) {
+	const std::string fileName = GetNodeLayerCacheFileName(layerNum);
+	const CMemoryMappedFile file(fileName);
 
-		if (md->udRefCount == 0)
-			continue;
+	if (!file.IsOpen())
+		return false;
 
-		fileNames[i] = cacheFileDir + "tree" + IntToString(i, "%02x") + "-" + md->name;
-		fileStreams[i] = new std::fstream();
-
-		if (haveCacheDir) {
-			#ifdef QTPFS_CACHE_XACCESS
-			{
-				// FIXME: lock fileNames[i] instead of doing this
-				// fstreams can not be easily locked however, see
-				// http://stackoverflow.com/questions/839856/
-				while (!FileSystem::FileExists(fileNames[i] + "-tmp")) {
-					spring::this_thread::sleep_for(std::chrono::milliseconds(100));
-				}
-				while (FileSystem::GetFileSize(fileNames[i] + "-tmp") != sizeof(unsigned int)) {
-					spring::this_thread::sleep_for(std::chrono::milliseconds(100));
-				}
-
-				fileStreams[i]->open((fileNames[i] + "-tmp").c_str(), std::ios::in | std::ios::binary);
-				fileStreams[i]->read(reinterpret_cast<char*>(&fileSizes[i]), sizeof(unsigned int));
-				fileStreams[i]->close();
-
-				while (!FileSystem::FileExists(fileNames[i])) {
-					spring::this_thread::sleep_for(std::chrono::milliseconds(100));
-				}
-				while (FileSystem::GetFileSize(fileNames[i]) != fileSizes[i]) {
-					spring::this_thread::sleep_for(std::chrono::milliseconds(100));
-				}
-			}
-			#else
-			assert(FileSystem::FileExists(fileNames[i]));
-			#endif
+	NodeLayer& layer = nodeLayers[layerNum];
+	NodeLayerCacheHeader header;
 
-			// read fileNames[i] into nodeTrees[i]
-			fileStreams[i]->open(fileNames[i].c_str(), std::ios::in | std::ios::binary);
-			assert(fileStreams[i]->good());
-			assert(nodeTrees[i]->IsLeaf());
-		} else {
-			// write nodeTrees[i] into fileNames[i]
-			fileStreams[i]->open(fileNames[i].c_str(), std::ios::out | std::ios::binary);
-		}
+	const auto IsValidHeader = [&]() {
+		if (file.GetSize() < sizeof(header))
+			return false;
 
-		#ifndef NDEBUG
-		sprintf(loadMsg, fmtString, __FUNCTION__, i, md->name.c_str());
-		pmLoadScreen.AddLoadMessage(loadMsg);
-		#endif
+		std::memcpy(&header, file.GetData(), sizeof(header));
+
+		if (std::memcmp(header.magic, NODE_LAYER_CACHE_MAGIC, sizeof(header.magic)) != 0)
+			return false;
+		if (header.version != QTPFS_CACHE_VERSION || header.layerNum != layerNum)
+			return false;
+		if (header.dataCheckSum != layer.CalcDataCheckSum())
+			return false;
+		if (file.GetSize() != (sizeof(header) + header.imageSize))
+			return false;
 
-		nodeTrees[i]->Serialize(*fileStreams[i], nodeLayers[i], &fileSizes[i], haveCacheDir);
+		return (HsiehHash(file.GetData() + sizeof(header), header.imageSize, 0) == header.imageCheckSum);
+	};
 
-		fileStreams[i]->flush();
-		fileStreams[i]->close();
+	// stale (map or MoveDef changed) or damaged, will be overwritten
+	if (!IsValidHeader())
+		return false;
 
-		#ifdef QTPFS_CACHE_XACCESS
-		if (!haveCacheDir) {
-			// signal any other (concurrently loading) Spring processes; needed for validation-tests
-			fileStreams[i]->open((fileNames[i] + "-tmp").c_str(), std::ios::out | std::ios::binary);
-			fileStreams[i]->write(reinterpret_cast<const char*>(&fileSizes[i]), sizeof(unsigned int));
-			fileStreams[i]->flush();
-			fileStreams[i]->close();
-		}
-		#endif
+	QTNode* root = layer.GetRootNode();
 
-		delete fileStreams[i];
+	const QTNode rootCopy = *root;
+	const std::uint8_t* imageBeg = file.GetData() + sizeof(header);
+	const std::uint8_t* imageEnd = imageBeg + header.imageSize;
+
+	if (root->Deserialize(imageBeg, imageEnd, layer) && imageBeg == imageEnd)
+		return true;
+
+	// malformed despite matching checksums; undo what was built so far
+	root->Merge(layer);
+	*root = rootCopy;
+
+	layer.RegisterNode(root);
+	layer.SetNumLeafNodes(1);
+	return false;
+}
+
+void QTPFS::PathManager::WriteNodeLayerCache(unsigned int layerNum) const {
+	const NodeLayer& layer = nodeLayers[layerNum];
+	const std::string fileName = GetNodeLayerCacheFileName(layerNum);
+
+	std::vector<std::uint8_t> image;
+	image.reserve(layer.GetNumLeafNodes() * 2 * (sizeof(float) * 4));
+
+	layer.GetRootNode()->Serialize(image, layer);
+
+	NodeLayerCacheHeader header;
+	std::memcpy(header.magic, NODE_LAYER_CACHE_MAGIC, sizeof(header.magic));
+
+	header.version = QTPFS_CACHE_VERSION;
+	header.layerNum = layerNum;
+	header.dataCheckSum = layer.CalcDataCheckSum();
+	header.imageCheckSum = HsiehHash(image.data(), image.size(), 0);
+	header.imageSize = image.size();
+
+	{
+		// write to a temporary and move it into place s.t. other (concurrently
+		// loading) Spring processes never see partial images; a reader which
+		// does anyway will fail the checksum test and rebuild the layer
+		std::ofstream file(fileName + "-tmp", std::ios::out | std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open())
+			return;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(image.data()), image.size());
+		file.close();
+
+		if (file.fail()) {
+			FileSystem::Remove(fileName + "-tmp");
+			return;
+		}
 	}
+
+	// std::rename does not replace existing files on all platforms
+	if (FileSystem::FileExists(fileName))
+		FileSystem::Remove(fileName);
+
+	std::rename((fileName + "-tmp").c_str(), fileName.c_str());
 }
 
 
@@ -701,19 +749,29 @@ void QTPFS::PathManager::ThreadUpdate() {
 		static unsigned int minPathTypeUpdate = 0;
 		static unsigned int maxPathTypeUpdate = numPathTypeUpdates;
 
-		sharedPaths.clear();
-
 		for (unsigned int pathTypeUpdate = minPathTypeUpdate; pathTypeUpdate < maxPathTypeUpdate; pathTypeUpdate++) {
 			#ifndef QTPFS_IGNORE_DEAD_PATHS
 			QueueDeadPathSearches(pathTypeUpdate);
 			#endif
 
 			#ifdef QTPFS_STAGGERED_LAYER_UPDATES
-			// NOTE: *must* be called between QueueDeadPathSearches and ExecuteQueuedSearches
+			// NOTE: *must* be called between QueueDeadPathSearches and SelectQueuedSearches
 			ExecQueuedNodeLayerUpdates(pathTypeUpdate, !pathSearches[pathTypeUpdate].empty());
 			#endif
 
-			ExecuteQueuedSearches(pathTypeUpdate);
+			SelectQueuedSearches(pathTypeUpdate);
+		}
+
+		// searches on different layers touch disjoint node and cache
+		// data, so each layer's batch can run on its own worker; any
+		// shared state is only modified when publishing the results
+		// (in layer-order, s.t. the outcome stays deterministic)
+		for_mt(minPathTypeUpdate, maxPathTypeUpdate, [&](const int pathType) {
+			ExecuteSearchBatch(pathType);
+		});
+
+		for (unsigned int pathTypeUpdate = minPathTypeUpdate; pathTypeUpdate < maxPathTypeUpdate; pathTypeUpdate++) {
+			PublishSearchBatch(pathTypeUpdate);
 		}
 
 		std::copy(numCurrExecutedSearches.begin(), numCurrExecutedSearches.end(), numPrevExecutedSearches.begin());
@@ -738,98 +796,143 @@ void QTPFS::PathManager::ThreadUpdate() {
 
 
 
-void QTPFS::PathManager::ExecuteQueuedSearches(unsigned int pathType) {
+void QTPFS::PathManager::SelectQueuedSearches(unsigned int pathType) {
 	NodeLayer& nodeLayer = nodeLayers[pathType];
 	PathCache& pathCache = pathCaches[pathType];
 
 	std::vector<IPathSearch*>& searches = pathSearches[pathType];
 	std::vector<IPathSearch*>::iterator searchesIt = searches.begin();
+	std::vector<BatchedSearch>& batch = searchBatches[pathType];
 
-	if (!searches.empty()) {
-		// execute pending searches collected via
-		// RequestPath and QueueDeadPathSearches
-		while (searchesIt != searches.end()) {
-			if (ExecuteSearch(searches, searchesIt, nodeLayer, pathCache, pathType)) {
-				searchStateOffset += NODE_STATE_OFFSET;
-			}
-		}
-	}
-}
-
-bool QTPFS::PathManager::ExecuteSearch(
-	PathSearchVect& searches,
-	PathSearchVectIt& searchesIt,
-	NodeLayer& nodeLayer,
-	PathCache& pathCache,
-	unsigned int pathType
-) {
-	IPathSearch* search = *searchesIt;
-	IPath* path = pathCache.GetTempPath(search->GetID());
+	#ifdef QTPFS_SEARCH_SHARED_PATHS
+	spring::unordered_set<std::uint64_t> batchHashes;
+	#endif
 
-	assert(search != nullptr);
-	assert(path != nullptr);
+	assert(batch.empty());
 
-	const auto DeleteSearch = [](IPathSearch* s, PathSearchVect& v, PathSearchVectIt& it) {
+	const auto RemoveSearch = [](PathSearchVect& v, PathSearchVectIt& it) {
 		// ordering of still-queued searches is not relevant
 		*it = v.back();
 		v.pop_back();
-		delete s;
 	};
 
-	// temp-path might have been removed already via
-	// DeletePath before we got a chance to process it
-	if (path->GetID() == 0) {
-		DeleteSearch(search, searches, searchesIt);
-		return false;
-	}
+	// take pending searches collected via RequestPath
+	// and QueueDeadPathSearches off the layer's queue
+	while (searchesIt != searches.end()) {
+		IPathSearch* search = *searchesIt;
+		IPath* path = pathCache.GetTempPath(search->GetID());
 
-	assert(search->GetID() != 0);
-	assert(path->GetID() == search->GetID());
+		assert(search != nullptr);
+		assert(path != nullptr);
 
-	search->Initialize(&nodeLayer, &pathCache, path->GetSourcePoint(), path->GetTargetPoint(), MAP_RECTANGLE);
-	path->SetHash(search->GetHash(mapDims.mapx * mapDims.mapy, pathType));
+		// temp-path might have been removed already via
+		// DeletePath before we got a chance to process it
+		if (path->GetID() == 0) {
+			RemoveSearch(searches, searchesIt);
+			delete search;
+			continue;
+		}
 
-	{
-		#ifdef QTPFS_SEARCH_SHARED_PATHS
-		SharedPathMap::const_iterator sharedPathsIt = sharedPaths.find(path->GetHash());
+		assert(search->GetID() != 0);
+		assert(path->GetID() == search->GetID());
 
-		if (sharedPathsIt != sharedPaths.end()) {
-			if (search->SharedFinalize(sharedPathsIt->second, path)) {
-				DeleteSearch(search, searches, searchesIt);
-				return false;
-			}
-		}
+		search->Initialize(&nodeLayer, &pathCache, path->GetSourcePoint(), path->GetTargetPoint(), MAP_RECTANGLE);
+		path->SetHash(search->GetHash(mapDims.mapx * mapDims.mapy, pathType));
+
+		bool charged = true;
+
+		#ifdef QTPFS_SEARCH_SHARED_PATHS
+		charged = (batchHashes.find(path->GetHash()) == batchHashes.end());
 		#endif
 
 		#ifdef QTPFS_LIMIT_TEAM_SEARCHES
-		const unsigned int numCurrSearches = numCurrExecutedSearches[search->GetTeam()];
-		const unsigned int numPrevSearches = numPrevExecutedSearches[search->GetTeam()];
+		if (charged) {
+			const unsigned int numCurrSearches = numCurrExecutedSearches[search->GetTeam()];
+			const unsigned int numPrevSearches = numPrevExecutedSearches[search->GetTeam()];
 
-		if ((numCurrSearches - numPrevSearches) >= MAX_TEAM_SEARCHES) {
-			++searchesIt; return false;
+			if ((numCurrSearches - numPrevSearches) >= MAX_TEAM_SEARCHES) {
+				++searchesIt; continue;
+			}
+
+			numCurrExecutedSearches[search->GetTeam()] += 1;
 		}
+		#endif
 
-		numCurrExecutedSearches[search->GetTeam()] += 1;
+		#ifdef QTPFS_SEARCH_SHARED_PATHS
+		batchHashes.insert(path->GetHash());
 		#endif
+
+		// every search gets its own state-offset, even if it ends up sharing
+		batch.push_back({search, path, searchStateOffset, SEARCH_RESULT_NONE, charged});
+		searchStateOffset += NODE_STATE_OFFSET;
+
+		RemoveSearch(searches, searchesIt);
 	}
+}
 
-	// removes path from temp-paths, adds it to live-paths
-	if (search->Execute(searchStateOffset, numTerrainChanges)) {
+__FORCE_ALIGN_STACK__
+void QTPFS::PathManager::ExecuteSearchBatch(unsigned int pathType) {
+	#ifdef QTPFS_SEARCH_SHARED_PATHS
+	// maps "hashes" of executed searches to the found paths
+	SharedPathMap sharedPaths;
+	#endif
+
+	for (BatchedSearch& bs: searchBatches[pathType]) {
+		IPathSearch* search = bs.search;
+		IPath* path = bs.path;
+
+		#ifdef QTPFS_SEARCH_SHARED_PATHS
+		const SharedPathMapIt sharedPathsIt = sharedPaths.find(path->GetHash());
+
+		if (sharedPathsIt != sharedPaths.end() && search->SharedFinalize(sharedPathsIt->second, path)) {
+			bs.result = SEARCH_RESULT_SHARED;
+			continue;
+		}
+		#endif
+
+		if (!search->Execute(bs.stateOffset, numTerrainChanges)) {
+			bs.result = SEARCH_RESULT_FAILED;
+			continue;
+		}
+
+		// removes path from temp-paths, adds it to live-paths
 		search->Finalize(path);
+		bs.result = SEARCH_RESULT_FOUND;
 
 		#ifdef QTPFS_SEARCH_SHARED_PATHS
 		sharedPaths[path->GetHash()] = path;
 		#endif
+	}
+}
 
-		#ifdef QTPFS_TRACE_PATH_SEARCHES
-		pathTraces[path->GetID()] = search->GetExecutionTrace();
+void QTPFS::PathManager::PublishSearchBatch(unsigned int pathType) {
+	std::vector<BatchedSearch>& batch = searchBatches[pathType];
+
+	for (BatchedSearch& bs: batch) {
+		#ifdef QTPFS_LIMIT_TEAM_SEARCHES
+		// a duplicate that could not share its path after all
+		// was executed in full, so it still counts for its team
+		if (!bs.charged && bs.result != SEARCH_RESULT_SHARED)
+			numCurrExecutedSearches[bs.search->GetTeam()] += 1;
 		#endif
-	} else {
-		DeletePath(path->GetID());
+
+		switch (bs.result) {
+			case SEARCH_RESULT_FOUND: {
+				#ifdef QTPFS_TRACE_PATH_SEARCHES
+				pathTraces[bs.path->GetID()] = bs.search->GetExecutionTrace();
+				#endif
+			} break;
+			case SEARCH_RESULT_FAILED: {
+				DeletePath(bs.path->GetID());
+			} break;
+			default: {
+			} break;
+		}
+
+		delete bs.search;
 	}
 
-	DeleteSearch(search, searches, searchesIt);
-	return true;
+	batch.clear();
 }
 
 void QTPFS::PathManager::QueueDeadPathSearches(unsigned int pathType) {
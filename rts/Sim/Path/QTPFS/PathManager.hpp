@@ -3,6 +3,7 @@
 #ifndef QTPFS_PATHMANAGER_HDR
 #define QTPFS_PATHMANAGER_HDR
 
+#include <atomic>
 #include <vector>
 
 #include "Sim/Path/IPathManager.h"
@@ -91,6 +92,26 @@ namespace QTPFS {
 		typedef std::vector<IPathSearch*> PathSearchVect;
 		typedef std::vector<IPathSearch*>::iterator PathSearchVectIt;
 
+		enum {
+			SEARCH_RESULT_NONE   = 0,
+			SEARCH_RESULT_FOUND  = 1,
+			SEARCH_RESULT_SHARED = 2,
+			SEARCH_RESULT_FAILED = 3,
+		};
+
+		// a search taken off its layer's queue during the current update
+		struct BatchedSearch {
+			IPathSearch* search;
+			IPath* path;
+
+			unsigned int stateOffset;
+			unsigned int result;
+
+			// false if the search duplicates an earlier one in its batch
+			// and is expected to share its path (not counted per team)
+			bool charged;
+		};
+
 		void SpawnSpringThreads(MemberFunc f, const SRectangle& r);
 
 		void InitNodeLayersThreaded(const SRectangle& rect);
@@ -106,14 +127,16 @@ namespace QTPFS {
 			const SRectangle& rect
 		);
 		void InitNodeLayer(unsigned int layerNum, const SRectangle& r);
-		void UpdateNodeLayer(unsigned int layerNum, const SRectangle& r);
+		bool UpdateNodeLayer(unsigned int layerNum, const SRectangle& r);
 
 		#ifdef QTPFS_STAGGERED_LAYER_UPDATES
 		void QueueNodeLayerUpdates(const SRectangle& r);
 		void ExecQueuedNodeLayerUpdates(unsigned int layerNum, bool flushQueue);
 		#endif
 
-		void ExecuteQueuedSearches(unsigned int pathType);
+		void SelectQueuedSearches(unsigned int pathType);
+		void ExecuteSearchBatch(unsigned int pathType);
+		void PublishSearchBatch(unsigned int pathType);
 		void QueueDeadPathSearches(unsigned int pathType);
 
 		unsigned int QueueSearch(
@@ -126,31 +149,23 @@ namespace QTPFS {
 			const bool synced
 		);
 
-		bool ExecuteSearch(
-			PathSearchVect& searches,
-			PathSearchVectIt& searchesIt,
-			NodeLayer& nodeLayer,
-			PathCache& pathCache,
-			unsigned int pathType
-		);
-
-		bool IsFinalized() const { return (!nodeTrees.empty()); }
+		bool IsFinalized() const { return (!nodeLayers.empty()); }
 
 
 		std::string GetCacheDirName(std::uint32_t mapCheckSum, std::uint32_t modCheckSum) const;
-		void Serialize(const std::string& cacheFileDir);
+		std::string GetNodeLayerCacheFileName(unsigned int layerNum) const;
+		bool ReadNodeLayerCache(unsigned int layerNum);
+		void WriteNodeLayerCache(unsigned int layerNum) const;
 
 		std::vector<NodeLayer> nodeLayers;
-		std::vector<QTNode*> nodeTrees;
 		std::vector<PathCache> pathCaches;
 		std::vector< std::vector<IPathSearch*> > pathSearches;
+		// searches selected for execution, per layer (one worker each)
+		std::vector< std::vector<BatchedSearch> > searchBatches;
 
 		spring::unordered_map<unsigned int, unsigned int> pathTypes;
 		spring::unordered_map<unsigned int, PathSearchTrace::Execution*> pathTraces;
 
-		// maps "hashes" of executed searches to the found paths
-		spring::unordered_map<std::uint64_t, IPath*> sharedPaths;
-
 		std::vector<unsigned int> numCurrExecutedSearches;
 		std::vector<unsigned int> numPrevExecutedSearches;
 
@@ -164,8 +179,12 @@ namespace QTPFS {
 
 		std::uint32_t pfsCheckSum;
 
+		// number of layers whose tree was loaded from cache, see InitNodeLayer
+		std::atomic<unsigned int> numCachedLayers;
+
 		bool layersInited;
-		bool haveCacheDir;
+
+		std::string cacheDirName;
 
 		#ifdef QTPFS_ENABLE_THREADED_UPDATE
 		spring::thread* updateThread;
@@ -1,5 +1,6 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
+#include <algorithm>
 #include <cassert>
 #include <limits>
 
@@ -14,8 +15,21 @@
 #endif
 
 #include "System/float3.h"
+#include "System/Threading/ThreadPool.h"
 
-QTPFS::binary_heap<QTPFS::INode*> QTPFS::PathSearch::openNodes;
+// one queue per thread so searches on different layers can run concurrently
+std::array<QTPFS::binary_heap<QTPFS::INode*>, ThreadPool::MAX_THREADS> QTPFS::PathSearch::openNodeQueues;
+
+void QTPFS::PathSearch::InitGlobalQueue(unsigned int n) {
+	// the sim-thread queue gets the full size, worker queues start
+	// smaller and grow on demand (most searches only touch a fraction
+	// of all leaf-nodes)
+	openNodeQueues[0].reserve(n);
+
+	for (unsigned int i = 1; i < openNodeQueues.size(); i++) {
+		openNodeQueues[i].reserve(std::max(n >> 4, 1u));
+	}
+}
 
 
 
@@ -49,6 +63,8 @@ bool QTPFS::PathSearch::Execute(
 	searchState = searchStateOffset; // starts at NODE_STATE_OFFSET
 	searchMagic = searchMagicNumber; // starts at numTerrainChanges
 
+	openNodes = &openNodeQueues[ThreadPool::GetThreadNum()];
+
 	haveFullPath = (srcNode == tgtNode);
 	havePartPath = false;
 
@@ -82,8 +98,8 @@ bool QTPFS::PathSearch::Execute(
 	ResetState(srcNode);
 	UpdateNode(srcNode, NULL, 0);
 
-	while (!openNodes.empty()) {
-		IterateNodes(nodeLayer->GetNodes());
+	while (!openNodes->empty()) {
+		IterateNodes();
 
 		#ifdef QTPFS_TRACE_PATH_SEARCHES
 		searchExec->AddIteration(searchIter);
@@ -94,7 +110,7 @@ bool QTPFS::PathSearch::Execute(
 		havePartPath = (minNode != srcNode);
 
 		if (haveFullPath) {
-			openNodes.reset();
+			openNodes->reset();
 		}
 	}
 
@@ -139,8 +155,8 @@ void QTPFS::PathSearch::ResetState(INode* node) {
 		hCosts[i] = 0.0f;
 	}
 
-	openNodes.reset();
-	openNodes.push(node);
+	openNodes->reset();
+	openNodes->push(node);
 }
 
 void QTPFS::PathSearch::UpdateNode(INode* nextNode, INode* prevNode, unsigned int netPointIdx) {
@@ -149,14 +165,21 @@ void QTPFS::PathSearch::UpdateNode(INode* nextNode, INode* prevNode, unsigned in
 	//   but this is *impossible* to achieve on a non-regular
 	//   grid on which any node only has an average move-cost
 	//   associated with it --> paths will be "nearly optimal"
-	nextNode->SetPrevNode(prevNode);
+	nextNode->SetPrevNodeIndex((prevNode != nullptr)? prevNode->GetIndex(): -1u);
 	nextNode->SetPathCosts(gCosts[netPointIdx], hCosts[netPointIdx]);
 	nextNode->SetSearchState(searchState | NODE_STATE_OPEN);
-	nextNode->SetNeighborEdgeTransitionPoint(0, netPoints[netPointIdx]);
+	nextNode->SetEntryPoint(netPoints[netPointIdx]);
 }
 
-void QTPFS::PathSearch::IterateNodes(const std::vector<INode*>& allNodes) {
-	curNode = openNodes.top();
+QTPFS::INode* QTPFS::PathSearch::GetPrevNode(const INode* node) const {
+	if (node->GetPrevNodeIndex() == -1u)
+		return nullptr;
+
+	return (nodeLayer->GetPoolNode(node->GetPrevNodeIndex()));
+}
+
+void QTPFS::PathSearch::IterateNodes() {
+	curNode = openNodes->top();
 	curNode->SetSearchState(searchState | NODE_STATE_CLOSED);
 	#ifdef QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
 	// in the non-conservative case, this is done from
@@ -164,8 +187,8 @@ void QTPFS::PathSearch::IterateNodes(const std::vector<INode*>& allNodes) {
 	curNode->SetMagicNumber(searchMagic);
 	#endif
 
-	openNodes.pop();
-	openNodes.check_heap_property(0);
+	openNodes->pop();
+	openNodes->check_heap_property(0);
 
 	#ifdef QTPFS_TRACE_PATH_SEARCHES
 	searchIter.SetPoppedNodeIdx(curNode->zmin() * mapDims.mapx + curNode->xmin());
@@ -187,14 +210,18 @@ void QTPFS::PathSearch::IterateNodes(const std::vector<INode*>& allNodes) {
 		minNode = curNode;
 	#endif
 
-	IterateNodeNeighbors(curNode->GetNeighbors(allNodes));
+	#ifdef QTPFS_CONSERVATIVE_NEIGHBOR_CACHE_UPDATES
+	curNode->UpdateNeighborCache(*nodeLayer);
+	#endif
+
+	IterateNodeNeighbors(nodeLayer->GetNeighborIndices(curNode), nodeLayer->GetNeighborPoints(curNode), curNode->GetNumNeighbors());
 }
 
-void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes) {
+void QTPFS::PathSearch::IterateNodeNeighbors(const unsigned int* nxtNodeIndices, const float3* nxtNodePoints, unsigned int numNxtNodes) {
 	// if curNode equals srcNode, this is just the original srcPoint
-	const float3 curPoint = curNode->GetNeighborEdgeTransitionPoint(0);
+	const float3 curPoint = curNode->GetEntryPoint();
 
-	for (unsigned int i = 0; i < nxtNodes.size(); i++) {
+	for (unsigned int i = 0; i < numNxtNodes; i++) {
 		// NOTE:
 		//   this uses the actual distance that edges of the final path will cover,
 		//   from <curPoint> (initialized to sourcePoint) to a position on the edge
@@ -212,7 +239,7 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes
 		//   in the first case we would explore many more nodes than necessary (CPU
 		//   nightmare), while in the second we would get low-quality paths (player
 		//   nightmare)
-		nxtNode = nxtNodes[i];
+		nxtNode = nodeLayer->GetPoolNode(nxtNodeIndices[i]);
 
 		if (nxtNode->AllSquaresImpassable())
 			continue;
@@ -230,7 +257,7 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes
 			// to be fancy (note that this is not always the best
 			// option, it causes local and global sub-optimalities
 			// which SmoothPath can only partially address)
-			netPoints[0] = curNode->GetNeighborEdgeTransitionPoint(1 + i);
+			netPoints[0] = nxtNodePoints[i];
 
 			// cannot use squared-distances because that will bias paths
 			// towards smaller nodes (eg. 1^2 + 1^2 + 1^2 + 1^2 != 4^2)
@@ -250,7 +277,7 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes
 		// not handle; more points means a greater degree
 		// of non-cardinality (but gets expensive quickly)
 		for (unsigned int j = 0; j < QTPFS_MAX_NETPOINTS_PER_NODE_EDGE; j++) {
-			netPoints[j] = curNode->GetNeighborEdgeTransitionPoint(1 + i * QTPFS_MAX_NETPOINTS_PER_NODE_EDGE + j);
+			netPoints[j] = nxtNodePoints[i * QTPFS_MAX_NETPOINTS_PER_NODE_EDGE + j];
 
 			gDists[j] = curPoint.distance(netPoints[j]);
 			hDists[j] = tgtPoint.distance(netPoints[j]);
@@ -269,8 +296,8 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes
 		if (!isCurrent) {
 			UpdateNode(nxtNode, curNode, netPointIdx);
 
-			openNodes.push(nxtNode);
-			openNodes.check_heap_property(0);
+			openNodes->push(nxtNode);
+			openNodes->check_heap_property(0);
 
 			#ifdef QTPFS_TRACE_PATH_SEARCHES
 			searchIter.AddPushedNodeIdx(nxtNode->zmin() * mapDims.mapx + nxtNode->xmin());
@@ -281,7 +308,7 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes
 		if (gCosts[netPointIdx] >= nxtNode->GetPathCost(NODE_PATH_COST_G))
 			continue;
 		if (isClosed)
-			openNodes.push(nxtNode);
+			openNodes->push(nxtNode);
 
 		UpdateNode(nxtNode, curNode, netPointIdx);
 
@@ -289,8 +316,8 @@ void QTPFS::PathSearch::IterateNodeNeighbors(const std::vector<INode*>& nxtNodes
 		// (changing the f-cost of an OPEN node messes up the
 		// queue's internal consistency; a pushed node remains
 		// OPEN until it gets popped)
-		openNodes.resort(nxtNode);
-		openNodes.check_heap_property(0);
+		openNodes->resort(nxtNode);
+		openNodes->check_heap_property(0);
 	}
 }
 
@@ -313,12 +340,12 @@ void QTPFS::PathSearch::TracePath(IPath* path) {
 
 	if (srcNode != tgtNode) {
 		INode* tmpNode = tgtNode;
-		INode* prvNode = tmpNode->GetPrevNode();
+		INode* prvNode = GetPrevNode(tmpNode);
 
 		float3 prvPoint = tgtPoint;
 
 		while ((prvNode != nullptr) && (tmpNode != srcNode)) {
-			const float3& tmpPoint = tmpNode->GetNeighborEdgeTransitionPoint(0);
+			const float3& tmpPoint = tmpNode->GetEntryPoint();
 
 			assert(!math::isinf(tmpPoint.x) && !math::isinf(tmpPoint.z));
 			assert(!math::isnan(tmpPoint.x) && !math::isnan(tmpPoint.z));
@@ -337,12 +364,12 @@ void QTPFS::PathSearch::TracePath(IPath* path) {
 			// make sure the back-pointers can never become dangling
 			// (if smoothing IS enabled, we delay this until we reach
 			// SmoothPath() because we still need them there)
-			tmpNode->SetPrevNode(NULL);
+			tmpNode->SetPrevNodeIndex(-1u);
 			#endif
 
 			prvPoint = tmpPoint;
 			tmpNode = prvNode;
-			prvNode = tmpNode->GetPrevNode();
+			prvNode = GetPrevNode(tmpNode);
 		}
 	}
 
@@ -368,7 +395,7 @@ void QTPFS::PathSearch::SmoothPath(IPath* path) const {
 	if (path->NumPoints() == 2)
 		return;
 
-	assert(srcNode->GetPrevNode() == NULL);
+	assert(GetPrevNode(srcNode) == nullptr);
 
 	for (unsigned int k = 0; k < QTPFS_MAX_SMOOTHING_ITERATIONS; k++) {
 		if (!SmoothPathIter(path)) {
@@ -382,10 +409,10 @@ void QTPFS::PathSearch::SmoothPath(IPath* path) const {
 
 	while (n1 != srcNode) {
 		n0 = n1;
-		n1 = n0->GetPrevNode();
+		n1 = GetPrevNode(n0);
 
 		// reset back-pointers
-		n0->SetPrevNode(NULL);
+		n0->SetPrevNodeIndex(-1u);
 	}
 }
 
@@ -402,7 +429,7 @@ bool QTPFS::PathSearch::SmoothPathIter(IPath* path) const {
 
 	while (n1 != srcNode) {
 		n0 = n1;
-		n1 = n0->GetPrevNode();
+		n1 = GetPrevNode(n0);
 		ni -= 1;
 
 		assert(n1->GetNeighborRelation(n0) != 0);
@@ -3,6 +3,7 @@
 #ifndef QTPFS_PATHSEARCH_HDR
 #define QTPFS_PATHSEARCH_HDR
 
+#include <array>
 #include <vector>
 
 #include "PathDefines.hpp"
@@ -10,6 +11,7 @@
 #include "NodeHeap.hpp"
 
 #include "System/float3.h"
+#include "System/Threading/ThreadPool.h"
 
 namespace QTPFS {
 	struct PathCache;
@@ -122,6 +124,7 @@ namespace QTPFS {
 			: IPathSearch(pathSearchType)
 			, nodeLayer(NULL)
 			, pathCache(NULL)
+			, openNodes(NULL)
 			, searchExec(NULL)
 			, srcNode(NULL)
 			, tgtNode(NULL)
@@ -132,7 +135,7 @@ namespace QTPFS {
 			, haveFullPath(false)
 			, havePartPath(false)
 			{}
-		~PathSearch() { openNodes.reset(); }
+		~PathSearch() { if (openNodes != NULL) openNodes->reset(); }
 
 		void Initialize(
 			NodeLayer* layer,
@@ -151,27 +154,32 @@ namespace QTPFS {
 
 		const std::uint64_t GetHash(std::uint64_t N, std::uint32_t k) const;
 
-		static void InitGlobalQueue(unsigned int n) { openNodes.reserve(n); }
-		static void FreeGlobalQueue() { openNodes.clear(); }
+		static void InitGlobalQueue(unsigned int n);
+		static void FreeGlobalQueue() { for (auto& q: openNodeQueues) q.clear(); }
 
 	private:
 		void ResetState(INode* node);
 		void UpdateNode(INode* nextNode, INode* prevNode, unsigned int netPointIdx);
 
-		void IterateNodes(const std::vector<INode*>& allNodes);
-		void IterateNodeNeighbors(const std::vector<INode*>& nxtNodes);
+		void IterateNodes();
+		void IterateNodeNeighbors(const unsigned int* nxtNodeIndices, const float3* nxtNodePoints, unsigned int numNxtNodes);
+
+		INode* GetPrevNode(const INode* node) const;
 
 		void TracePath(IPath* path);
 		void SmoothPath(IPath* path) const;
 		bool SmoothPathIter(IPath* path) const;
 
-		// global queue: allocated once, re-used by all searches without clear()'s
+		// global queues: allocated once, re-used by all searches without clear()'s
 		// this relies on INode::operator< to sort the INode*'s by increasing f-cost
-		static binary_heap<INode*> openNodes;
+		// (searches executing on the same thread share one queue, see Execute)
+		static std::array<binary_heap<INode*>, ThreadPool::MAX_THREADS> openNodeQueues;
 
 		NodeLayer* nodeLayer;
 		PathCache* pathCache;
 
+		binary_heap<INode*>* openNodes;
+
 		// not used unless QTPFS_TRACE_PATH_SEARCHES is defined
 		PathSearchTrace::Execution* searchExec;
 		PathSearchTrace::Iteration searchIter;
@@ -28,6 +28,7 @@
 #include "System/EventHandler.h"
 #include "System/Log/ILog.h"
 #include "System/TimeProfiler.h"
+#include "System/Threading/ThreadPool.h"
 #include "System/creg/STL_Deque.h"
 
 
@@ -35,6 +36,11 @@
 #define NORMAL_NANO_PRIO 0.95f
 #define HIGH_NANO_PRIO 1.0f
 
+// below this many projectiles the collision broad-phase is not worth
+// spreading over threads; otherwise it is gathered in batches of this
+// size, so later batches see the objects moved by earlier impacts
+#define MIN_PARALLEL_COLLISION_CHECKS 256
+
 
 using namespace std;
 
@@ -60,7 +66,9 @@ CR_REG_METADATA(CProjectileHandler, (
 	CR_MEMBER(freeSyncedIDs),
 	CR_MEMBER(freeUnsyncedIDs),
 	CR_MEMBER(syncedProjectileIDs),
-	CR_MEMBER(unsyncedProjectileIDs)
+	CR_MEMBER(unsyncedProjectileIDs),
+
+	CR_IGNORED(collisionCandidates)
 ))
 
 
@@ -550,12 +558,48 @@ void CProjectileHandler::CheckShieldCollisions(
 	}
 }
 
+void CProjectileHandler::GetCollisionCandidates(const ProjectileContainer& pc, size_t begin, size_t end)
+{
+	// only reads sim-state, and QuadField queries are thread-safe
+	for_mt(begin, end, [&](const int i) {
+		const CProjectile* p = pc[i];
+		CollisionCandidates& cc = collisionCandidates[i];
+
+		cc.Clear();
+		cc.pos = p->pos;
+		cc.radius = p->radius + p->speed.w;
+		cc.version = quadField->GetSolidQuadsVersion();
+		cc.valid = (p->checkCol && !p->deleteMe);
+
+		if (!cc.valid)
+			return;
+
+		quadField->GetUnitsAndFeaturesInQuads(cc.pos, cc.radius, cc.quads, cc.units, cc.features, cc.repulsers);
+	});
+}
+
 void CProjectileHandler::CheckUnitFeatureCollisions(ProjectileContainer& pc)
 {
 	static std::vector<CUnit*> tempUnits;
 	static std::vector<CFeature*> tempFeatures;
 	static std::vector<CPlasmaRepulser*> tempRepulsers;
 
+	// gather the candidates of a batch of projectiles in parallel; narrow-
+	// phase tests and impacts still happen serially and in container order.
+	// A batch holds every object in the quads around each projectile and
+	// is filtered by distance right before testing, so it stays valid when
+	// an impact runs Lua code that moves objects within their quads. Only
+	// projectiles that were changed themselves, or whose quads an object
+	// entered or left since, are queried again (at most once each, as the
+	// per-projectile path would).
+	// The pass only appends to <pc>, newer projectiles are handled serially.
+	const size_t numCandidates = (pc.size() >= MIN_PARALLEL_COLLISION_CHECKS)? pc.size(): 0;
+
+	size_t validCandidates = 0;
+
+	if (numCandidates > 0)
+		collisionCandidates.resize(std::max(collisionCandidates.size(), numCandidates));
+
 	for (size_t i = 0; i < pc.size(); ++i) {
 		CProjectile* p = pc[i];
 
@@ -565,11 +609,33 @@ void CProjectileHandler::CheckUnitFeatureCollisions(ProjectileContainer& pc)
 		const float3 ppos0 = p->pos;
 		const float3 ppos1 = p->pos + p->speed;
 
-		quadField->GetUnitsAndFeaturesColVol(p->pos, p->radius + p->speed.w, tempUnits, tempFeatures, &tempRepulsers);
+		if (i >= numCandidates) {
+			quadField->GetUnitsAndFeaturesColVol(p->pos, p->radius + p->speed.w, tempUnits, tempFeatures, &tempRepulsers);
+
+			CheckShieldCollisions(p, tempRepulsers, ppos0, ppos1); tempRepulsers.clear();
+			CheckUnitCollisions(p, tempUnits, ppos0, ppos1); tempUnits.clear();
+			CheckFeatureCollisions(p, tempFeatures, ppos0, ppos1); tempFeatures.clear();
+			continue;
+		}
+
+		if (i >= validCandidates) {
+			validCandidates = std::min(numCandidates, i + MIN_PARALLEL_COLLISION_CHECKS);
+			GetCollisionCandidates(pc, i, validCandidates);
+		}
+
+		CollisionCandidates& cc = collisionCandidates[i];
+
+		if (!cc.Matches(p->pos, p->radius + p->speed.w) || quadField->SolidQuadsChangedSince(cc.quads, cc.version)) {
+			cc.Clear();
+			cc.version = quadField->GetSolidQuadsVersion();
+			quadField->GetUnitsAndFeaturesInQuads(p->pos, p->radius + p->speed.w, cc.quads, cc.units, cc.features, cc.repulsers);
+		}
+
+		CQuadField::FilterUnitsAndFeaturesColVol(p->pos, p->radius + p->speed.w, cc.units, cc.features, cc.repulsers);
 
-		CheckShieldCollisions(p, tempRepulsers, ppos0, ppos1); tempRepulsers.clear();
-		CheckUnitCollisions(p, tempUnits, ppos0, ppos1); tempUnits.clear();
-		CheckFeatureCollisions(p, tempFeatures, ppos0, ppos1); tempFeatures.clear();
+		CheckShieldCollisions(p, cc.repulsers, ppos0, ppos1);
+		CheckUnitCollisions(p, cc.units, ppos0, ppos1);
+		CheckFeatureCollisions(p, cc.features, ppos0, ppos1);
 	}
 }
 
@@ -45,6 +45,7 @@ public:
 	void CheckUnitCollisions(CProjectile*, std::vector<CUnit*>&, const float3, const float3);
 	void CheckFeatureCollisions(CProjectile*, std::vector<CFeature*>&, const float3, const float3);
 	void CheckShieldCollisions(CProjectile*, std::vector<CPlasmaRepulser*>&, const float3, const float3);
+	void GetCollisionCandidates(const ProjectileContainer&, size_t, size_t);
 	void CheckUnitFeatureCollisions(ProjectileContainer&);
 	void CheckGroundCollisions(ProjectileContainer&);
 	void CheckCollisions();
@@ -92,6 +93,35 @@ public:
 private:
 	void UpdateProjectileContainer(ProjectileContainer&, bool);
 
+	// broad-phase results of CheckUnitFeatureCollisions, per projectile
+	struct CollisionCandidates {
+		void Clear() {
+			quads.clear();
+			units.clear();
+			features.clear();
+			repulsers.clear();
+		}
+
+		// exact, float3::operator== has a tolerance
+		bool Matches(const float3& p, float r) const {
+			return (valid && pos.x == p.x && pos.y == p.y && pos.z == p.z && radius == r);
+		}
+
+		// everything in <quads>, not yet filtered by distance
+		std::vector<int> quads;
+		std::vector<CUnit*> units;
+		std::vector<CFeature*> features;
+		std::vector<CPlasmaRepulser*> repulsers;
+
+		// query parameters, to detect projectiles changed after the query
+		float3 pos;
+		float radius = 0.0f;
+		unsigned int version = 0;
+		bool valid = false;
+	};
+
+	std::vector<CollisionCandidates> collisionCandidates;
+
 	std::deque<int> freeSyncedIDs;            // available synced (weapon, piece) projectile ID's
 	std::deque<int> freeUnsyncedIDs;          // available unsynced projectile ID's
 	ProjectileMap syncedProjectileIDs;        // ID ==> projectile* map for living synced projectiles
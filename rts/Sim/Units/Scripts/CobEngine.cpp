@@ -6,6 +6,8 @@
 #include "CobFile.h"
 #include "System/FileSystem/FileHandler.h"
 
+#include <algorithm>
+
 
 CCobEngine* cobEngine = nullptr;
 CCobFileHandler* cobFileHandler = nullptr;
@@ -20,6 +22,7 @@ CR_REG_METADATA(CCobEngine, (
 	CR_MEMBER(currentTime),
 	CR_MEMBER(running),
 	CR_MEMBER(sleeping),
+	CR_MEMBER(sleepingTime),
 
 	//always null/empty when saving
 	CR_IGNORED(wantToRun),
@@ -28,7 +31,8 @@ CR_REG_METADATA(CCobEngine, (
 
 
 CCobEngine::CCobEngine()
-	: curThread(nullptr)
+	: sleepingTime(0)
+	, curThread(nullptr)
 	, currentTime(0)
 
 { }
@@ -48,13 +52,15 @@ CCobEngine::~CCobEngine()
 			wantToRun.pop_back();
 			delete tmp;
 		}
-		while (!sleeping.empty()) {
-			CCobThread* tmp = sleeping.top();
-			sleeping.pop();
-			delete tmp;
+		for (std::vector<CCobThread*>& slot: sleeping) {
+			while (!slot.empty()) {
+				CCobThread* tmp = slot.back();
+				slot.pop_back();
+				delete tmp;
+			}
 		}
 		// callbacks may add new threads
-	} while (!running.empty() || !wantToRun.empty() || !sleeping.empty());
+	} while (!running.empty() || !wantToRun.empty() || !CobSleepWheel::Empty(sleeping));
 }
 
 
@@ -75,7 +81,7 @@ void CCobEngine::AddThread(CCobThread *thread)
 			wantToRun.push_back(thread);
 			break;
 		case CCobThread::Sleep:
-			sleeping.push(thread);
+			AddSleepingThread(thread);
 			break;
 		default:
 			LOG_L(L_ERROR, "thread added to scheduler with unknown state (%d)", thread->state);
@@ -115,31 +121,34 @@ void CCobEngine::Tick(int deltaTime)
 	std::swap(running, wantToRun);
 
 	//Check on the sleeping threads
-	if (!sleeping.empty()) {
-		CCobThread* cur = sleeping.top();
-
-		while ((cur != nullptr) && (cur->GetWakeTime() < currentTime)) {
-			// Start with removing the executing thread from the queue
-			sleeping.pop();
-
-			//Run forward again. This can quite possibly readd the thread to the sleeping array again
-			//But it will not interfere since it is guaranteed to sleep > 0 ms
-			//LOG_L(L_DEBUG, "Now 2running %d: %s", currentTime, cur->GetName().c_str());
-			if (cur->state == CCobThread::Sleep) {
-				cur->state = CCobThread::Run;
-				TickThread(cur);
-			} else if (cur->state == CCobThread::Dead) {
-				delete cur;
-			} else {
-				LOG_L(L_ERROR, "Sleeping thread strange state %d", cur->state);
-			}
+	WakeSleepingThreads();
+}
+
 
-			if (!sleeping.empty())
-				cur = sleeping.top();
-			else
-				cur = nullptr;
+void CCobEngine::AddSleepingThread(CCobThread* thread)
+{
+	CobSleepWheel::Add(sleeping, sleepingTime, thread, thread->GetWakeTime());
+}
+
+void CCobEngine::WakeSleepingThreads()
+{
+	const auto getWakeTime = [](const CCobThread* t) { return t->GetWakeTime(); };
+	const auto wakeThread = [&](CCobThread* cur) {
+		//Run forward again. This can quite possibly readd the thread to the sleeping array again
+		//But it will not interfere since it is guaranteed to sleep > 0 ms
+		//LOG_L(L_DEBUG, "Now 2running %d: %s", currentTime, cur->GetName().c_str());
+		if (cur->state == CCobThread::Sleep) {
+			cur->state = CCobThread::Run;
+			TickThread(cur);
+		} else if (cur->state == CCobThread::Dead) {
+			delete cur;
+		} else {
+			LOG_L(L_ERROR, "Sleeping thread strange state %d", cur->state);
 		}
-	}
+	};
+
+	// wake everything that was due before currentTime, in order of wake-time
+	CobSleepWheel::Wake(sleeping, sleepingTime, currentTime, getWakeTime, wakeThread);
 }
 
 
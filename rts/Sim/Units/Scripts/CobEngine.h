@@ -12,9 +12,9 @@
 #include <vector>
 
 #include "CobThread.h"
+#include "CobSleepWheel.h"
 #include "System/creg/creg_cond.h"
 
-#include "System/creg/STL_Queue.h"
 #include "System/UnorderedMap.hpp"
 
 
@@ -23,14 +23,6 @@ class CCobInstance;
 class CCobFile;
 
 
-class CCobThreadPtr_less : public std::binary_function<CCobThread*, CCobThread*, bool> {
-public:
-	bool operator() (const CCobThread* const& a, const CCobThread* const& b) const {
-		return a->GetWakeTime() > b->GetWakeTime();
-	}
-};
-
-
 class CCobEngine
 {
 	CR_DECLARE_STRUCT(CCobEngine)
@@ -41,10 +33,18 @@ protected:
 	 * And moved to real running after running is empty.
 	 */
 	std::vector<CCobThread*> wantToRun;
-	std::priority_queue<CCobThread*, std::vector<CCobThread*>, CCobThreadPtr_less> sleeping;
+
+	/// sleeping threads, see CobSleepWheel
+	std::vector<CCobThread*> sleeping[CobSleepWheel::NUM_SLOTS];
+	/// threads that should have woken before this time have been
+	int sleepingTime;
+
 	CCobThread* curThread;
 	int currentTime;
 	void TickThread(CCobThread* thread);
+
+	void AddSleepingThread(CCobThread* thread);
+	void WakeSleepingThreads();
 public:
 	CCobEngine();
 	~CCobEngine();
@@ -3,6 +3,7 @@
 
 #include "Sim/Misc/GlobalConstants.h"
 #include "CobFile.h"
+#include "CobOpcodes.h"
 #include "System/FileSystem/FileHandler.h"
 #include "System/Log/ILog.h"
 #include "System/Sound/ISound.h"
@@ -10,6 +11,7 @@
 #include "System/StringUtil.h"
 
 #include <algorithm>
+#include <cassert>
 #include <locale>
 #include <cctype>
 #include <cstring>
@@ -162,6 +164,21 @@ CCobFile::CCobFile(CFileHandler& in, const std::string& scriptName)
 		swabDWordInPlace(code[i]);
 	}
 
+#ifdef _DEBUG
+	const std::vector<int> rawCode = code;
+#endif
+
+	// replace sparse opcodes by dense ones so CCobThread can dispatch through a table
+	for (int i = 0; i < ch.NumberOfScripts; ++i) {
+		CobOpcodes::TranslateScript(code, scriptOffsets[i], scriptOffsets[i] + scriptLengths[i], scriptNames);
+	}
+
+#ifdef _DEBUG
+	for (int i = 0; i < ch.NumberOfScripts; ++i) {
+		assert(CobOpcodes::MatchesRawScript(code, rawCode, scriptOffsets[i], scriptOffsets[i] + scriptLengths[i]));
+	}
+#endif
+
 	numStaticVars = ch.NumberOfStaticVars;
 
 	// if this is a TA:K script, read the sound names
@@ -22,6 +22,7 @@ public:
 public:
 	int numStaticVars;
 
+	/// bytecode with opcodes translated by CobOpcodes::TranslateScript
 	std::vector<int> code;
 	std::vector<std::string> scriptNames;
 	std::vector<int> scriptOffsets;
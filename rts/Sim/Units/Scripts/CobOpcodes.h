@@ -0,0 +1,218 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef COB_OPCODES_H
+#define COB_OPCODES_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Command documentation from http://visualta.tauniverse.com/Downloads/cob-commands.txt
+// And some information from basm0.8 source (basm ops.txt)
+//
+// X(name, raw opcode, number of operand words following the opcode, mnemonic)
+#define COB_OPCODE_LIST(X)                                                     \
+	/* Model interaction */                                                    \
+	X(MOVE,                 0x10001000, 2, "move"         )                    \
+	X(TURN,                 0x10002000, 2, "turn"         )                    \
+	X(SPIN,                 0x10003000, 2, "spin"         )                    \
+	X(STOP_SPIN,            0x10004000, 2, "stop-spin"    )                    \
+	X(SHOW,                 0x10005000, 1, "show"         )                    \
+	X(HIDE,                 0x10006000, 1, "hide"         )                    \
+	X(CACHE,                0x10007000, 1, "cache"        )                    \
+	X(DONT_CACHE,           0x10008000, 1, "dont-cache"   )                    \
+	X(MOVE_NOW,             0x1000B000, 2, "move-now"     )                    \
+	X(TURN_NOW,             0x1000C000, 2, "turn-now"     )                    \
+	X(SHADE,                0x1000D000, 1, "shade"        )                    \
+	X(DONT_SHADE,           0x1000E000, 1, "dont-shade"   )                    \
+	X(EMIT_SFX,             0x1000F000, 1, "sfx"          )                    \
+	/* Blocking operations */                                                  \
+	X(WAIT_TURN,            0x10011000, 2, "wait-for-turn")                    \
+	X(WAIT_MOVE,            0x10012000, 2, "wait-for-move")                    \
+	X(SLEEP,                0x10013000, 0, "sleep"        )                    \
+	/* Stack manipulation */                                                   \
+	X(PUSH_CONSTANT,        0x10021001, 1, "pushc"        )                    \
+	X(PUSH_LOCAL_VAR,       0x10021002, 1, "pushl"        )                    \
+	X(PUSH_STATIC,          0x10021004, 1, "pushs"        )                    \
+	X(CREATE_LOCAL_VAR,     0x10022000, 0, "clv"          )                    \
+	X(POP_LOCAL_VAR,        0x10023002, 1, "popl"         )                    \
+	X(POP_STATIC,           0x10023004, 1, "pops"         )                    \
+	X(POP_STACK,            0x10024000, 0, "pop-stack"    ) /* Not sure what this is supposed to do */ \
+	/* Arithmetic operations */                                                \
+	X(ADD,                  0x10031000, 0, "add"          )                    \
+	X(SUB,                  0x10032000, 0, "sub"          )                    \
+	X(MUL,                  0x10033000, 0, "mul"          )                    \
+	X(DIV,                  0x10034000, 0, "div"          )                    \
+	X(MOD,                  0x10034001, 0, "mod"          ) /* spring specific */ \
+	X(BITWISE_AND,          0x10035000, 0, "and"          )                    \
+	X(BITWISE_OR,           0x10036000, 0, "or"           )                    \
+	X(BITWISE_XOR,          0x10037000, 0, "xor"          )                    \
+	X(BITWISE_NOT,          0x10038000, 0, "not"          )                    \
+	/* Native function calls */                                                \
+	X(RAND,                 0x10041000, 0, "rand"         )                    \
+	X(GET_UNIT_VALUE,       0x10042000, 0, "getuv"        )                    \
+	X(GET,                  0x10043000, 0, "get"          )                    \
+	/* Comparison */                                                           \
+	X(SET_LESS,             0x10051000, 0, "setl"         )                    \
+	X(SET_LESS_OR_EQUAL,    0x10052000, 0, "setle"        )                    \
+	X(SET_GREATER,          0x10053000, 0, "setg"         )                    \
+	X(SET_GREATER_OR_EQUAL, 0x10054000, 0, "setge"        )                    \
+	X(SET_EQUAL,            0x10055000, 0, "sete"         )                    \
+	X(SET_NOT_EQUAL,        0x10056000, 0, "setne"        )                    \
+	X(LOGICAL_AND,          0x10057000, 0, "land"         )                    \
+	X(LOGICAL_OR,           0x10058000, 0, "lor"          )                    \
+	X(LOGICAL_XOR,          0x10059000, 0, "lxor"         )                    \
+	X(LOGICAL_NOT,          0x1005A000, 0, "neg"          )                    \
+	/* Flow control */                                                         \
+	X(START,                0x10061000, 2, "start"        )                    \
+	X(CALL,                 0x10062000, 2, "call"         ) /* resolved into one of the next two */ \
+	X(REAL_CALL,            0x10062001, 2, "call"         ) /* spring custom */ \
+	X(LUA_CALL,             0x10062002, 2, "lua_call"     ) /* spring custom */ \
+	X(JUMP,                 0x10064000, 1, "jmp"          )                    \
+	X(RETURN,               0x10065000, 0, "return"       )                    \
+	X(JUMP_NOT_EQUAL,       0x10066000, 1, "jne"          )                    \
+	X(SIGNAL,               0x10067000, 0, "signal"       )                    \
+	X(SET_SIGNAL_MASK,      0x10068000, 0, "mask"         )                    \
+	/* Piece destruction */                                                    \
+	X(EXPLODE,              0x10071000, 1, "explode"      )                    \
+	X(PLAY_SOUND,           0x10072000, 1, "play-sound"   )                    \
+	/* Special functions */                                                    \
+	X(SET,                  0x10082000, 0, "set"          )                    \
+	X(ATTACH,               0x10083000, 0, "attach"       )                    \
+	X(DROP,                 0x10084000, 0, "drop"         )
+
+
+/**
+ * COB bytecode identifies instructions by sparse 32-bit words; CCobFile
+ * translates these at load-time into dense indices (tagged with OP_TAG so
+ * untranslated words can still be told apart) which CCobThread::Tick can
+ * dispatch on through a jump-table. Operand words are left untouched, so
+ * program counters and jump targets are the same in both forms.
+ */
+namespace CobOpcodes {
+	#define COB_RAW_OPCODE(name, raw, numOperands, mnemonic) static constexpr int name = raw;
+	COB_OPCODE_LIST(COB_RAW_OPCODE)
+	#undef COB_RAW_OPCODE
+
+	enum Opcode {
+		#define COB_DENSE_OPCODE(name, raw, numOperands, mnemonic) OP_##name,
+		COB_OPCODE_LIST(COB_DENSE_OPCODE)
+		#undef COB_DENSE_OPCODE
+		OP_UNKNOWN,
+		OP_COUNT
+	};
+
+	// never the upper half of a raw opcode
+	static constexpr unsigned int OP_TAG = 0x7FFF0000;
+
+	static constexpr int NUM_OPERANDS[OP_COUNT + 1] = {
+		#define COB_NUM_OPERANDS(name, raw, numOperands, mnemonic) numOperands,
+		COB_OPCODE_LIST(COB_NUM_OPERANDS)
+		#undef COB_NUM_OPERANDS
+		0, 0
+	};
+
+	static constexpr int RAW_OPCODES[OP_COUNT + 1] = {
+		#define COB_RAW_OPCODE(name, raw, numOperands, mnemonic) raw,
+		COB_OPCODE_LIST(COB_RAW_OPCODE)
+		#undef COB_RAW_OPCODE
+		0, 0
+	};
+
+	static inline Opcode Translate(int rawOpcode) {
+		switch (rawOpcode) {
+			#define COB_TRANSLATE(name, raw, numOperands, mnemonic) case raw: return OP_##name;
+			COB_OPCODE_LIST(COB_TRANSLATE)
+			#undef COB_TRANSLATE
+			default: {} break;
+		}
+
+		return OP_UNKNOWN;
+	}
+
+	/// dense opcode of a word in translated code, translating it on the fly if needed
+	static inline Opcode Decode(int word) {
+		const unsigned int op = static_cast<unsigned int>(word) - OP_TAG;
+
+		if (op < OP_UNKNOWN)
+			return static_cast<Opcode>(op);
+
+		return (Translate(word));
+	}
+
+	static inline int Encode(Opcode op) { return (static_cast<int>(OP_TAG + op)); }
+
+	static inline const char* GetMnemonic(int rawOpcode) {
+		switch (rawOpcode) {
+			#define COB_MNEMONIC(name, raw, numOperands, mnemonic) case raw: return mnemonic;
+			COB_OPCODE_LIST(COB_MNEMONIC)
+			#undef COB_MNEMONIC
+			default: {} break;
+		}
+
+		return "unknown";
+	}
+
+	/**
+	 * Translates the instructions of the script occupying [begin, end) in
+	 * code, which is assumed to be laid out contiguously. CALL's are bound
+	 * to REAL_CALL or LUA_CALL here rather than on first execution. Decoding
+	 * stops at the first unknown opcode; the remaining raw words are handled
+	 * by Decode if the thread ever gets there.
+	 */
+	static inline void TranslateScript(std::vector<int>& code, int begin, int end, const std::vector<std::string>& scriptNames) {
+		end = std::min(end, static_cast<int>(code.size()));
+
+		for (int pc = std::max(begin, 0); pc < end; ) {
+			Opcode op = Translate(code[pc]);
+
+			if (op == OP_UNKNOWN)
+				break;
+			if ((pc + NUM_OPERANDS[op]) >= end)
+				break;
+
+			if (op == OP_CALL) {
+				const int scriptID = code[pc + 1];
+
+				// out-of-range ID's are left to the interpreter
+				if (scriptID >= 0 && scriptID < static_cast<int>(scriptNames.size()))
+					op = (scriptNames[scriptID].find("lua_") == 0)? OP_LUA_CALL: OP_REAL_CALL;
+			}
+
+			code[pc] = Encode(op);
+			pc += (1 + NUM_OPERANDS[op]);
+		}
+	}
+
+	/**
+	 * Returns true if the script occupying [begin, end) in translated <code>
+	 * decodes back to <rawCode>: each translated word is an instruction that
+	 * stands for the raw opcode it replaced (CALL for either bound call), and
+	 * its operands as well as everything from the first raw word on are equal.
+	 */
+	static inline bool MatchesRawScript(const std::vector<int>& code, const std::vector<int>& rawCode, int begin, int end) {
+		end = std::min(end, static_cast<int>(std::min(code.size(), rawCode.size())));
+
+		for (int pc = std::max(begin, 0); pc < end; ) {
+			const unsigned int op = static_cast<unsigned int>(code[pc]) - OP_TAG;
+
+			if (op >= OP_UNKNOWN)
+				return (std::equal(code.begin() + pc, code.begin() + end, rawCode.begin() + pc));
+
+			const bool boundCall = (rawCode[pc] == CALL && (op == OP_REAL_CALL || op == OP_LUA_CALL));
+
+			if (rawCode[pc] != RAW_OPCODES[op] && !boundCall)
+				return false;
+			if ((pc + NUM_OPERANDS[op]) >= end)
+				return false;
+			if (!std::equal(code.begin() + pc + 1, code.begin() + pc + 1 + NUM_OPERANDS[op], rawCode.begin() + pc + 1))
+				return false;
+
+			pc += (1 + NUM_OPERANDS[op]);
+		}
+
+		return true;
+	}
+};
+
+#endif // COB_OPCODES_H
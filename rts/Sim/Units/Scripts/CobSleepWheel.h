@@ -0,0 +1,106 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef COB_SLEEP_WHEEL_H
+#define COB_SLEEP_WHEEL_H
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * Hierarchical timing wheel for sleeping COB threads, keyed on their
+ * wake-time in ms. Level 0 has one slot per ms of the current 256ms
+ * window, each higher level one slot per window of the level below.
+ * Higher-level slots are cascaded down when their window is entered.
+ *
+ * Items are woken in order of wake-time; items with equal wake-times
+ * are woken in the order they were added.
+ *
+ * The slots and the wheel's clock (everything due before it has been
+ * woken) are owned and serialized by CCobEngine.
+ */
+namespace CobSleepWheel {
+	static constexpr int LEVELS = 5;
+	static constexpr int BITS0 = 8;
+	static constexpr int BITSN = 6;
+	static constexpr int NUM_SLOTS = (1 << BITS0) + (LEVELS - 1) * (1 << BITSN);
+
+	template<typename T> using Slots = std::vector<T>[NUM_SLOTS];
+
+
+	template<typename T> void Add(Slots<T>& slots, int time, T item, int itemWakeTime)
+	{
+		// overdue items go into the slot that is woken next
+		const unsigned int wakeTime = std::max(itemWakeTime, time);
+		const unsigned int diffBits = wakeTime ^ time;
+
+		if (diffBits < (1u << BITS0)) {
+			slots[wakeTime & ((1u << BITS0) - 1)].push_back(item);
+			return;
+		}
+
+		// lowest level whose current block also holds wakeTime, top level holds the rest
+		int level = 1;
+		int shift = BITS0;
+
+		while (level < (LEVELS - 1) && (diffBits >> (shift + BITSN)) != 0) {
+			level += 1;
+			shift += BITSN;
+		}
+
+		const unsigned int slotIdx = (wakeTime >> shift) & ((1u << BITSN) - 1);
+
+		slots[(1 << BITS0) + (level - 1) * (1 << BITSN) + slotIdx].push_back(item);
+	}
+
+	template<typename T, typename WakeTimeFunc> void Cascade(Slots<T>& slots, int time, const WakeTimeFunc& getWakeTime)
+	{
+		// <time> has just entered a new level 0 window; every level whose
+		// window starts here redistributes its slot for it over the levels
+		// below, highest first to preserve the order in which items were added
+		int level = 1;
+		int shift = BITS0;
+
+		while (level < (LEVELS - 1) && (time & ((1 << (shift + BITSN)) - 1)) == 0) {
+			level += 1;
+			shift += BITSN;
+		}
+
+		std::vector<T> items;
+
+		for (; level >= 1; level -= 1, shift -= BITSN) {
+			const unsigned int slotIdx = (static_cast<unsigned int>(time) >> shift) & ((1u << BITSN) - 1);
+
+			items.clear();
+			items.swap(slots[(1 << BITS0) + (level - 1) * (1 << BITSN) + slotIdx]);
+
+			for (const T& item: items) {
+				Add(slots, time, item, getWakeTime(item));
+			}
+		}
+	}
+
+	/// calls wake(item) for everything due before <currTime>; wake may Add new items
+	template<typename T, typename WakeTimeFunc, typename WakeFunc> void Wake(Slots<T>& slots, int& time, int currTime, const WakeTimeFunc& getWakeTime, const WakeFunc& wake)
+	{
+		for (; time < currTime; time++) {
+			if ((time & ((1 << BITS0) - 1)) == 0)
+				Cascade(slots, time, getWakeTime);
+
+			std::vector<T>& slot = slots[time & ((1 << BITS0) - 1)];
+
+			// indexed, items can be appended while we iterate
+			for (size_t i = 0; i < slot.size(); i++) {
+				wake(slot[i]);
+			}
+
+			slot.clear();
+		}
+	}
+
+	template<typename T> bool Empty(const Slots<T>& slots)
+	{
+		return (std::find_if(std::begin(slots), std::end(slots), [](const std::vector<T>& slot) { return !slot.empty(); }) == std::end(slots));
+	}
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include "CobFile.h"
 #include "CobInstance.h"
 #include "CobEngine.h"
+#include "CobOpcodes.h"
 #include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/GlobalSynced.h"
 
@@ -25,6 +26,7 @@ CR_REG_METADATA(CCobThread, (
 	CR_MEMBER(state),
 	CR_MEMBER(signalMask),
 	CR_MEMBER(luaArgs),
+	CR_MEMBER(stackSize),
 	CR_MEMBER(stack),
 	CR_MEMBER(callStack)
 ))
@@ -54,6 +56,7 @@ CCobThread::CCobThread(CCobInstance* owner)
 	, waitPiece(-1)
 	, state(Init)
 	, signalMask(0)
+	, stackSize(0)
 {
 	memset(&luaArgs[0], 0, MAX_LUA_COB_ARGS * sizeof(luaArgs[0]));
 	owner->threads.push_back(this);
@@ -92,7 +95,9 @@ void CCobThread::Start(int functionId, const vector<int>& args, bool schedule)
 	paramCount = args.size();
 
 	// copy arguments
-	stack = args;
+	stackSize = args.size();
+	stack.resize(std::max(args.size(), size_t(INITIAL_STACK_SIZE)));
+	std::copy(args.begin(), args.end(), stack.begin());
 
 	// Add to scheduler
 	if (schedule)
@@ -106,18 +111,18 @@ const string& CCobThread::GetName()
 
 int CCobThread::CheckStack(unsigned int size, bool warn)
 {
-	if (size <= stack.size())
+	if (size <= static_cast<unsigned int>(stackSize))
 		return size;
 
 	if (warn) {
 		static char msg[512];
 		static const char* fmt =
-			"stack-size mismatch: need %u but have %lu arguments "
+			"stack-size mismatch: need %u but have %d arguments "
 			"(too many passed to function or too few returned?)";
-		SNPRINTF(msg, sizeof(msg), fmt, size, stack.size());
+		SNPRINTF(msg, sizeof(msg), fmt, size, stackSize);
 		ShowError(msg);
 	}
-	return stack.size();
+	return stackSize;
 }
 
 int CCobThread::GetStackVal(int pos)
@@ -130,86 +135,6 @@ int CCobThread::GetWakeTime() const
 	return wakeTime;
 }
 
-// Command documentation from http://visualta.tauniverse.com/Downloads/cob-commands.txt
-// And some information from basm0.8 source (basm ops.txt)
-
-// Model interaction
-const int MOVE       = 0x10001000;
-const int TURN       = 0x10002000;
-const int SPIN       = 0x10003000;
-const int STOP_SPIN  = 0x10004000;
-const int SHOW       = 0x10005000;
-const int HIDE       = 0x10006000;
-const int CACHE      = 0x10007000;
-const int DONT_CACHE = 0x10008000;
-const int MOVE_NOW   = 0x1000B000;
-const int TURN_NOW   = 0x1000C000;
-const int SHADE      = 0x1000D000;
-const int DONT_SHADE = 0x1000E000;
-const int EMIT_SFX   = 0x1000F000;
-
-// Blocking operations
-const int WAIT_TURN  = 0x10011000;
-const int WAIT_MOVE  = 0x10012000;
-const int SLEEP      = 0x10013000;
-
-// Stack manipulation
-const int PUSH_CONSTANT    = 0x10021001;
-const int PUSH_LOCAL_VAR   = 0x10021002;
-const int PUSH_STATIC      = 0x10021004;
-const int CREATE_LOCAL_VAR = 0x10022000;
-const int POP_LOCAL_VAR    = 0x10023002;
-const int POP_STATIC       = 0x10023004;
-const int POP_STACK        = 0x10024000; ///< Not sure what this is supposed to do
-
-// Arithmetic operations
-const int ADD         = 0x10031000;
-const int SUB         = 0x10032000;
-const int MUL         = 0x10033000;
-const int DIV         = 0x10034000;
-const int MOD		  = 0x10034001; ///< spring specific
-const int BITWISE_AND = 0x10035000;
-const int BITWISE_OR  = 0x10036000;
-const int BITWISE_XOR = 0x10037000;
-const int BITWISE_NOT = 0x10038000;
-
-// Native function calls
-const int RAND           = 0x10041000;
-const int GET_UNIT_VALUE = 0x10042000;
-const int GET            = 0x10043000;
-
-// Comparison
-const int SET_LESS             = 0x10051000;
-const int SET_LESS_OR_EQUAL    = 0x10052000;
-const int SET_GREATER          = 0x10053000;
-const int SET_GREATER_OR_EQUAL = 0x10054000;
-const int SET_EQUAL            = 0x10055000;
-const int SET_NOT_EQUAL        = 0x10056000;
-const int LOGICAL_AND          = 0x10057000;
-const int LOGICAL_OR           = 0x10058000;
-const int LOGICAL_XOR          = 0x10059000;
-const int LOGICAL_NOT          = 0x1005A000;
-
-// Flow control
-const int START           = 0x10061000;
-const int CALL            = 0x10062000; ///< converted when executed
-const int REAL_CALL       = 0x10062001; ///< spring custom
-const int LUA_CALL        = 0x10062002; ///< spring custom
-const int JUMP            = 0x10064000;
-const int RETURN          = 0x10065000;
-const int JUMP_NOT_EQUAL  = 0x10066000;
-const int SIGNAL          = 0x10067000;
-const int SET_SIGNAL_MASK = 0x10068000;
-
-// Piece destruction
-const int EXPLODE    = 0x10071000;
-const int PLAY_SOUND = 0x10072000;
-
-// Special functions
-const int SET    = 0x10082000;
-const int ATTACH = 0x10083000;
-const int DROP   = 0x10084000;
-
 // Indices for SET, GET, and GET_UNIT_VALUE for LUA return values
 #define LUA0 110 // (LUA0 returns the lua call status, 0 or 1)
 #define LUA1 111
@@ -224,20 +149,52 @@ const int DROP   = 0x10084000;
 
 
 // Handy macros
-#define GET_LONG_PC() (owner->script->code[PC++])
-// #define POP() (stack.size() > 0) ? stack.back(), stack.pop_back(); : 0
+#define GET_LONG_PC() (code[PC++])
+
+// with labels-as-values every instruction ends in its own indirect jump to the
+// next one, which predicts much better than funneling all of them through the
+// single jump of a switch; other compilers get a switch over the dense opcodes
+#if defined(__GNUC__)
+	#define COB_COMPUTED_GOTO
+#endif
+
+#define COB_OP(name) op_##name:
+#define COB_NEXT() goto dispatch
+
 
 int CCobThread::POP()
 {
-	if (!stack.empty()) {
-		int r = stack.back();
-		stack.pop_back();
-		return r;
-	}
+	if (stackSize > 0)
+		return stack[--stackSize];
 
 	return 0;
 }
 
+void CCobThread::PUSH(int val)
+{
+	if (stackSize == static_cast<int>(stack.size()))
+		stack.resize(stack.size() * 2 + INITIAL_STACK_SIZE);
+
+	stack[stackSize++] = val;
+}
+
+bool CCobThread::LocalVarIndex(int r, int& idx)
+{
+	idx = callStack.back().stackTop + r;
+
+	if (idx >= 0) {
+		// locals beyond the top of the stack are read and written in place
+		if (static_cast<size_t>(idx) >= stack.size())
+			stack.resize(idx + 1);
+
+		return true;
+	}
+
+	ShowError("local variable out of range");
+	state = Dead;
+	return false;
+}
+
 bool CCobThread::Tick()
 {
 	if (state == Sleep) {
@@ -249,476 +206,453 @@ bool CCobThread::Tick()
 
 	state = Run;
 
+	// translated by CCobFile at load-time, see CobOpcodes.h
+	int* code = owner->script->code.data();
+	int opcode;
 	int r1, r2, r3, r4, r5, r6;
 
 	vector<int> args;
-	vector<int>::iterator ei;
-
-	//execTrace.clear();
 
 	//LOG_L(L_DEBUG, "Executing in %s (from %s)", script.scriptNames[callStack.back().functionId].c_str(), GetName().c_str());
 
-	while (state == Run) {
-		//int opcode = *(int*)&script.code[PC];
+#ifdef COB_COMPUTED_GOTO
+	static const void* const dispatchTable[CobOpcodes::OP_COUNT] = {
+		#define COB_OP_LABEL(name, raw, numOperands, mnemonic) &&op_##name,
+		COB_OPCODE_LIST(COB_OP_LABEL)
+		#undef COB_OP_LABEL
+		&&op_UNKNOWN
+	};
+#endif
 
-		// Disabling exec trace gives about a 50% speedup on vm-intensive code
-		//execTrace.push_back(PC);
+dispatch:
+	// can arrive here as dead, through CCobInstance::Signal()
+	if (state != Run)
+		return (state != Dead);
 
-		int opcode = GET_LONG_PC();
+	opcode = CobOpcodes::Decode(GET_LONG_PC());
 
-		//LOG_L(L_DEBUG, "PC: %x opcode: %x (%s)", PC - 1, opcode, GetOpcodeName(opcode).c_str());
+	//LOG_L(L_DEBUG, "PC: %x opcode: %x (%s)", PC - 1, code[PC - 1], GetOpcodeName(code[PC - 1]).c_str());
 
-		switch(opcode) {
-			case PUSH_CONSTANT:
-				r1 = GET_LONG_PC();
-				stack.push_back(r1);
-				break;
-			case SLEEP:
-				r1 = POP();
-				wakeTime = cobEngine->GetCurrentTime() + r1;
-				state = Sleep;
-				cobEngine->AddThread(this);
-				//LOG_L(L_DEBUG, "%s sleeping for %d ms", script.scriptNames[callStack.back().functionId].c_str(), r1);
-				return true;
-			case SPIN:
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-				r3 = POP();         // speed
-				r4 = POP();         // accel
-				owner->Spin(r1, r2, r3, r4);
-				break;
-			case STOP_SPIN:
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-				r3 = POP();         // decel
-				//LOG_L(L_DEBUG, "Stop spin of %s around %d", script.pieceNames[r1].c_str(), r2);
-				owner->StopSpin(r1, r2, r3);
-				break;
-			case RETURN:
-				retCode = POP();
-				if (callStack.back().returnAddr == -1) {
-					//LOG_L(L_DEBUG, "%s returned %d", script.scriptNames[callStack.back().functionId].c_str(), retCode);
-					state = Dead;
-					//callStack.pop_back();
-					// Leave values intact on stack in case caller wants to check them
-					return false;
-				}
-
-				PC = callStack.back().returnAddr;
-				while (stack.size() > callStack.back().stackTop) {
-					stack.pop_back();
-				}
-				callStack.pop_back();
-				//LOG_L(L_DEBUG, "Returning to %s", owner->script->scriptNames[callStack.back().functionId].c_str());
-				break;
-			case SHADE:
-				r1 = GET_LONG_PC();
-				break;
-			case DONT_SHADE:
-				r1 = GET_LONG_PC();
-				break;
-			case CACHE:
-				r1 = GET_LONG_PC();
-				break;
-			case DONT_CACHE:
-				r1 = GET_LONG_PC();
-				break;
-			case CALL: {
-				r1 = GET_LONG_PC();
-				PC--;
-				const string& name = owner->script->scriptNames[r1];
-				if (name.find("lua_") == 0) {
-					owner->script->code[PC - 1] = LUA_CALL;
-					LuaCall();
-					break;
-				}
-				owner->script->code[PC - 1] = REAL_CALL;
-
-				// fall through //
-			}
-			case REAL_CALL:
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-
-				if (owner->script->scriptLengths[r1] == 0) {
-					//LOG_L(L_DEBUG, "Preventing call to zero-len script %s", owner->script->scriptNames[r1].c_str());
-					break;
-				}
-
-				CallInfo ci;
-				ci.functionId = r1;
-				ci.returnAddr = PC;
-				ci.stackTop = stack.size() - r2;
-				callStack.push_back(ci);
-				paramCount = r2;
-
-				PC = owner->script->scriptOffsets[r1];
-				//LOG_L(L_DEBUG, "Calling %s", owner->script->scriptNames[r1].c_str());
-				break;
-			case LUA_CALL:
-				LuaCall();
-				break;
-			case POP_STATIC:
-				r1 = GET_LONG_PC();
-				r2 = POP();
-				owner->staticVars[r1] = r2;
-				//LOG_L(L_DEBUG, "Pop static var %d val %d", r1, r2);
-				break;
-			case POP_STACK:
-				POP();
-				break;
-			case START: {
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-
-				if (owner->script->scriptLengths[r1] == 0) {
-					//LOG_L(L_DEBUG, "Preventing start of zero-len script %s", owner->script->scriptNames[r1].c_str());
-					break;
-				}
-
-				args.clear();
-				args.reserve(r2);
-				for (r3 = 0; r3 < r2; ++r3) {
-					r4 = POP();
-					args.push_back(r4);
-				}
-
-				CCobThread* thread = new CCobThread(owner);
-				thread->Start(r1, args, true);
-
-				// Seems that threads should inherit signal mask from creator
-				thread->signalMask = signalMask;
-				//LOG_L(L_DEBUG, "Starting %s %d", owner->script->scriptNames[r1].c_str(), signalMask);
-			} break;
-			case CREATE_LOCAL_VAR:
-				if (paramCount == 0) {
-					stack.push_back(0);
-				} else {
-					paramCount--;
-				}
-				break;
-			case GET_UNIT_VALUE:
-				r1 = POP();
-				if ((r1 >= LUA0) && (r1 <= LUA9)) {
-					stack.push_back(luaArgs[r1 - LUA0]);
-					break;
-				}
-				r1 = owner->GetUnitVal(r1, 0, 0, 0, 0);
-				stack.push_back(r1);
-				break;
-			case JUMP_NOT_EQUAL:
-				r1 = GET_LONG_PC();
-				r2 = POP();
-				if (r2 == 0) {
-					PC = r1;
-				}
-				break;
-			case JUMP:
-				r1 = GET_LONG_PC();
-				// this seem to be an error in the docs..
-				//r2 = owner->script->scriptOffsets[callStack.back().functionId] + r1;
-				PC = r1;
-				break;
-			case POP_LOCAL_VAR:
-				r1 = GET_LONG_PC();
-				r2 = POP();
-				stack[callStack.back().stackTop + r1] = r2;
-				break;
-			case PUSH_LOCAL_VAR:
-				r1 = GET_LONG_PC();
-				r2 = stack[callStack.back().stackTop + r1];
-				stack.push_back(r2);
-				break;
-			case SET_LESS_OR_EQUAL:
-				r2 = POP();
-				r1 = POP();
-				if (r1 <= r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case BITWISE_AND:
-				r1 = POP();
-				r2 = POP();
-				stack.push_back(r1 & r2);
-				break;
-			case BITWISE_OR: // seems to want stack contents or'd, result places on stack
-				r1 = POP();
-				r2 = POP();
-				stack.push_back(r1 | r2);
-				break;
-			case BITWISE_XOR:
-				r1 = POP();
-				r2 = POP();
-				stack.push_back(r1 ^ r2);
-				break;
-			case BITWISE_NOT:
-				r1 = POP();
-				stack.push_back(~r1);
-				break;
-			case EXPLODE:
-				r1 = GET_LONG_PC();
-				r2 = POP();
-				owner->Explode(r1, r2);
-				break;
-			case PLAY_SOUND:
-				r1 = GET_LONG_PC();
-				r2 = POP();
-				owner->PlayUnitSound(r1, r2);
-				break;
-			case PUSH_STATIC:
-				r1 = GET_LONG_PC();
-				stack.push_back(owner->staticVars[r1]);
-				//LOG_L(L_DEBUG, "Push static %d val %d", r1, owner->staticVars[r1]);
-				break;
-			case SET_NOT_EQUAL:
-				r1 = POP();
-				r2 = POP();
-				if (r1 != r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case SET_EQUAL:
-				r1 = POP();
-				r2 = POP();
-				if (r1 == r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case SET_LESS:
-				r2 = POP();
-				r1 = POP();
-				if (r1 < r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case SET_GREATER:
-				r2 = POP();
-				r1 = POP();
-				if (r1 > r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case SET_GREATER_OR_EQUAL:
-				r2 = POP();
-				r1 = POP();
-				if (r1 >= r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case RAND:
-				r2 = POP();
-				r1 = POP();
-				r3 = gsRNG.NextInt(r2 - r1 + 1) + r1;
-				stack.push_back(r3);
-				break;
-			case EMIT_SFX:
-				r1 = POP();
-				r2 = GET_LONG_PC();
-				owner->EmitSfx(r1, r2);
-				break;
-			case MUL:
-				r1 = POP();
-				r2 = POP();
-				stack.push_back(r1 * r2);
-				break;
-			case SIGNAL:
-				r1 = POP();
-				owner->Signal(r1);
-				break;
-			case SET_SIGNAL_MASK:
-				r1 = POP();
-				signalMask = r1;
-				break;
-			case TURN:
-				r2 = POP();
-				r1 = POP();
-				r3 = GET_LONG_PC();
-				r4 = GET_LONG_PC();
-				//LOG_L(L_DEBUG, "Turning piece %s axis %d to %d speed %d", owner->script->pieceNames[r3].c_str(), r4, r2, r1);
-				owner->Turn(r3, r4, r1, r2);
-				break;
-			case GET:
-				r5 = POP();
-				r4 = POP();
-				r3 = POP();
-				r2 = POP();
-				r1 = POP();
-				if ((r1 >= LUA0) && (r1 <= LUA9)) {
-					stack.push_back(luaArgs[r1 - LUA0]);
-					break;
-				}
-				r6 = owner->GetUnitVal(r1, r2, r3, r4, r5);
-				stack.push_back(r6);
-				break;
-			case ADD:
-				r2 = POP();
-				r1 = POP();
-				stack.push_back(r1 + r2);
-				break;
-			case SUB:
-				r2 = POP();
-				r1 = POP();
-				r3 = r1 - r2;
-				stack.push_back(r3);
-				break;
-			case DIV:
-				r2 = POP();
-				r1 = POP();
-				if (r2 != 0)
-					r3 = r1 / r2;
-				else {
-					r3 = 1000; // infinity!
-					ShowError("division by zero");
-				}
-				stack.push_back(r3);
-				break;
-			case MOD:
-				r2 = POP();
-				r1 = POP();
-				if (r2 != 0)
-					stack.push_back(r1 % r2);
-				else {
-					stack.push_back(0);
-					ShowError("modulo division by zero");
-				}
-				break;
-			case MOVE:
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-				r4 = POP();
-				r3 = POP();
-				owner->Move(r1, r2, r3, r4);
-				break;
-			case MOVE_NOW:{
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-				r3 = POP();
-				owner->MoveNow(r1, r2, r3);
-				break;}
-			case TURN_NOW:{
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-				r3 = POP();
-				owner->TurnNow(r1, r2, r3);
-				break;}
-			case WAIT_TURN:
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-				//LOG_L(L_DEBUG, "Waiting for turn on piece %s around axis %d", owner->script->pieceNames[r1].c_str(), r2);
-				if (owner->NeedsWait(CCobInstance::ATurn, r1, r2)) {
-					state = WaitTurn;
-					waitPiece = r1;
-					waitAxis = r2;
-					return true;
-				}
-				else
-					break;
-			case WAIT_MOVE:
-				r1 = GET_LONG_PC();
-				r2 = GET_LONG_PC();
-				//LOG_L(L_DEBUG, "Waiting for move on piece %s on axis %d", owner->script->pieceNames[r1].c_str(), r2);
-				if (owner->NeedsWait(CCobInstance::AMove, r1, r2)) {
-					state = WaitMove;
-					waitPiece = r1;
-					waitAxis = r2;
-					return true;
-				}
-				break;
-			case SET:
-				r2 = POP();
-				r1 = POP();
-				//LOG_L(L_DEBUG, "Setting unit value %d to %d", r1, r2);
-				if ((r1 >= LUA0) && (r1 <= LUA9)) {
-					luaArgs[r1 - LUA0] = r2;
-					break;
-				}
-				owner->SetUnitVal(r1, r2);
-				break;
-			case ATTACH:
-				r3 = POP();
-				r2 = POP();
-				r1 = POP();
-				owner->AttachUnit(r2, r1);
-				break;
-			case DROP:
-				r1 = POP();
-				owner->DropUnit(r1);
-				break;
-			case LOGICAL_NOT: // Like bitwise, but only on values 1 and 0.
-				r1 = POP();
-				if (r1 == 0)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case LOGICAL_AND:
-				r1 = POP();
-				r2 = POP();
-				if (r1 && r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case LOGICAL_OR:
-				r1 = POP();
-				r2 = POP();
-				if (r1 || r2)
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case LOGICAL_XOR:
-				r1 = POP();
-				r2 = POP();
-				if ( (!!r1) ^ (!!r2))
-					stack.push_back(1);
-				else
-					stack.push_back(0);
-				break;
-			case HIDE:
-				r1 = GET_LONG_PC();
-				owner->SetVisibility(r1, false);
-				//LOG_L(L_DEBUG, "Hiding %d", r1);
-				break;
-			case SHOW:{
-				r1 = GET_LONG_PC();
-				int i;
-				for (i = 0; i < MAX_WEAPONS_PER_UNIT; ++i)
-					if (callStack.back().functionId == owner->script->scriptIndex[COBFN_FirePrimary + COBFN_Weapon_Funcs * i])
-						break;
-
-				// If true, we are in a Fire-script and should show a special flare effect
-				if (i < MAX_WEAPONS_PER_UNIT) {
-					owner->ShowFlare(r1);
-				}
-				else {
-					owner->SetVisibility(r1, true);
-				}
-				//LOG_L(L_DEBUG, "Showing %d", r1);
-				break;}
-			default:
-				LOG_L(L_ERROR, "Unknown opcode %x (in %s:%s at %x)",
-						opcode, owner->script->name.c_str(),
-						owner->script->scriptNames[callStack.back().functionId].c_str(),
-						PC - 1);
-				LOG_L(L_ERROR, "Exec trace:");
-				// ei = execTrace.begin();
-				// while (ei != execTrace.end()) {
-					// LOG_L(L_ERROR, "PC: %3x  opcode: %s", *ei, GetOpcodeName(owner->script->code[*ei]).c_str());
-					// ++ei;
-				// }
-				state = Dead;
-				return false;
+#ifdef COB_COMPUTED_GOTO
+	goto *dispatchTable[opcode];
+#else
+	switch (opcode) {
+		#define COB_OP_CASE(name, raw, numOperands, mnemonic) case CobOpcodes::OP_##name: goto op_##name;
+		COB_OPCODE_LIST(COB_OP_CASE)
+		#undef COB_OP_CASE
+		default: goto op_UNKNOWN;
+	}
+#endif
+
+	COB_OP(PUSH_CONSTANT)
+		r1 = GET_LONG_PC();
+		PUSH(r1);
+		COB_NEXT();
+	COB_OP(SLEEP)
+		r1 = POP();
+		wakeTime = cobEngine->GetCurrentTime() + r1;
+		state = Sleep;
+		cobEngine->AddThread(this);
+		//LOG_L(L_DEBUG, "%s sleeping for %d ms", script.scriptNames[callStack.back().functionId].c_str(), r1);
+		return true;
+	COB_OP(SPIN)
+		r1 = GET_LONG_PC();
+		r2 = GET_LONG_PC();
+		r3 = POP();         // speed
+		r4 = POP();         // accel
+		owner->Spin(r1, r2, r3, r4);
+		COB_NEXT();
+	COB_OP(STOP_SPIN)
+		r1 = GET_LONG_PC();
+		r2 = GET_LONG_PC();
+		r3 = POP();         // decel
+		//LOG_L(L_DEBUG, "Stop spin of %s around %d", script.pieceNames[r1].c_str(), r2);
+		owner->StopSpin(r1, r2, r3);
+		COB_NEXT();
+	COB_OP(RETURN)
+		retCode = POP();
+		if (callStack.back().returnAddr == -1) {
+			//LOG_L(L_DEBUG, "%s returned %d", script.scriptNames[callStack.back().functionId].c_str(), retCode);
+			state = Dead;
+			//callStack.pop_back();
+			// Leave values intact on stack in case caller wants to check them
+			return false;
+		}
+
+		PC = callStack.back().returnAddr;
+		if (callStack.back().stackTop >= 0)
+			stackSize = std::min(stackSize, callStack.back().stackTop);
+		callStack.pop_back();
+		//LOG_L(L_DEBUG, "Returning to %s", owner->script->scriptNames[callStack.back().functionId].c_str());
+		COB_NEXT();
+	COB_OP(SHADE)
+		r1 = GET_LONG_PC();
+		COB_NEXT();
+	COB_OP(DONT_SHADE)
+		r1 = GET_LONG_PC();
+		COB_NEXT();
+	COB_OP(CACHE)
+		r1 = GET_LONG_PC();
+		COB_NEXT();
+	COB_OP(DONT_CACHE)
+		r1 = GET_LONG_PC();
+		COB_NEXT();
+	COB_OP(CALL) {
+		// only reached if CCobFile could not bind this call at load-time
+		r1 = GET_LONG_PC();
+		PC--;
+		const string& name = owner->script->scriptNames[r1];
+		if (name.find("lua_") == 0) {
+			code[PC - 1] = CobOpcodes::Encode(CobOpcodes::OP_LUA_CALL);
+			LuaCall();
+			COB_NEXT();
 		}
+		code[PC - 1] = CobOpcodes::Encode(CobOpcodes::OP_REAL_CALL);
 	}
+	// fall through //
+	COB_OP(REAL_CALL) {
+		r1 = GET_LONG_PC();
+		r2 = GET_LONG_PC();
+
+		if (owner->script->scriptLengths[r1] == 0) {
+			//LOG_L(L_DEBUG, "Preventing call to zero-len script %s", owner->script->scriptNames[r1].c_str());
+			COB_NEXT();
+		}
+
+		CallInfo ci;
+		ci.functionId = r1;
+		ci.returnAddr = PC;
+		ci.stackTop = stackSize - r2;
+		callStack.push_back(ci);
+		paramCount = r2;
+
+		PC = owner->script->scriptOffsets[r1];
+		//LOG_L(L_DEBUG, "Calling %s", owner->script->scriptNames[r1].c_str());
+	} COB_NEXT();
+	COB_OP(LUA_CALL)
+		LuaCall();
+		COB_NEXT();
+	COB_OP(POP_STATIC)
+		r1 = GET_LONG_PC();
+		r2 = POP();
+		owner->staticVars[r1] = r2;
+		//LOG_L(L_DEBUG, "Pop static var %d val %d", r1, r2);
+		COB_NEXT();
+	COB_OP(POP_STACK)
+		POP();
+		COB_NEXT();
+	COB_OP(START) {
+		r1 = GET_LONG_PC();
+		r2 = GET_LONG_PC();
+
+		if (owner->script->scriptLengths[r1] == 0) {
+			//LOG_L(L_DEBUG, "Preventing start of zero-len script %s", owner->script->scriptNames[r1].c_str());
+			COB_NEXT();
+		}
+
+		args.clear();
+		args.reserve(r2);
+		for (r3 = 0; r3 < r2; ++r3) {
+			r4 = POP();
+			args.push_back(r4);
+		}
 
-	return (state != Dead); // can arrive here as dead, through CCobInstance::Signal()
+		CCobThread* thread = new CCobThread(owner);
+		thread->Start(r1, args, true);
+
+		// Seems that threads should inherit signal mask from creator
+		thread->signalMask = signalMask;
+		//LOG_L(L_DEBUG, "Starting %s %d", owner->script->scriptNames[r1].c_str(), signalMask);
+	} COB_NEXT();
+	COB_OP(CREATE_LOCAL_VAR)
+		if (paramCount == 0) {
+			PUSH(0);
+		} else {
+			paramCount--;
+		}
+		COB_NEXT();
+	COB_OP(GET_UNIT_VALUE)
+		r1 = POP();
+		if ((r1 >= LUA0) && (r1 <= LUA9)) {
+			PUSH(luaArgs[r1 - LUA0]);
+			COB_NEXT();
+		}
+		r1 = owner->GetUnitVal(r1, 0, 0, 0, 0);
+		PUSH(r1);
+		COB_NEXT();
+	COB_OP(JUMP_NOT_EQUAL)
+		r1 = GET_LONG_PC();
+		r2 = POP();
+		if (r2 == 0) {
+			PC = r1;
+		}
+		COB_NEXT();
+	COB_OP(JUMP)
+		r1 = GET_LONG_PC();
+		// this seem to be an error in the docs..
+		//r2 = owner->script->scriptOffsets[callStack.back().functionId] + r1;
+		PC = r1;
+		COB_NEXT();
+	COB_OP(POP_LOCAL_VAR)
+		r1 = GET_LONG_PC();
+		r2 = POP();
+		if (LocalVarIndex(r1, r3))
+			stack[r3] = r2;
+		COB_NEXT();
+	COB_OP(PUSH_LOCAL_VAR)
+		r1 = GET_LONG_PC();
+		if (LocalVarIndex(r1, r3))
+			PUSH(stack[r3]);
+		COB_NEXT();
+	COB_OP(SET_LESS_OR_EQUAL)
+		r2 = POP();
+		r1 = POP();
+		PUSH(r1 <= r2);
+		COB_NEXT();
+	COB_OP(BITWISE_AND)
+		r1 = POP();
+		r2 = POP();
+		PUSH(r1 & r2);
+		COB_NEXT();
+	COB_OP(BITWISE_OR) // seems to want stack contents or'd, result places on stack
+		r1 = POP();
+		r2 = POP();
+		PUSH(r1 | r2);
+		COB_NEXT();
+	COB_OP(BITWISE_XOR)
+		r1 = POP();
+		r2 = POP();
+		PUSH(r1 ^ r2);
+		COB_NEXT();
+	COB_OP(BITWISE_NOT)
+		r1 = POP();
+		PUSH(~r1);
+		COB_NEXT();
+	COB_OP(EXPLODE)
+		r1 = GET_LONG_PC();
+		r2 = POP();
+		owner->Explode(r1, r2);
+		COB_NEXT();
+	COB_OP(PLAY_SOUND)
+		r1 = GET_LONG_PC();
+		r2 = POP();
+		owner->PlayUnitSound(r1, r2);
+		COB_NEXT();
+	COB_OP(PUSH_STATIC)
+		r1 = GET_LONG_PC();
+		PUSH(owner->staticVars[r1]);
+		//LOG_L(L_DEBUG, "Push static %d val %d", r1, owner->staticVars[r1]);
+		COB_NEXT();
+	COB_OP(SET_NOT_EQUAL)
+		r1 = POP();
+		r2 = POP();
+		PUSH(r1 != r2);
+		COB_NEXT();
+	COB_OP(SET_EQUAL)
+		r1 = POP();
+		r2 = POP();
+		PUSH(r1 == r2);
+		COB_NEXT();
+	COB_OP(SET_LESS)
+		r2 = POP();
+		r1 = POP();
+		PUSH(r1 < r2);
+		COB_NEXT();
+	COB_OP(SET_GREATER)
+		r2 = POP();
+		r1 = POP();
+		PUSH(r1 > r2);
+		COB_NEXT();
+	COB_OP(SET_GREATER_OR_EQUAL)
+		r2 = POP();
+		r1 = POP();
+		PUSH(r1 >= r2);
+		COB_NEXT();
+	COB_OP(RAND)
+		r2 = POP();
+		r1 = POP();
+		r3 = gsRNG.NextInt(r2 - r1 + 1) + r1;
+		PUSH(r3);
+		COB_NEXT();
+	COB_OP(EMIT_SFX)
+		r1 = POP();
+		r2 = GET_LONG_PC();
+		owner->EmitSfx(r1, r2);
+		COB_NEXT();
+	COB_OP(MUL)
+		r1 = POP();
+		r2 = POP();
+		PUSH(r1 * r2);
+		COB_NEXT();
+	COB_OP(SIGNAL)
+		r1 = POP();
+		owner->Signal(r1);
+		COB_NEXT();
+	COB_OP(SET_SIGNAL_MASK)
+		r1 = POP();
+		signalMask = r1;
+		COB_NEXT();
+	COB_OP(TURN)
+		r2 = POP();
+		r1 = POP();
+		r3 = GET_LONG_PC();
+		r4 = GET_LONG_PC();
+		//LOG_L(L_DEBUG, "Turning piece %s axis %d to %d speed %d", owner->script->pieceNames[r3].c_str(), r4, r2, r1);
+		owner->Turn(r3, r4, r1, r2);
+		COB_NEXT();
+	COB_OP(GET)
+		r5 = POP();
+		r4 = POP();
+		r3 = POP();
+		r2 = POP();
+		r1 = POP();
+		if ((r1 >= LUA0) && (r1 <= LUA9)) {
+			PUSH(luaArgs[r1 - LUA0]);
+			COB_NEXT();
+		}
+		r6 = owner->GetUnitVal(r1, r2, r3, r4, r5);
+		PUSH(r6);
+		COB_NEXT();
+	COB_OP(ADD)
+		r2 = POP();
+		r1 = POP();
+		PUSH(r1 + r2);
+		COB_NEXT();
+	COB_OP(SUB)
+		r2 = POP();
+		r1 = POP();
+		r3 = r1 - r2;
+		PUSH(r3);
+		COB_NEXT();
+	COB_OP(DIV)
+		r2 = POP();
+		r1 = POP();
+		if (r2 != 0)
+			r3 = r1 / r2;
+		else {
+			r3 = 1000; // infinity!
+			ShowError("division by zero");
+		}
+		PUSH(r3);
+		COB_NEXT();
+	COB_OP(MOD)
+		r2 = POP();
+		r1 = POP();
+		if (r2 != 0)
+			PUSH(r1 % r2);
+		else {
+			PUSH(0);
+			ShowError("modulo division by zero");
+		}
+		COB_NEXT();
+	COB_OP(MOVE)
+		r1 = GET_LONG_PC();
+		r2 = GET_LONG_PC();
+		r4 = POP();
+		r3 = POP();
+		owner->Move(r1, r2, r3, r4);
+		COB_NEXT();
+	COB_OP(MOVE_NOW)
+		r1 = GET_LONG_PC();
+		r2 = GET_LONG_PC();
+		r3 = POP();
+		owner->MoveNow(r1, r2, r3);
+		COB_NEXT();
+	COB_OP(TURN_NOW)
+		r1 = GET_LONG_PC();
+		r2 = GET_LONG_PC();
+		r3 = POP();
+		owner->TurnNow(r1, r2, r3);
+		COB_NEXT();
+	COB_OP(WAIT_TURN)
+		r1 = GET_LONG_PC();
+		r2 = GET_LONG_PC();
+		//LOG_L(L_DEBUG, "Waiting for turn on piece %s around axis %d", owner->script->pieceNames[r1].c_str(), r2);
+		if (owner->NeedsWait(CCobInstance::ATurn, r1, r2)) {
+			state = WaitTurn;
+			waitPiece = r1;
+			waitAxis = r2;
+			return true;
+		}
+		COB_NEXT();
+	COB_OP(WAIT_MOVE)
+		r1 = GET_LONG_PC();
+		r2 = GET_LONG_PC();
+		//LOG_L(L_DEBUG, "Waiting for move on piece %s on axis %d", owner->script->pieceNames[r1].c_str(), r2);
+		if (owner->NeedsWait(CCobInstance::AMove, r1, r2)) {
+			state = WaitMove;
+			waitPiece = r1;
+			waitAxis = r2;
+			return true;
+		}
+		COB_NEXT();
+	COB_OP(SET)
+		r2 = POP();
+		r1 = POP();
+		//LOG_L(L_DEBUG, "Setting unit value %d to %d", r1, r2);
+		if ((r1 >= LUA0) && (r1 <= LUA9)) {
+			luaArgs[r1 - LUA0] = r2;
+			COB_NEXT();
+		}
+		owner->SetUnitVal(r1, r2);
+		COB_NEXT();
+	COB_OP(ATTACH)
+		r3 = POP();
+		r2 = POP();
+		r1 = POP();
+		owner->AttachUnit(r2, r1);
+		COB_NEXT();
+	COB_OP(DROP)
+		r1 = POP();
+		owner->DropUnit(r1);
+		COB_NEXT();
+	COB_OP(LOGICAL_NOT) // Like bitwise, but only on values 1 and 0.
+		r1 = POP();
+		PUSH(r1 == 0);
+		COB_NEXT();
+	COB_OP(LOGICAL_AND)
+		r1 = POP();
+		r2 = POP();
+		PUSH(r1 && r2);
+		COB_NEXT();
+	COB_OP(LOGICAL_OR)
+		r1 = POP();
+		r2 = POP();
+		PUSH(r1 || r2);
+		COB_NEXT();
+	COB_OP(LOGICAL_XOR)
+		r1 = POP();
+		r2 = POP();
+		PUSH((!!r1) ^ (!!r2));
+		COB_NEXT();
+	COB_OP(HIDE)
+		r1 = GET_LONG_PC();
+		owner->SetVisibility(r1, false);
+		//LOG_L(L_DEBUG, "Hiding %d", r1);
+		COB_NEXT();
+	COB_OP(SHOW) {
+		r1 = GET_LONG_PC();
+		int i;
+		for (i = 0; i < MAX_WEAPONS_PER_UNIT; ++i)
+			if (callStack.back().functionId == owner->script->scriptIndex[COBFN_FirePrimary + COBFN_Weapon_Funcs * i])
+				break;
+
+		// If true, we are in a Fire-script and should show a special flare effect
+		if (i < MAX_WEAPONS_PER_UNIT) {
+			owner->ShowFlare(r1);
+		}
+		else {
+			owner->SetVisibility(r1, true);
+		}
+		//LOG_L(L_DEBUG, "Showing %d", r1);
+	} COB_NEXT();
+	COB_OP(UNKNOWN)
+		LOG_L(L_ERROR, "Unknown opcode %x (in %s:%s at %x)",
+				code[PC - 1], owner->script->name.c_str(),
+				owner->script->scriptNames[callStack.back().functionId].c_str(),
+				PC - 1);
+		state = Dead;
+		return false;
 }
 
 void CCobThread::ShowError(const string& msg)
@@ -738,88 +672,20 @@ void CCobThread::ShowError(const string& msg)
 
 string CCobThread::GetOpcodeName(int opcode)
 {
-	switch (opcode) {
-		case MOVE: return "move";
-		case TURN: return "turn";
-		case SPIN: return "spin";
-		case STOP_SPIN: return "stop-spin";
-		case SHOW: return "show";
-		case HIDE: return "hide";
-		case CACHE: return "cache";
-		case DONT_CACHE: return "dont-cache";
-		case TURN_NOW: return "turn-now";
-		case MOVE_NOW: return "move-now";
-		case SHADE: return "shade";
-		case DONT_SHADE: return "dont-shade";
-		case EMIT_SFX: return "sfx";
-
-		case WAIT_TURN: return "wait-for-turn";
-		case WAIT_MOVE: return "wait-for-move";
-		case SLEEP: return "sleep";
-
-		case PUSH_CONSTANT: return "pushc";
-		case PUSH_LOCAL_VAR: return "pushl";
-		case PUSH_STATIC: return "pushs";
-		case CREATE_LOCAL_VAR: return "clv";
-		case POP_LOCAL_VAR: return "popl";
-		case POP_STATIC: return "pops";
-		case POP_STACK: return "pop-stack";
-
-		case ADD: return "add";
-		case SUB: return "sub";
-		case MUL: return "mul";
-		case DIV: return "div";
-		case MOD: return "mod";
-		case BITWISE_AND: return "and";
-		case BITWISE_OR: return "or";
-		case BITWISE_XOR: return "xor";
-		case BITWISE_NOT: return "not";
-
-		case RAND: return "rand";
-		case GET_UNIT_VALUE: return "getuv";
-		case GET: return "get";
-
-		case SET_LESS: return "setl";
-		case SET_LESS_OR_EQUAL: return "setle";
-		case SET_GREATER: return "setg";
-		case SET_GREATER_OR_EQUAL: return "setge";
-		case SET_EQUAL: return "sete";
-		case SET_NOT_EQUAL: return "setne";
-		case LOGICAL_AND: return "land";
-		case LOGICAL_OR: return "lor";
-		case LOGICAL_XOR: return "lxor";
-		case LOGICAL_NOT: return "neg";
-
-		case START: return "start";
-		case CALL: return "call";
-		case REAL_CALL: return "call";
-		case LUA_CALL: return "lua_call";
-		case JUMP: return "jmp";
-		case RETURN: return "return";
-		case JUMP_NOT_EQUAL: return "jne";
-		case SIGNAL: return "signal";
-		case SET_SIGNAL_MASK: return "mask";
-
-		case EXPLODE: return "explode";
-		case PLAY_SOUND: return "play-sound";
-
-		case SET: return "set";
-		case ATTACH: return "attach";
-		case DROP: return "drop";
-	}
-
-	return "unknown";
+	return CobOpcodes::GetMnemonic(opcode);
 }
 
 /******************************************************************************/
 
 void CCobThread::LuaCall()
 {
+	const int* code = owner->script->code.data();
+
 	const int r1 = GET_LONG_PC(); // script id
 	const int r2 = GET_LONG_PC(); // arg count
 
 	// setup the parameter array
-	const int size = (int) stack.size();
+	const int size = stackSize;
 	const int argCount = std::min(r2, MAX_LUA_COB_ARGS);
 	const int start = std::max(0, size - r2);
 	const int end = std::min(size, start + argCount);
@@ -829,9 +695,9 @@ void CCobThread::LuaCall()
 		a++;
 	}
 	if (r2 >= size) {
-		stack.clear();
+		stackSize = 0;
 	} else {
-		stack.resize(size - r2);
+		stackSize = std::min(size - r2, size);
 	}
 
 	if (!luaRules) {
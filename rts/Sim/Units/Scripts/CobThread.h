@@ -43,7 +43,7 @@ public:
 	void SetCallback(CCobInstance::ThreadCallbackType cb, int cbp);
 	/**
 	 * @brief Checks whether the stack has at least size items.
-	 * @returns min(size, stack.size())
+	 * @returns min(size, stackSize)
 	 */
 	int CheckStack(unsigned int size, bool warn);
 	/**
@@ -63,16 +63,20 @@ public:
 	int GetRetCode() const { return retCode; }
 	bool IsWaiting() const { return (waitAxis != -1); }
 
+	static constexpr int INITIAL_STACK_SIZE = 16;
+
 	CCobInstance* owner;
 protected:
 	std::string GetOpcodeName(int opcode);
 	void LuaCall();
 
 	inline int POP();
+	inline void PUSH(int val);
+	/// kills the thread if local variable r of the current function lies below the stack
+	inline bool LocalVarIndex(int r, int& idx);
 
 	int wakeTime;
 	int PC;
-	vector<int> stack;
 	//vector<int> execTrace;
 
 	int paramCount;
@@ -98,6 +102,11 @@ public:
 	enum State {Init, Sleep, Run, Dead, WaitTurn, WaitMove};
 	State state;
 	int signalMask;
+
+protected:
+	/// grows as needed, the values above stackSize are kept for local variables
+	int stackSize;
+	vector<int> stack;
 };
 
 #endif // COB_THREAD_H
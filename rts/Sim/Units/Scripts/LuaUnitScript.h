@@ -128,6 +128,11 @@ public:
 	// special callin to allow Lua to resume threads blocking on this anim
 	void AnimFinished(AnimType type, int piece, int axis) override;
 
+	// MoveFinished and TurnFinished run synchronously and can start new
+	// animations on this unit (or another one through CallAsUnit), which
+	// must still be ticked in the same frame if this script comes later
+	bool TickSerially() const override { return true; }
+
 public:
 	static void HandleFreed(CLuaHandle* handle);
 	static bool PushEntries(lua_State* L);
@@ -57,7 +57,9 @@ CR_REG_METADATA(CUnitScript, (
 	CR_IGNORED(pieces),
 	CR_IGNORED(hasSetSFXOccupy),
 	CR_IGNORED(hasRockUnit),
-	CR_IGNORED(hasStartBuilding)
+	CR_IGNORED(hasStartBuilding),
+	// transient, consumed by TickAnimFinished in the same frame
+	CR_IGNORED(doneAnims)
 ))
 
 CR_BIND(CUnitScript::AnimInfo,)
@@ -172,7 +174,8 @@ bool CUnitScript::DoSpin(float& cur, float dest, float& speed, float accel, int
 
 
 
-void CUnitScript::TickAnims(int tickRate, const TickAnimFunc& tickAnimFunc, AnimContainerType& liveAnims, AnimContainerType& doneAnims) {
+template<CUnitScript::TickAnimFunc tickAnimFunc>
+void CUnitScript::TickAnims(int tickRate, AnimContainerType& liveAnims, AnimContainerType& doneAnims) {
 	for (size_t i = 0; i < liveAnims.size(); ) {
 		AnimInfo& ai = liveAnims[i];
 		LocalModelPiece& lmp = *pieces[ai.piece];
@@ -190,27 +193,25 @@ void CUnitScript::TickAnims(int tickRate, const TickAnimFunc& tickAnimFunc, Anim
 	}
 }
 
-/**
- * @brief Called by the engine when we are registered as animating.
-          If we return false there are no active animations left.
- * @param deltaTime int delta time to update
- * @return true if there are still active animations
- */
-bool CUnitScript::Tick(int deltaTime)
+void CUnitScript::TickAnims(int deltaTime)
 {
-	// vector of indexes of finished animations,
-	// so we can get rid of them in constant time
-	static AnimContainerType doneAnims[AMove + 1];
-	// tick-functions; these never change address
-	static constexpr TickAnimFunc tickAnimFuncs[AMove + 1] = {&CUnitScript::TickTurnAnim, &CUnitScript::TickSpinAnim, &CUnitScript::TickMoveAnim};
+	const int tickRate = 1000 / deltaTime;
 
-	for (int animType = ATurn; animType <= AMove; animType++) {
-		TickAnims(1000 / deltaTime, tickAnimFuncs[animType], anims[animType], doneAnims[animType]);
-	}
+	// the tick-function is a template argument so each loop can inline it
+	TickAnims<&CUnitScript::TickTurnAnim>(tickRate, anims[ATurn], doneAnims[ATurn]);
+	TickAnims<&CUnitScript::TickSpinAnim>(tickRate, anims[ASpin], doneAnims[ASpin]);
+	TickAnims<&CUnitScript::TickMoveAnim>(tickRate, anims[AMove], doneAnims[AMove]);
+}
 
+bool CUnitScript::TickAnimFinished()
+{
 	// Tell listeners to unblock, and remove finished animations from the unit/script.
 	for (int animType = ATurn; animType <= AMove; animType++) {
 		for (AnimInfo& ai: doneAnims[animType]) {
+			// taken over by a new animation (see AddAnim)
+			if (!ai.hasWaiting)
+				continue;
+
 			AnimFinished((AnimType) animType, ai.piece, ai.axis);
 		}
 
@@ -220,6 +221,18 @@ bool CUnitScript::Tick(int deltaTime)
 	return (HaveAnimations());
 }
 
+/**
+ * @brief Called by the engine when we are registered as animating.
+          If we return false there are no active animations left.
+ * @param deltaTime int delta time to update
+ * @return true if there are still active animations
+ */
+bool CUnitScript::Tick(int deltaTime)
+{
+	TickAnims(deltaTime);
+	return (TickAnimFinished());
+}
+
 
 
 CUnitScript::AnimContainerTypeIt CUnitScript::FindAnim(AnimType type, int piece, int axis)
@@ -315,6 +328,20 @@ void CUnitScript::AddAnim(AnimType type, int piece, int axis, float speed, float
 		ai = &anims[type].back();
 		ai->piece = piece;
 		ai->axis = axis;
+
+		// an animation on this piece and axis may have finished in the current
+		// engine tick with AnimFinished still pending, if a callin of another
+		// script ran in between (scripts ticked serially dispatch immediately);
+		// take it over like a live one so its listeners wait for this one now
+		for (AnimInfo& dai: doneAnims[type]) {
+			if (TickSerially())
+				break;
+			if (dai.piece != piece || dai.axis != axis)
+				continue;
+
+			ai->hasWaiting |= dai.hasWaiting;
+			dai.hasWaiting = false;
+		}
 	} else {
 		ai = &(*animInfoIt);
 	}
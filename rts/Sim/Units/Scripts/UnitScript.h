@@ -59,6 +59,8 @@ protected:
 	typedef bool(CUnitScript::*TickAnimFunc)(int, LocalModelPiece&, AnimInfo&);
 
 	AnimContainerType anims[AMove + 1];
+	// finished animations with waiting listeners, between TickAnims and TickAnimFinished
+	AnimContainerType doneAnims[AMove + 1];
 
 
 	bool hasSetSFXOccupy;
@@ -122,12 +124,20 @@ public:
 	      CUnit* GetUnit()       { return unit; }
 	const CUnit* GetUnit() const { return unit; }
 
-	bool Tick(int tickRate);
+	bool Tick(int deltaTime);
+	// if true, CUnitScriptEngine does not tick this script in its parallel pass
+	// but serially and in order, together with dispatching AnimFinished
+	virtual bool TickSerially() const { return false; }
+	// advances all animations; touches nothing but this script's pieces, safe to run in parallel
+	void TickAnims(int deltaTime);
+	// dispatches AnimFinished for the animations TickAnims completed; false if none are left
+	bool TickAnimFinished();
+
 	// note: must copy-and-set here (LMP dirty flag, etc)
 	bool TickMoveAnim(int tickRate, LocalModelPiece& lmp, AnimInfo& ai) { float3 pos = lmp.GetPosition(); const bool ret = MoveToward(pos[ai.axis], ai.dest, ai.speed / tickRate); lmp.SetPosition(pos); return ret; }
 	bool TickTurnAnim(int tickRate, LocalModelPiece& lmp, AnimInfo& ai) { float3 rot = lmp.GetRotation(); const bool ret = TurnToward(rot[ai.axis], ai.dest, ai.speed / tickRate); lmp.SetRotation(rot); return ret; }
 	bool TickSpinAnim(int tickRate, LocalModelPiece& lmp, AnimInfo& ai) { float3 rot = lmp.GetRotation(); const bool ret = DoSpin(rot[ai.axis], ai.dest, ai.speed, ai.accel, tickRate); lmp.SetRotation(rot); return ret; }
-	void TickAnims(int tickRate, const TickAnimFunc& tickAnimFunc, AnimContainerType& liveAnims, AnimContainerType& doneAnims);
+	template<TickAnimFunc tickAnimFunc> void TickAnims(int tickRate, AnimContainerType& liveAnims, AnimContainerType& doneAnims);
 
 	// animation, used by CCobThread
 	void Spin(int piece, int axis, float speed, float accel);
@@ -12,6 +12,7 @@
 #include "System/ContainerUtil.h"
 #include "System/SafeUtil.h"
 #include "System/FileSystem/FileHandler.h"
+#include "System/Threading/ThreadPool.h"
 
 CUnitScriptEngine* unitScriptEngine = nullptr;
 
@@ -119,12 +120,33 @@ void CUnitScriptEngine::Tick(int deltaTime)
 {
 	cobEngine->Tick(deltaTime);
 
-	// Tick all instances that have registered themselves as animating
+	// advance the animations of all instances that have registered themselves
+	// as animating; each only modifies the pieces of its own unit and runs no
+	// script code, so they can be ticked in parallel
+	// the dirtied piece matrices are then flushed in the same pass, such that
+	// weapons and drawing do not trigger recursive on-demand updates later on
+	for_mt(0, animating.size(), [&](const int i) {
+		CUnitScript* script = animating[i];
+
+		if (script->TickSerially())
+			return;
+
+		script->TickAnims(deltaTime);
+		script->GetUnit()->localModel.UpdatePieceMatrices();
+	});
+
+	// AnimFinished wakes up COB threads and calls into Lua, so it is
+	// dispatched serially afterwards in the (synced) animating order
+	// Lua scripts are also ticked here rather than above, so animations
+	// started by the callins of scripts before them are not delayed
 	size_t i = 0;
 	while (i < animating.size()) {
 		currentScript = animating[i];
 
-		if (!currentScript->Tick(deltaTime)) {
+		if (currentScript->TickSerially())
+			currentScript->TickAnims(deltaTime);
+
+		if (!currentScript->TickAnimFinished()) {
 			animating[i] = animating.back();
 			animating.pop_back();
 			continue;
@@ -971,18 +971,16 @@ void CUnit::SetLosStatus(int at, unsigned short newStatus)
 }
 
 
-unsigned short CUnit::CalcLosStatus(int at)
+unsigned short CUnit::CalcLosStatus(const UnitLosState& state, unsigned short currStatus, int at)
 {
-	const unsigned short currStatus = losStatus[at];
-
 	unsigned short newStatus = currStatus;
 	unsigned short mask = ~(currStatus >> 8);
 
-	if (losHandler->InLos(this, at)) {
+	if (losHandler->InLos(state, at)) {
 		newStatus |= (mask & (LOS_INLOS   | LOS_INRADAR |
 		                      LOS_PREVLOS | LOS_CONTRADAR));
 	}
-	else if (losHandler->InRadar(this, at)) {
+	else if (losHandler->InRadar(state, at)) {
 		newStatus |=  (mask & LOS_INRADAR);
 		newStatus &= ~(mask & LOS_INLOS);
 	}
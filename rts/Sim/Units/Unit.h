@@ -6,6 +6,7 @@
 #include <vector>
 #include <string>
 
+#include "UnitHotState.h"
 #include "Sim/Objects/SolidObject.h"
 #include "Sim/Misc/Resource.h"
 #include "Sim/Weapons/WeaponTarget.h"
@@ -175,7 +176,24 @@ public:
 	bool IsInLosForAllyTeam(int allyTeam) const { return ((losStatus[allyTeam] & LOS_INLOS) != 0); }
 
 	void SetLosStatus(int allyTeam, unsigned short newStatus);
-	unsigned short CalcLosStatus(int allyTeam);
+	unsigned short CalcLosStatus(int allyTeam) { return (CalcLosStatus(GetLosState(), losStatus[allyTeam], allyTeam)); }
+	static unsigned short CalcLosStatus(const UnitLosState& state, unsigned short currStatus, int allyTeam);
+	UnitLosState GetLosState() const {
+		UnitLosState state;
+
+		state.pos = pos;
+		state.speed = speed;
+		state.allyTeam = allyteam;
+		state.bits  = (UnitLosState::LOS_BIT_ALWAYSVISIBLE * alwaysVisible);
+		state.bits |= (UnitLosState::LOS_BIT_CLOAKED       * isCloaked    );
+		state.bits |= (UnitLosState::LOS_BIT_USEAIRLOS     * useAirLos    );
+		state.bits |= (UnitLosState::LOS_BIT_INWATER       * IsInWater()  );
+		state.bits |= (UnitLosState::LOS_BIT_UNDERWATER    * IsUnderWater());
+		state.bits |= (UnitLosState::LOS_BIT_STEALTH       * stealth      );
+		state.bits |= (UnitLosState::LOS_BIT_SONARSTEALTH  * sonarStealth );
+		state.bits |= (UnitLosState::LOS_BIT_BEINGBUILT    * beingBuilt   );
+		return state;
+	}
 	void UpdateLosStatus(int allyTeam);
 
 	void SlowUpdateCloak(bool);
@@ -1,5 +1,6 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
+#include <array>
 #include <cassert>
 
 #include "UnitHandler.h"
@@ -12,6 +13,7 @@
 
 #include "CommandAI/BuilderCAI.h"
 #include "Sim/Misc/GlobalSynced.h"
+#include "Sim/Misc/LosHandler.h"
 #include "Sim/Misc/TeamHandler.h"
 #include "Sim/MoveTypes/MoveType.h"
 #include "Sim/Weapons/Weapon.h"
@@ -20,6 +22,7 @@
 #include "System/myMath.h"
 #include "System/TimeProfiler.h"
 #include "System/Sync/SyncTracer.h"
+#include "System/Threading/ThreadPool.h"
 #include "System/creg/STL_Deque.h"
 #include "System/creg/STL_List.h"
 #include "System/creg/STL_Set.h"
@@ -35,6 +38,7 @@ CR_REG_METADATA(CUnitHandler, (
 	CR_MEMBER(unitsToBeRemoved),
 	CR_MEMBER(activeSlowUpdateUnit),
 	CR_MEMBER(activeUpdateUnit),
+	CR_IGNORED(hotState),
 	CR_MEMBER(maxUnits),
 	CR_MEMBER(maxUnitRadius)
 ))
@@ -161,6 +165,9 @@ void CUnitHandler::InsertActiveUnit(CUnit* unit)
 	#endif
 
 	units[unit->id] = unit;
+
+	// the id might have belonged to a unit that died since the last pass
+	hotState.InvalidatePrevLos(unit->id);
 }
 
 
@@ -292,11 +299,8 @@ void CUnitHandler::Update()
 
 	{
 		SCOPED_TIMER("Sim::Unit::UpdateLosStatus");
-		for (CUnit* unit: activeUnits) {
-			for (int at = 0; at < teamHandler->ActiveAllyTeams(); ++at) {
-				unit->UpdateLosStatus(at);
-			}
-		}
+		UpdateHotState();
+		UpdateLosStatus();
 	}
 
 	{
@@ -348,6 +352,100 @@ void CUnitHandler::Update()
 }
 
 
+void CUnitHandler::UpdateHotState()
+{
+	const int numAllyTeams = teamHandler->ActiveAllyTeams();
+
+	hotState.Resize(activeUnits.size(), numAllyTeams);
+
+	// every row is written by exactly one thread and units are only read
+	for_mt(0, activeUnits.size(), [&](const int i) {
+		CUnit* unit = activeUnits[i];
+		hotState.SetRow(i, unit, unit->id, unit->GetLosState(), &unit->losStatus[0]);
+	});
+}
+
+
+namespace {
+	// the LOS-maps are not modified while UnitHotState::CalcNextLosStatus runs
+	struct UnitLosInputs {
+		bool IsMasked(unsigned short status) const { return ((status & LOS_ALL_MASK_BITS) == LOS_ALL_MASK_BITS); }
+		bool InSameSquares(const UnitLosState& a, const UnitLosState& b) const { return (losHandler->InSameSquares(a, b)); }
+		bool IsDirty(const UnitLosState& s, int at) const {
+			if (!losHandler->HaveDirtyBlocks(at))
+				return false;
+
+			return (losHandler->IsDirty(s.pos, at) || losHandler->IsDirty(s.pos + s.speed, at));
+		}
+
+		unsigned short CalcLosStatus(const UnitLosState& s, unsigned short status, int at) const { return (CUnit::CalcLosStatus(s, status, at)); }
+	};
+}
+
+void CUnitHandler::UpdateLosStatus()
+{
+	const int numAllyTeams = teamHandler->ActiveAllyTeams();
+
+	hotState.ResizePrevLos(maxUnits, numAllyTeams);
+
+	// a toggled globalLOS changes the status of every unit for that allyteam
+	std::array<bool, MAX_TEAMS> allyTeamChanged;
+
+	for (int at = 0; at < numAllyTeams; ++at) {
+		allyTeamChanged[at] = (hotState.prevGlobalLOS[at] != losHandler->globalLOS[at]);
+		hotState.prevGlobalLOS[at] = losHandler->globalLOS[at];
+	}
+
+	// calculate the new status of every (unit, allyteam) pair from the
+	// snapshot; CalcLosStatus is idempotent, so pairs whose inputs did
+	// not change since the previous pass keep their status
+	UnitLosInputs losInputs;
+
+	for_mt(0, hotState.Size(), [&](const int i) {
+		hotState.CalcNextLosStatus(i, allyTeamChanged.data(), losInputs);
+	});
+
+	// everything the blocks were marked for has been accounted for above
+	losHandler->ClearDirtyBlocks();
+
+	// only units whose status changed need to be touched; this happens in
+	// activeUnits order so the enter/leave events are always sent in the
+	// same order
+	// an event sent earlier in this loop (e.g. UnitEnteredLos calling
+	// SetUnitPosition or TransferUnit) can change the state of any later
+	// unit, whose statuses calculated from the snapshot are then stale
+	bool statusChanged = false;
+
+	for (size_t i = 0, n = hotState.Size(); i < n; ++i) {
+		CUnit* unit = hotState.units[i];
+
+		if (statusChanged && !unit->GetLosState().Equals(hotState.losStates[i])) {
+			for (int at = 0; at < numAllyTeams; ++at) {
+				unit->UpdateLosStatus(at);
+			}
+
+			continue;
+		}
+
+		for (int at = 0; at < numAllyTeams; ++at) {
+			const size_t idx = hotState.GetLosStatusIndex(i, at);
+
+			if (hotState.nextLosStatus[idx] == hotState.losStatus[idx])
+				continue;
+
+			statusChanged = true;
+
+			// an event sent earlier in this loop might have changed the mask bits
+			if (unit->losStatus[at] != hotState.losStatus[idx]) {
+				unit->UpdateLosStatus(at);
+			} else {
+				unit->SetLosStatus(at, hotState.nextLosStatus[idx]);
+			}
+		}
+	}
+}
+
+
 
 void CUnitHandler::AddBuilderCAI(CBuilderCAI* b)
 {
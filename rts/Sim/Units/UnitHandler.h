@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "UnitDef.h"
+#include "UnitHotState.h"
 #include "Sim/Misc/SimObjectIDPool.h"
 #include "System/creg/STL_Map.h"
 
@@ -66,6 +67,9 @@ private:
 	void DeleteUnitsNow();
 	void InsertActiveUnit(CUnit* unit);
 
+	void UpdateHotState();
+	void UpdateLosStatus();
+
 private:
 	SimObjectIDPool idPool;
 
@@ -75,6 +79,9 @@ private:
 
 	spring::unordered_map<unsigned int, CBuilderCAI*> builderCAIs;
 
+	///< snapshot of activeUnits' per-frame state, see UpdateHotState
+	UnitHotState hotState;
+
 	size_t activeSlowUpdateUnit;  ///< first unit of batch that will be SlowUpdate'd this frame
 	size_t activeUpdateUnit;  ///< first unit of batch that will be SlowUpdate'd this frame
 
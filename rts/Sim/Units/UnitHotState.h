@@ -0,0 +1,168 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef UNIT_HOT_STATE_H
+#define UNIT_HOT_STATE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "System/float3.h"
+
+class CUnit;
+
+/**
+ * The subset of unit state that LOS- and radar-tests depend on;
+ * small enough that a contiguous array of these can be scanned
+ * without touching the (very large) CUnit objects themselves.
+ */
+struct UnitLosState {
+	enum {
+		LOS_BIT_ALWAYSVISIBLE = (1 << 0),
+		LOS_BIT_CLOAKED       = (1 << 1),
+		LOS_BIT_USEAIRLOS     = (1 << 2),
+		LOS_BIT_INWATER       = (1 << 3),
+		LOS_BIT_UNDERWATER    = (1 << 4),
+		LOS_BIT_STEALTH       = (1 << 5),
+		LOS_BIT_SONARSTEALTH  = (1 << 6),
+		LOS_BIT_BEINGBUILT    = (1 << 7),
+	};
+
+	bool HasBit(unsigned int bit) const { return ((bits & bit) != 0); }
+
+	// exact, float3::operator== has a tolerance
+	bool Equals(const UnitLosState& s) const {
+		if (pos.x != s.pos.x || pos.y != s.pos.y || pos.z != s.pos.z)
+			return false;
+		if (speed.x != s.speed.x || speed.y != s.speed.y || speed.z != s.speed.z)
+			return false;
+
+		return (allyTeam == s.allyTeam && bits == s.bits);
+	}
+
+	float3 pos;
+	float3 speed;
+
+	int allyTeam;
+	unsigned int bits;
+};
+
+
+/**
+ * Compact copy of the per-unit state read by the LOS-status pass
+ * (CUnitHandler::UpdateLosStatus); an array of UnitLosState's plus
+ * the flattened losStatus of each unit. Row i always mirrors
+ * activeUnits[i] as of the last CUnitHandler::UpdateHotState call;
+ * it is a read snapshot and never written back to the units.
+ */
+struct UnitHotState {
+public:
+	void Resize(size_t numUnits, size_t numAllyTeams) {
+		units.resize(numUnits);
+		unitIDs.resize(numUnits);
+		losStates.resize(numUnits);
+		losStatus.resize(numUnits * numAllyTeams);
+		nextLosStatus.resize(numUnits * numAllyTeams);
+
+		allyTeamStride = numAllyTeams;
+	}
+
+	void ResizePrevLos(size_t maxUnits, size_t numAllyTeams) {
+		prevLosStates.resize(maxUnits);
+		prevLosStatus.resize(maxUnits * numAllyTeams);
+		prevLosValid.resize(maxUnits, 0);
+		prevGlobalLOS.resize(numAllyTeams, 0);
+	}
+
+	void InvalidatePrevLos(int unitID) {
+		if (static_cast<size_t>(unitID) < prevLosValid.size())
+			prevLosValid[unitID] = 0;
+	}
+
+	void SetRow(size_t row, CUnit* unit, int unitID, const UnitLosState& losState, const unsigned short* unitLosStatus) {
+		units[row] = unit;
+		unitIDs[row] = unitID;
+		losStates[row] = losState;
+
+		std::copy(unitLosStatus, unitLosStatus + allyTeamStride, losStatus.begin() + GetLosStatusIndex(row, 0));
+	}
+
+	/**
+	 * Fills nextLosStatus of <row> for every allyteam. A (unit, allyteam)
+	 * pair is only recalculated if the unit's state moved to another LOS
+	 * square or otherwise changed, if its status was changed by someone
+	 * else, or if coverage changed around it since the previous pass.
+	 * Different rows can be processed concurrently.
+	 *
+	 * LosInputs must provide IsMasked(status), InSameSquares(a, b),
+	 * IsDirty(state, allyTeam) and CalcLosStatus(state, status, allyTeam).
+	 */
+	template<typename LosInputs>
+	void CalcNextLosStatus(size_t row, const bool* allyTeamChanged, const LosInputs& inputs) {
+		const UnitLosState& losState = losStates[row];
+		const int unitID = unitIDs[row];
+
+		UnitLosState& prevLosState = prevLosStates[unitID];
+
+		const bool stateChanged =
+			(prevLosValid[unitID] == 0) ||
+			(losState.bits != prevLosState.bits) ||
+			(losState.allyTeam != prevLosState.allyTeam) ||
+			!inputs.InSameSquares(losState, prevLosState);
+
+		for (size_t at = 0; at < allyTeamStride; ++at) {
+			const size_t idx = GetLosStatusIndex(row, at);
+			const size_t prevIdx = GetPrevLosStatusIndex(unitID, at);
+			const unsigned short currStatus = losStatus[idx];
+
+			// no need to calculate, all changes are masked
+			if (inputs.IsMasked(currStatus)) {
+				nextLosStatus[idx] = currStatus;
+				prevLosStatus[prevIdx] = currStatus;
+				continue;
+			}
+
+			const bool inputsChanged =
+				stateChanged || allyTeamChanged[at] ||
+				(currStatus != prevLosStatus[prevIdx]) ||
+				inputs.IsDirty(losState, at);
+
+			if (inputsChanged) {
+				nextLosStatus[idx] = inputs.CalcLosStatus(losState, currStatus, at);
+			} else {
+				nextLosStatus[idx] = currStatus;
+			}
+
+			prevLosStatus[prevIdx] = nextLosStatus[idx];
+		}
+
+		prevLosState = losState;
+		prevLosValid[unitID] = 1;
+	}
+
+	size_t Size() const { return units.size(); }
+	size_t GetLosStatusIndex(size_t row, int allyTeam) const { return (row * allyTeamStride + allyTeam); }
+	size_t GetPrevLosStatusIndex(int unitID, int allyTeam) const { return (unitID * allyTeamStride + allyTeam); }
+
+public:
+	std::vector<CUnit*> units;
+	std::vector<int> unitIDs;
+	std::vector<UnitLosState> losStates;
+
+	// CUnit::losStatus of each row, flattened [row][allyTeam]
+	std::vector<unsigned short> losStatus;
+	// scratch-space for the statuses calculated from <losStates>
+	std::vector<unsigned short> nextLosStatus;
+
+	// by unit-id: the state and statuses the previous LOS-status pass
+	// calculated, such that (unit, allyteam) pairs whose inputs did not
+	// change since can be skipped
+	std::vector<UnitLosState> prevLosStates;
+	std::vector<unsigned short> prevLosStatus;
+	std::vector<unsigned char> prevLosValid;
+	std::vector<unsigned char> prevGlobalLOS;
+
+	size_t allyTeamStride = 0;
+};
+
+#endif
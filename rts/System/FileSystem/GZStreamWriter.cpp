@@ -0,0 +1,361 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "GZStreamWriter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+static constexpr std::size_t CHUNK_SIZE = 1024 * 1024;
+// emptied chunks kept around for reuse, the rest is freed
+static constexpr std::size_t MAX_FREE_CHUNKS = 8;
+static constexpr std::size_t DEFLATE_BUFFER_SIZE = 64 * 1024;
+
+static constexpr std::uint64_t UNPINNED = std::numeric_limits<std::uint64_t>::max();
+
+
+CGZStreamWriter::CGZStreamWriter(const std::string& filePath, int compressionLevel)
+	: file(nullptr)
+	, prefixSize(UNPINNED)
+	, prefixPos(0)
+	, chunkPos(0)
+	, chunkFill(0)
+	, streaming(false)
+	, patching(false)
+	, closing(false)
+	, writeError(false)
+{
+	memset(&bodyStream, 0, sizeof(bodyStream));
+
+	if (deflateInit2(&bodyStream, std::max(Z_BEST_SPEED, std::min(compressionLevel, Z_BEST_COMPRESSION)), Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return;
+
+	if ((file = fopen(filePath.c_str(), "wb")) == nullptr)
+		deflateEnd(&bodyStream);
+}
+
+
+void CGZStreamWriter::Pin(std::uint64_t pos)
+{
+	assert(!streaming);
+	assert(pos >= prefix.size());
+
+	prefixSize = pos;
+}
+
+bool CGZStreamWriter::Close()
+{
+	if (file == nullptr)
+		return false;
+
+	if (patching)
+		seekpos(GetEndPos(), std::ios_base::out);
+
+	// nothing went past the pinned position, or no pin at all
+	if (!streaming)
+		BeginStreaming();
+
+	SubmitChunk();
+
+	{
+		std::lock_guard<spring::mutex> lock(chunkMutex);
+		closing = true;
+	}
+
+	chunkCond.notify_all();
+
+	if (compressorThread.joinable())
+		compressorThread.join();
+
+	deflateEnd(&bodyStream);
+
+	// the prefix is final now
+	bool ret = (!writeError && WritePrefixMember());
+
+	ret &= (fclose(file) == 0);
+	file = nullptr;
+
+	setp(nullptr, nullptr);
+	return ret;
+}
+
+
+CGZStreamWriter::int_type CGZStreamWriter::overflow(int_type c)
+{
+	if (traits_type::eq_int_type(c, traits_type::eof()))
+		return traits_type::not_eof(c);
+
+	const char_type ch = traits_type::to_char_type(c);
+
+	if (xsputn(&ch, 1) != 1)
+		return traits_type::eof();
+
+	return c;
+}
+
+std::streamsize CGZStreamWriter::xsputn(const char_type* s, std::streamsize n)
+{
+	std::streamsize numWritten = 0;
+
+	if (file == nullptr)
+		return numWritten;
+
+	while (numWritten < n) {
+		const std::uint64_t numBytes = n - numWritten;
+
+		if (InPrefix()) {
+			// while patching, writes may not extend the prefix
+			const std::uint64_t prefixEnd = patching? prefix.size(): prefixSize;
+			const std::uint64_t prefixBytes = std::min(numBytes, prefixEnd - prefixPos);
+
+			if (prefixBytes == 0) {
+				if (patching || !BeginStreaming())
+					break;
+
+				continue;
+			}
+
+			if ((prefixPos + prefixBytes) > prefix.size())
+				prefix.resize(prefixPos + prefixBytes);
+
+			std::memcpy(&prefix[prefixPos], s + numWritten, prefixBytes);
+
+			prefixPos += prefixBytes;
+			numWritten += prefixBytes;
+			continue;
+		}
+
+		const std::uint64_t chunkBytes = std::min(numBytes, std::uint64_t(epptr() - pptr()));
+
+		if (chunkBytes == 0) {
+			if (!SubmitChunk())
+				break;
+
+			continue;
+		}
+
+		std::memcpy(pptr(), s + numWritten, chunkBytes);
+
+		pbump(chunkBytes);
+		numWritten += chunkBytes;
+	}
+
+	return numWritten;
+}
+
+
+std::uint64_t CGZStreamWriter::GetCurPos() const
+{
+	if (InPrefix())
+		return prefixPos;
+
+	return (chunkPos + (pptr() - pbase()));
+}
+
+std::uint64_t CGZStreamWriter::GetEndPos() const
+{
+	if (!streaming)
+		return prefix.size();
+	if (patching)
+		return (chunkPos + chunkFill);
+
+	return (chunkPos + (pptr() - pbase()));
+}
+
+CGZStreamWriter::pos_type CGZStreamWriter::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+	switch (dir) {
+		case std::ios_base::beg: { return seekpos(off, which); } break;
+		case std::ios_base::cur: { return seekpos(GetCurPos() + off, which); } break;
+		case std::ios_base::end: { return seekpos(GetEndPos() + off, which); } break;
+		default: {} break;
+	}
+
+	return pos_type(off_type(-1));
+}
+
+CGZStreamWriter::pos_type CGZStreamWriter::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+	if ((which & std::ios_base::out) == 0 || file == nullptr)
+		return pos_type(off_type(-1));
+
+	const std::uint64_t newPos = off_type(pos);
+
+	if (!streaming) {
+		if (newPos > prefix.size())
+			return pos_type(off_type(-1));
+
+		prefixPos = newPos;
+		return pos;
+	}
+
+	if (newPos < prefix.size()) {
+		if (!patching) {
+			chunkFill = pptr() - pbase();
+			patching = true;
+
+			setp(nullptr, nullptr);
+		}
+
+		prefixPos = newPos;
+		return pos;
+	}
+
+	// anything after the prefix is gone (or about to be), except for the end
+	if (newPos != GetEndPos())
+		return pos_type(off_type(-1));
+
+	if (patching) {
+		patching = false;
+
+		setp(chunk.data(), chunk.data() + chunk.size());
+		pbump(chunkFill);
+	}
+
+	return pos;
+}
+
+
+bool CGZStreamWriter::BeginStreaming()
+{
+	assert(!streaming);
+
+	// reserve space for the prefix, it has the same size when rewritten
+	if (!WritePrefixMember()) {
+		writeError = true;
+		return false;
+	}
+
+	chunk.resize(CHUNK_SIZE);
+	chunkPos = prefix.size();
+
+	setp(chunk.data(), chunk.data() + chunk.size());
+
+	streaming = true;
+	compressorThread = spring::thread(&CGZStreamWriter::CompressorThread, this);
+	return true;
+}
+
+bool CGZStreamWriter::SubmitChunk()
+{
+	const std::size_t numBytes = pptr() - pbase();
+
+	if (numBytes == 0)
+		return true;
+
+	{
+		// never waits for the compressor; the writing thread
+		// (the sim) should not be slowed down by compression
+		std::lock_guard<spring::mutex> lock(chunkMutex);
+
+		if (writeError)
+			return false;
+
+		chunk.resize(numBytes);
+		queuedChunks.emplace_back(std::move(chunk));
+
+		if (!freeChunks.empty()) {
+			chunk = std::move(freeChunks.back());
+			freeChunks.pop_back();
+		}
+	}
+
+	chunkCond.notify_all();
+
+	chunk.resize(CHUNK_SIZE);
+	chunkPos += numBytes;
+
+	setp(chunk.data(), chunk.data() + chunk.size());
+	return true;
+}
+
+bool CGZStreamWriter::WritePrefixMember()
+{
+	z_stream prefixStream;
+	memset(&prefixStream, 0, sizeof(prefixStream));
+
+	if (deflateInit2(&prefixStream, Z_NO_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return false;
+
+	std::vector<std::uint8_t> buffer(deflateBound(&prefixStream, prefix.size()));
+
+	prefixStream.next_in = reinterpret_cast<Bytef*>(prefix.data());
+	prefixStream.avail_in = prefix.size();
+	prefixStream.next_out = buffer.data();
+	prefixStream.avail_out = buffer.size();
+
+	const int ret = deflate(&prefixStream, Z_FINISH);
+	const std::size_t memberSize = buffer.size() - prefixStream.avail_out;
+
+	deflateEnd(&prefixStream);
+
+	if (ret != Z_STREAM_END)
+		return false;
+
+	if (fseek(file, 0, SEEK_SET) != 0)
+		return false;
+	if (fwrite(buffer.data(), 1, memberSize, file) != memberSize)
+		return false;
+
+	return (fseek(file, 0, SEEK_END) == 0);
+}
+
+bool CGZStreamWriter::DeflateChunk(const std::vector<char>& data, int flush)
+{
+	std::vector<std::uint8_t> outBuffer(DEFLATE_BUFFER_SIZE);
+
+	bodyStream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+	bodyStream.avail_in = data.size();
+
+	do {
+		bodyStream.next_out = outBuffer.data();
+		bodyStream.avail_out = outBuffer.size();
+
+		if (deflate(&bodyStream, flush) == Z_STREAM_ERROR)
+			return false;
+
+		const std::size_t numBytes = outBuffer.size() - bodyStream.avail_out;
+
+		if (fwrite(outBuffer.data(), 1, numBytes, file) != numBytes)
+			return false;
+	} while (bodyStream.avail_out == 0);
+
+	return true;
+}
+
+
+void CGZStreamWriter::CompressorThread()
+{
+	std::vector<char> data;
+
+	while (true) {
+		{
+			std::unique_lock<spring::mutex> lock(chunkMutex);
+
+			chunkCond.wait(lock, [&]() { return (!queuedChunks.empty() || closing); });
+
+			if (queuedChunks.empty())
+				break;
+
+			data = std::move(queuedChunks.front());
+			queuedChunks.pop_front();
+		}
+
+		const bool ret = DeflateChunk(data, Z_NO_FLUSH);
+
+		{
+			std::lock_guard<spring::mutex> lock(chunkMutex);
+
+			writeError |= !ret;
+
+			if (freeChunks.size() < MAX_FREE_CHUNKS)
+				freeChunks.emplace_back(std::move(data));
+		}
+	}
+
+	const bool ret = DeflateChunk({}, Z_FINISH);
+
+	std::lock_guard<spring::mutex> lock(chunkMutex);
+	writeError |= !ret;
+}
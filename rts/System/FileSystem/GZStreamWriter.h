@@ -0,0 +1,96 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _GZ_STREAM_WRITER_H
+#define _GZ_STREAM_WRITER_H
+
+#include <cinttypes>
+#include <cstdio>
+#include <deque>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "System/Threading/SpringThreading.h"
+
+/**
+ * std::streambuf which gzip-compresses everything written to it into a
+ * file on the raw filesystem. Data is handed to a compression thread in
+ * fixed-size chunks without waiting for it, so writing is never slowed
+ * down by compression; chunks are freed once compressed, so the data is
+ * held in memory at most once and only while compression lags behind.
+ *
+ * Since compressed data can not be patched, the stream is split at the
+ * position passed to Pin: everything before it is kept in memory and can
+ * be overwritten (seekp + write) until Close, at which point it is stored
+ * uncompressed as the first gzip member of the file; everything after it
+ * is deflated into a second member. gzread and CGZFileHandler read both
+ * as one contiguous stream. Until Pin is called, all data is buffered.
+ */
+class CGZStreamWriter : public std::streambuf
+{
+public:
+	CGZStreamWriter(const std::string& filePath, int compressionLevel);
+	CGZStreamWriter(const CGZStreamWriter&) = delete;
+	~CGZStreamWriter() { Close(); }
+
+	CGZStreamWriter& operator = (const CGZStreamWriter&) = delete;
+
+	bool IsOpen() const { return (file != nullptr); }
+
+	/// keep everything before <pos> (not yet passed) rewritable until Close
+	void Pin(std::uint64_t pos);
+
+	/// waits for the remaining data to be written; false if anything failed along the way
+	bool Close();
+
+protected:
+	int_type overflow(int_type c) override;
+	std::streamsize xsputn(const char_type* s, std::streamsize n) override;
+
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+private:
+	bool InPrefix() const { return (!streaming || patching); }
+
+	std::uint64_t GetCurPos() const;
+	std::uint64_t GetEndPos() const;
+
+	bool BeginStreaming();
+	bool SubmitChunk();
+	bool WritePrefixMember();
+	bool DeflateChunk(const std::vector<char>& data, int flush);
+
+	void CompressorThread();
+
+private:
+	FILE* file;
+	z_stream bodyStream;
+
+	spring::thread compressorThread;
+	spring::mutex chunkMutex;
+	spring::condition_variable_any chunkCond;
+
+	// chunks waiting for the compressor, and emptied ones for reuse
+	std::deque< std::vector<char> > queuedChunks;
+	std::vector< std::vector<char> > freeChunks;
+
+	std::vector<char> prefix;
+	std::vector<char> chunk;
+
+	std::uint64_t prefixSize;
+	// position of prefix-writes, only meaningful if InPrefix()
+	std::uint64_t prefixPos;
+	// stream-position of chunk[0]
+	std::uint64_t chunkPos;
+	// fill-level of chunk while patching the prefix
+	std::uint64_t chunkFill;
+
+	bool streaming;
+	bool patching;
+	bool closing;
+	bool writeError;
+};
+
+#endif // _GZ_STREAM_WRITER_H
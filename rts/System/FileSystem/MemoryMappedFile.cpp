@@ -0,0 +1,115 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "MemoryMappedFile.h"
+
+#include <utility>
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#else
+	#include <windows.h>
+#endif
+
+
+CMemoryMappedFile& CMemoryMappedFile::operator = (CMemoryMappedFile&& f)
+{
+	if (this == &f)
+		return *this;
+
+	Close();
+
+	std::swap(fileData, f.fileData);
+	std::swap(fileSize, f.fileSize);
+
+	#ifdef _WIN32
+	std::swap(fileHandle, f.fileHandle);
+	std::swap(mapHandle, f.mapHandle);
+	#endif
+	return *this;
+}
+
+
+bool CMemoryMappedFile::Open(const std::string& filePath)
+{
+	Close();
+
+	#ifndef _WIN32
+	const int fd = open(filePath.c_str(), O_RDONLY);
+
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+
+	if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// the mapping holds its own reference to the file
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return false;
+
+	fileData = reinterpret_cast<const std::uint8_t*>(data);
+	fileSize = info.st_size;
+
+	#else
+	fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		fileHandle = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER size;
+
+	if (!GetFileSizeEx(fileHandle, &size) || size.QuadPart <= 0) {
+		Close();
+		return false;
+	}
+
+	if ((mapHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr)) == nullptr) {
+		Close();
+		return false;
+	}
+
+	if ((fileData = reinterpret_cast<const std::uint8_t*>(MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0))) == nullptr) {
+		Close();
+		return false;
+	}
+
+	fileSize = size.QuadPart;
+	#endif
+
+	return true;
+}
+
+
+void CMemoryMappedFile::Close()
+{
+	#ifndef _WIN32
+	if (fileData != nullptr)
+		munmap(const_cast<std::uint8_t*>(fileData), fileSize);
+
+	#else
+	if (fileData != nullptr)
+		UnmapViewOfFile(fileData);
+	if (mapHandle != nullptr)
+		CloseHandle(mapHandle);
+	if (fileHandle != nullptr)
+		CloseHandle(fileHandle);
+
+	mapHandle = nullptr;
+	fileHandle = nullptr;
+	#endif
+
+	fileData = nullptr;
+	fileSize = 0;
+}
@@ -0,0 +1,46 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _MEMORY_MAPPED_FILE_H
+#define _MEMORY_MAPPED_FILE_H
+
+#include <cinttypes>
+#include <string>
+#include <utility>
+
+/**
+ * Read-only view of a file on the raw filesystem (not the VFS).
+ * The contents are paged in lazily by the OS; nothing is copied
+ * unless the caller does so itself. Files of size zero or files
+ * that can not be opened leave the object in the !IsOpen() state.
+ */
+class CMemoryMappedFile
+{
+public:
+	CMemoryMappedFile() = default;
+	CMemoryMappedFile(const std::string& filePath) { Open(filePath); }
+	CMemoryMappedFile(const CMemoryMappedFile&) = delete;
+	CMemoryMappedFile(CMemoryMappedFile&& f) { *this = std::move(f); }
+	~CMemoryMappedFile() { Close(); }
+
+	CMemoryMappedFile& operator = (const CMemoryMappedFile&) = delete;
+	CMemoryMappedFile& operator = (CMemoryMappedFile&& f);
+
+	bool Open(const std::string& filePath);
+	void Close();
+
+	bool IsOpen() const { return (fileData != nullptr); }
+
+	const std::uint8_t* GetData() const { return fileData; }
+	std::uint64_t GetSize() const { return fileSize; }
+
+private:
+	const std::uint8_t* fileData = nullptr;
+	std::uint64_t fileSize = 0;
+
+	#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mapHandle = nullptr;
+	#endif
+};
+
+#endif // _MEMORY_MAPPED_FILE_H
@@ -1,5 +1,7 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
+#include <future>
+#include <memory>
 #include <sstream>
 #include <zlib.h>
 
@@ -30,10 +32,12 @@
 #include "Sim/Units/Scripts/UnitScriptEngine.h"
 #include "Sim/Units/Scripts/NullUnitScript.h"
 #include "System/SafeUtil.h"
+#include "System/Config/ConfigHandler.h"
 #include "System/Platform/errorhandler.h"
 #include "System/FileSystem/DataDirsAccess.h"
 #include "System/FileSystem/FileQueryFlags.h"
 #include "System/FileSystem/GZFileHandler.h"
+#include "System/FileSystem/GZStreamWriter.h"
 #include "System/Threading/ThreadPool.h"
 #include "System/creg/Serializer.h"
 #include "System/Exceptions.h"
@@ -41,6 +45,8 @@
 
 
 
+CONFIG(int, SaveGameCompressionLevel).defaultValue(9).minimumValue(1).maximumValue(9).description("zlib compression level of savegames; 1 is fastest, 9 gives the smallest files.");
+
 CCregLoadSaveHandler::CCregLoadSaveHandler()
 	: iss(nullptr)
 {}
@@ -128,7 +134,14 @@ void CCregLoadSaveHandler::SaveGame(const std::string& path)
 	LOG("[LSH::%s] saving game to \"%s\"", __func__, path.c_str());
 
 	try {
-		std::stringstream oss;
+		// objects are compressed on another thread while the rest is serialized
+		std::shared_ptr<CGZStreamWriter> gzWriter = std::make_shared<CGZStreamWriter>(dataDirsAccess.LocateFile(path, FileQueryFlags::WRITE), configHandler->GetInt("SaveGameCompressionLevel"));
+		std::ostream oss(gzWriter.get());
+
+		if (!gzWriter->IsOpen()) {
+			LOG_L(L_ERROR, "[LSH::%s] could not open save-file", __func__);
+			return;
+		}
 
 		// write our own header. SavePackage() will add its own
 		WriteString(oss, SpringVersion::GetSync());
@@ -136,6 +149,9 @@ void CCregLoadSaveHandler::SaveGame(const std::string& path)
 		WriteString(oss, modName);
 		WriteString(oss, mapName);
 
+		// SavePackage() fills in its header last, keep that part uncompressed
+		gzWriter->Pin(std::uint64_t(oss.tellp()) + creg::COutputStreamSerializer::GetPackageHeaderSize());
+
 		CGameStateCollector gsc = CGameStateCollector();
 
 		{
@@ -158,26 +174,18 @@ void CCregLoadSaveHandler::SaveGame(const std::string& path)
 			PrintSize("AIs", ((int)oss.tellp()) - aiStart);
 		}
 
-		{
-			gzFile file = gzopen(dataDirsAccess.LocateFile(path, FileQueryFlags::WRITE).c_str(), "wb9");
-
-			if (file == nullptr) {
-				LOG_L(L_ERROR, "[LSH::%s] could not open save-file", __func__);
-				return;
-			}
-
-			std::string data = std::move(oss.str());
-			std::function<void(gzFile, std::string&&)> func = [](gzFile file, std::string&& data) {
-				gzwrite(file, data.c_str(), data.size());
-				gzflush(file, Z_FINISH);
-				gzclose(file);
-			};
-
-			// gzFile is just a plain typedef (struct gzFile_s {}* gzFile), can be copied
-			// need to keep a reference to the future around or its destructor will block
-			ThreadPool::AddExtJob(std::move(std::async(std::launch::async, std::move(func), file, std::move(data))));
+		if (!oss.good()) {
+			LOG_L(L_ERROR, "[LSH::%s] error writing save-file", __func__);
+			return;
 		}
 
+		// compression can lag behind, let it finish on its own
+		// need to keep a reference to the future around or its destructor will block
+		ThreadPool::AddExtJob(std::async(std::launch::async, [gzWriter]() {
+			if (!gzWriter->Close())
+				LOG_L(L_ERROR, "[LSH::SaveGame] error writing save-file");
+		}));
+
 		//FIXME add lua state
 	} catch (const content_error& ex) {
 		LOG_L(L_ERROR, "[LSH::%s] content error \"%s\"", __func__, ex.what());
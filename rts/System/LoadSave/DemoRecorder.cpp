@@ -2,20 +2,21 @@
 
 #include <cassert>
 #include <cerrno>
+#include <chrono>
 #include <cstring>
-#include <memory>
 
 #include "DemoRecorder.h"
 #include "Game/GameVersion.h"
 #include "Sim/Misc/TeamStatistics.h"
 #include "System/TimeUtil.h"
 #include "System/StringUtil.h"
+#include "System/Config/ConfigHandler.h"
 #include "System/FileSystem/DataDirsAccess.h"
 #include "System/FileSystem/FileSystem.h"
 #include "System/FileSystem/FileQueryFlags.h"
 #include "System/FileSystem/FileHandler.h"
 #include "System/Log/ILog.h"
-#include "System/Threading/ThreadPool.h"
+#include "System/Platform/Threading.h"
 
 #ifdef CreateDirectory
 #undef CreateDirectory
@@ -25,16 +26,54 @@
 #undef GetCurrentTime
 #endif
 
-// server and client memory-streams
-static std::unique_ptr<std::stringstream> demoStreams[2] = {nullptr, nullptr};
+CONFIG(int, DemoFlushInterval).defaultValue(5).minimumValue(1).description("Seconds between flush points of demos being recorded; if the engine crashes, the demo remains playable up to the last one.");
 
-CDemoRecorder::CDemoRecorder(const std::string& mapName, const std::string& modName, bool serverDemo): isServerDemo(serverDemo)
+// staging-buffer size at which the writer thread is woken early
+static constexpr unsigned int WRITE_BUFFER_SIZE = 64 * 1024;
+static constexpr unsigned int DEFLATE_BUFFER_SIZE = 16 * 1024;
+
+
+static DemoFileHeader SwabFileHeader(const DemoFileHeader& fileHeader, bool updateStreamLength)
+{
+	DemoFileHeader tmpHeader;
+	memcpy(&tmpHeader, &fileHeader, sizeof(fileHeader));
+
+	// a zero stream-size tells readers to play until EOF, which is
+	// what they should do with files of interrupted recordings
+	if (!updateStreamLength)
+		tmpHeader.demoStreamSize = 0;
+
+	tmpHeader.swab(); // to little endian
+	return tmpHeader;
+}
+
+
+CDemoRecorder::CDemoRecorder(const std::string& mapName, const std::string& modName, bool serverDemo)
+	: file(nullptr)
+	, flushInterval(spring_secs(configHandler->GetInt("DemoFlushInterval")))
+	, headerMemberSize(0)
+	, headerPending(false)
+	, stopWriter(false)
+	, isServerDemo(serverDemo)
 {
-	SetStream();
+	memset(&bodyStream, 0, sizeof(bodyStream));
+
 	SetName(mapName, modName);
 	SetFileHeader();
 
-	file = gzopen(demoName.c_str(), "wb9");
+	if ((file = fopen(demoName.c_str(), "wb")) == nullptr) {
+		LOG_L(L_ERROR, "[%s] could not open demo \"%s\" (%s)", __func__, demoName.c_str(), strerror(errno));
+		return;
+	}
+
+	if (!WriteHeaderMember(SwabFileHeader(fileHeader, false)) || deflateInit2(&bodyStream, 9, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		LOG_L(L_ERROR, "[%s] could not initialize demo \"%s\"", __func__, demoName.c_str());
+		fclose(file);
+		file = nullptr;
+		return;
+	}
+
+	writerThread = spring::thread(&CDemoRecorder::WriterThread, this);
 }
 
 CDemoRecorder::~CDemoRecorder()
@@ -43,19 +82,9 @@ CDemoRecorder::~CDemoRecorder()
 	WriteWinnerList();
 	WritePlayerStats();
 	WriteTeamStats();
-	WriteFileHeader(true);
 	WriteDemoFile();
 }
 
-void CDemoRecorder::SetStream()
-{
-	if (demoStreams[isServerDemo].get() == nullptr)
-		demoStreams[isServerDemo].reset(new std::stringstream(std::ios::binary | std::ios::out));
-
-	demoStreams[isServerDemo]->clear();
-	demoStreams[isServerDemo]->seekp(0);
-}
-
 void CDemoRecorder::SetFileHeader()
 {
 	memset(&fileHeader, 0, sizeof(DemoFileHeader));
@@ -68,38 +97,175 @@ void CDemoRecorder::SetFileHeader()
 	fileHeader.teamStatElemSize = sizeof(TeamStatistics);
 	fileHeader.teamStatPeriod = TeamStatistics::statsPeriod;
 	fileHeader.winningAllyTeamsSize = 0;
-
-	demoStreams[isServerDemo]->seekp(WriteFileHeader(false) + sizeof(DemoFileHeader));
 }
 
 void CDemoRecorder::WriteDemoFile()
 {
-	// using operator<<(basic_stringbuf*) requires the stream to be opened with std::ios::in
-	// stringbuf::{eback(), egptr(), gptr()} are protected so we cannot access them directly
-	// (plus data is not guaranteed to be stored contiguously) ==> the only clean OO solution
-	// that avoids str()'s copy would be to supply our own stringbuffer backend to demoStream
-	// which is slightly overdoing it
-	//
-	// zlib FAQ claims the lib is thread-safe, "however any library routines that zlib uses and
-	// any application-provided memory allocation routines must also be thread-safe. zlib's gz*
-	// functions use stdio library routines, and most of zlib's functions use the library memory
-	// allocation routines by default" (should be OK)
-	std::string data = std::move(demoStreams[isServerDemo]->str());
-	std::function<void(gzFile, std::string&&)> func = [](gzFile file, std::string&& data) {
-		gzwrite(file, data.c_str(), data.size());
-		gzflush(file, Z_FINISH);
-		gzclose(file);
-	};
-
-	#ifndef WIN32
-	// NOTE: can not use ThreadPool for this directly here, workers are already gone
-	// FIXME: does not currently (august 2017) compile on Windows mingw buildbots
-	ThreadPool::AddExtJob(spring::thread(std::move(func), file, std::move(data)));
-	#else
-	ThreadPool::AddExtJob(std::move(std::async(std::launch::async, std::move(func), file, std::move(data))));
-	#endif
+	if (file == nullptr)
+		return;
+
+	{
+		std::lock_guard<spring::mutex> lock(writerMutex);
+		stopWriter = true;
+	}
+
+	// everything but the last staging-buffer is already compressed
+	// at this point, so waiting for the writer does not take long
+	writerCond.notify_one();
+	writerThread.join();
+
+	deflateEnd(&bodyStream);
+
+	// stream-size and statistics are only known now
+	if (!WriteHeaderMember(SwabFileHeader(fileHeader, true)))
+		LOG_L(L_ERROR, "[%s] could not finalize header of demo \"%s\"", __func__, demoName.c_str());
+
+	fclose(file);
+	file = nullptr;
+}
+
+
+void CDemoRecorder::WriteToDemo(const void* data, unsigned int size)
+{
+	if (file == nullptr)
+		return;
+
+	const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(data);
+
+	bool wakeWriter = false;
+
+	{
+		std::lock_guard<spring::mutex> lock(writerMutex);
+		pendingData.insert(pendingData.end(), bytes, bytes + size);
+		wakeWriter = (pendingData.size() >= WRITE_BUFFER_SIZE);
+	}
+
+	if (wakeWriter)
+		writerCond.notify_one();
 }
 
+void CDemoRecorder::WriterThread()
+{
+	Threading::SetThreadName("demo-writer");
+
+	std::vector<std::uint8_t> data;
+	DemoFileHeader header;
+
+	spring_time lastFlushTime = spring_gettime();
+
+	bool stop = false;
+	bool writeHeader = false;
+	bool haveUnflushedData = false;
+	bool haveWriteError = false;
+
+	while (!stop) {
+		{
+			std::unique_lock<spring::mutex> lock(writerMutex);
+
+			const auto waitTime = std::chrono::milliseconds(flushInterval.toMilliSecsi());
+			const auto waitPred = [&]() { return (stopWriter || headerPending || pendingData.size() >= WRITE_BUFFER_SIZE); };
+
+			writerCond.wait_for(lock, waitTime, waitPred);
+
+			data.clear();
+			data.swap(pendingData);
+
+			if ((writeHeader = headerPending))
+				header = pendingHeader;
+
+			headerPending = false;
+			stop = stopWriter;
+		}
+
+		if (haveWriteError)
+			continue;
+
+		const spring_time now = spring_gettime();
+		const bool flush = (stop || (haveUnflushedData && (now - lastFlushTime) >= flushInterval));
+
+		haveUnflushedData |= !data.empty();
+
+		if (!data.empty() || flush)
+			haveWriteError |= !DeflateBody(data, stop? Z_FINISH: (flush? Z_SYNC_FLUSH: Z_NO_FLUSH));
+		if (writeHeader)
+			haveWriteError |= !WriteHeaderMember(header);
+
+		if (haveWriteError) {
+			LOG_L(L_ERROR, "[%s] error writing demo \"%s\", recording stopped", __func__, demoName.c_str());
+			continue;
+		}
+
+		if (flush) {
+			fflush(file);
+
+			lastFlushTime = now;
+			haveUnflushedData = false;
+		}
+	}
+}
+
+bool CDemoRecorder::DeflateBody(const std::vector<std::uint8_t>& data, int flush)
+{
+	std::uint8_t outBuffer[DEFLATE_BUFFER_SIZE];
+
+	bodyStream.next_in = const_cast<Bytef*>(data.data());
+	bodyStream.avail_in = data.size();
+
+	do {
+		bodyStream.next_out = outBuffer;
+		bodyStream.avail_out = sizeof(outBuffer);
+
+		if (deflate(&bodyStream, flush) == Z_STREAM_ERROR)
+			return false;
+
+		const size_t numBytes = sizeof(outBuffer) - bodyStream.avail_out;
+
+		if (fwrite(outBuffer, 1, numBytes, file) != numBytes)
+			return false;
+	} while (bodyStream.avail_out == 0);
+
+	return true;
+}
+
+/** @brief Write a (swabbed) header as the first gzip member of the file
+The member is not compressed, so its size stays the same for every header and
+it can be overwritten in-place; the write position is restored to the end. */
+bool CDemoRecorder::WriteHeaderMember(const DemoFileHeader& header)
+{
+	std::uint8_t buffer[sizeof(DemoFileHeader) + 64];
+
+	z_stream headerStream;
+	memset(&headerStream, 0, sizeof(headerStream));
+
+	if (deflateInit2(&headerStream, Z_NO_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return false;
+
+	headerStream.next_in = reinterpret_cast<Bytef*>(const_cast<DemoFileHeader*>(&header));
+	headerStream.avail_in = sizeof(header);
+	headerStream.next_out = buffer;
+	headerStream.avail_out = sizeof(buffer);
+
+	const int ret = deflate(&headerStream, Z_FINISH);
+	const unsigned int memberSize = sizeof(buffer) - headerStream.avail_out;
+
+	deflateEnd(&headerStream);
+
+	if (ret != Z_STREAM_END)
+		return false;
+	if (headerMemberSize != 0 && memberSize != headerMemberSize)
+		return false;
+
+	headerMemberSize = memberSize;
+
+	if (fseek(file, 0, SEEK_SET) != 0)
+		return false;
+	if (fwrite(buffer, 1, memberSize, file) != memberSize)
+		return false;
+
+	return (fseek(file, 0, SEEK_END) == 0);
+}
+
+
 void CDemoRecorder::WriteSetupText(const std::string& text)
 {
 	int length = text.length();
@@ -108,7 +274,7 @@ void CDemoRecorder::WriteSetupText(const std::string& text)
 	}
 
 	fileHeader.scriptSize = length;
-	demoStreams[isServerDemo]->write(text.c_str(), length);
+	WriteToDemo(text.c_str(), length);
 }
 
 void CDemoRecorder::SaveToDemo(const unsigned char* buf, const unsigned length, const float modGameTime)
@@ -118,8 +284,8 @@ void CDemoRecorder::SaveToDemo(const unsigned char* buf, const unsigned length,
 	chunkHeader.modGameTime = modGameTime;
 	chunkHeader.length = length;
 	chunkHeader.swab();
-	demoStreams[isServerDemo]->write((char*) &chunkHeader, sizeof(chunkHeader));
-	demoStreams[isServerDemo]->write((char*) buf, length);
+	WriteToDemo(&chunkHeader, sizeof(chunkHeader));
+	WriteToDemo(buf, length);
 	fileHeader.demoStreamSize += (length + sizeof(chunkHeader));
 }
 
@@ -213,49 +379,32 @@ void CDemoRecorder::SetWinningAllyTeams(const std::vector<unsigned char>& winnin
 }
 
 /** @brief Write DemoFileHeader
-Write the DemoFileHeader at the start of the file and restores the original
-position in the file afterwards. */
-unsigned int CDemoRecorder::WriteFileHeader(bool updateStreamLength)
+Hands the current DemoFileHeader to the writer thread, which overwrites the
+header member at the start of the file with it. */
+void CDemoRecorder::WriteFileHeader(bool updateStreamLength)
 {
-#ifdef _MSC_VER // MSVC8 behaves strange if tell/seek is called before anything has been written
-	const bool empty = (demoStreams[isServerDemo]->str() == "");
-	const unsigned int pos = empty? 0 : demoStreams[isServerDemo]->tellp();
-#else
-	const unsigned int pos = demoStreams[isServerDemo]->tellp();
-#endif
-
-	DemoFileHeader tmpHeader;
-	memcpy(&tmpHeader, &fileHeader, sizeof(fileHeader));
-	if (!updateStreamLength)
-		tmpHeader.demoStreamSize = 0;
-	tmpHeader.swab(); // to little endian
+	if (file == nullptr)
+		return;
 
-#ifdef _MSC_VER
-	if (!empty)
-#endif
 	{
-		demoStreams[isServerDemo]->seekp(0);
+		std::lock_guard<spring::mutex> lock(writerMutex);
+		pendingHeader = SwabFileHeader(fileHeader, updateStreamLength);
+		headerPending = true;
 	}
 
-
-	demoStreams[isServerDemo]->write((char*) &tmpHeader, sizeof(tmpHeader));
-	demoStreams[isServerDemo]->seekp(pos);
-
-	return pos;
+	writerCond.notify_one();
 }
 
 /** @brief Write the CPlayer::Statistics at the current position in the file. */
 void CDemoRecorder::WritePlayerStats()
 {
-	int pos = demoStreams[isServerDemo]->tellp();
-
 	for (PlayerStatistics& stats: playerStats) {
 		stats.swab();
-		demoStreams[isServerDemo]->write(reinterpret_cast<char*>(&stats), sizeof(PlayerStatistics));
+		WriteToDemo(&stats, sizeof(PlayerStatistics));
 	}
 
 	fileHeader.numPlayers = playerStats.size();
-	fileHeader.playerStatSize = (int)demoStreams[isServerDemo]->tellp() - pos;
+	fileHeader.playerStatSize = playerStats.size() * sizeof(PlayerStatistics);
 
 	playerStats.clear();
 }
@@ -268,38 +417,36 @@ void CDemoRecorder::WriteWinnerList()
 	if (fileHeader.numTeams == 0)
 		return;
 
-	const int pos = demoStreams[isServerDemo]->tellp();
-
 	// Write the array of winningAllyTeams.
-	for (std::vector<unsigned char>::const_iterator it = winningAllyTeams.begin(); it != winningAllyTeams.end(); ++it) {
-		demoStreams[isServerDemo]->write((char*) &(*it), sizeof(unsigned char));
-	}
+	WriteToDemo(winningAllyTeams.data(), winningAllyTeams.size() * sizeof(unsigned char));
 
-	winningAllyTeams.clear();
+	fileHeader.winningAllyTeamsSize = winningAllyTeams.size() * sizeof(unsigned char);
 
-	fileHeader.winningAllyTeamsSize = int(demoStreams[isServerDemo]->tellp()) - pos;
+	winningAllyTeams.clear();
 }
 
 /** @brief Write the TeamStatistics at the current position in the file. */
 void CDemoRecorder::WriteTeamStats()
 {
-	int pos = demoStreams[isServerDemo]->tellp();
+	int size = 0;
 
 	// Write array of dwords indicating number of TeamStatistics per team.
 	for (std::vector<TeamStatistics>& history: teamStats) {
 		unsigned int c = swabDWord(history.size());
-		demoStreams[isServerDemo]->write((char*)&c, sizeof(unsigned int));
+		WriteToDemo(&c, sizeof(unsigned int));
+		size += sizeof(unsigned int);
 	}
 
 	// Write big array of TeamStatistics.
 	for (std::vector<TeamStatistics>& history: teamStats) {
 		for (TeamStatistics& stats: history) {
 			stats.swab();
-			demoStreams[isServerDemo]->write(reinterpret_cast<char*>(&stats), sizeof(TeamStatistics));
+			WriteToDemo(&stats, sizeof(TeamStatistics));
+			size += sizeof(TeamStatistics);
 		}
 	}
 
-	fileHeader.teamStatSize = (int)demoStreams[isServerDemo]->tellp() - pos;
+	fileHeader.teamStatSize = size;
 
 	teamStats.clear();
 }
@@ -3,17 +3,29 @@
 #ifndef DEMO_RECORDER
 #define DEMO_RECORDER
 
+#include <cinttypes>
+#include <cstdio>
 #include <vector>
-#include <sstream>
 #include <zlib.h>
 
 #include "Demo.h"
 #include "Game/Players/PlayerStatistics.h"
 #include "Sim/Misc/TeamStatistics.h"
+#include "System/Misc/SpringTime.h"
+#include "System/Threading/SpringThreading.h"
 
 
 /**
  * @brief Used to record demos
+ *
+ * Data is handed to a writer thread which compresses it straight into
+ * the .sdfz file, so nothing but a small staging buffer is held in RAM.
+ * The file consists of two concatenated gzip members: a stored (ie.
+ * uncompressed and therefore fixed-size) one holding the DemoFileHeader
+ * which is rewritten in-place when the header changes, followed by the
+ * deflated script, stream and statistics. Readers based on gzread see a
+ * single contiguous stream. The body is sync-flushed periodically so an
+ * interrupted recording remains readable up to the last flush point.
  */
 class CDemoRecorder : public CDemo
 {
@@ -24,7 +36,6 @@ public:
 	void WriteSetupText(const std::string& text);
 	void SaveToDemo(const unsigned char* buf, const unsigned length, const float modGameTime);
 
-	void SetStream();
 	void SetName(const std::string& mapName, const std::string& modName);
 	const std::string& GetName() const { return demoName; }
 
@@ -38,15 +49,37 @@ public:
 	void SetWinningAllyTeams(const std::vector<unsigned char>& winningAllyTeams);
 
 private:
-	unsigned int WriteFileHeader(bool updateStreamLength);
+	void WriteFileHeader(bool updateStreamLength);
 	void SetFileHeader();
 	void WritePlayerStats();
 	void WriteTeamStats();
 	void WriteWinnerList();
 	void WriteDemoFile();
 
+	void WriteToDemo(const void* data, unsigned int size);
+	void WriterThread();
+	bool DeflateBody(const std::vector<std::uint8_t>& data, int flush);
+	bool WriteHeaderMember(const DemoFileHeader& header);
+
 private:
-	gzFile file;
+	FILE* file;
+	z_stream bodyStream;
+
+	spring::thread writerThread;
+	spring::mutex writerMutex;
+	spring::condition_variable_any writerCond;
+
+	// filled by SaveToDemo et al., drained by the writer thread
+	std::vector<std::uint8_t> pendingData;
+	// (swabbed) header waiting to be written, if headerPending
+	DemoFileHeader pendingHeader;
+
+	spring_time flushInterval;
+
+	unsigned int headerMemberSize;
+
+	bool headerPending;
+	bool stopWriter;
 
 	std::vector<PlayerStatistics> playerStats;
 	std::vector< std::vector<TeamStatistics> > teamStats;
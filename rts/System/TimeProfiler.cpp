@@ -1,11 +1,13 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include <algorithm>
-#include <climits>
+#include <cstdint>
 #include <cstring>
+#include <memory>
 
 #include "System/TimeProfiler.h"
 #include "System/GlobalRNG.h"
+#include "System/MainDefines.h"
 #include "System/Log/ILog.h"
 #include "System/Threading/SpringThreading.h"
 
@@ -14,127 +16,159 @@
 #endif
 
 static spring::mutex profileMutex;
-static spring::unordered_map<int, std::string> hashToName;
-static spring::unordered_map<int, int> refCounters;
+static spring::mutex timerNamesMutex;
+static spring::mutex timerEventsMutex;
 
 static CGlobalUnsyncedRNG profileColorRNG;
 
 
 
-static unsigned HashString(const char* s, size_t n)
-{
-	unsigned hash = 0;
+// interned timer names, indexed by id; a deque so the strings never move
+static std::deque<std::string> timerNames;
+static spring::unsynced_map<std::string, unsigned> timerNameIDs;
+
+struct TimerNameCacheEntry {
+	const char* name;
+	const char* internedName;
+	unsigned id;
+};
+
+// timer names are nearly always literals, so a cache keyed on their address
+// resolves them without locking; strcmp guards against reused addresses
+static constexpr unsigned TIMER_NAME_CACHE_SIZE = 256;
+static _threadlocal TimerNameCacheEntry timerNameCache[TIMER_NAME_CACHE_SIZE];
+
+
+
+enum {
+	TIMER_EVENT_SHOW_GRAPH = 1,
+	TIMER_EVENT_SPECIAL    = 2,
+	TIMER_EVENT_THREAD     = 4,
+};
+
+struct TimerEvent {
+	spring_time startTime;
+	spring_time endTime;
+
+	unsigned timerID;
+	unsigned flags;
+};
+
+// single-producer single-consumer ring, written by the thread owning it
+// and read by MergeTimes; full rings drop (and count) their new events
+struct ThreadTimerEvents {
+	static constexpr unsigned NUM_EVENTS = 4096;
+
+	TimerEvent events[NUM_EVENTS];
 
-	for (size_t i = 0; (i < n || n == std::string::npos); ++i) {
-		if (s[i] == 0)
-			break;
+	std::atomic<unsigned> writeIdx = {0};
+	std::atomic<unsigned> readIdx = {0};
+	std::atomic<unsigned> numDropped = {0};
 
-		hash += s[i];
-		hash ^= (hash << 7) | (hash >> (sizeof(hash) * CHAR_BIT - 7));
+	// cleared when the owning thread exits, so the ring can be reused
+	std::atomic<bool> inUse = {false};
+
+	int poolThreadNum = 0;
+	int traceThreadNum = 0;
+};
+
+struct ThreadTimerEventsRef {
+	~ThreadTimerEventsRef() {
+		if (events != nullptr)
+			events->inUse.store(false, std::memory_order_release);
 	}
 
-	return hash;
-}
+	ThreadTimerEvents* events = nullptr;
+};
 
-#if 0
-// unused
-static unsigned HashString(const std::string& s) {
-	return (HashString(s.c_str(), s.size()));
-}
+static std::vector< std::unique_ptr<ThreadTimerEvents> > timerEvents;
 
+static thread_local ThreadTimerEventsRef threadTimerEvents;
+// nesting depth per timer id, only the outermost ScopedTimer of a name counts
+static thread_local std::vector<unsigned> threadRefCounters;
 
 
-BasicTimer::BasicTimer(const std::string& timerName)
-	: nameHash(HashString(timerName))
-	, startTime(spring_gettime())
 
-	, name(timerName)
+static ThreadTimerEvents* GetThreadTimerEvents()
 {
-	const auto iter = hashToName.find(nameHash);
+	if (threadTimerEvents.events != nullptr)
+		return threadTimerEvents.events;
+
+	std::lock_guard<spring::mutex> lock(timerEventsMutex);
+
+	const auto pred = [](const std::unique_ptr<ThreadTimerEvents>& e) { return (!e->inUse.load(std::memory_order_acquire)); };
+	const auto iter = std::find_if(timerEvents.begin(), timerEvents.end(), pred);
+
+	ThreadTimerEvents* events = nullptr;
 
-	if (iter == hashToName.end()) {
-		hashToName.insert(std::pair<int, std::string>(nameHash, timerName)).first;
+	if (iter == timerEvents.end()) {
+		timerEvents.emplace_back(new ThreadTimerEvents());
+
+		events = timerEvents.back().get();
+		events->traceThreadNum = timerEvents.size() - 1;
 	} else {
-#ifdef DEBUG
-		if (iter->second != timerName) {
-			LOG_L(L_ERROR, "Timer hash collision: %s <=> %s", timerName.c_str(), iter->second.c_str());
-			assert(false);
-		}
-#endif
+		events = iter->get();
 	}
+
+	#ifdef THREADPOOL
+	events->poolThreadNum = ThreadPool::GetThreadNum();
+	#endif
+	events->inUse.store(true, std::memory_order_release);
+
+	return (threadTimerEvents.events = events);
 }
-#endif
 
-BasicTimer::BasicTimer(const char* timerName)
-	: nameHash(HashString(timerName, std::string::npos))
-	, startTime(spring_gettime())
 
-	, name(timerName)
+static void WriteTraceString(FILE* file, const std::string& str)
 {
-	const auto iter = hashToName.find(nameHash);
+	fputc('"', file);
 
-	if (iter == hashToName.end()) {
-		hashToName.insert(std::pair<int, std::string>(nameHash, timerName));
-	} else {
-#ifdef DEBUG
-		if (iter->second != timerName) {
-			LOG_L(L_ERROR, "Timer hash collision: %s <=> %s", timerName, iter->second.c_str());
-			assert(false);
-		}
-#endif
+	for (const char c: str) {
+		if (c == '"' || c == '\\')
+			fputc('\\', file);
+
+		// raw control characters are not valid json
+		fputc((static_cast<unsigned char>(c) < 0x20)? ' ': c, file);
 	}
-}
 
-spring_time BasicTimer::GetDuration() const
-{
-	return spring_difftime(spring_gettime(), startTime);
+	fputc('"', file);
 }
 
 
 
-#if 0
-// unused
-ScopedTimer::ScopedTimer(const std::string& name, bool _autoShowGraph, bool _specialTimer)
-	: BasicTimer(name)
+BasicTimer::BasicTimer(const char* timerName)
+	: timerID(CTimeProfiler::GetTimerID(timerName))
+	, startTime(spring_gettime())
+{
+}
 
-	, autoShowGraph(_autoShowGraph)
-	, specialTimer(_specialTimer)
+spring_time BasicTimer::GetDuration() const
 {
-	auto iter = refCounters.find(nameHash);
+	return spring_difftime(spring_gettime(), startTime);
+}
 
-	if (iter == refCounters.end())
-		iter = refCounters.insert(std::pair<int, int>(nameHash, 0)).first;
 
-	++(iter->second);
-}
-#endif
 
 ScopedTimer::ScopedTimer(const char* timerName, bool _autoShowGraph, bool _specialTimer)
 	: BasicTimer(timerName)
 
 	// Game::SendClientProcUsage depends on "Sim" and "Draw" percentages, BenchMark on "Lua"
-	// note that address-comparison is intended here, timer names are (and must be) literals
 	, autoShowGraph(_autoShowGraph)
 	, specialTimer(_specialTimer)
 {
-	auto iter = refCounters.find(nameHash);
-
-	if (iter == refCounters.end())
-		iter = refCounters.insert(std::pair<int, int>(nameHash, 0)).first;
+	if (timerID >= threadRefCounters.size())
+		threadRefCounters.resize(timerID + 1, 0);
 
-	++(iter->second);
+	++threadRefCounters[timerID];
 }
 
 ScopedTimer::~ScopedTimer()
 {
-	// no avoiding a second lookup since iterators can be invalidated with unordered_map
-	auto iter = refCounters.find(nameHash);
-
-	assert(iter != refCounters.end());
-	assert(iter->second > 0);
+	assert(timerID < threadRefCounters.size());
+	assert(threadRefCounters[timerID] > 0);
 
-	if (--(iter->second) == 0) {
-		profiler.AddTime(GetName(), startTime, GetDuration(), autoShowGraph, specialTimer, false);
+	if (--threadRefCounters[timerID] == 0) {
+		profiler.AddTime(timerID, startTime, spring_gettime(), autoShowGraph, specialTimer, false);
 	}
 }
 
@@ -164,28 +198,15 @@ spring_time ScopedOnceTimer::GetDuration() const
 
 
 
-#if 0
-// unused
-ScopedMtTimer::ScopedMtTimer(const std::string& timerName, bool _autoShowGraph)
-	// can not call BasicTimer's other ctor, accesses global map
-	// collisions for MT timers do not need to be checked anyway
-	: BasicTimer(spring_gettime())
-	, autoShowGraph(_autoShowGraph)
-{
-	name = timerName;
-}
-#endif
-
 ScopedMtTimer::ScopedMtTimer(const char* timerName, bool _autoShowGraph)
-	: BasicTimer(spring_gettime())
+	: BasicTimer(timerName)
 	, autoShowGraph(_autoShowGraph)
 {
-	name = timerName;
 }
 
 ScopedMtTimer::~ScopedMtTimer()
 {
-	profiler.AddTime(GetName(), startTime, GetDuration(), autoShowGraph, false, true);
+	profiler.AddTime(timerID, startTime, spring_gettime(), autoShowGraph, false, true);
 }
 
 
@@ -195,17 +216,18 @@ ScopedMtTimer::~ScopedMtTimer()
 //////////////////////////////////////////////////////////////////////
 
 CTimeProfiler::CTimeProfiler()
+	: traceFile(nullptr)
+	, numTraceEvents(0)
+	, numDroppedTimes(0)
+	, tracing(false)
 {
 	ResetState();
 }
 
 CTimeProfiler::~CTimeProfiler()
 {
-	#if 0
-	// should not be needed, destructor runs after main returns and all threads are gone
-	std::unique_lock<spring::mutex> ulk(profileMutex, std::defer_lock);
-	while (!ulk.try_lock()) {}
-	#endif
+	// flush the trace if the game did not get to it
+	StopTrace();
 }
 
 CTimeProfiler& CTimeProfiler::GetInstance()
@@ -215,6 +237,32 @@ CTimeProfiler& CTimeProfiler::GetInstance()
 }
 
 
+unsigned CTimeProfiler::GetTimerID(const char* name)
+{
+	TimerNameCacheEntry& entry = timerNameCache[(reinterpret_cast<std::uintptr_t>(name) >> 2) % TIMER_NAME_CACHE_SIZE];
+
+	if (entry.name == name && strcmp(entry.internedName, name) == 0)
+		return entry.id;
+
+	std::lock_guard<spring::mutex> lock(timerNamesMutex);
+
+	const auto iter = timerNameIDs.find(name);
+
+	if (iter != timerNameIDs.end()) {
+		entry.id = iter->second;
+	} else {
+		entry.id = timerNames.size();
+
+		timerNames.emplace_back(name);
+		timerNameIDs[timerNames.back()] = entry.id;
+	}
+
+	entry.name = name;
+	entry.internedName = timerNames[entry.id].c_str();
+	return entry.id;
+}
+
+
 void CTimeProfiler::ResetState() {
 	// grab lock; ThreadPool workers might already be running SCOPED_MT_TIMER
 	std::unique_lock<spring::mutex> ulk(profileMutex, std::defer_lock);
@@ -227,10 +275,21 @@ void CTimeProfiler::ResetState() {
 	threadProfile.resize(ThreadPool::GetMaxThreads());
 	#endif
 
+	{
+		// discard whatever was queued before the reset
+		std::lock_guard<spring::mutex> lock(timerEventsMutex);
+
+		for (const auto& e: timerEvents) {
+			e->readIdx.store(e->writeIdx.load(std::memory_order_acquire), std::memory_order_release);
+			e->numDropped = 0;
+		}
+	}
+
 	profileColorRNG.Seed(spring_tomsecs(lastBigUpdate = spring_gettime()));
 
 	currentPosition = 0;
 	resortProfiles = 0;
+	numDroppedTimes = 0;
 
 	enabled = false;
 }
@@ -254,7 +313,6 @@ void CTimeProfiler::Update()
 		return;
 	}
 
-	// FIXME: non-locking threadsafe
 	std::unique_lock<spring::mutex> ulk(profileMutex, std::defer_lock);
 	while (!ulk.try_lock()) {}
 
@@ -301,6 +359,65 @@ void CTimeProfiler::UpdateRaw()
 	}
 }
 
+
+void CTimeProfiler::MergeTimes()
+{
+	std::unique_lock<spring::mutex> ulk(profileMutex, std::defer_lock);
+	while (!ulk.try_lock()) {}
+
+	MergeTimesRaw();
+}
+
+void CTimeProfiler::MergeTimesRaw()
+{
+	const spring_time t0 = spring_gettime();
+
+	// keeps new threads from adding their rings while iterating
+	std::lock_guard<spring::mutex> lock(timerEventsMutex);
+
+	for (const auto& te: timerEvents) {
+		const unsigned readIdx = te->readIdx.load(std::memory_order_relaxed);
+		const unsigned writeIdx = te->writeIdx.load(std::memory_order_acquire);
+
+		for (unsigned idx = readIdx; idx != writeIdx; idx++) {
+			const TimerEvent& e = te->events[idx % ThreadTimerEvents::NUM_EVENTS];
+
+			if (e.timerID >= mergedTimerNames.size()) {
+				std::lock_guard<spring::mutex> namesLock(timerNamesMutex);
+				mergedTimerNames.insert(mergedTimerNames.end(), timerNames.begin() + mergedTimerNames.size(), timerNames.end());
+			}
+
+			const std::string& name = mergedTimerNames[e.timerID];
+
+			if (traceFile != nullptr && e.startTime >= traceStartTime)
+				AddTraceEvent(name, e.startTime, e.endTime, te->traceThreadNum);
+
+			// only special timers are counted while disabled
+			if (!enabled && (e.flags & TIMER_EVENT_SPECIAL) == 0)
+				continue;
+
+			if ((e.flags & TIMER_EVENT_THREAD) != 0 && size_t(te->poolThreadNum) < threadProfile.size())
+				threadProfile[te->poolThreadNum].emplace_back(e.startTime, e.endTime);
+
+			AddTimeRaw(name, e.startTime, e.endTime - e.startTime, (e.flags & TIMER_EVENT_SHOW_GRAPH) != 0);
+		}
+
+		te->readIdx.store(writeIdx, std::memory_order_release);
+		numDroppedTimes += te->numDropped.exchange(0, std::memory_order_relaxed);
+	}
+
+	if (traceFile != nullptr) {
+		// marks frame boundaries on the trace timeline
+		fprintf(traceFile, "%s{\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":0,\"ts\":%.3f}", (numTraceEvents++ == 0)? "": ",\n", (t0 - traceStartTime).toNanoSecsi() * 1e-3);
+	}
+
+	if (!enabled)
+		return;
+
+	AddTimeRaw("Misc::Profiler::MergeTimes", t0, spring_gettime() - t0, false);
+}
+
+
 void CTimeProfiler::ResortProfilesRaw()
 {
 	if (resortProfiles > 0) {
@@ -353,8 +470,8 @@ void CTimeProfiler::RefreshProfilesRaw()
 
 float CTimeProfiler::GetPercent(const char* name) const
 {
-	// if disabled, only special timers can pass AddTime
-	// all of those are non-threaded, so no need to lock
+	// if disabled, only special timers are merged into the
+	// profile and only by the main thread, no need to lock
 	if (!enabled)
 		return (GetPercentRaw(name));
 
@@ -366,46 +483,42 @@ float CTimeProfiler::GetPercent(const char* name) const
 
 
 void CTimeProfiler::AddTime(
-	const std::string& name,
+	const unsigned timerID,
 	const spring_time startTime,
-	const spring_time deltaTime,
+	const spring_time endTime,
 	const bool showGraph,
 	const bool specialTimer,
 	const bool threadTimer
 ) {
-	const spring_time t0 = spring_now();
+	if (!enabled && !tracing && !specialTimer)
+		return;
 
-	if (!enabled) {
-		if (!specialTimer)
-			return;
+	ThreadTimerEvents* te = GetThreadTimerEvents();
 
-		assert(!threadTimer);
-		AddTimeRaw(name, startTime, deltaTime, showGraph, threadTimer);
-		AddTimeRaw("Misc::Profiler::AddTime", t0, spring_now() - t0, false, false);
+	const unsigned writeIdx = te->writeIdx.load(std::memory_order_relaxed);
+	const unsigned readIdx = te->readIdx.load(std::memory_order_acquire);
+
+	if ((writeIdx - readIdx) >= ThreadTimerEvents::NUM_EVENTS) {
+		te->numDropped.fetch_add(1, std::memory_order_relaxed);
 		return;
 	}
 
-	// acquire lock at the start; one inserting thread could
-	// cause a profile rehash and invalidate <pi> for another
-	std::unique_lock<spring::mutex> ulk(profileMutex, std::defer_lock);
-	while (!ulk.try_lock()) {}
+	TimerEvent& e = te->events[writeIdx % ThreadTimerEvents::NUM_EVENTS];
+
+	e.startTime = startTime;
+	e.endTime = endTime;
+	e.timerID = timerID;
+	e.flags = (TIMER_EVENT_SHOW_GRAPH * showGraph) | (TIMER_EVENT_SPECIAL * specialTimer) | (TIMER_EVENT_THREAD * threadTimer);
 
-	AddTimeRaw(name, startTime, deltaTime, showGraph, threadTimer);
-	AddTimeRaw("Misc::Profiler::AddTime", t0, spring_now() - t0, false, false);
+	te->writeIdx.store(writeIdx + 1, std::memory_order_release);
 }
 
 void CTimeProfiler::AddTimeRaw(
 	const std::string& name,
 	const spring_time startTime,
 	const spring_time deltaTime,
-	const bool showGraph,
-	const bool threadTimer
+	const bool showGraph
 ) {
-#ifdef THREADPOOL
-	if (threadTimer)
-		threadProfile[ThreadPool::GetThreadNum()].emplace_back(startTime, spring_gettime());
-#endif
-
 	auto pi = profile.find(name);
 	auto& p = (pi != profile.end())? pi->second: profile[name];
 
@@ -430,8 +543,65 @@ void CTimeProfiler::AddTimeRaw(
 	}
 }
 
+
+bool CTimeProfiler::StartTrace(const std::string& fileName)
+{
+	if (fileName.empty())
+		return false;
+
+	std::unique_lock<spring::mutex> ulk(profileMutex, std::defer_lock);
+	while (!ulk.try_lock()) {}
+
+	if (traceFile != nullptr)
+		return false;
+
+	if ((traceFile = fopen(fileName.c_str(), "w")) == nullptr) {
+		LOG_L(L_WARNING, "[TimeProfiler::%s] could not open \"%s\"", __func__, fileName.c_str());
+		return false;
+	}
+
+	fputs("{\"traceEvents\":[\n", traceFile);
+
+	traceStartTime = spring_gettime();
+	numTraceEvents = 0;
+	tracing = true;
+
+	LOG("[TimeProfiler::%s] writing trace-events to \"%s\"", __func__, fileName.c_str());
+	return true;
+}
+
+void CTimeProfiler::StopTrace()
+{
+	std::unique_lock<spring::mutex> ulk(profileMutex, std::defer_lock);
+	while (!ulk.try_lock()) {}
+
+	if (traceFile == nullptr)
+		return;
+
+	MergeTimesRaw();
+
+	fputs("\n]}\n", traceFile);
+	fclose(traceFile);
+
+	LOG("[TimeProfiler::%s] wrote %u trace-events", __func__, numTraceEvents);
+
+	traceFile = nullptr;
+	tracing = false;
+}
+
+void CTimeProfiler::AddTraceEvent(const std::string& name, const spring_time startTime, const spring_time endTime, int threadNum)
+{
+	fputs((numTraceEvents++ == 0)? "{\"name\":": ",\n{\"name\":", traceFile);
+	WriteTraceString(traceFile, name);
+	fprintf(traceFile, ",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", threadNum, (startTime - traceStartTime).toNanoSecsi() * 1e-3, (endTime - startTime).toNanoSecsi() * 1e-3);
+}
+
+
 void CTimeProfiler::PrintProfilingInfo() const
 {
+	if (numDroppedTimes > 0)
+		LOG_L(L_WARNING, "[TimeProfiler::%s] %u timer-events were dropped (merged too rarely)", __func__, numDroppedTimes);
+
 	if (sortedProfile.empty())
 		return;
 
@@ -444,4 +614,3 @@ void CTimeProfiler::PrintProfilingInfo() const
 		LOG("%35s %16.2fms %5.2f%%", name.c_str(), tr.total.toMilliSecsf(), tr.percent * 100);
 	}
 }
-
@@ -4,6 +4,7 @@
 #define TIME_PROFILER_H
 
 #include <atomic>
+#include <cstdio>
 #include <cstring> // memset
 #include <string>
 #include <deque>
@@ -24,18 +25,13 @@
 class BasicTimer : public spring::noncopyable
 {
 public:
-	BasicTimer(const spring_time time): nameHash(0), startTime(time) {}
-	BasicTimer(const std::string& timerName);
 	BasicTimer(const char* timerName);
 
-	const std::string& GetName() const { return name; }
 	spring_time GetDuration() const;
 
 protected:
-	const unsigned nameHash;
+	const unsigned timerID;
 	const spring_time startTime;
-
-	std::string name;
 };
 
 
@@ -48,7 +44,6 @@ protected:
 class ScopedTimer : public BasicTimer
 {
 public:
-	ScopedTimer(const std::string& timerName, bool _autoShowGraph = false, bool _specialTimer = false);
 	ScopedTimer(const char* timerName, bool _autoShowGraph = false, bool _specialTimer = false);
 	~ScopedTimer();
 
@@ -61,7 +56,6 @@ private:
 class ScopedMtTimer : public BasicTimer
 {
 public:
-	ScopedMtTimer(const std::string& timerName, bool _autoShowGraph = false);
 	ScopedMtTimer(const char* timerName, bool _autoShowGraph = false);
 	~ScopedMtTimer();
 
@@ -91,6 +85,19 @@ protected:
 
 
 
+/**
+ * @brief Collects the times measured by Scoped{Mt}Timer's
+ *
+ * Timers do not touch the profile when they finish; each thread appends
+ * {timer-id, start, end} events to its own lock-free ring-buffer, which
+ * are merged into the profile by the main thread once per frame (in
+ * MergeTimes). Timer names are interned into ids on first use, so the
+ * events themselves carry no strings.
+ *
+ * While a trace is running, every merged event is also written to a
+ * file in the Chrome trace-event format (viewable in chrome://tracing
+ * or ui.perfetto.dev), regardless of whether profiling is enabled.
+ */
 class CTimeProfiler
 {
 public:
@@ -99,6 +106,9 @@ public:
 
 	static CTimeProfiler& GetInstance();
 
+	/// thread-safe; <name> does not need to outlive the call
+	static unsigned GetTimerID(const char* name);
+
 	float GetPercent(const char* name) const;
 	float GetPercentRaw(const char* name) const {
 		// do not default-create keys, breaks resorting
@@ -114,6 +124,10 @@ public:
 	void Update();
 	void UpdateRaw();
 
+	/// drains the per-thread event buffers, called by the main thread each frame
+	void MergeTimes();
+	void MergeTimesRaw();
+
 	void ResortProfilesRaw();
 	void RefreshProfiles();
 	void RefreshProfilesRaw();
@@ -121,10 +135,15 @@ public:
 	void SetEnabled(bool b) { enabled = b; }
 	void PrintProfilingInfo() const;
 
+	bool StartTrace(const std::string& fileName);
+	void StopTrace();
+	bool IsTracing() const { return tracing; }
+
+	/// called by finished timers on any thread; never blocks
 	void AddTime(
-		const std::string& name,
+		const unsigned timerID,
 		const spring_time startTime,
-		const spring_time deltaTime,
+		const spring_time endTime,
 		const bool showGraph = false,
 		const bool specialTimer = false,
 		const bool threadTimer = false
@@ -133,10 +152,12 @@ public:
 		const std::string& name,
 		const spring_time startTime,
 		const spring_time deltaTime,
-		const bool showGraph,
-		const bool threadTimer
+		const bool showGraph
 	);
 
+private:
+	void AddTraceEvent(const std::string& name, const spring_time startTime, const spring_time endTime, int threadNum);
+
 public:
 	struct TimeRecord {
 		TimeRecord()
@@ -178,6 +199,14 @@ public:
 
 private:
 	spring_time lastBigUpdate;
+	spring_time traceStartTime;
+
+	// names of all ids seen by MergeTimes, owned by the main thread
+	std::vector<std::string> mergedTimerNames;
+
+	FILE* traceFile;
+	unsigned numTraceEvents;
+	unsigned numDroppedTimes;
 
 	/// increases each update, from 0 to (numFrames-1)
 	unsigned currentPosition;
@@ -185,6 +214,8 @@ private:
 
 	// if false, AddTime is a no-op for (almost) all timers
 	std::atomic<bool> enabled;
+	// if true, AddTime accepts all timers even when disabled
+	std::atomic<bool> tracing;
 };
 
 #define profiler (CTimeProfiler::GetInstance())
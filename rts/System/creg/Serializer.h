@@ -13,6 +13,8 @@
 #include <deque>
 #include <istream>
 
+#include "System/UnorderedMap.hpp"
+
 namespace creg {
 
 	/**
@@ -39,26 +41,34 @@ namespace creg {
 				id=0;
 				classIndex=0;
 				isEmbedded=false;
+				isPending=false;
 				class_=0;
+				nextRef=nullptr;
 			}
 			ObjectRef(void* ptr, int id, bool isEmbedded, Class* class_) {
 				this->ptr = ptr;
 				this->id=id;
 				classIndex=0;
 				this->isEmbedded=isEmbedded;
+				isPending=false;
 				this->class_=class_;
+				nextRef=nullptr;
 			}
 			ObjectRef(const ObjectRef&src) :memberGroups(src.memberGroups){
 				ptr=src.ptr;
 				id=src.id;
 				classIndex=src.classIndex;
 				isEmbedded=src.isEmbedded;
+				isPending=src.isPending;
 				class_=src.class_;
+				nextRef=src.nextRef;
 			}
 			void* ptr;
 			int id, classIndex;
 			bool isEmbedded;
+			bool isPending; // referenced by pointer but not yet saved
 			Class* class_;
+			ObjectRef* nextRef; // next ref sharing the same ptr (embedded objects, bases)
 			std::vector<COutputStreamSerializer::ObjectMemberGroup> memberGroups;
 			bool isThisObject(void* objPtr, Class* objClass, bool objEmbedded) const
 			{
@@ -80,8 +90,20 @@ namespace creg {
 		// Temporary class reference
 		struct ClassRef;
 
+		struct PtrHash {
+			std::size_t operator()(const void* ptr) const {
+				// objects are at least 8-byte aligned, spread the remaining bits
+				std::uint64_t x = reinterpret_cast<std::uintptr_t>(ptr) >> 3;
+				x ^= (x >> 33);
+				x *= 0xff51afd7ed558ccdull;
+				x ^= (x >> 33);
+				return x;
+			}
+		};
+
 		std::ostream* stream;
-		std::map<void*,std::vector<ObjectRef*> > ptrToId;
+		// first ref of each ptr, the others are chained via nextRef
+		spring::unsynced_map<void*, ObjectRef*, PtrHash> ptrToId;
 		std::deque<ObjectRef> objects;
 		std::vector<ObjectRef*> pendingObjects; // these objects still have to be saved
 		std::map<Class*, int> classSizes;
@@ -94,11 +116,17 @@ namespace creg {
 
 		ObjectRef* FindObjectRef(void* inst, Class* objClass, bool isEmbedded);
 
+		ObjectRef* AddObjectRef(void* inst, Class* objClass, bool isEmbedded);
+
 		void SerializeObject(Class* c, void* ptr, ObjectRef* objr);
 
 	public:
 		COutputStreamSerializer();
 
+		/// number of bytes SavePackage writes before the object data, these are
+		/// overwritten (via seekp) once everything else has been written
+		static unsigned int GetPackageHeaderSize();
+
 		/** Create a package of the given root object and all the objects that it references
 		 * @param s stream to serialize the data to
 		 * @param rootObj the rootObj: the starting point for finding all the objects to save
@@ -0,0 +1,12 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _FEATURE_H
+#define _FEATURE_H
+
+#include "Sim/Objects/SolidObject.h"
+
+class CFeature: public CSolidObject
+{
+};
+
+#endif
@@ -0,0 +1,19 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef COLLISION_VOLUME_H
+#define COLLISION_VOLUME_H
+
+#include "System/float3.h"
+
+class CSolidObject;
+
+struct CollisionVolume
+{
+	float GetBoundingRadius() const { return volumeBoundingRadius; }
+	float3 GetWorldSpacePos(const CSolidObject* o, const float3& extOffsets = ZeroVector) const;
+
+	float3 axisOffsets;
+	float volumeBoundingRadius = 0.0f;
+};
+
+#endif
@@ -0,0 +1,16 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _GLOBAL_SYNCED_H
+#define _GLOBAL_SYNCED_H
+
+class CGlobalSynced
+{
+public:
+	int GetTempNum() { return tempNum++; }
+
+	int tempNum = 1;
+};
+
+extern CGlobalSynced* gs;
+
+#endif
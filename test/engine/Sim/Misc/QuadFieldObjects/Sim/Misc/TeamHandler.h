@@ -0,0 +1,16 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef TEAMHANDLER_H
+#define TEAMHANDLER_H
+
+class CTeamHandler
+{
+public:
+	int ActiveAllyTeams() const { return numAllyTeams; }
+
+	int numAllyTeams = 1;
+};
+
+extern CTeamHandler* teamHandler;
+
+#endif
@@ -0,0 +1,32 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef SOLID_OBJECT_H
+#define SOLID_OBJECT_H
+
+#include "Sim/Misc/CollisionVolume.h"
+#include "System/float3.h"
+
+class CSolidObject
+{
+public:
+	bool HasPhysicalStateBit(unsigned int bit) const { return ((physicalState & bit) != 0); }
+	bool HasCollidableStateBit(unsigned int bit) const { return ((collidableState & bit) != 0); }
+
+	int id = 0;
+	int tempNum = 0;
+
+	float3 pos;
+	float radius = 0.0f;
+
+	unsigned int physicalState = 1;
+	unsigned int collidableState = 1;
+
+	CollisionVolume collisionVolume;
+};
+
+inline float3 CollisionVolume::GetWorldSpacePos(const CSolidObject* o, const float3& extOffsets) const
+{
+	return (o->pos + axisOffsets + extOffsets);
+}
+
+#endif
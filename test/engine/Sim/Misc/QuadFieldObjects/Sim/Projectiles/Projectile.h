@@ -0,0 +1,28 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef PROJECTILE_H
+#define PROJECTILE_H
+
+#include <vector>
+
+#include "System/float3.h"
+#include "System/float4.h"
+
+class CProjectile
+{
+public:
+	bool synced = true;
+	bool hitscan = false;
+
+	int id = 0;
+	int tempNum = 0;
+
+	float3 pos;
+	float3 dir;
+	float4 speed;
+	float radius = 0.0f;
+
+	std::vector<int> quads;
+};
+
+#endif
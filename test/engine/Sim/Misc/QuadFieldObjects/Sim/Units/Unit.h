@@ -0,0 +1,19 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef UNIT_H
+#define UNIT_H
+
+#include <vector>
+
+#include "Sim/Objects/SolidObject.h"
+
+class CUnit: public CSolidObject
+{
+public:
+	int allyteam = 0;
+
+	/// quads the unit is part of
+	std::vector<int> quads;
+};
+
+#endif
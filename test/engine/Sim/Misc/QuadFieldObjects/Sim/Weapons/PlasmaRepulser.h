@@ -0,0 +1,24 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef PLASMAREPULSER_H
+#define PLASMAREPULSER_H
+
+#include <vector>
+
+#include "Sim/Misc/CollisionVolume.h"
+#include "System/float3.h"
+
+class CPlasmaRepulser
+{
+public:
+	float GetRadius() const { return radius; }
+
+	float3 weaponMuzzlePos;
+	float radius = 0.0f;
+
+	std::vector<int> quads;
+	CollisionVolume collisionVolume;
+	int tempNum = 0;
+};
+
+#endif
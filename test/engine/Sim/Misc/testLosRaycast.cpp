@@ -0,0 +1,165 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Misc/LosRaycast.h"
+
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#define BOOST_TEST_MODULE LosRaycast
+#include <boost/test/unit_test.hpp>
+
+
+static constexpr int MAP_SIZE = 256;
+static constexpr int NUM_INSTANCES = 200;
+
+
+// same construction as CLosTableHelper::GetRay, rays to the circle surface
+static LosRaycast::LosTable GetLosRays(const int radius)
+{
+	LosRaycast::LosTable rays;
+
+	for (int a = 0; a < 2 * radius; ++a) {
+		const float angle = (a * 0.5f * 3.14159265f) / (2 * radius);
+		const int xf = int(std::round(std::cos(angle) * radius));
+		const int yf = int(std::round(std::sin(angle) * radius));
+
+		LosRaycast::LosLine ray;
+
+		if (xf > yf) {
+			for (int x = 1; x <= xf; x++) {
+				ray.emplace_back(x, int(std::round((float(yf) / xf) * x)));
+			}
+		} else {
+			for (int y = 1; y <= yf; y++) {
+				ray.emplace_back(int(std::round((float(xf) / yf) * y)), y);
+			}
+		}
+
+		rays.push_back(ray);
+	}
+
+	return rays;
+}
+
+
+struct RaycastInstance {
+	int2 pos;
+	std::vector<float> anglesMap;
+};
+
+
+static std::vector<RaycastInstance> GetInstances(const std::vector<float>& heightMap, const std::vector<float>& isqrtTable, const int radius, std::mt19937& rng, const int2 minPos, const int2 maxPos)
+{
+	std::uniform_int_distribution<int> xDist(minPos.x, maxPos.x - 1);
+	std::uniform_int_distribution<int> zDist(minPos.y, maxPos.y - 1);
+	std::vector<RaycastInstance> instances(NUM_INSTANCES);
+
+	for (RaycastInstance& ri: instances) {
+		ri.pos = int2(xDist(rng), zDist(rng));
+		ri.anglesMap.resize((2 * radius + 1) * (2 * radius + 1), -1e8f);
+
+		const float losHeight = heightMap[Clamp(ri.pos.y, 0, MAP_SIZE - 1) * MAP_SIZE + Clamp(ri.pos.x, 0, MAP_SIZE - 1)] + 20.0f;
+
+		for (int y = -radius; y <= radius; ++y) {
+			for (int x = -radius; x <= radius; ++x) {
+				const int2 p = ri.pos + int2(x, y);
+
+				if (x == 0 && y == 0)
+					continue;
+				if (p.x < 0 || p.y < 0 || p.x >= MAP_SIZE || p.y >= MAP_SIZE)
+					continue;
+
+				const float dh = std::max(0.0f, heightMap[p.y * MAP_SIZE + p.x]) - losHeight;
+				ri.anglesMap[LosRaycast::ToAngleMapIdx(int2(x, y), radius)] = (dh + LosRaycast::LOS_BONUS_HEIGHT) * isqrtTable[x * x + y * y];
+			}
+		}
+	}
+
+	return instances;
+}
+
+
+template<LosRaycast::ClipMode clipMode>
+static void TestClipMode(const char* name, const int2 minPos, const int2 maxPos)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> hDist(-20.0f, 200.0f);
+
+	std::vector<float> heightMap(MAP_SIZE * MAP_SIZE);
+
+	// smooth-ish hills
+	for (int z = 0; z < MAP_SIZE; ++z) {
+		for (int x = 0; x < MAP_SIZE; ++x) {
+			heightMap[z * MAP_SIZE + x] = 100.0f * std::sin(x * 0.07f) * std::cos(z * 0.05f) + hDist(rng) * 0.1f;
+		}
+	}
+
+	const SRectangle mapRect(0, 0, MAP_SIZE, MAP_SIZE);
+
+	for (const int radius: {8, 16, 32, 64}) {
+		std::vector<float> isqrtTable((radius + 1) * (radius + 1) + 1);
+
+		for (size_t i = 0; i < isqrtTable.size(); ++i) {
+			isqrtTable[i] = 1.0f / std::sqrt(float(std::max(i, size_t(1))));
+		}
+
+		const LosRaycast::LosTable rays = GetLosRays(radius);
+		const std::vector<RaycastInstance> instances = GetInstances(heightMap, isqrtTable, radius, rng, minPos, maxPos);
+
+		std::vector<std::vector<char>> scalarMaps(instances.size(), std::vector<char>(Square(2 * radius + 1), true));
+		std::vector<std::vector<char>> kernelMaps(instances.size(), std::vector<char>(Square(2 * radius + 1), true));
+
+		// in CLosMap the angles-map of an instance is filled right before its
+		// rays are cast, so make sure it is in cache for both kernels as well
+		const auto WarmUp = [](const std::vector<float>& anglesMap) {
+			return std::accumulate(anglesMap.begin(), anglesMap.end(), 0.0f);
+		};
+
+		float scalarTime = 0.0f;
+		float kernelTime = 0.0f;
+		float checkSum = 0.0f;
+
+		for (size_t i = 0; i < instances.size(); ++i) {
+			checkSum += WarmUp(instances[i].anglesMap);
+
+			const auto t0 = std::chrono::steady_clock::now();
+			LosRaycast::CastRaysScalar<clipMode>(rays, &scalarMaps[i][0], &instances[i].anglesMap[0], &isqrtTable[0], radius, instances[i].pos, mapRect);
+			const auto t1 = std::chrono::steady_clock::now();
+
+			checkSum += WarmUp(instances[i].anglesMap);
+
+			const auto t2 = std::chrono::steady_clock::now();
+			LosRaycast::CastRays<clipMode>(rays, &kernelMaps[i][0], &instances[i].anglesMap[0], &isqrtTable[0], radius, instances[i].pos, mapRect);
+			const auto t3 = std::chrono::steady_clock::now();
+
+			scalarTime += std::chrono::duration<float>(t1 - t0).count();
+			kernelTime += std::chrono::duration<float>(t3 - t2).count();
+		}
+
+		BOOST_TEST_MESSAGE("[" << name << "] radius=" << radius);
+		BOOST_TEST_MESSAGE("\tscalar: " << (instances.size() / scalarTime) << " instances/s");
+		BOOST_TEST_MESSAGE("\tkernel: " << (instances.size() / kernelTime) << " instances/s");
+
+		BOOST_CHECK(scalarMaps == kernelMaps);
+		BOOST_CHECK(checkSum != 0.0f);
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( LosRaycastClipNone )
+{
+	TestClipMode<LosRaycast::CLIP_NONE>("CLIP_NONE", int2(64, 64), int2(MAP_SIZE - 64, MAP_SIZE - 64));
+}
+
+BOOST_AUTO_TEST_CASE( LosRaycastClipRays )
+{
+	TestClipMode<LosRaycast::CLIP_RAYS>("CLIP_RAYS", int2(0, 0), int2(MAP_SIZE, MAP_SIZE));
+}
+
+BOOST_AUTO_TEST_CASE( LosRaycastClipSquares )
+{
+	TestClipMode<LosRaycast::CLIP_SQUARES>("CLIP_SQUARES", int2(-32, -32), int2(0, MAP_SIZE));
+}
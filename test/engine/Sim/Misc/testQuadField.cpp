@@ -1,14 +1,36 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "Sim/Misc/QuadField.h"
+#include "Sim/Misc/GlobalSynced.h"
+#include "Sim/Misc/TeamHandler.h"
+#include "Sim/Features/Feature.h"
+#include "Sim/Projectiles/Projectile.h"
+#include "Sim/Units/Unit.h"
+#include "Sim/Weapons/PlasmaRepulser.h"
 #include "System/float3.h"
 #include "System/myMath.h"
 #include <stdlib.h>
 #include <time.h>
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <vector>
+
 #define BOOST_TEST_MODULE QuadField
 #include <boost/test/unit_test.hpp>
 
+// CUnit and friends are the minimal versions from QuadFieldObjects/
+static const int NUM_ALLYTEAMS = 4;
+
+static CGlobalSynced globalSynced;
+static CTeamHandler globalTeamHandler = []() { CTeamHandler th; th.numAllyTeams = NUM_ALLYTEAMS; return th; }();
+
+CGlobalSynced* gs = &globalSynced;
+CTeamHandler* teamHandler = &globalTeamHandler;
+
+
 static inline float randf()
 {
 	return rand() / float(RAND_MAX);
@@ -101,3 +123,626 @@ BOOST_AUTO_TEST_CASE( QuadField )
 
 	BOOST_CHECK_MESSAGE(!fail, "Too less quads returned!");
 }
+
+
+
+BOOST_AUTO_TEST_CASE( QuadFieldResizePolicy )
+{
+	const int2 mapSize = int2(8192, 8192);
+	const int baseSize = CQuadField::BASE_QUAD_SIZE;
+
+	// overloaded; split down to MIN_QUAD_SIZE but not beyond
+	BOOST_CHECK(CQuadField::GetResizedQuadSize(baseSize, CQuadField::MAX_QUAD_LOAD + 1, mapSize) == baseSize / 2);
+	BOOST_CHECK(CQuadField::GetResizedQuadSize(CQuadField::MIN_QUAD_SIZE, CQuadField::MAX_QUAD_LOAD + 1, mapSize) == int(CQuadField::MIN_QUAD_SIZE));
+
+	// MAX_NUM_QUADS limits splitting on large maps
+	BOOST_CHECK(CQuadField::GetResizedQuadSize(baseSize / 2, CQuadField::MAX_QUAD_LOAD + 1, int2(16384, 16384)) == baseSize / 2);
+
+	// quad-size has to divide the map-size
+	BOOST_CHECK(CQuadField::GetResizedQuadSize(baseSize, CQuadField::MAX_QUAD_LOAD + 1, int2(8192 + 32, 8192)) == baseSize);
+
+	// hysteresis; a split's load is not low enough to grow right back
+	BOOST_CHECK(CQuadField::GetResizedQuadSize(baseSize / 2, CQuadField::MAX_QUAD_LOAD / 4, mapSize) == baseSize / 2);
+	BOOST_CHECK(CQuadField::GetResizedQuadSize(baseSize / 2, 0, mapSize) == baseSize);
+	BOOST_CHECK(CQuadField::GetResizedQuadSize(baseSize, 0, mapSize) == baseSize);
+}
+
+
+
+// a battle on a MAP_SIZE x MAP_SIZE map, most objects crammed into its center
+struct World {
+	static const int MAP_SIZE = 128;
+
+	World(int numUnits, int numFeatures, int numProjectiles, int numRepulsers, float battleSize, unsigned int seed)
+		: qf(int2(MAP_SIZE, MAP_SIZE), CQuadField::BASE_QUAD_SIZE)
+		, rng(seed)
+	{
+		quadField = &qf;
+
+		float3::maxxpos = MAP_SIZE * SQUARE_SIZE - 1;
+		float3::maxzpos = MAP_SIZE * SQUARE_SIZE - 1;
+
+		for (int i = 0; i < numUnits; i++) {
+			units.emplace_back();
+			units.back().id = i;
+			units.back().allyteam = i % NUM_ALLYTEAMS;
+			units.back().pos = RandomPos(battleSize);
+			units.back().radius = 8.0f + (rng() % 32);
+			units.back().collisionVolume.volumeBoundingRadius = units.back().radius;
+			units.back().physicalState = 1 << (rng() % 2);
+			qf.MovedUnit(&units.back());
+		}
+		for (int i = 0; i < numFeatures; i++) {
+			features.emplace_back();
+			features.back().id = i;
+			features.back().pos = RandomPos(battleSize);
+			features.back().radius = 8.0f + (rng() % 48);
+			features.back().collisionVolume.volumeBoundingRadius = features.back().radius;
+			features.back().collisionVolume.axisOffsets = float3(0.0f, features.back().radius, 0.0f);
+			qf.AddFeature(&features.back());
+		}
+		for (int i = 0; i < numProjectiles; i++) {
+			projectiles.emplace_back();
+			projectiles.back().id = i;
+			projectiles.back().pos = RandomPos(battleSize);
+			projectiles.back().radius = 1.0f + (rng() % 8);
+			projectiles.back().hitscan = ((i % 8) == 0);
+			projectiles.back().dir = float3(float(rng() % 64) - 32.0f, 0.0f, float(rng() % 64) - 32.0f).SafeNormalize();
+			projectiles.back().speed = float4(projectiles.back().dir * 8.0f, 500.0f);
+			qf.AddProjectile(&projectiles.back());
+		}
+		for (int i = 0; i < numRepulsers; i++) {
+			repulsers.emplace_back();
+			repulsers.back().weaponMuzzlePos = RandomPos(battleSize);
+			repulsers.back().radius = 100.0f + (rng() % 200);
+			repulsers.back().collisionVolume.volumeBoundingRadius = repulsers.back().radius;
+			qf.MovedRepulser(&repulsers.back());
+		}
+	}
+
+	~World() { quadField = nullptr; }
+
+	float3 RandomPos(float battleSize) {
+		std::uniform_real_distribution<float> posDist(-battleSize * 0.5f, battleSize * 0.5f);
+		return (float3(MAP_SIZE * SQUARE_SIZE * 0.5f, 0.0f, MAP_SIZE * SQUARE_SIZE * 0.5f) + float3(posDist(rng), 0.0f, posDist(rng)));
+	}
+
+	std::vector<int> GetQuads(const float3& pos, float radius) {
+		QuadFieldQuery qfQuery;
+		qf.GetQuads(qfQuery, pos, radius);
+		return *qfQuery.quads;
+	}
+
+	// what the query functions are documented to return: every object that
+	// passes <test>, in the order it is first found in the quads of <quads>
+	template<typename T, typename ListFunc, typename TestFunc>
+	std::vector<T*> Expected(const std::vector<int>& quads, const ListFunc& list, const TestFunc& test) const {
+		std::vector<T*> found;
+		std::vector<T*> expected;
+
+		for (const int qi: quads) {
+			for (T* o: list(qf.GetQuad(qi))) {
+				if (std::find(found.begin(), found.end(), o) != found.end())
+					continue;
+
+				found.push_back(o);
+
+				if (test(o))
+					expected.push_back(o);
+			}
+		}
+
+		return expected;
+	}
+
+	// same objects as a brute-force search, independent of the quads
+	template<typename T, typename TestFunc>
+	static bool SameContents(std::vector<T*> a, std::deque<T>& objects, const TestFunc& test) {
+		std::vector<T*> b;
+
+		for (T& o: objects) {
+			if (test(&o))
+				b.push_back(&o);
+		}
+
+		std::sort(a.begin(), a.end());
+		std::sort(b.begin(), b.end());
+		return (a == b);
+	}
+
+	CQuadField qf;
+	std::mt19937 rng;
+
+	std::deque<CUnit> units;
+	std::deque<CFeature> features;
+	std::deque<CProjectile> projectiles;
+	std::deque<CPlasmaRepulser> repulsers;
+};
+
+
+
+// every object is in exactly the quads its position and radius cover
+static bool CheckInsertion(World& w)
+{
+	const CQuadField& qf = w.qf;
+	bool ok = true;
+
+	for (CUnit& u: w.units) {
+		ok &= (u.quads == w.GetQuads(u.pos, u.radius));
+	}
+	for (CPlasmaRepulser& r: w.repulsers) {
+		ok &= (r.quads == w.GetQuads(r.weaponMuzzlePos, r.radius));
+	}
+	for (CProjectile& p: w.projectiles) {
+		if (p.hitscan) {
+			QuadFieldQuery qfQuery;
+			w.qf.GetQuadsOnRay(qfQuery, p.pos, p.dir, p.speed.w);
+			ok &= (p.quads == *qfQuery.quads);
+		} else {
+			ok &= (p.quads == w.GetQuads(p.pos, 0.0f));
+		}
+	}
+
+	for (int qi = 0; qi < qf.GetNumQuadsX() * qf.GetNumQuadsZ(); qi++) {
+		const CQuadField::Quad& quad = qf.GetQuad(qi);
+
+		size_t numUnits = 0;
+		size_t numFeatures = 0;
+		size_t numProjectiles = 0;
+		size_t numRepulsers = 0;
+		size_t numTeamUnits = 0;
+
+		for (CUnit& u: w.units) {
+			if (std::find(u.quads.begin(), u.quads.end(), qi) == u.quads.end())
+				continue;
+
+			numUnits += 1;
+			ok &= (std::find(quad.units.begin(), quad.units.end(), &u) != quad.units.end());
+			ok &= (std::find(quad.teamUnits[u.allyteam].begin(), quad.teamUnits[u.allyteam].end(), &u) != quad.teamUnits[u.allyteam].end());
+		}
+		for (CFeature& f: w.features) {
+			const std::vector<int> quads = w.GetQuads(f.pos, f.radius);
+
+			if (std::find(quads.begin(), quads.end(), qi) == quads.end())
+				continue;
+
+			numFeatures += 1;
+			ok &= (std::find(quad.features.begin(), quad.features.end(), &f) != quad.features.end());
+		}
+		for (CProjectile& p: w.projectiles) {
+			numProjectiles += (std::find(p.quads.begin(), p.quads.end(), qi) != p.quads.end());
+		}
+		for (CPlasmaRepulser& r: w.repulsers) {
+			numRepulsers += (std::find(r.quads.begin(), r.quads.end(), qi) != r.quads.end());
+		}
+		for (const auto& teamUnits: quad.teamUnits) {
+			numTeamUnits += teamUnits.size();
+		}
+
+		// and nothing else
+		ok &= (quad.units.size() == numUnits && numTeamUnits == numUnits);
+		ok &= (quad.features.size() == numFeatures);
+		ok &= (quad.projectiles.size() == numProjectiles);
+		ok &= (quad.repulsers.size() == numRepulsers);
+	}
+
+	return ok;
+}
+
+// each quad lists its objects in the order they were first found in <order>
+template<typename T, typename ListFunc>
+static bool CheckOrder(const CQuadField& qf, const std::vector<T*>& order, const ListFunc& list)
+{
+	bool ok = true;
+
+	for (int qi = 0; qi < qf.GetNumQuadsX() * qf.GetNumQuadsZ(); qi++) {
+		std::vector<size_t> indices;
+
+		for (T* o: list(qf.GetQuad(qi))) {
+			indices.push_back(std::find(order.begin(), order.end(), o) - order.begin());
+		}
+
+		ok &= std::is_sorted(indices.begin(), indices.end());
+	}
+
+	return ok;
+}
+
+template<typename T, typename ListFunc>
+static std::vector<T*> FirstFoundOrder(const CQuadField& qf, const ListFunc& list)
+{
+	std::vector<T*> order;
+
+	for (int qi = 0; qi < qf.GetNumQuadsX() * qf.GetNumQuadsZ(); qi++) {
+		for (T* o: list(qf.GetQuad(qi))) {
+			if (std::find(order.begin(), order.end(), o) == order.end())
+				order.push_back(o);
+		}
+	}
+
+	return order;
+}
+
+
+static const auto QuadUnits       = [](const CQuadField::Quad& q) -> const std::vector<CUnit*>& { return q.units; };
+static const auto QuadFeatures    = [](const CQuadField::Quad& q) -> const std::vector<CFeature*>& { return q.features; };
+static const auto QuadProjectiles = [](const CQuadField::Quad& q) -> const std::vector<CProjectile*>& { return q.projectiles; };
+static const auto QuadRepulsers   = [](const CQuadField::Quad& q) -> const std::vector<CPlasmaRepulser*>& { return q.repulsers; };
+
+
+
+BOOST_AUTO_TEST_CASE( QuadFieldResize )
+{
+	World w(400, 100, 200, 8, 512.0f, 1234);
+
+	BOOST_CHECK(CheckInsertion(w));
+
+	for (const int quadSize: {64, 32, 64, 128}) {
+		const std::vector<CUnit*> units = FirstFoundOrder<CUnit>(w.qf, QuadUnits);
+		const std::vector<CFeature*> features = FirstFoundOrder<CFeature>(w.qf, QuadFeatures);
+		const std::vector<CProjectile*> projectiles = FirstFoundOrder<CProjectile>(w.qf, QuadProjectiles);
+		const std::vector<CPlasmaRepulser*> repulsers = FirstFoundOrder<CPlasmaRepulser>(w.qf, QuadRepulsers);
+
+		const unsigned int unitQuadsVersion = w.qf.GetUnitQuadsVersion();
+		const unsigned int solidQuadsVersion = w.qf.GetSolidQuadsVersion();
+
+		w.qf.Resize(quadSize);
+
+		BOOST_CHECK(w.qf.GetQuadSizeX() == quadSize && w.qf.GetQuadSizeZ() == quadSize);
+		BOOST_CHECK(w.qf.GetNumQuadsX() == (World::MAP_SIZE * SQUARE_SIZE) / quadSize);
+		BOOST_CHECK(w.qf.GetUnitQuadsVersion() != unitQuadsVersion);
+		BOOST_CHECK(w.qf.GetSolidQuadsVersion() != solidQuadsVersion);
+
+		// every object was re-inserted, into the quads of the new grid
+		BOOST_CHECK(CheckInsertion(w));
+
+		// in the order it was found in the old grid, the same on every client
+		BOOST_CHECK(CheckOrder(w.qf, units, QuadUnits));
+		BOOST_CHECK(CheckOrder(w.qf, features, QuadFeatures));
+		BOOST_CHECK(CheckOrder(w.qf, projectiles, QuadProjectiles));
+		BOOST_CHECK(CheckOrder(w.qf, repulsers, QuadRepulsers));
+
+		// objects keep moving through the new grid
+		for (CUnit& u: w.units) {
+			u.pos += float3(float(w.rng() % 64) - 32.0f, 0.0f, float(w.rng() % 64) - 32.0f);
+			w.qf.MovedUnit(&u);
+		}
+		for (CProjectile& p: w.projectiles) {
+			if (p.hitscan)
+				continue;
+
+			p.pos += float3(float(w.rng() % 64) - 32.0f, 0.0f, float(w.rng() % 64) - 32.0f);
+			w.qf.MovedProjectile(&p);
+		}
+
+		BOOST_CHECK(CheckInsertion(w));
+	}
+
+	// removals leave no stale entries behind in the resized grid
+	for (CUnit& u: w.units) {
+		w.qf.RemoveUnit(&u);
+	}
+	for (CFeature& f: w.features) {
+		w.qf.RemoveFeature(&f);
+	}
+	for (CProjectile& p: w.projectiles) {
+		w.qf.RemoveProjectile(&p);
+	}
+	for (CPlasmaRepulser& r: w.repulsers) {
+		w.qf.RemoveRepulser(&r);
+	}
+
+	w.units.clear();
+	w.features.clear();
+	w.projectiles.clear();
+	w.repulsers.clear();
+
+	BOOST_CHECK(CheckInsertion(w));
+}
+
+
+
+BOOST_AUTO_TEST_CASE( QuadFieldQueries )
+{
+	static const int NUM_QUERIES = 200;
+
+	World w(400, 100, 200, 8, 768.0f, 5678);
+
+	std::vector<std::pair<float3, float>> queries;
+
+	for (int n = 0; n < NUM_QUERIES; n++) {
+		queries.emplace_back(w.RandomPos(1024.0f) + float3(0.0f, float(w.rng() % 64), 0.0f), float(w.rng() % 250));
+	}
+
+	for (const int quadSize: {128, 64, 32}) {
+		w.qf.Resize(quadSize);
+
+		bool sameContents = true;
+		bool sameOrder = true;
+
+		for (const auto& query: queries) {
+			const float3& pos = query.first;
+			const float radius = query.second;
+
+			const float3 mins = pos - radius;
+			const float3 maxs = pos + radius;
+
+			const std::vector<int> quads = w.GetQuads(pos, radius);
+			std::vector<int> rectQuads;
+
+			{
+				QuadFieldQuery qfQuery;
+				w.qf.GetQuadsRectangle(qfQuery, mins, maxs);
+				rectQuads = *qfQuery.quads;
+			}
+
+			const auto InRadius = [&](const CSolidObject* o) { return (pos.SqDistance(o->pos) < Square(radius + o->radius)); };
+			const auto InCylinder = [&](const CSolidObject* o) { return (pos.SqDistance2D(o->pos) < Square(radius + o->radius)); };
+			const auto InRect = [&](const float3& p) { return (p.x >= mins.x && p.x <= maxs.x && p.z >= mins.z && p.z <= maxs.z); };
+			const auto InColVol = [&](const CSolidObject* o) { return (pos.SqDistance(o->collisionVolume.GetWorldSpacePos(o)) < Square(radius + o->collisionVolume.GetBoundingRadius())); };
+
+			{
+				QuadFieldQuery qfQuery;
+				w.qf.GetUnitsExact(qfQuery, pos, radius, true);
+				sameContents &= World::SameContents(*qfQuery.units, w.units, InRadius);
+				sameOrder &= (*qfQuery.units == w.Expected<CUnit>(quads, QuadUnits, InRadius));
+			}
+			{
+				QuadFieldQuery qfQuery;
+				w.qf.GetUnitsExact(qfQuery, pos, radius, false);
+				sameContents &= World::SameContents(*qfQuery.units, w.units, InCylinder);
+				sameOrder &= (*qfQuery.units == w.Expected<CUnit>(quads, QuadUnits, InCylinder));
+			}
+			{
+				const auto InRectU = [&](const CUnit* u) { return InRect(u->pos); };
+
+				QuadFieldQuery qfQuery;
+				w.qf.GetUnitsExact(qfQuery, mins, maxs);
+				sameContents &= World::SameContents(*qfQuery.units, w.units, InRectU);
+				sameOrder &= (*qfQuery.units == w.Expected<CUnit>(rectQuads, QuadUnits, InRectU));
+			}
+			{
+				QuadFieldQuery qfQuery;
+				w.qf.GetFeaturesExact(qfQuery, pos, radius, true);
+				sameContents &= World::SameContents(*qfQuery.features, w.features, InRadius);
+				sameOrder &= (*qfQuery.features == w.Expected<CFeature>(quads, QuadFeatures, InRadius));
+			}
+			{
+				const auto InRadiusP = [&](const CProjectile* p) { return (pos.SqDistance(p->pos) < Square(radius + p->radius)); };
+
+				// hit-scan projectiles are only inserted along their ray
+				const auto InRadiusPS = [&](const CProjectile* p) { return (!p->hitscan && InRadiusP(p)); };
+
+				QuadFieldQuery qfQuery;
+				w.qf.GetProjectilesExact(qfQuery, pos, radius);
+
+				std::vector<CProjectile*> nonHitScan;
+				for (CProjectile* p: *qfQuery.projectiles) {
+					if (!p->hitscan)
+						nonHitScan.push_back(p);
+				}
+
+				sameContents &= World::SameContents(nonHitScan, w.projectiles, InRadiusPS);
+				sameOrder &= (*qfQuery.projectiles == w.Expected<CProjectile>(quads, QuadProjectiles, InRadiusP));
+			}
+			{
+				// units before features per quad
+				const auto IsSolid = [&](const CSolidObject* o) { return (o->HasPhysicalStateBit(1) && InRadius(o)); };
+
+				std::vector<CSolidObject*> expected;
+
+				for (const int qi: quads) {
+					for (CUnit* u: w.Expected<CUnit>({qi}, QuadUnits, IsSolid)) {
+						if (std::find(expected.begin(), expected.end(), u) == expected.end())
+							expected.push_back(u);
+					}
+					for (CFeature* f: w.Expected<CFeature>({qi}, QuadFeatures, IsSolid)) {
+						if (std::find(expected.begin(), expected.end(), f) == expected.end())
+							expected.push_back(f);
+					}
+				}
+
+				QuadFieldQuery qfQuery;
+				w.qf.GetSolidsExact(qfQuery, pos, radius, 1);
+				sameOrder &= (*qfQuery.solids == expected);
+				sameContents &= (w.qf.NoSolidsExact(pos, radius, 1) == expected.empty());
+			}
+			{
+				std::vector<CUnit*> units;
+				std::vector<CFeature*> features;
+				std::vector<CPlasmaRepulser*> repulsers;
+
+				const auto InShield = [&](const CPlasmaRepulser* r) { return (pos.SqDistance(r->weaponMuzzlePos) < Square(radius + r->collisionVolume.GetBoundingRadius())); };
+
+				w.qf.GetUnitsAndFeaturesColVol(pos, radius, units, features, &repulsers);
+				sameContents &= World::SameContents(units, w.units, InColVol);
+				sameContents &= World::SameContents(features, w.features, InColVol);
+				sameContents &= World::SameContents(repulsers, w.repulsers, InShield);
+				sameOrder &= (units == w.Expected<CUnit>(quads, QuadUnits, InColVol));
+				sameOrder &= (features == w.Expected<CFeature>(quads, QuadFeatures, InColVol));
+				sameOrder &= (repulsers == w.Expected<CPlasmaRepulser>(quads, QuadRepulsers, InShield));
+			}
+		}
+
+		// the quad-size changes the order, but never what is found
+		BOOST_CHECK_MESSAGE(sameContents, "quadSize=" << quadSize);
+		BOOST_CHECK_MESSAGE(sameOrder, "quadSize=" << quadSize);
+	}
+}
+
+
+
+BOOST_AUTO_TEST_CASE( QuadFieldDensity )
+{
+	// all units crammed into one battle-area; the small
+	// radius is typical for collision-tests, the large for targeting
+	static const int NUM_QUERIES = 5000;
+	static const float BATTLE_SIZE = 768.0f;
+
+	for (const float queryRadius: {32.0f, 250.0f}) {
+		for (const int numUnits: {1000, 4000, 16000}) {
+			World w(numUnits, 0, 0, 0, BATTLE_SIZE, numUnits);
+
+			std::vector<float3> queries(NUM_QUERIES);
+			std::vector< std::vector<CUnit*> > baseResults(NUM_QUERIES);
+
+			for (float3& p: queries) {
+				p = w.RandomPos(BATTLE_SIZE);
+			}
+
+			BOOST_TEST_MESSAGE("[QuadFieldDensity] units=" << numUnits << " radius=" << queryRadius);
+
+			for (const int quadSize: {int(CQuadField::BASE_QUAD_SIZE), int(CQuadField::BASE_QUAD_SIZE) / 2, int(CQuadField::MIN_QUAD_SIZE)}) {
+				w.qf.Resize(quadSize);
+
+				size_t maxQuadLoad = 0;
+
+				for (int qi = 0; qi < w.qf.GetNumQuadsX() * w.qf.GetNumQuadsZ(); qi++) {
+					maxQuadLoad = std::max(maxQuadLoad, w.qf.GetQuad(qi).units.size());
+				}
+
+				std::vector< std::vector<CUnit*> > results(NUM_QUERIES);
+
+				const auto t0 = std::chrono::steady_clock::now();
+
+				for (int n = 0; n < NUM_QUERIES; ++n) {
+					QuadFieldQuery qfQuery;
+					w.qf.GetUnitsExact(qfQuery, queries[n], queryRadius);
+					results[n] = *qfQuery.units;
+				}
+
+				const auto t1 = std::chrono::steady_clock::now();
+				const float queryTime = std::chrono::duration<float, std::micro>(t1 - t0).count() / NUM_QUERIES;
+
+				BOOST_TEST_MESSAGE("\tquadSize=" << quadSize << " maxQuadLoad=" << maxQuadLoad << " time/query=" << queryTime << "us");
+
+				// every quad-size has to find exactly the same units
+				for (std::vector<CUnit*>& r: results) {
+					std::sort(r.begin(), r.end());
+				}
+
+				if (quadSize == int(CQuadField::BASE_QUAD_SIZE)) {
+					baseResults = results;
+				} else {
+					BOOST_CHECK(results == baseResults);
+				}
+			}
+		}
+	}
+}
+
+
+
+BOOST_AUTO_TEST_CASE( QuadFieldCollisionCandidates )
+{
+	// CProjectileHandler::CheckUnitFeatureCollisions: the candidates of a
+	// batch of projectiles are gathered up front, then every projectile is
+	// tested in turn and one in IMPACT_RATE impacts, which can move or kill what
+	// it hit; afterwards each projectile has to see exactly what a fresh
+	// GetUnitsAndFeaturesColVol at its turn would return
+	static const int NUM_PROJECTILES = 2000;
+	static const int IMPACT_RATE = 4;
+	static const int BATCH_SIZE = 256;
+
+	World w(2000, 200, 0, 8, 1024.0f, 4321);
+
+	struct Candidates {
+		std::vector<int> quads;
+		std::vector<CUnit*> units;
+		std::vector<CFeature*> features;
+		std::vector<CPlasmaRepulser*> repulsers;
+		unsigned int version;
+	};
+
+	std::vector<std::pair<float3, float>> projectiles;
+	std::vector<Candidates> candidates(NUM_PROJECTILES);
+
+	for (int n = 0; n < NUM_PROJECTILES; n++) {
+		projectiles.emplace_back(w.RandomPos(1024.0f) + float3(0.0f, float(w.rng() % 32), 0.0f), 1.0f + float(w.rng() % 48));
+	}
+
+	size_t numQueries = 0;
+	size_t numBatchQueries = 0;
+	size_t numImpacts = 0;
+	size_t numCandidates = 0;
+
+	bool sameOrder = true;
+
+	for (int n = 0; n < NUM_PROJECTILES; n++) {
+		const float3& pos = projectiles[n].first;
+		const float radius = projectiles[n].second;
+
+		Candidates& c = candidates[n];
+
+		// runs in parallel in CProjectileHandler
+		if ((n % BATCH_SIZE) == 0) {
+			for (int k = n; k < std::min(n + BATCH_SIZE, NUM_PROJECTILES); k++) {
+				candidates[k].version = w.qf.GetSolidQuadsVersion();
+				w.qf.GetUnitsAndFeaturesInQuads(projectiles[k].first, projectiles[k].second, candidates[k].quads, candidates[k].units, candidates[k].features, candidates[k].repulsers);
+			}
+		}
+
+		if (w.qf.SolidQuadsChangedSince(c.quads, c.version)) {
+			c = Candidates();
+			c.version = w.qf.GetSolidQuadsVersion();
+			w.qf.GetUnitsAndFeaturesInQuads(pos, radius, c.quads, c.units, c.features, c.repulsers);
+			numQueries += 1;
+		}
+
+		CQuadField::FilterUnitsAndFeaturesColVol(pos, radius, c.units, c.features, c.repulsers);
+
+		std::vector<CUnit*> units;
+		std::vector<CFeature*> features;
+		std::vector<CPlasmaRepulser*> repulsers;
+
+		w.qf.GetUnitsAndFeaturesColVol(pos, radius, units, features, &repulsers);
+
+		// a projectile that does not see what was moved into its quads
+		// (or still sees what was killed) would hit or miss differently
+		sameOrder &= (c.units == units && c.features == features && c.repulsers == repulsers);
+
+		numCandidates += c.units.size();
+
+		if (c.units.empty() || (w.rng() % IMPACT_RATE) != 0)
+			continue;
+
+		// dropping the rest of the batch after every impact instead
+		numImpacts += 1;
+		numBatchQueries += std::min(BATCH_SIZE, NUM_PROJECTILES - n - 1);
+
+		CUnit* u = c.units[w.rng() % c.units.size()];
+
+		switch (w.rng() % 20) {
+			case 0: case 1: case 2: case 3: case 4: {
+				// pushed back a little, usually without changing quads
+				u->pos += float3(float(w.rng() % 9) - 4.0f, 0.0f, float(w.rng() % 9) - 4.0f);
+				w.qf.MovedUnit(u);
+			} break;
+			case 5: case 6: {
+				// Lua gives it a bigger collision-volume
+				u->collisionVolume.volumeBoundingRadius *= 2.0f;
+			} break;
+			case 7: case 8: {
+				// killed
+				w.qf.RemoveUnit(u);
+			} break;
+			case 9: {
+				// thrown far away
+				u->pos = w.RandomPos(1024.0f);
+				w.qf.MovedUnit(u);
+			} break;
+			default: {
+				// only damaged
+			} break;
+		}
+	}
+
+	BOOST_TEST_MESSAGE("[QuadFieldCollisionCandidates] projectiles=" << NUM_PROJECTILES << " impacts=" << numImpacts << " candidates/projectile=" << (numCandidates / NUM_PROJECTILES));
+	BOOST_TEST_MESSAGE("\tserial queries: per-projectile=" << NUM_PROJECTILES << " changed quads only=" << numQueries << " (batch dropped per impact: " << numBatchQueries << " parallel)");
+
+	BOOST_CHECK(sameOrder);
+
+	// never more than the serial path, which queries every projectile once
+	BOOST_CHECK(numQueries < size_t(NUM_PROJECTILES));
+	BOOST_CHECK(numImpacts > 0);
+}
@@ -0,0 +1,226 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Path/Default/PathEstimatorCacheFile.h"
+#include "System/FileSystem/MemoryMappedFile.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <zlib.h>
+
+#define BOOST_TEST_MODULE PathEstimatorCache
+#include <boost/test/unit_test.hpp>
+
+
+// roughly the PE16 dataset of a 32x32 map with a typical number of movedefs
+static constexpr unsigned int BLOCK_SIZE = 16;
+static constexpr unsigned int NUM_BLOCKS = (2048 / BLOCK_SIZE) * (2048 / BLOCK_SIZE);
+static constexpr unsigned int NUM_PATH_TYPES = 24;
+static constexpr unsigned int NUM_VERTEX_COSTS = NUM_PATH_TYPES * NUM_BLOCKS * 4;
+static constexpr unsigned int NUM_LOADS = 5;
+static constexpr std::uint32_t DATA_HASH = 0x12345678;
+
+static const char* ZIP_FILE_NAME = "testPathEstimatorCache.gz";
+static const char* BIN_FILE_NAME = "testPathEstimatorCache.bin";
+
+
+struct CacheData {
+	CacheData(): offsets(NUM_PATH_TYPES * NUM_BLOCKS * 2), costs(NUM_VERTEX_COSTS) {}
+
+	void Generate() {
+		std::mt19937 rng(NUM_BLOCKS);
+		std::uniform_int_distribution<int> offsetDist(0, BLOCK_SIZE - 1);
+		std::uniform_real_distribution<float> costDist(BLOCK_SIZE * 0.5f, BLOCK_SIZE * 4.0f);
+
+		for (auto& o: offsets)
+			o = offsetDist(rng);
+
+		// impassable terrain shows up as runs of infinite costs
+		for (unsigned int i = 0; i < costs.size(); i++)
+			costs[i] = ((i / 512) % 7 == 0)? std::numeric_limits<float>::infinity(): costDist(rng);
+	}
+
+	PECacheFile::Header GetHeader() const {
+		return (PECacheFile::MakeHeader(DATA_HASH, BLOCK_SIZE, NUM_PATH_TYPES, NUM_BLOCKS, NUM_VERTEX_COSTS));
+	}
+
+	std::vector<std::int16_t> offsets;
+	std::vector<float> costs;
+};
+
+
+// same layout and compression level as PE::WriteZipFile, minus the archive directory
+static void WriteZipFile(const CacheData& data) {
+	gzFile file = gzopen(ZIP_FILE_NAME, "wb9");
+
+	gzwrite(file, &DATA_HASH, sizeof(DATA_HASH));
+	gzwrite(file, data.offsets.data(), data.offsets.size() * sizeof(std::int16_t));
+	gzwrite(file, data.costs.data(), data.costs.size() * sizeof(float));
+	gzclose(file);
+}
+
+static bool ReadZipFile(CacheData& data) {
+	gzFile file = gzopen(ZIP_FILE_NAME, "rb");
+
+	if (file == nullptr)
+		return false;
+
+	// PE::ReadZipFile inflates the whole entry into a buffer, then copies out
+	std::vector<std::uint8_t> buffer(sizeof(DATA_HASH) + data.offsets.size() * sizeof(std::int16_t) + data.costs.size() * sizeof(float));
+
+	const int numBytes = gzread(file, buffer.data(), buffer.size());
+	gzclose(file);
+
+	if (numBytes != int(buffer.size()))
+		return false;
+
+	std::memcpy(data.offsets.data(), &buffer[sizeof(DATA_HASH)], data.offsets.size() * sizeof(std::int16_t));
+	std::memcpy(data.costs.data(), &buffer[sizeof(DATA_HASH) + data.offsets.size() * sizeof(std::int16_t)], data.costs.size() * sizeof(float));
+	return true;
+}
+
+
+static void WriteFlatFile(const CacheData& data) {
+	PECacheFile::Header header = data.GetHeader();
+	header.dataChecksum = PECacheFile::CalcChecksum(header, reinterpret_cast<const std::uint8_t*>(data.offsets.data()), reinterpret_cast<const std::uint8_t*>(data.costs.data()));
+
+	std::ofstream file(BIN_FILE_NAME, std::ios::out | std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(data.offsets.data()), data.offsets.size() * sizeof(std::int16_t));
+	file.write(reinterpret_cast<const char*>(data.costs.data()), data.costs.size() * sizeof(float));
+}
+
+static bool ReadFlatFile(CacheData& data) {
+	const CMemoryMappedFile file(BIN_FILE_NAME);
+	const PECacheFile::Header header = data.GetHeader();
+
+	if (!PECacheFile::IsValid(file.GetData(), file.GetSize(), header))
+		return false;
+
+	const std::uint8_t* offsets = file.GetData() + sizeof(PECacheFile::Header);
+	const std::uint8_t* costs = offsets + PECacheFile::GetOffsetsSize(header);
+
+	std::memcpy(data.offsets.data(), offsets, PECacheFile::GetOffsetsSize(header));
+	std::memcpy(data.costs.data(), costs, PECacheFile::GetCostsSize(header));
+	return true;
+}
+
+
+static void CorruptFlatFile(std::uint64_t pos, std::uint64_t size) {
+	std::vector<char> bytes(size);
+
+	{
+		std::ifstream file(BIN_FILE_NAME, std::ios::in | std::ios::binary);
+		file.read(bytes.data(), size);
+	}
+
+	if (pos < size)
+		bytes[pos] ^= 0x40;
+
+	std::ofstream file(BIN_FILE_NAME, std::ios::out | std::ios::binary | std::ios::trunc);
+	file.write(bytes.data(), size);
+}
+
+
+
+BOOST_AUTO_TEST_CASE(FlatFileRoundTrip)
+{
+	CacheData srcData;
+	CacheData dstData;
+
+	srcData.Generate();
+	WriteFlatFile(srcData);
+
+	BOOST_CHECK(ReadFlatFile(dstData));
+	BOOST_CHECK(dstData.offsets == srcData.offsets);
+	BOOST_CHECK(std::memcmp(dstData.costs.data(), srcData.costs.data(), srcData.costs.size() * sizeof(float)) == 0);
+
+	std::remove(BIN_FILE_NAME);
+}
+
+BOOST_AUTO_TEST_CASE(FlatFileValidation)
+{
+	CacheData srcData;
+	CacheData dstData;
+
+	srcData.Generate();
+
+	const std::uint64_t fileSize = PECacheFile::GetFileSize(srcData.GetHeader());
+
+	// flipped payload byte
+	WriteFlatFile(srcData);
+	CorruptFlatFile(fileSize / 2, fileSize);
+	BOOST_CHECK(!ReadFlatFile(dstData));
+
+	// flipped header byte (version)
+	WriteFlatFile(srcData);
+	CorruptFlatFile(8, fileSize);
+	BOOST_CHECK(!ReadFlatFile(dstData));
+
+	// truncated write
+	WriteFlatFile(srcData);
+	CorruptFlatFile(fileSize, fileSize - 4);
+	BOOST_CHECK(!ReadFlatFile(dstData));
+
+	// stale dataset
+	WriteFlatFile(srcData);
+	{
+		const CMemoryMappedFile file(BIN_FILE_NAME);
+		PECacheFile::Header header = srcData.GetHeader();
+		header.dataHash += 1;
+		BOOST_CHECK(!PECacheFile::IsValid(file.GetData(), file.GetSize(), header));
+	}
+
+	std::remove(BIN_FILE_NAME);
+}
+
+BOOST_AUTO_TEST_CASE(ZipVsFlatLoadTimes)
+{
+	CacheData srcData;
+	CacheData dstData;
+
+	srcData.Generate();
+
+	WriteZipFile(srcData);
+	WriteFlatFile(srcData);
+
+	bool zipLoaded = true;
+	bool binLoaded = true;
+
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	for (unsigned int n = 0; n < NUM_LOADS; n++)
+		zipLoaded &= ReadZipFile(dstData);
+
+	const auto t1 = std::chrono::high_resolution_clock::now();
+
+	for (unsigned int n = 0; n < NUM_LOADS; n++)
+		binLoaded &= ReadFlatFile(dstData);
+
+	const auto t2 = std::chrono::high_resolution_clock::now();
+
+	BOOST_CHECK(zipLoaded);
+	BOOST_CHECK(binLoaded);
+	BOOST_CHECK(std::memcmp(dstData.costs.data(), srcData.costs.data(), srcData.costs.size() * sizeof(float)) == 0);
+
+	const float zipMillis = std::chrono::duration<float, std::milli>(t1 - t0).count() / NUM_LOADS;
+	const float binMillis = std::chrono::duration<float, std::milli>(t2 - t1).count() / NUM_LOADS;
+
+	std::ifstream zipFile(ZIP_FILE_NAME, std::ios::in | std::ios::binary | std::ios::ate);
+	std::ifstream binFile(BIN_FILE_NAME, std::ios::in | std::ios::binary | std::ios::ate);
+
+	BOOST_TEST_MESSAGE("path-types: " << NUM_PATH_TYPES << ", blocks: " << NUM_BLOCKS << ", vertex-costs: " << NUM_VERTEX_COSTS);
+	BOOST_TEST_MESSAGE("zip:  " << zipMillis << " ms/load, " << (int(zipFile.tellg()) >> 10) << " KB");
+	BOOST_TEST_MESSAGE("flat: " << binMillis << " ms/load, " << (int(binFile.tellg()) >> 10) << " KB");
+
+	// warm-cache loads should never be slower than inflating
+	BOOST_CHECK(binMillis < zipMillis);
+
+	std::remove(ZIP_FILE_NAME);
+	std::remove(BIN_FILE_NAME);
+}
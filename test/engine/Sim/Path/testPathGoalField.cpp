@@ -0,0 +1,331 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Path/Default/PathGoalField.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <queue>
+#include <random>
+#include <vector>
+
+#define BOOST_TEST_MODULE PathGoalField
+#include <boost/test/unit_test.hpp>
+
+
+// PathGoalField is tested on its own, on a random block-graph (setting up
+// a CPathEstimator requires a loaded map and move-defs)
+static constexpr int NUM_BLOCKS = 256;
+static constexpr int NUM_REQUESTS = 200;
+static constexpr int GOAL_RADIUS = 2;
+
+// same layout as IPathFinder::PE_DIRECTION_VECTORS
+static const int2 DIRECTION_VECTORS[PATH_DIRECTIONS] = {
+	int2(+1,  0),
+	int2(+1, +1),
+	int2( 0, +1),
+	int2(-1, +1),
+	int2(-1,  0),
+	int2(-1, -1),
+	int2( 0, -1),
+	int2(+1, -1),
+};
+
+
+struct BlockGraph {
+	BlockGraph(std::mt19937& rng) {
+		std::uniform_real_distribution<float> costDist(1.0f, 4.0f);
+		std::uniform_int_distribution<int> blockDist(0, 15);
+
+		blockCosts.resize(NUM_BLOCKS * NUM_BLOCKS);
+
+		// impassable blocks (e.g. cliffs) have infinite cost
+		for (float& c: blockCosts) {
+			c = (blockDist(rng) == 0)? PATHCOST_INFINITY: costDist(rng);
+		}
+	}
+
+	// symmetric like the estimator's vertex-costs
+	float EdgeCost(unsigned int prevIdx, unsigned int pathDir, unsigned int nextIdx) const {
+		const float dirCost = ((pathDir & 1) != 0)? 1.41421356f: 1.0f;
+		return ((blockCosts[prevIdx] + blockCosts[nextIdx]) * 0.5f * dirCost);
+	}
+
+	bool IsGoal(const int2 blockPos) const {
+		return (std::abs(blockPos.x - goalPos.x) <= GOAL_RADIUS && std::abs(blockPos.y - goalPos.y) <= GOAL_RADIUS && blockCosts[blockPos.y * NUM_BLOCKS + blockPos.x] < PATHCOST_INFINITY);
+	}
+
+	std::vector<float> blockCosts;
+	int2 goalPos;
+};
+
+
+// reference forward A* search from a single start-block
+static float SearchPath(const BlockGraph& graph, const int2 startPos, std::vector<float>& gCosts, std::vector<unsigned int>& dirtyBlocks)
+{
+	typedef std::pair<float, unsigned int> OpenBlock;
+
+	std::priority_queue<OpenBlock, std::vector<OpenBlock>, std::greater<OpenBlock>> openBlocks;
+
+	// octile-distance times the minimum block-cost, admissible
+	const auto Heuristic = [&](const int2 p) {
+		const int dx = std::abs(p.x - graph.goalPos.x) - GOAL_RADIUS;
+		const int dz = std::abs(p.y - graph.goalPos.y) - GOAL_RADIUS;
+		const int mn = std::max(0, std::min(dx, dz));
+		const int mx = std::max(0, std::max(dx, dz));
+		return ((mx - mn) + mn * 1.41421356f);
+	};
+
+	for (const unsigned int idx: dirtyBlocks) {
+		gCosts[idx] = PATHCOST_INFINITY;
+	}
+
+	dirtyBlocks.clear();
+
+	const unsigned int startIdx = startPos.y * NUM_BLOCKS + startPos.x;
+
+	gCosts[startIdx] = 0.0f;
+	dirtyBlocks.push_back(startIdx);
+	openBlocks.emplace(Heuristic(startPos), startIdx);
+
+	while (!openBlocks.empty()) {
+		const OpenBlock ob = openBlocks.top();
+		openBlocks.pop();
+
+		const int2 blockPos = int2(ob.second % NUM_BLOCKS, ob.second / NUM_BLOCKS);
+		const float gCost = gCosts[ob.second];
+
+		if (ob.first > (gCost + Heuristic(blockPos)))
+			continue;
+
+		if (graph.IsGoal(blockPos))
+			return gCost;
+
+		for (unsigned int pathDir = 0; pathDir < PATH_DIRECTIONS; pathDir++) {
+			const int2 nextPos = blockPos + DIRECTION_VECTORS[pathDir];
+
+			if (static_cast<unsigned int>(nextPos.x) >= NUM_BLOCKS || static_cast<unsigned int>(nextPos.y) >= NUM_BLOCKS)
+				continue;
+
+			const unsigned int nextIdx = nextPos.y * NUM_BLOCKS + nextPos.x;
+			const float nextCost = gCost + graph.EdgeCost(ob.second, pathDir, nextIdx);
+
+			if (nextCost >= gCosts[nextIdx])
+				continue;
+
+			if (gCosts[nextIdx] == PATHCOST_INFINITY)
+				dirtyBlocks.push_back(nextIdx);
+
+			gCosts[nextIdx] = nextCost;
+			openBlocks.emplace(nextCost + Heuristic(nextPos), nextIdx);
+		}
+	}
+
+	return PATHCOST_INFINITY;
+}
+
+
+static PathGoalField InitField(const BlockGraph& graph)
+{
+	PathGoalField field;
+	field.Init(int2(NUM_BLOCKS, NUM_BLOCKS), &DIRECTION_VECTORS[0]);
+
+	for (int z = graph.goalPos.y - GOAL_RADIUS; z <= graph.goalPos.y + GOAL_RADIUS; z++) {
+		for (int x = graph.goalPos.x - GOAL_RADIUS; x <= graph.goalPos.x + GOAL_RADIUS; x++) {
+			if (graph.IsGoal(int2(x, z)))
+				field.AddGoalBlock(z * NUM_BLOCKS + x);
+		}
+	}
+
+	return field;
+}
+
+
+BOOST_AUTO_TEST_CASE( PathGoalFieldOptimalPaths )
+{
+	std::mt19937 rng(1234);
+
+	BlockGraph graph(rng);
+	graph.goalPos = int2(NUM_BLOCKS * 3 / 4, NUM_BLOCKS * 3 / 4);
+
+	// a group of units ordered across the map, in some random order
+	std::uniform_int_distribution<int> startDist(NUM_BLOCKS / 8, NUM_BLOCKS / 4);
+	std::vector<int2> startPositions;
+
+	while (startPositions.size() < NUM_REQUESTS) {
+		const int2 startPos = int2(startDist(rng), startDist(rng));
+
+		if (graph.blockCosts[startPos.y * NUM_BLOCKS + startPos.x] < PATHCOST_INFINITY)
+			startPositions.push_back(startPos);
+	}
+
+	std::vector<float> searchCosts(NUM_REQUESTS);
+	std::vector<float> fieldCosts(NUM_REQUESTS);
+	std::vector<std::vector<unsigned int>> fieldPaths(NUM_REQUESTS);
+
+	std::vector<float> gCosts(NUM_BLOCKS * NUM_BLOCKS, PATHCOST_INFINITY);
+	std::vector<unsigned int> dirtyBlocks;
+
+	const auto EdgeCost = [&](unsigned int prevIdx, unsigned int pathDir, unsigned int nextIdx) {
+		return (graph.EdgeCost(prevIdx, pathDir, nextIdx));
+	};
+
+	// #1: one search per request
+	for (int i = 0; i < NUM_REQUESTS; i++) {
+		searchCosts[i] = SearchPath(graph, startPositions[i], gCosts, dirtyBlocks);
+	}
+
+	// #2: one field shared by all requests
+	{
+		PathGoalField field = InitField(graph);
+
+		for (int i = 0; i < NUM_REQUESTS; i++) {
+			const unsigned int startIdx = startPositions[i].y * NUM_BLOCKS + startPositions[i].x;
+
+			if (!field.Expand(startIdx, EdgeCost)) {
+				fieldCosts[i] = PATHCOST_INFINITY;
+				continue;
+			}
+
+			field.GetPathBlocks(startIdx, fieldPaths[i]);
+			fieldCosts[i] = field.GetBlockCost(startIdx);
+		}
+	}
+
+	for (int i = 0; i < NUM_REQUESTS; i++) {
+		// both searches are optimal, so costs must agree (up to summation order)
+		BOOST_CHECK_CLOSE(searchCosts[i], fieldCosts[i], 0.01f);
+
+		if (fieldCosts[i] == PATHCOST_INFINITY)
+			continue;
+
+		// path must be connected, end in a goal-block and add up to the field's cost
+		float pathCost = 0.0f;
+
+		for (size_t n = 1; n < fieldPaths[i].size(); n++) {
+			const unsigned int prevIdx = fieldPaths[i][n - 1];
+			const unsigned int nextIdx = fieldPaths[i][n    ];
+			const int2 step = int2(nextIdx % NUM_BLOCKS, nextIdx / NUM_BLOCKS) - int2(prevIdx % NUM_BLOCKS, prevIdx / NUM_BLOCKS);
+			const unsigned int pathDir = std::find(&DIRECTION_VECTORS[0], &DIRECTION_VECTORS[PATH_DIRECTIONS], step) - &DIRECTION_VECTORS[0];
+
+			BOOST_CHECK(pathDir < PATH_DIRECTIONS);
+			pathCost += graph.EdgeCost(prevIdx, pathDir, nextIdx);
+		}
+
+		BOOST_CHECK_CLOSE(pathCost, fieldCosts[i], 0.01f);
+		BOOST_CHECK(graph.IsGoal(int2(fieldPaths[i].back() % NUM_BLOCKS, fieldPaths[i].back() / NUM_BLOCKS)));
+	}
+}
+
+BOOST_AUTO_TEST_CASE( PathGoalFieldGroupRequests )
+{
+	std::mt19937 rng(4321);
+
+	BlockGraph graph(rng);
+	graph.goalPos = int2(NUM_BLOCKS * 3 / 4, NUM_BLOCKS * 3 / 4);
+
+	// a group of units ordered across the map at once
+	std::uniform_int_distribution<int> startDist(NUM_BLOCKS / 8, NUM_BLOCKS / 4);
+	std::vector<unsigned int> startBlocks(NUM_REQUESTS);
+
+	for (unsigned int& idx: startBlocks) {
+		idx = startDist(rng) * NUM_BLOCKS + startDist(rng);
+	}
+
+	std::vector<float> gCosts(NUM_BLOCKS * NUM_BLOCKS, PATHCOST_INFINITY);
+	std::vector<unsigned int> dirtyBlocks;
+	std::vector<unsigned int> pathBlocks;
+
+	const auto EdgeCost = [&](unsigned int prevIdx, unsigned int pathDir, unsigned int nextIdx) {
+		return (graph.EdgeCost(prevIdx, pathDir, nextIdx));
+	};
+
+	float searchCostSum = 0.0f;
+	float fieldCostSum = 0.0f;
+
+	const auto t0 = std::chrono::steady_clock::now();
+
+	// #1: one A* search per request, as the estimator runs without a shared field
+	for (int i = 0; i < NUM_REQUESTS; i++) {
+		const float cost = SearchPath(graph, int2(startBlocks[i] % NUM_BLOCKS, startBlocks[i] / NUM_BLOCKS), gCosts, dirtyBlocks);
+
+		if (cost < PATHCOST_INFINITY)
+			searchCostSum += cost;
+	}
+
+	const auto t1 = std::chrono::steady_clock::now();
+
+	// #2: one field shared by all requests, each also extracts its path
+	{
+		PathGoalField field = InitField(graph);
+
+		for (int i = 0; i < NUM_REQUESTS; i++) {
+			if (!field.Expand(startBlocks[i], EdgeCost))
+				continue;
+
+			field.GetPathBlocks(startBlocks[i], pathBlocks);
+			fieldCostSum += field.GetBlockCost(startBlocks[i]);
+		}
+	}
+
+	const auto t2 = std::chrono::steady_clock::now();
+
+	const float searchTime = std::chrono::duration<float>(t1 - t0).count();
+	const float fieldTime = std::chrono::duration<float>(t2 - t1).count();
+
+	BOOST_TEST_MESSAGE("[PathGoalFieldGroupRequests] blocks=" << NUM_BLOCKS << "x" << NUM_BLOCKS << " requests=" << NUM_REQUESTS);
+	BOOST_TEST_MESSAGE("\tper-request search: " << (NUM_REQUESTS / searchTime) << " requests/s");
+	BOOST_TEST_MESSAGE("\tshared goal-field: " << (NUM_REQUESTS / fieldTime) << " requests/s");
+
+	// both are optimal, so they must have found the same paths
+	BOOST_CHECK_CLOSE(searchCostSum, fieldCostSum, 0.01f);
+}
+
+BOOST_AUTO_TEST_CASE( PathGoalFieldRequestOrder )
+{
+	std::mt19937 rng(5678);
+
+	BlockGraph graph(rng);
+	graph.goalPos = int2(NUM_BLOCKS / 2, NUM_BLOCKS / 2);
+
+	std::uniform_int_distribution<int> startDist(0, NUM_BLOCKS - 1);
+	std::vector<unsigned int> startBlocks(NUM_REQUESTS);
+
+	for (unsigned int& idx: startBlocks) {
+		idx = startDist(rng) * NUM_BLOCKS + startDist(rng);
+	}
+
+	const auto EdgeCost = [&](unsigned int prevIdx, unsigned int pathDir, unsigned int nextIdx) {
+		return (graph.EdgeCost(prevIdx, pathDir, nextIdx));
+	};
+
+	// paths must not depend on which requests expanded the field before
+	// (the order of requests is the same on all clients, but a request's
+	// path should not change if another unit was or was not also ordered)
+	PathGoalField fwdField = InitField(graph);
+	PathGoalField revField = InitField(graph);
+	PathGoalField fullField = InitField(graph);
+
+	std::vector<std::vector<unsigned int>> fwdPaths(NUM_REQUESTS);
+	std::vector<std::vector<unsigned int>> revPaths(NUM_REQUESTS);
+	std::vector<std::vector<unsigned int>> fullPaths(NUM_REQUESTS);
+
+	// expand the full field over the entire map first
+	fullField.Expand(0, EdgeCost);
+	fullField.Expand(NUM_BLOCKS * NUM_BLOCKS - 1, EdgeCost);
+
+	for (int i = 0; i < NUM_REQUESTS; i++) {
+		const int j = NUM_REQUESTS - 1 - i;
+
+		if (fwdField.Expand(startBlocks[i], EdgeCost))
+			fwdField.GetPathBlocks(startBlocks[i], fwdPaths[i]);
+		if (revField.Expand(startBlocks[j], EdgeCost))
+			revField.GetPathBlocks(startBlocks[j], revPaths[j]);
+		if (fullField.Expand(startBlocks[i], EdgeCost))
+			fullField.GetPathBlocks(startBlocks[i], fullPaths[i]);
+	}
+
+	BOOST_CHECK(fwdPaths == revPaths);
+	BOOST_CHECK(fwdPaths == fullPaths);
+	BOOST_CHECK(fwdField.GetNumSettledBlocks() <= fullField.GetNumSettledBlocks());
+}
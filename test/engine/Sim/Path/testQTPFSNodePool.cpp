@@ -0,0 +1,562 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Path/QTPFS/NodePool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <random>
+#include <vector>
+
+#define BOOST_TEST_MODULE QTPFSNodePool
+#include <boost/test/unit_test.hpp>
+
+
+// synthetic quadtree; roughly what a 16x16 map tesselates into
+static constexpr unsigned int MAP_SIZE = 1024;
+static constexpr unsigned int MIN_NODE_SIZE = 2;
+static constexpr unsigned int MAX_LEAF_SIZE = 64;
+static constexpr unsigned int NUM_SEARCHES = 250;
+static constexpr unsigned int CHILD_COUNT = 4;
+
+// stand-in for float3, only the xz-components matter here
+struct Point {
+	float x;
+	float z;
+};
+
+static float Distance(const Point& a, const Point& b) {
+	return (std::sqrt((a.x - b.x) * (a.x - b.x) + (a.z - b.z) * (a.z - b.z)));
+}
+
+
+struct NodeBase {
+	unsigned int xsize() const { return (xmax - xmin); }
+	unsigned int zsize() const { return (zmax - zmin); }
+
+	// same overestimate QTNode::GetMaxNumNeighbors makes
+	unsigned int GetMaxNumNeighbors() const {
+		unsigned int n = 0;
+
+		if (xmin > (           0)) { n += zsize(); }
+		if (xmax < (MAP_SIZE - 1)) { n += zsize(); }
+		if (zmin > (           0)) { n += xsize(); }
+		if (zmax < (MAP_SIZE - 1)) { n += xsize(); }
+
+		return n;
+	}
+
+	unsigned int xmin = 0;
+	unsigned int zmin = 0;
+	unsigned int xmax = 0;
+	unsigned int zmax = 0;
+
+	unsigned int searchState = 0;
+
+	float moveCost = 0.0f;
+	float gCost = 0.0f;
+
+	Point entryPoint = {0.0f, 0.0f};
+};
+
+// the pointer-linked layout QTNode used to have: four heap-allocated
+// children and per-node neighbor / netpoint vectors reserved for the
+// worst-case number of neighbors
+struct LegacyNode: public NodeBase {
+	~LegacyNode() {
+		for (LegacyNode* c: children) {
+			delete c;
+		}
+	}
+
+	bool IsLeaf() const { return children.empty(); }
+
+	LegacyNode* prevNode = nullptr;
+
+	std::vector<LegacyNode*> children;
+	std::vector<LegacyNode*> neighbors;
+	std::vector<Point> netpoints;
+};
+
+// the pooled layout: siblings are one group in a NodePool, links are indices
+struct PooledNode: public NodeBase {
+	bool IsLeaf() const { return (childBaseIdx == -1u); }
+
+	unsigned int nodeIndex = -1u;
+	unsigned int prevNodeIdx = -1u;
+	unsigned int childBaseIdx = -1u;
+
+	unsigned int ngbsOffset = 0;
+	unsigned int ngbsSizeClass = -1u;
+	unsigned int numNeighbors = 0;
+};
+
+typedef QTPFS::NodePool<PooledNode, CHILD_COUNT> PooledNodes;
+typedef QTPFS::NodeNeighborPool<Point, 1> PooledNeighbors;
+
+
+template<typename TNode>
+static void SetRect(TNode* n, unsigned int x1, unsigned int z1, unsigned int x2, unsigned int z2) {
+	n->xmin = x1;
+	n->zmin = z1;
+	n->xmax = x2;
+	n->zmax = z2;
+}
+
+template<typename TNode>
+static void SetChildRects(TNode* p, TNode* c0, TNode* c1, TNode* c2, TNode* c3) {
+	const unsigned int xmid = (p->xmin + p->xmax) >> 1;
+	const unsigned int zmid = (p->zmin + p->zmax) >> 1;
+
+	SetRect(c0, p->xmin, p->zmin,   xmid,   zmid);
+	SetRect(c1,   xmid, p->zmin, p->xmax,   zmid);
+	SetRect(c2,   xmid,   zmid, p->xmax, p->zmax);
+	SetRect(c3, p->xmin,   zmid,   xmid, p->zmax);
+}
+
+// random tesselation: large nodes always split, small ones sometimes
+static void BuildLegacyTree(LegacyNode* n, std::mt19937& rng) {
+	std::uniform_real_distribution<float> splitDist(0.0f, 1.0f);
+	std::uniform_real_distribution<float> costDist(1.0f, 4.0f);
+	std::uniform_int_distribution<int> blockDist(0, 9);
+
+	const bool canSplit = (n->xsize() > MIN_NODE_SIZE);
+	const bool mustSplit = (n->xsize() > MAX_LEAF_SIZE);
+
+	if (!mustSplit && (!canSplit || splitDist(rng) < 0.3f)) {
+		// impassable nodes (e.g. cliffs) have infinite cost
+		n->moveCost = (blockDist(rng) == 0)? std::numeric_limits<float>::infinity(): costDist(rng);
+		return;
+	}
+
+	n->children.reserve(CHILD_COUNT);
+
+	for (unsigned int i = 0; i < CHILD_COUNT; i++) {
+		n->children.push_back(new LegacyNode());
+	}
+
+	SetChildRects(n, n->children[0], n->children[1], n->children[2], n->children[3]);
+
+	for (LegacyNode* c: n->children) {
+		BuildLegacyTree(c, rng);
+	}
+}
+
+// mirrors the legacy tree so both layouts describe the same tesselation
+static void BuildPooledTree(PooledNodes& pool, unsigned int idx, const LegacyNode* src) {
+	PooledNode& n = pool[idx];
+
+	n.nodeIndex = idx;
+	n.moveCost = src->moveCost;
+
+	if (src->IsLeaf())
+		return;
+
+	// AllocGroup may add a chunk, but never moves existing nodes
+	const unsigned int childBaseIdx = (n.childBaseIdx = pool.AllocGroup());
+
+	SetChildRects(&n, &pool[childBaseIdx + 0], &pool[childBaseIdx + 1], &pool[childBaseIdx + 2], &pool[childBaseIdx + 3]);
+
+	for (unsigned int i = 0; i < CHILD_COUNT; i++) {
+		BuildPooledTree(pool, childBaseIdx + i, src->children[i]);
+	}
+}
+
+
+template<typename TNode, typename TFunc>
+static void VisitLeafs(TNode* n, const TFunc& f) {
+	if (n->IsLeaf()) {
+		f(n);
+		return;
+	}
+
+	for (unsigned int i = 0; i < CHILD_COUNT; i++) {
+		VisitLeafs(n->children[i], f);
+	}
+}
+
+template<typename TFunc>
+static void VisitLeafs(PooledNodes& pool, PooledNode* n, const TFunc& f) {
+	if (n->IsLeaf()) {
+		f(n);
+		return;
+	}
+
+	for (unsigned int i = 0; i < CHILD_COUNT; i++) {
+		VisitLeafs(pool, &pool[n->childBaseIdx + i], f);
+	}
+}
+
+template<typename TNode>
+static void RegisterLeaf(std::vector<TNode>& grid, const NodeBase* n, TNode v) {
+	for (unsigned int z = n->zmin; z < n->zmax; z++) {
+		for (unsigned int x = n->xmin; x < n->xmax; x++) {
+			grid[z * MAP_SIZE + x] = v;
+		}
+	}
+}
+
+// walks the four edges of <n> like QTNode::UpdateNeighborCache and
+// calls f(ngbSquareIdx, transitionPoint) once per distinct neighbor
+template<typename TFunc>
+static void ForEachNeighbor(const NodeBase* n, const std::vector<const NodeBase*>& leafGrid, const TFunc& f) {
+	const auto EdgePoint = [&](const NodeBase* ngb, bool vertEdge, float edgeCoor) {
+		if (vertEdge)
+			return (Point{edgeCoor, (std::max(n->zmin, ngb->zmin) + std::min(n->zmax, ngb->zmax)) * 0.5f});
+
+		return (Point{(std::max(n->xmin, ngb->xmin) + std::min(n->xmax, ngb->xmax)) * 0.5f, edgeCoor});
+	};
+
+	if (n->xmin > 0) {
+		for (unsigned int hmz = n->zmin; hmz < n->zmax; ) {
+			const unsigned int sqr = hmz * MAP_SIZE + (n->xmin - 1);
+			hmz = leafGrid[sqr]->zmax;
+			f(sqr, EdgePoint(leafGrid[sqr], true, n->xmin));
+		}
+	}
+	if (n->xmax < MAP_SIZE) {
+		for (unsigned int hmz = n->zmin; hmz < n->zmax; ) {
+			const unsigned int sqr = hmz * MAP_SIZE + n->xmax;
+			hmz = leafGrid[sqr]->zmax;
+			f(sqr, EdgePoint(leafGrid[sqr], true, n->xmax));
+		}
+	}
+	if (n->zmin > 0) {
+		for (unsigned int hmx = n->xmin; hmx < n->xmax; ) {
+			const unsigned int sqr = (n->zmin - 1) * MAP_SIZE + hmx;
+			hmx = leafGrid[sqr]->xmax;
+			f(sqr, EdgePoint(leafGrid[sqr], false, n->zmin));
+		}
+	}
+	if (n->zmax < MAP_SIZE) {
+		for (unsigned int hmx = n->xmin; hmx < n->xmax; ) {
+			const unsigned int sqr = n->zmax * MAP_SIZE + hmx;
+			hmx = leafGrid[sqr]->xmax;
+			f(sqr, EdgePoint(leafGrid[sqr], false, n->zmax));
+		}
+	}
+}
+
+
+struct LegacyLayer {
+	LegacyLayer(std::mt19937& rng) {
+		SetRect(&root, 0, 0, MAP_SIZE, MAP_SIZE);
+		BuildLegacyTree(&root, rng);
+
+		nodeGrid.resize(MAP_SIZE * MAP_SIZE, nullptr);
+		leafGrid.resize(MAP_SIZE * MAP_SIZE, nullptr);
+
+		VisitLeafs(&root, [&](LegacyNode* n) {
+			RegisterLeaf(nodeGrid, n, n);
+			RegisterLeaf(leafGrid, n, static_cast<const NodeBase*>(n));
+		});
+		VisitLeafs(&root, [&](LegacyNode* n) {
+			const unsigned int maxNgbs = n->GetMaxNumNeighbors();
+
+			n->neighbors.reserve(maxNgbs + 4);
+			n->netpoints.reserve(1 + maxNgbs + 4);
+			n->netpoints.push_back(Point{0.0f, 0.0f});
+
+			ForEachNeighbor(n, leafGrid, [&](unsigned int sqr, const Point& p) {
+				n->neighbors.push_back(nodeGrid[sqr]);
+				n->netpoints.push_back(p);
+			});
+		});
+	}
+
+	std::uint64_t GetMemFootPrint() const {
+		std::uint64_t memFootPrint = nodeGrid.capacity() * sizeof(LegacyNode*);
+
+		VisitTree(&root, [&](const LegacyNode* n) {
+			memFootPrint += sizeof(LegacyNode);
+			memFootPrint += (n->children.capacity() * sizeof(LegacyNode*));
+			memFootPrint += (n->neighbors.capacity() * sizeof(LegacyNode*));
+			memFootPrint += (n->netpoints.capacity() * sizeof(Point));
+		});
+
+		return memFootPrint;
+	}
+
+	template<typename TFunc>
+	static void VisitTree(const LegacyNode* n, const TFunc& f) {
+		f(n);
+
+		for (const LegacyNode* c: n->children) {
+			VisitTree(c, f);
+		}
+	}
+
+	LegacyNode root;
+
+	std::vector<LegacyNode*> nodeGrid;
+	std::vector<const NodeBase*> leafGrid;
+};
+
+struct PooledLayer {
+	PooledLayer(const LegacyLayer& src) {
+		const unsigned int rootIdx = nodePool.AllocGroup();
+
+		SetRect(&nodePool[rootIdx], 0, 0, MAP_SIZE, MAP_SIZE);
+		BuildPooledTree(nodePool, rootIdx, &src.root);
+
+		nodeGrid.resize(MAP_SIZE * MAP_SIZE, 0);
+		leafGrid.resize(MAP_SIZE * MAP_SIZE, nullptr);
+
+		VisitLeafs(nodePool, &nodePool[rootIdx], [&](PooledNode* n) {
+			RegisterLeaf(nodeGrid, n, n->nodeIndex);
+			RegisterLeaf(leafGrid, n, static_cast<const NodeBase*>(n));
+		});
+		VisitLeafs(nodePool, &nodePool[rootIdx], [&](PooledNode* n) {
+			tmpIndices.clear();
+			tmpPoints.clear();
+
+			ForEachNeighbor(n, leafGrid, [&](unsigned int sqr, const Point& p) {
+				tmpIndices.push_back(nodeGrid[sqr]);
+				tmpPoints.push_back(p);
+			});
+
+			n->ngbsSizeClass = PooledNeighbors::GetSizeClass(tmpIndices.size());
+			n->ngbsOffset = ngbPool.Alloc(n->ngbsSizeClass);
+			n->numNeighbors = tmpIndices.size();
+
+			std::copy(tmpIndices.begin(), tmpIndices.end(), ngbPool.GetIndices(n->ngbsOffset));
+			std::copy(tmpPoints.begin(), tmpPoints.end(), ngbPool.GetPoints(n->ngbsOffset));
+		});
+	}
+
+	PooledNode* GetNode(unsigned int x, unsigned int z) { return &nodePool[nodeGrid[z * MAP_SIZE + x]]; }
+
+	std::uint64_t GetMemFootPrint() const {
+		std::uint64_t memFootPrint = nodeGrid.capacity() * sizeof(unsigned int);
+		memFootPrint += nodePool.GetMemFootPrint();
+		memFootPrint += ngbPool.GetMemFootPrint();
+		return memFootPrint;
+	}
+
+	PooledNodes nodePool;
+	PooledNeighbors ngbPool;
+
+	std::vector<unsigned int> nodeGrid;
+	std::vector<const NodeBase*> leafGrid;
+
+	std::vector<unsigned int> tmpIndices;
+	std::vector<Point> tmpPoints;
+};
+
+
+struct SearchQuery {
+	Point srcPoint;
+	Point tgtPoint;
+};
+
+// ties are broken by push-order (not by address) so both layouts pop the same sequence
+struct OpenNode {
+	bool operator > (const OpenNode& n) const { return (fCost > n.fCost || (fCost == n.fCost && pushNum > n.pushNum)); }
+
+	float fCost;
+	unsigned int pushNum;
+	void* node;
+};
+
+struct OpenNodes: public std::priority_queue<OpenNode, std::vector<OpenNode>, std::greater<OpenNode>> {
+	void Reset(void* srcNode) {
+		c.clear();
+		numPushes = 0;
+		Push(0.0f, srcNode);
+	}
+	void Push(float fCost, void* node) { push(OpenNode{fCost, numPushes++, node}); }
+
+	unsigned int numPushes = 0;
+};
+
+// both searches share this relaxation step so their costs are bit-identical
+template<typename TNode>
+static bool RelaxNeighbor(OpenNodes& openNodes, const TNode* curNode, TNode* nxtNode, const Point& nxtPoint, const SearchQuery& q, unsigned int searchState) {
+	if (std::isinf(nxtNode->moveCost))
+		return false;
+
+	const float gCost = curNode->gCost + Distance(curNode->entryPoint, nxtPoint) * nxtNode->moveCost;
+	const float hCost = Distance(nxtPoint, q.tgtPoint);
+
+	if (nxtNode->searchState >= searchState && gCost >= nxtNode->gCost)
+		return false;
+
+	nxtNode->searchState = searchState;
+	nxtNode->gCost = gCost;
+	nxtNode->entryPoint = nxtPoint;
+
+	openNodes.Push(gCost + hCost, nxtNode);
+	return true;
+}
+
+// A* over the leafs like QTPFS::PathSearch; returns the final g-cost
+static float SearchLegacy(LegacyLayer& layer, const SearchQuery& q, unsigned int searchState, OpenNodes& openNodes) {
+	LegacyNode* srcNode = layer.nodeGrid[unsigned(q.srcPoint.z) * MAP_SIZE + unsigned(q.srcPoint.x)];
+	LegacyNode* tgtNode = layer.nodeGrid[unsigned(q.tgtPoint.z) * MAP_SIZE + unsigned(q.tgtPoint.x)];
+
+	srcNode->searchState = searchState;
+	srcNode->gCost = 0.0f;
+	srcNode->entryPoint = q.srcPoint;
+	srcNode->prevNode = nullptr;
+
+	openNodes.Reset(srcNode);
+
+	while (!openNodes.empty()) {
+		LegacyNode* curNode = static_cast<LegacyNode*>(openNodes.top().node);
+
+		openNodes.pop();
+
+		if (curNode == tgtNode)
+			return (curNode->gCost + Distance(curNode->entryPoint, q.tgtPoint) * curNode->moveCost);
+
+		for (unsigned int i = 0; i < curNode->neighbors.size(); i++) {
+			LegacyNode* nxtNode = curNode->neighbors[i];
+
+			if (RelaxNeighbor(openNodes, curNode, nxtNode, curNode->netpoints[1 + i], q, searchState)) {
+				nxtNode->prevNode = curNode;
+			}
+		}
+	}
+
+	return -1.0f;
+}
+
+static float SearchPooled(PooledLayer& layer, const SearchQuery& q, unsigned int searchState, OpenNodes& openNodes) {
+	PooledNode* srcNode = layer.GetNode(q.srcPoint.x, q.srcPoint.z);
+	PooledNode* tgtNode = layer.GetNode(q.tgtPoint.x, q.tgtPoint.z);
+
+	srcNode->searchState = searchState;
+	srcNode->gCost = 0.0f;
+	srcNode->entryPoint = q.srcPoint;
+	srcNode->prevNodeIdx = -1u;
+
+	openNodes.Reset(srcNode);
+
+	while (!openNodes.empty()) {
+		PooledNode* curNode = static_cast<PooledNode*>(openNodes.top().node);
+
+		openNodes.pop();
+
+		if (curNode == tgtNode)
+			return (curNode->gCost + Distance(curNode->entryPoint, q.tgtPoint) * curNode->moveCost);
+
+		const unsigned int* ngbIndices = layer.ngbPool.GetIndices(curNode->ngbsOffset);
+		const Point* ngbPoints = layer.ngbPool.GetPoints(curNode->ngbsOffset);
+
+		for (unsigned int i = 0; i < curNode->numNeighbors; i++) {
+			PooledNode* nxtNode = &layer.nodePool[ngbIndices[i]];
+
+			if (RelaxNeighbor(openNodes, curNode, nxtNode, ngbPoints[i], q, searchState)) {
+				nxtNode->prevNodeIdx = curNode->nodeIndex;
+			}
+		}
+	}
+
+	return -1.0f;
+}
+
+
+BOOST_AUTO_TEST_CASE(NodePoolGroups)
+{
+	QTPFS::NodePool<PooledNode, CHILD_COUNT, 16> pool;
+
+	const unsigned int g0 = pool.AllocGroup();
+	const unsigned int g1 = pool.AllocGroup();
+	const PooledNode* n1 = &pool[g1];
+
+	BOOST_CHECK_EQUAL(g0, 0u);
+	BOOST_CHECK_EQUAL(g1, CHILD_COUNT);
+
+	// crossing into a new chunk must not move existing nodes
+	for (unsigned int i = 0; i < 8; i++) {
+		pool.AllocGroup();
+	}
+
+	BOOST_CHECK_EQUAL(n1, &pool[g1]);
+	BOOST_CHECK_EQUAL(pool.GetNumUsedSlots(), 10 * CHILD_COUNT);
+
+	// freed groups are recycled before the pool grows
+	pool.FreeGroup(g1);
+	BOOST_CHECK_EQUAL(pool.GetNumUsedSlots(), 9 * CHILD_COUNT);
+	BOOST_CHECK_EQUAL(pool.AllocGroup(), g1);
+	BOOST_CHECK_EQUAL(pool.GetNumSlots(), 10 * CHILD_COUNT);
+}
+
+BOOST_AUTO_TEST_CASE(NeighborPoolSizeClasses)
+{
+	PooledNeighbors pool;
+
+	BOOST_CHECK_EQUAL(PooledNeighbors::GetSizeClass(0), 0u);
+	BOOST_CHECK_EQUAL(PooledNeighbors::GetSizeClass(1), 0u);
+	BOOST_CHECK_EQUAL(PooledNeighbors::GetSizeClass(5), 3u);
+	BOOST_CHECK_EQUAL(PooledNeighbors::GetSizeClass(8), 3u);
+
+	const unsigned int r0 = pool.Alloc(3);
+	const unsigned int r1 = pool.Alloc(2);
+
+	BOOST_CHECK_EQUAL(r0, 0u);
+	BOOST_CHECK_EQUAL(r1, 8u);
+
+	// same-class ranges are recycled, others append
+	pool.Free(r0, 3);
+	BOOST_CHECK_EQUAL(pool.Alloc(2), 12u);
+	BOOST_CHECK_EQUAL(pool.Alloc(3), r0);
+}
+
+BOOST_AUTO_TEST_CASE(PooledVsLegacySearches)
+{
+	std::mt19937 rng(0x5EED);
+	std::uniform_real_distribution<float> posDist(0.0f, MAP_SIZE - 1.0f);
+
+	LegacyLayer legacyLayer(rng);
+	PooledLayer pooledLayer(legacyLayer);
+
+	std::vector<SearchQuery> queries(NUM_SEARCHES);
+
+	for (SearchQuery& q: queries) {
+		q.srcPoint = Point{posDist(rng), posDist(rng)};
+		q.tgtPoint = Point{posDist(rng), posDist(rng)};
+	}
+
+	std::vector<float> legacyCosts(NUM_SEARCHES);
+	std::vector<float> pooledCosts(NUM_SEARCHES);
+
+	OpenNodes openNodes;
+
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	for (unsigned int i = 0; i < NUM_SEARCHES; i++) {
+		legacyCosts[i] = SearchLegacy(legacyLayer, queries[i], i + 1, openNodes);
+	}
+
+	const auto t1 = std::chrono::high_resolution_clock::now();
+
+	for (unsigned int i = 0; i < NUM_SEARCHES; i++) {
+		pooledCosts[i] = SearchPooled(pooledLayer, queries[i], i + 1, openNodes);
+	}
+
+	const auto t2 = std::chrono::high_resolution_clock::now();
+
+	unsigned int numLeafs = 0;
+	unsigned int numFound = 0;
+
+	VisitLeafs(&legacyLayer.root, [&](const LegacyNode*) { numLeafs++; });
+
+	for (unsigned int i = 0; i < NUM_SEARCHES; i++) {
+		BOOST_CHECK_EQUAL(legacyCosts[i], pooledCosts[i]);
+		numFound += (pooledCosts[i] >= 0.0f);
+	}
+
+	BOOST_CHECK(numFound > 0);
+	BOOST_CHECK_EQUAL(pooledLayer.nodePool.GetNumUsedSlots(), CHILD_COUNT + (numLeafs - 1) / (CHILD_COUNT - 1) * CHILD_COUNT);
+	BOOST_CHECK(pooledLayer.GetMemFootPrint() < legacyLayer.GetMemFootPrint());
+
+	const float legacySecs = std::chrono::duration<float>(t1 - t0).count();
+	const float pooledSecs = std::chrono::duration<float>(t2 - t1).count();
+
+	BOOST_TEST_MESSAGE("leafs: " << numLeafs << ", searches: " << NUM_SEARCHES << " (" << numFound << " found)");
+	BOOST_TEST_MESSAGE("legacy: " << (NUM_SEARCHES / legacySecs) << " searches/s, " << (legacyLayer.GetMemFootPrint() >> 10) << " KB");
+	BOOST_TEST_MESSAGE("pooled: " << (NUM_SEARCHES / pooledSecs) << " searches/s, " << (pooledLayer.GetMemFootPrint() >> 10) << " KB");
+}
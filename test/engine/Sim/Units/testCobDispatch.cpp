@@ -0,0 +1,325 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Units/Scripts/CobOpcodes.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MODULE CobDispatch
+#include <boost/test/unit_test.hpp>
+
+using namespace CobOpcodes;
+
+
+static constexpr int NUM_RUNS = 2000;
+static constexpr int NUM_ITERATIONS = 1000;
+static constexpr int INITIAL_STACK_SIZE = 16;
+
+
+// sum of [0, n) with n passed in as the only argument
+static std::vector<int> CreateLoopScript()
+{
+	return {
+		CREATE_LOCAL_VAR,                                   //  0: n (argument)
+		CREATE_LOCAL_VAR,                                   //  1: i
+		CREATE_LOCAL_VAR,                                   //  2: sum
+		PUSH_LOCAL_VAR, 1, PUSH_LOCAL_VAR, 0, SET_LESS,     //  3: while (i < n)
+		JUMP_NOT_EQUAL, 30,                                 //  8
+		PUSH_LOCAL_VAR, 2, PUSH_LOCAL_VAR, 1, ADD,          // 10: sum += i
+		POP_LOCAL_VAR, 2,                                   // 15
+		PUSH_LOCAL_VAR, 1, PUSH_CONSTANT, 1, ADD,           // 17: i += 1
+		POP_LOCAL_VAR, 1,                                   // 22
+		PUSH_CONSTANT, SLEEP,                               // 24: operand looks like an opcode
+		POP_STACK,                                          // 26
+		JUMP, 3,                                            // 27
+		DROP,                                               // 29: never reached
+		PUSH_LOCAL_VAR, 2, RETURN,                          // 30
+	};
+}
+
+
+// the interpreter as it was: a switch over sparse opcodes and a growing stack
+static int RunSparse(const std::vector<int>& code, int arg)
+{
+	std::vector<int> stack = {arg};
+	int paramCount = 1;
+	int PC = 0;
+	int r1, r2;
+
+	while (true) {
+		switch (code[PC++]) {
+			case PUSH_CONSTANT: { stack.push_back(code[PC++]); } break;
+			case PUSH_LOCAL_VAR: { stack.push_back(stack[code[PC++]]); } break;
+			case POP_LOCAL_VAR: { r1 = code[PC++]; stack[r1] = stack.back(); stack.pop_back(); } break;
+			case POP_STACK: { stack.pop_back(); } break;
+			case CREATE_LOCAL_VAR: {
+				if (paramCount == 0) {
+					stack.push_back(0);
+				} else {
+					paramCount--;
+				}
+			} break;
+			case ADD: { r2 = stack.back(); stack.pop_back(); r1 = stack.back(); stack.back() = r1 + r2; } break;
+			case SET_LESS: { r2 = stack.back(); stack.pop_back(); r1 = stack.back(); stack.back() = (r1 < r2); } break;
+			case JUMP_NOT_EQUAL: { r1 = code[PC++]; r2 = stack.back(); stack.pop_back(); if (r2 == 0) PC = r1; } break;
+			case JUMP: { PC = code[PC]; } break;
+			case RETURN: { return stack.back(); } break;
+			default: { return -1; } break;
+		}
+	}
+
+	return -1;
+}
+
+// the interpreter as it is: dispatch on translated opcodes, the stack grows
+// in steps and is indexed by a separate size
+static int RunTranslated(const std::vector<int>& code, int arg)
+{
+	std::vector<int> stack(INITIAL_STACK_SIZE);
+	int stackSize = 1;
+	int paramCount = 1;
+	int PC = 0;
+	int r1, r2;
+
+	stack[0] = arg;
+
+	#define PUSH(val) do { if (stackSize == int(stack.size())) stack.resize(stack.size() * 2 + INITIAL_STACK_SIZE); stack[stackSize++] = (val); } while (false)
+
+#if defined(__GNUC__)
+	static const void* const dispatchTable[OP_COUNT] = {
+		#define COB_OP_LABEL(name, raw, numOperands, mnemonic) &&op_##name,
+		COB_OPCODE_LIST(COB_OP_LABEL)
+		#undef COB_OP_LABEL
+		&&op_UNKNOWN
+	};
+	#define COB_DISPATCH() goto *dispatchTable[Decode(code[PC++])]
+#else
+	#define COB_DISPATCH() switch (Decode(code[PC++])) {                                       \
+		case OP_PUSH_CONSTANT: goto op_PUSH_CONSTANT; case OP_PUSH_LOCAL_VAR: goto op_PUSH_LOCAL_VAR; \
+		case OP_POP_LOCAL_VAR: goto op_POP_LOCAL_VAR; case OP_POP_STACK: goto op_POP_STACK;           \
+		case OP_CREATE_LOCAL_VAR: goto op_CREATE_LOCAL_VAR; case OP_ADD: goto op_ADD;                 \
+		case OP_SET_LESS: goto op_SET_LESS; case OP_JUMP_NOT_EQUAL: goto op_JUMP_NOT_EQUAL;           \
+		case OP_JUMP: goto op_JUMP; case OP_RETURN: goto op_RETURN; default: goto op_UNKNOWN; }
+#endif
+
+	COB_DISPATCH();
+
+	op_PUSH_CONSTANT: { PUSH(code[PC++]); } COB_DISPATCH();
+	op_PUSH_LOCAL_VAR: { r1 = code[PC++]; PUSH(stack[r1]); } COB_DISPATCH();
+	op_POP_LOCAL_VAR: { r1 = code[PC++]; stack[r1] = stack[--stackSize]; } COB_DISPATCH();
+	op_POP_STACK: { stackSize--; } COB_DISPATCH();
+	op_CREATE_LOCAL_VAR: {
+		if (paramCount == 0) {
+			PUSH(0);
+		} else {
+			paramCount--;
+		}
+	} COB_DISPATCH();
+	op_ADD: { r2 = stack[--stackSize]; r1 = stack[stackSize - 1]; stack[stackSize - 1] = r1 + r2; } COB_DISPATCH();
+	op_SET_LESS: { r2 = stack[--stackSize]; r1 = stack[stackSize - 1]; stack[stackSize - 1] = (r1 < r2); } COB_DISPATCH();
+	op_JUMP_NOT_EQUAL: { r1 = code[PC++]; r2 = stack[--stackSize]; if (r2 == 0) PC = r1; } COB_DISPATCH();
+	op_JUMP: { PC = code[PC]; } COB_DISPATCH();
+	op_RETURN: { return stack[stackSize - 1]; }
+
+#if defined(__GNUC__)
+	op_MOVE: op_TURN: op_SPIN: op_STOP_SPIN: op_SHOW: op_HIDE: op_CACHE: op_DONT_CACHE: op_MOVE_NOW:
+	op_TURN_NOW: op_SHADE: op_DONT_SHADE: op_EMIT_SFX: op_WAIT_TURN: op_WAIT_MOVE: op_SLEEP:
+	op_PUSH_STATIC: op_POP_STATIC: op_SUB: op_MUL: op_DIV: op_MOD: op_BITWISE_AND: op_BITWISE_OR:
+	op_BITWISE_XOR: op_BITWISE_NOT: op_RAND: op_GET_UNIT_VALUE: op_GET: op_SET_LESS_OR_EQUAL:
+	op_SET_GREATER: op_SET_GREATER_OR_EQUAL: op_SET_EQUAL: op_SET_NOT_EQUAL: op_LOGICAL_AND:
+	op_LOGICAL_OR: op_LOGICAL_XOR: op_LOGICAL_NOT: op_START: op_CALL: op_REAL_CALL: op_LUA_CALL:
+	op_SIGNAL: op_SET_SIGNAL_MASK: op_EXPLODE: op_PLAY_SOUND: op_SET: op_ATTACH: op_DROP:
+#endif
+	op_UNKNOWN:
+	return -1;
+
+	#undef COB_DISPATCH
+	#undef PUSH
+}
+
+
+template<typename F> static float TimeMillis(F&& f)
+{
+	const auto t0 = std::chrono::high_resolution_clock::now();
+	f();
+	const auto t1 = std::chrono::high_resolution_clock::now();
+	return (std::chrono::duration<float, std::milli>(t1 - t0).count());
+}
+
+
+
+BOOST_AUTO_TEST_CASE(Opcodes)
+{
+	BOOST_CHECK(Translate(MOVE) == OP_MOVE);
+	BOOST_CHECK(Translate(DROP) == OP_DROP);
+	BOOST_CHECK(Translate(0x12345678) == OP_UNKNOWN);
+
+	BOOST_CHECK(Decode(Encode(OP_LUA_CALL)) == OP_LUA_CALL);
+	BOOST_CHECK(Decode(Encode(OP_UNKNOWN)) == OP_UNKNOWN);
+	// raw words are decoded on the fly
+	BOOST_CHECK(Decode(SET_LESS) == OP_SET_LESS);
+	BOOST_CHECK(Decode(0) == OP_UNKNOWN);
+
+	BOOST_CHECK(NUM_OPERANDS[OP_MOVE] == 2);
+	BOOST_CHECK(NUM_OPERANDS[OP_PUSH_CONSTANT] == 1);
+	BOOST_CHECK(NUM_OPERANDS[OP_ADD] == 0);
+
+	BOOST_CHECK(std::string(GetMnemonic(LUA_CALL)) == "lua_call");
+	BOOST_CHECK(std::string(GetMnemonic(0)) == "unknown");
+}
+
+BOOST_AUTO_TEST_CASE(TranslateScripts)
+{
+	const std::vector<std::string> scriptNames = {"Create", "lua_Foo", "Bar"};
+
+	std::vector<int> code = {
+		CALL, 1, 0,           // 0: Create
+		CALL, 2, 0,
+		CALL, 7, 0,           // unknown script, bound at runtime
+		PUSH_CONSTANT, MOVE,
+		RETURN,
+		0x12345678, ADD,      // 12: translation stops here
+		PUSH_CONSTANT, 1,     // 14: lua_Foo
+		RETURN,
+		MOVE, 1,              // 17: Bar, truncated
+	};
+
+	const std::vector<int> rawCode = code;
+
+	TranslateScript(code,  0, 14, scriptNames);
+	TranslateScript(code, 14, 17, scriptNames);
+	TranslateScript(code, 17, 19, scriptNames);
+
+	BOOST_CHECK(code[0] == Encode(OP_LUA_CALL));
+	BOOST_CHECK(code[3] == Encode(OP_REAL_CALL));
+	BOOST_CHECK(code[6] == Encode(OP_CALL));
+	BOOST_CHECK(code[9] == Encode(OP_PUSH_CONSTANT));
+	BOOST_CHECK(code[11] == Encode(OP_RETURN));
+	BOOST_CHECK(code[14] == Encode(OP_PUSH_CONSTANT));
+	BOOST_CHECK(code[16] == Encode(OP_RETURN));
+
+	// operands, unknown opcodes and everything after them stay raw
+	for (const int pc: {1, 2, 4, 5, 7, 8, 10, 12, 13, 15, 17, 18}) {
+		BOOST_CHECK(code[pc] == rawCode[pc]);
+	}
+
+	BOOST_CHECK(MatchesRawScript(code, rawCode,  0, 14));
+	BOOST_CHECK(MatchesRawScript(code, rawCode, 14, 17));
+	BOOST_CHECK(MatchesRawScript(code, rawCode, 17, 19));
+}
+
+BOOST_AUTO_TEST_CASE(CompiledScripts)
+{
+	// code section of a typical unit script, laid out the way the compiler
+	// emits it (each function ends in RETURN, jumps are absolute)
+	const std::vector<std::string> scriptNames = {"Create", "QueryWeapon1", "AimWeapon1", "lua_FlashMuzzle", "Killed"};
+	const std::vector<int> scriptOffsets = {0, 12, 16, 47, 55};
+
+	const std::vector<int> rawCode = {
+		// Create: hide flare; call-script lua_FlashMuzzle(); start-script Killed(); return 0
+		HIDE, 2,
+		CALL, 3, 0,
+		START, 4, 0,
+		PUSH_CONSTANT, 0,
+		RETURN,
+		DROP,
+		// QueryWeapon1(piecenum): piecenum = flare
+		PUSH_CONSTANT, 2, POP_LOCAL_VAR, 0,
+		// AimWeapon1(heading, pitch)
+		CREATE_LOCAL_VAR, CREATE_LOCAL_VAR,
+		PUSH_CONSTANT, 2, SIGNAL,
+		PUSH_CONSTANT, 2, SET_SIGNAL_MASK,
+		PUSH_LOCAL_VAR, 0, PUSH_CONSTANT, 16384, TURN, 1, 1,               // turn turret to y-axis heading speed <90>
+		PUSH_CONSTANT, 0, PUSH_LOCAL_VAR, 1, SUB, PUSH_CONSTANT, 8192, TURN, 0, 0,
+		WAIT_TURN, 1, 1,
+		PUSH_CONSTANT, 1,
+		RETURN,
+		// lua_FlashMuzzle
+		PUSH_CONSTANT, 1024, EMIT_SFX, 2,
+		PUSH_CONSTANT, 100, SLEEP,
+		RETURN,
+		// Killed(severity, corpsetype)
+		PUSH_LOCAL_VAR, 0, PUSH_CONSTANT, 25, SET_LESS_OR_EQUAL,
+		JUMP_NOT_EQUAL, 69,
+		PUSH_CONSTANT, 0, EXPLODE, 1,
+		PUSH_CONSTANT, 1, RETURN,
+		PUSH_CONSTANT, 256, EXPLODE, 1,
+		PUSH_CONSTANT, 2, RETURN,
+		0, 0, 0, 0,                                                         // CCobFile pads the code section
+	};
+
+	std::vector<int> code = rawCode;
+
+	for (size_t i = 0; i < scriptOffsets.size(); ++i) {
+		const int end = (i + 1 < scriptOffsets.size())? scriptOffsets[i + 1]: int(rawCode.size()) - 4;
+
+		TranslateScript(code, scriptOffsets[i], end, scriptNames);
+		BOOST_CHECK(MatchesRawScript(code, rawCode, scriptOffsets[i], end));
+	}
+
+	BOOST_CHECK(code[2] == Encode(OP_LUA_CALL));
+	BOOST_CHECK(code[5] == Encode(OP_START));
+	BOOST_CHECK(code[55] == Encode(OP_PUSH_LOCAL_VAR));
+	BOOST_CHECK(code[60] == Encode(OP_JUMP_NOT_EQUAL));
+	BOOST_CHECK(code[69] == Encode(OP_PUSH_CONSTANT));
+	// the padding stays raw
+	BOOST_CHECK(std::equal(code.end() - 4, code.end(), rawCode.end() - 4));
+
+	// every word of the translated code decodes to the instruction it replaced
+	std::vector<int> decodedCode = code;
+
+	for (size_t pc = 0; pc < decodedCode.size() - 4; ) {
+		const Opcode op = Decode(code[pc]);
+
+		BOOST_CHECK(op != OP_UNKNOWN);
+		BOOST_CHECK(rawCode[pc] == ((op == OP_LUA_CALL || op == OP_REAL_CALL)? CALL: RAW_OPCODES[op]));
+
+		decodedCode[pc] = rawCode[pc];
+		pc += (1 + NUM_OPERANDS[op]);
+	}
+
+	BOOST_CHECK(decodedCode == rawCode);
+
+	// a corrupted operand or opcode is detected
+	std::vector<int> badCode = code;
+
+	badCode[19] = 0;
+	BOOST_CHECK(!MatchesRawScript(badCode, rawCode, 16, 47));
+	badCode = code;
+	badCode[16] = Encode(OP_POP_STACK);
+	BOOST_CHECK(!MatchesRawScript(badCode, rawCode, 16, 47));
+}
+
+BOOST_AUTO_TEST_CASE(DispatchBenchmark)
+{
+	const std::vector<int> rawCode = CreateLoopScript();
+	std::vector<int> code = rawCode;
+
+	TranslateScript(code, 0, code.size(), {});
+
+	BOOST_CHECK(RunSparse(rawCode, 100) == 4950);
+	BOOST_CHECK(RunTranslated(code, 100) == 4950);
+	// untranslated code runs through the fallback path
+	BOOST_CHECK(RunTranslated(rawCode, 100) == 4950);
+
+	int sparseResult = 0;
+	int denseResult = 0;
+
+	const float sparseMillis = TimeMillis([&]() {
+		for (int n = 0; n < NUM_RUNS; n++) {
+			sparseResult += RunSparse(rawCode, NUM_ITERATIONS);
+		}
+	});
+	const float denseMillis = TimeMillis([&]() {
+		for (int n = 0; n < NUM_RUNS; n++) {
+			denseResult += RunTranslated(code, NUM_ITERATIONS);
+		}
+	});
+
+	BOOST_CHECK(sparseResult == denseResult);
+
+	BOOST_TEST_MESSAGE("runs: " << NUM_RUNS << ", loop iterations: " << NUM_ITERATIONS);
+	BOOST_TEST_MESSAGE("  sparse switch: " << sparseMillis << " ms");
+	BOOST_TEST_MESSAGE("  translated dispatch: " << denseMillis << " ms");
+}
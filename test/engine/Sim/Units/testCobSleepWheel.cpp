@@ -0,0 +1,134 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Units/Scripts/CobSleepWheel.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+#define BOOST_TEST_MODULE CobSleepWheel
+#include <boost/test/unit_test.hpp>
+
+
+struct SleepingThread {
+	int id;
+	int wakeTime;
+};
+
+struct Scheduler {
+	void Add(SleepingThread* t) { CobSleepWheel::Add(sleeping, sleepingTime, t, t->wakeTime); }
+
+	template<typename F> void Tick(int deltaTime, const F& wake) {
+		currentTime += deltaTime;
+		CobSleepWheel::Wake(sleeping, sleepingTime, currentTime, [](const SleepingThread* t) { return t->wakeTime; }, wake);
+	}
+
+	std::vector<SleepingThread*> sleeping[CobSleepWheel::NUM_SLOTS];
+
+	int sleepingTime = 0;
+	int currentTime = 0;
+};
+
+
+BOOST_AUTO_TEST_CASE(EqualWakeTimes)
+{
+	// each group shares a wake-time; one in the current window, one on a
+	// window boundary and ones that cascade down from every higher level
+	const std::vector<int> wakeTimes = {100, 256, 5000, 70000, 1 << 22, (1 << 24) + 17};
+
+	std::vector<SleepingThread> threads;
+	std::vector<int> order;
+
+	for (int n = 0; n < 4; n++) {
+		for (const int wakeTime: wakeTimes) {
+			threads.push_back({int(threads.size()), wakeTime});
+		}
+	}
+
+	Scheduler s;
+
+	for (SleepingThread& t: threads) {
+		s.Add(&t);
+	}
+
+	// threads that went to sleep later, but wake at the same times
+	std::vector<SleepingThread> laterThreads;
+
+	for (const int wakeTime: wakeTimes) {
+		laterThreads.push_back({int(threads.size() + laterThreads.size()), wakeTime});
+	}
+
+	s.Tick(33, [&](SleepingThread* t) { order.push_back(t->id); });
+	BOOST_CHECK(order.empty());
+
+	for (SleepingThread& t: laterThreads) {
+		s.Add(&t);
+	}
+
+	while (!CobSleepWheel::Empty(s.sleeping)) {
+		s.Tick(33, [&](SleepingThread* t) {
+			BOOST_CHECK(t->wakeTime < s.currentTime);
+			order.push_back(t->id);
+		});
+	}
+
+	// by wake-time, and in the order they went to sleep within a group
+	std::vector<int> expected;
+
+	for (size_t i = 0; i < wakeTimes.size(); i++) {
+		for (size_t n = 0; n < 4; n++) {
+			expected.push_back(n * wakeTimes.size() + i);
+		}
+
+		expected.push_back(laterThreads[i].id);
+	}
+
+	BOOST_CHECK(order == expected);
+}
+
+BOOST_AUTO_TEST_CASE(MatchesStableOrder)
+{
+	// reference: a multimap keeps items with equal keys in insertion order
+	std::multimap<int, SleepingThread*> reference;
+
+	std::mt19937 rng(1234);
+	std::vector<SleepingThread> threads(20000);
+
+	Scheduler s;
+
+	const auto AddThread = [&](SleepingThread* t, int time, int maxSleep) {
+		t->wakeTime = time + int(rng() % maxSleep);
+
+		s.Add(t);
+		reference.emplace(std::max(t->wakeTime, time), t);
+	};
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].id = i;
+		AddThread(&threads[i], 0, 1 << 20);
+	}
+
+	std::vector<int> order;
+	std::vector<int> expected;
+
+	for (int frame = 0; frame < 40000; frame++) {
+		// threads sleep again a while after they are woken, some more than once per tick
+		s.Tick(33, [&](SleepingThread* t) {
+			order.push_back(t->id);
+
+			if ((rng() % 4) != 0)
+				AddThread(t, s.sleepingTime, (rng() % 2)? 50: (1 << 16));
+		});
+
+		while (!reference.empty() && reference.begin()->first < s.currentTime) {
+			expected.push_back(reference.begin()->second->id);
+			reference.erase(reference.begin());
+		}
+	}
+
+	// both were fed the same re-sleeps, in the wheel's order; they only
+	// agree if that is the order the reference wakes them in too
+	BOOST_CHECK(order.size() > threads.size());
+	BOOST_CHECK(order == expected);
+}
@@ -0,0 +1,272 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Units/UnitHotState.h"
+#include "System/float3.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+
+#define BOOST_TEST_MODULE UnitHotState
+#include <boost/test/unit_test.hpp>
+
+
+// synthetic 5000-unit scenario for CUnitHandler::UpdateLosStatus
+//
+// CUnit and CLosHandler can not be constructed outside of a running game,
+// so FatUnit stands in for CUnit (it is several KB large and allocated in
+// creation order) and LosInputs for the LOS-maps; the status calculation
+// of the new path is the real UnitHotState::CalcNextLosStatus
+static constexpr int NUM_UNITS = 5000;
+static constexpr int NUM_ALLYTEAMS = 16;
+static constexpr int NUM_FRAMES = 100;
+
+static constexpr int MAP_SIZE = 4096;
+static constexpr int LOS_DIV = 32;
+static constexpr int LOS_SIZE = MAP_SIZE / LOS_DIV;
+
+static constexpr unsigned short LOS_INLOS = (1 << 0);
+static constexpr unsigned short LOS_INRADAR = (1 << 1);
+static constexpr unsigned short LOS_ALL_MASK_BITS = (0xF << 8);
+
+
+struct FatUnit {
+	UnitLosState GetLosState() const {
+		UnitLosState state;
+		state.pos = pos;
+		state.speed = speed;
+		state.allyTeam = allyteam;
+		state.bits = bits;
+		return state;
+	}
+
+	unsigned char head[1024];
+
+	float3 pos;
+	unsigned char body[1536];
+	float3 speed;
+
+	int id;
+	int allyteam;
+	unsigned int bits;
+
+	unsigned char tail[1024];
+
+	std::vector<unsigned short> losStatus;
+};
+
+
+struct LosInputs {
+	static int Square(float x) { return std::max(0, std::min(LOS_SIZE - 1, int(x / LOS_DIV))); }
+	static int Index(const float3& p, int at) { return ((at * LOS_SIZE + Square(p.z)) * LOS_SIZE + Square(p.x)); }
+
+	bool IsMasked(unsigned short status) const { return ((status & LOS_ALL_MASK_BITS) == LOS_ALL_MASK_BITS); }
+	bool InSameSquares(const UnitLosState& a, const UnitLosState& b) const {
+		return (Index(a.pos, 0) == Index(b.pos, 0) && Index(a.pos + a.speed, 0) == Index(b.pos + b.speed, 0));
+	}
+	bool IsDirty(const UnitLosState& s, int at) const {
+		return (dirty[Index(s.pos, at)] != 0 || dirty[Index(s.pos + s.speed, at)] != 0);
+	}
+
+	unsigned short CalcLosStatus(const UnitLosState& s, unsigned short status, int at) const {
+		const unsigned short mask = ~(status >> 8);
+
+		if ((s.bits & UnitLosState::LOS_BIT_ALWAYSVISIBLE) != 0 || losMap[Index(s.pos, at)] != 0 || losMap[Index(s.pos + s.speed, at)] != 0)
+			return (status | (mask & (LOS_INLOS | LOS_INRADAR)));
+
+		return (status & ~(mask & (LOS_INLOS | LOS_INRADAR)));
+	}
+
+	std::vector<unsigned char> losMap;
+	std::vector<unsigned char> dirty;
+};
+
+
+struct Scenario {
+	Scenario(unsigned int seed): rng(seed) {
+		std::uniform_real_distribution<float> posDist(0.0f, MAP_SIZE);
+		std::uniform_real_distribution<float> spdDist(-2.0f, 2.0f);
+
+		inputs.losMap.resize(NUM_ALLYTEAMS * LOS_SIZE * LOS_SIZE);
+		inputs.dirty.resize(NUM_ALLYTEAMS * LOS_SIZE * LOS_SIZE);
+
+		for (unsigned char& s: inputs.losMap) {
+			s = (rng() & 1);
+		}
+
+		unitMem.resize(NUM_UNITS);
+		activeUnits.resize(NUM_UNITS);
+
+		for (int i = 0; i < NUM_UNITS; i++) {
+			unitMem[i].reset(new FatUnit());
+
+			FatUnit* u = unitMem[i].get();
+			u->pos = float3(posDist(rng), 0.0f, posDist(rng));
+			u->speed = float3(spdDist(rng), 0.0f, spdDist(rng));
+			u->id = i;
+			u->allyteam = i % NUM_ALLYTEAMS;
+			u->bits = ((rng() & 255) == 0) * UnitLosState::LOS_BIT_ALWAYSVISIBLE;
+			u->losStatus.resize(NUM_ALLYTEAMS, 0);
+
+			// own allyteam; everything is masked
+			u->losStatus[u->allyteam] = LOS_ALL_MASK_BITS | LOS_INLOS | LOS_INRADAR;
+
+			activeUnits[i] = u;
+		}
+
+		// units are created and destroyed in arbitrary order during a game
+		std::shuffle(activeUnits.begin(), activeUnits.end(), rng);
+	}
+
+	// moves a few units and changes coverage in a few squares, like a frame would
+	void Step() {
+		std::fill(inputs.dirty.begin(), inputs.dirty.end(), 0);
+
+		for (int n = 0; n < NUM_UNITS / 20; n++) {
+			FatUnit* u = activeUnits[rng() % NUM_UNITS];
+			u->pos.x = std::max(0.0f, std::min(MAP_SIZE - 1.0f, u->pos.x + u->speed.x * LOS_DIV));
+			u->pos.z = std::max(0.0f, std::min(MAP_SIZE - 1.0f, u->pos.z + u->speed.z * LOS_DIV));
+		}
+
+		for (int n = 0; n < LOS_SIZE; n++) {
+			const size_t idx = rng() % inputs.losMap.size();
+			inputs.losMap[idx] ^= 1;
+			inputs.dirty[idx] = 1;
+		}
+	}
+
+	std::mt19937 rng;
+
+	LosInputs inputs;
+
+	std::vector<std::unique_ptr<FatUnit>> unitMem;
+	std::vector<FatUnit*> activeUnits;
+};
+
+
+// the per-unit loop UpdateLosStatus used to run, CUnit::UpdateLosStatus for every pair
+static void UpdateLosStatusPerUnit(Scenario& s)
+{
+	for (FatUnit* u: s.activeUnits) {
+		for (int at = 0; at < NUM_ALLYTEAMS; at++) {
+			if (s.inputs.IsMasked(u->losStatus[at]))
+				continue;
+
+			u->losStatus[at] = s.inputs.CalcLosStatus(u->GetLosState(), u->losStatus[at], at);
+		}
+	}
+}
+
+// CUnitHandler::UpdateHotState + UpdateLosStatus, without the callins
+static void UpdateLosStatusHotState(Scenario& s, UnitHotState& hotState)
+{
+	const std::array<bool, NUM_ALLYTEAMS> allyTeamChanged = {};
+
+	hotState.Resize(s.activeUnits.size(), NUM_ALLYTEAMS);
+	hotState.ResizePrevLos(NUM_UNITS, NUM_ALLYTEAMS);
+
+	for (size_t i = 0; i < s.activeUnits.size(); i++) {
+		const FatUnit* u = s.activeUnits[i];
+		hotState.SetRow(i, nullptr, u->id, u->GetLosState(), &u->losStatus[0]);
+	}
+
+	for (size_t i = 0; i < hotState.Size(); i++) {
+		hotState.CalcNextLosStatus(i, allyTeamChanged.data(), s.inputs);
+	}
+
+	for (size_t i = 0; i < hotState.Size(); i++) {
+		for (int at = 0; at < NUM_ALLYTEAMS; at++) {
+			const size_t idx = hotState.GetLosStatusIndex(i, at);
+
+			if (hotState.nextLosStatus[idx] == hotState.losStatus[idx])
+				continue;
+
+			s.activeUnits[i]->losStatus[at] = hotState.nextLosStatus[idx];
+		}
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE( UpdateLosStatus5000Units )
+{
+	Scenario perUnit(1234);
+	Scenario hotStateScen(1234);
+
+	UnitHotState hotState;
+
+	float perUnitTime = 0.0f;
+	float hotStateTime = 0.0f;
+
+	bool sameStatus = true;
+
+	for (int f = 0; f < NUM_FRAMES; f++) {
+		perUnit.Step();
+		hotStateScen.Step();
+
+		const auto t0 = std::chrono::steady_clock::now();
+		UpdateLosStatusPerUnit(perUnit);
+		const auto t1 = std::chrono::steady_clock::now();
+		UpdateLosStatusHotState(hotStateScen, hotState);
+		const auto t2 = std::chrono::steady_clock::now();
+
+		perUnitTime += std::chrono::duration<float, std::milli>(t1 - t0).count();
+		hotStateTime += std::chrono::duration<float, std::milli>(t2 - t1).count();
+
+		for (int i = 0; i < NUM_UNITS; i++) {
+			sameStatus &= (perUnit.unitMem[i]->losStatus == hotStateScen.unitMem[i]->losStatus);
+		}
+	}
+
+	BOOST_TEST_MESSAGE("[UpdateLosStatus5000Units] units=" << NUM_UNITS << " allyteams=" << NUM_ALLYTEAMS << " frames=" << NUM_FRAMES);
+	BOOST_TEST_MESSAGE("\tper-unit:  " << (perUnitTime / NUM_FRAMES) << "ms/frame");
+	BOOST_TEST_MESSAGE("\thot-state: " << (hotStateTime / NUM_FRAMES) << "ms/frame");
+
+	BOOST_CHECK(sameStatus);
+}
+
+BOOST_AUTO_TEST_CASE( UpdateLosStatusSkipsUnchangedPairs )
+{
+	Scenario s(5678);
+	UnitHotState hotState;
+
+	UpdateLosStatusHotState(s, hotState);
+
+	std::vector<std::vector<unsigned short>> prevStatus;
+
+	for (const auto& u: s.unitMem) {
+		prevStatus.push_back(u->losStatus);
+	}
+
+	// nothing moved and no square is dirty, so a pass must not recalculate
+	// anything; coverage changed behind its back makes that observable
+	std::fill(s.inputs.losMap.begin(), s.inputs.losMap.end(), 0);
+	UpdateLosStatusHotState(s, hotState);
+
+	bool unchanged = true;
+
+	for (int i = 0; i < NUM_UNITS; i++) {
+		unchanged &= (s.unitMem[i]->losStatus == prevStatus[i]);
+	}
+
+	BOOST_CHECK(unchanged);
+
+	// marking the squares dirty makes the pairs in them pick up the new coverage
+	std::fill(s.inputs.dirty.begin(), s.inputs.dirty.end(), 1);
+	UpdateLosStatusHotState(s, hotState);
+
+	bool recalculated = true;
+
+	for (const FatUnit* u: s.activeUnits) {
+		for (int at = 0; at < NUM_ALLYTEAMS; at++) {
+			if (s.inputs.IsMasked(u->losStatus[at]))
+				continue;
+
+			recalculated &= (u->losStatus[at] == s.inputs.CalcLosStatus(u->GetLosState(), u->losStatus[at], at));
+		}
+	}
+
+	BOOST_CHECK(recalculated);
+}
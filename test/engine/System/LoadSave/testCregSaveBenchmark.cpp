@@ -0,0 +1,242 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "System/creg/creg_cond.h"
+#include "System/creg/Serializer.h"
+#include "System/FileSystem/GZStreamWriter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#define BOOST_TEST_MODULE CregSaveBenchmark
+#include <boost/test/unit_test.hpp>
+
+
+static const char* SAVE_FILE_NAME = "testCregSaveBenchmark.gz";
+static const std::string SAVE_HEADER = "header written before the package";
+
+
+struct BenchPart {
+	CR_DECLARE_STRUCT(BenchPart);
+	int value;
+};
+
+CR_BIND(BenchPart, );
+CR_REG_METADATA(BenchPart, CR_MEMBER(value));
+
+
+// looks roughly like a unit: some plain data, an embedded
+// struct, an owned container and links to other objects
+struct BenchObj {
+	CR_DECLARE(BenchObj);
+
+	BenchObj(): id(0), next(nullptr), target(nullptr), partPtr(&part) {
+		part.value = 0;
+		for (float& v: values) v = 0.0f;
+	}
+	virtual ~BenchObj() {}
+
+	int id;
+	float values[8];
+	std::vector<int> list;
+
+	BenchObj* next;
+	BenchObj* target;
+	BenchPart* partPtr;
+	BenchPart part;
+};
+
+CR_BIND(BenchObj, );
+CR_REG_METADATA(BenchObj, (
+	CR_MEMBER(id),
+	CR_MEMBER(values),
+	CR_MEMBER(list),
+	CR_MEMBER(next),
+	CR_MEMBER(target),
+	CR_MEMBER(part),
+	CR_MEMBER(partPtr)
+));
+
+
+struct BenchRoot {
+	CR_DECLARE(BenchRoot);
+
+	virtual ~BenchRoot() {
+		for (BenchObj* o: objects) delete o;
+	}
+
+	std::vector<BenchObj*> objects;
+};
+
+CR_BIND(BenchRoot, );
+CR_REG_METADATA(BenchRoot, CR_MEMBER(objects));
+
+
+
+static BenchRoot* CreateGraph(unsigned int numObjects)
+{
+	BenchRoot* root = new BenchRoot();
+	root->objects.resize(numObjects);
+
+	for (unsigned int n = 0; n < numObjects; n++) {
+		BenchObj* o = new BenchObj();
+		o->id = n;
+		o->part.value = n * 3;
+		o->list.assign(n % 5, n);
+		for (unsigned int i = 0; i < 8; i++) o->values[i] = n * 0.5f + i;
+		root->objects[n] = o;
+	}
+
+	for (unsigned int n = 0; n < numObjects; n++) {
+		root->objects[n]->next = root->objects[(n + 1) % numObjects];
+		root->objects[n]->target = root->objects[(n * 7919) % numObjects];
+	}
+
+	return root;
+}
+
+static bool CheckGraph(const BenchRoot* root, unsigned int numObjects)
+{
+	if (root->objects.size() != numObjects)
+		return false;
+
+	for (unsigned int n = 0; n < numObjects; n++) {
+		const BenchObj* o = root->objects[n];
+
+		if (o->id != int(n) || o->part.value != int(n * 3) || o->partPtr != &o->part)
+			return false;
+		if (o->list.size() != (n % 5) || o->values[7] != (n * 0.5f + 7))
+			return false;
+		if (o->next != root->objects[(n + 1) % numObjects] || o->target != root->objects[(n * 7919) % numObjects])
+			return false;
+	}
+
+	return true;
+}
+
+
+// mirrors CCregLoadSaveHandler::SaveGame; <simMillis> is the time
+// until Close, which SaveGame leaves to another thread
+static bool SaveToFile(BenchRoot* root, int compressionLevel, float* simMillis = nullptr)
+{
+	const auto t0 = std::chrono::high_resolution_clock::now();
+
+	CGZStreamWriter gzWriter(SAVE_FILE_NAME, compressionLevel);
+	std::ostream os(&gzWriter);
+
+	os.write(SAVE_HEADER.c_str(), SAVE_HEADER.size() + 1);
+	gzWriter.Pin(std::uint64_t(os.tellp()) + creg::COutputStreamSerializer::GetPackageHeaderSize());
+
+	creg::COutputStreamSerializer ss;
+	ss.SavePackage(&os, root, root->GetClass());
+
+	if (simMillis != nullptr)
+		*simMillis = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+
+	return (os.good() && gzWriter.Close());
+}
+
+static BenchRoot* LoadFromFile()
+{
+	std::stringstream is(std::ios::in | std::ios::out | std::ios::binary);
+
+	gzFile file = gzopen(SAVE_FILE_NAME, "rb");
+	char buffer[65536];
+	int numBytes = 0;
+
+	while ((numBytes = gzread(file, buffer, sizeof(buffer))) > 0)
+		is.write(buffer, numBytes);
+
+	gzclose(file);
+
+	std::string header;
+	std::getline(is, header, '\0');
+
+	if (header != SAVE_HEADER)
+		return nullptr;
+
+	void* root = nullptr;
+	creg::Class* rootCls = nullptr;
+
+	creg::CInputStreamSerializer ss;
+	ss.LoadPackage(&is, root, rootCls);
+
+	return static_cast<BenchRoot*>(root);
+}
+
+
+template<typename F> static float TimeMillis(F&& f)
+{
+	const auto t0 = std::chrono::high_resolution_clock::now();
+	f();
+	const auto t1 = std::chrono::high_resolution_clock::now();
+	return (std::chrono::duration<float, std::milli>(t1 - t0).count());
+}
+
+
+
+BOOST_AUTO_TEST_CASE(StreamingRoundTrip)
+{
+	for (const unsigned int numObjects: {0u, 1u, 20000u}) {
+		BenchRoot* srcRoot = CreateGraph(numObjects);
+
+		BOOST_CHECK(SaveToFile(srcRoot, 1));
+		delete srcRoot;
+
+		BenchRoot* dstRoot = LoadFromFile();
+
+		BOOST_CHECK(dstRoot != nullptr);
+		BOOST_CHECK(dstRoot != nullptr && CheckGraph(dstRoot, numObjects));
+		delete dstRoot;
+	}
+
+	std::remove(SAVE_FILE_NAME);
+}
+
+BOOST_AUTO_TEST_CASE(SaveLoadBenchmark)
+{
+	float nsPerObject[2] = {0.0f, 0.0f};
+
+	for (const unsigned int numObjects: {25000u, 400000u}) {
+		BenchRoot* root = CreateGraph(numObjects);
+
+		std::stringstream memStream(std::ios::in | std::ios::out | std::ios::binary);
+
+		const float memMillis = TimeMillis([&]() {
+			creg::COutputStreamSerializer ss;
+			ss.SavePackage(&memStream, root, root->GetClass());
+		});
+		float gz1SimMillis = 0.0f;
+		float gz9SimMillis = 0.0f;
+
+		const float gz1Millis = TimeMillis([&]() { BOOST_CHECK(SaveToFile(root, 1, &gz1SimMillis)); });
+		const float gz9Millis = TimeMillis([&]() { BOOST_CHECK(SaveToFile(root, 9, &gz9SimMillis)); });
+
+		delete root;
+
+		BenchRoot* loadedRoot = nullptr;
+
+		const float loadMillis = TimeMillis([&]() { loadedRoot = LoadFromFile(); });
+
+		BOOST_CHECK(loadedRoot != nullptr && CheckGraph(loadedRoot, numObjects));
+		delete loadedRoot;
+
+		nsPerObject[numObjects > 25000u] = memMillis * 1e6f / numObjects;
+
+		BOOST_TEST_MESSAGE("objects: " << numObjects << ", package: " << (int(memStream.tellp()) >> 10) << " KB");
+		BOOST_TEST_MESSAGE("  save (memory): " << memMillis << " ms");
+		BOOST_TEST_MESSAGE("  save (gz, level 1): " << gz1SimMillis << " ms until Close, " << gz1Millis << " ms total");
+		BOOST_TEST_MESSAGE("  save (gz, level 9): " << gz9SimMillis << " ms until Close, " << gz9Millis << " ms total");
+		BOOST_TEST_MESSAGE("  load (gz): " << loadMillis << " ms");
+	}
+
+	// object lookups are O(1), so 16x the objects should not take much more than 16x the time
+	BOOST_TEST_MESSAGE("save ns/object: " << nsPerObject[0] << " vs " << nsPerObject[1]);
+	BOOST_CHECK(nsPerObject[1] < (nsPerObject[0] * 4.0f));
+
+	std::remove(SAVE_FILE_NAME);
+}
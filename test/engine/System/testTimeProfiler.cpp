@@ -0,0 +1,161 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "System/TimeProfiler.h"
+#include "System/Misc/SpringTime.h"
+#include "System/Threading/SpringThreading.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MODULE TimeProfiler
+#include <boost/test/unit_test.hpp>
+
+BOOST_GLOBAL_FIXTURE(InitSpringTime);
+
+
+static const char* TRACE_FILE_NAME = "testTimeProfiler.json";
+
+static constexpr int NUM_THREADS = 4;
+static constexpr int NUM_TIMERS = 100;
+
+
+static bool HaveProfile(const char* name)
+{
+	return (profiler.profile.find(name) != profiler.profile.end());
+}
+
+static unsigned CountSubstrings(const std::string& str, const std::string& sub)
+{
+	unsigned count = 0;
+
+	for (size_t pos = str.find(sub); pos != std::string::npos; pos = str.find(sub, pos + sub.size())) {
+		count += 1;
+	}
+
+	return count;
+}
+
+static void RunWorkerTimers()
+{
+	std::vector<spring::thread> threads;
+
+	for (int i = 0; i < NUM_THREADS; i++) {
+		threads.emplace_back([]() {
+			for (int j = 0; j < NUM_TIMERS; j++) {
+				SCOPED_MT_TIMER("Test::Worker");
+			}
+		});
+	}
+
+	for (spring::thread& t: threads) {
+		t.join();
+	}
+}
+
+
+
+BOOST_AUTO_TEST_CASE(TimerIDs)
+{
+	const std::string dynamicName = "Test::Interned";
+	const std::string otherName = "Test::Other";
+
+	BOOST_CHECK(CTimeProfiler::GetTimerID("Test::Interned") == CTimeProfiler::GetTimerID(dynamicName.c_str()));
+	BOOST_CHECK(CTimeProfiler::GetTimerID("Test::Interned") != CTimeProfiler::GetTimerID(otherName.c_str()));
+
+	// a different name at a previously seen address
+	char buffer[32] = "Test::Buffer0";
+	const unsigned bufferID = CTimeProfiler::GetTimerID(buffer);
+
+	buffer[12] = '1';
+
+	BOOST_CHECK(CTimeProfiler::GetTimerID(buffer) != bufferID);
+	BOOST_CHECK(CTimeProfiler::GetTimerID("Test::Buffer1") == CTimeProfiler::GetTimerID(buffer));
+}
+
+BOOST_AUTO_TEST_CASE(MergeTimes)
+{
+	profiler.ResetState();
+	profiler.SetEnabled(true);
+
+	{
+		SCOPED_TIMER("Test::Main");
+		{
+			// nested timers of the same name are not counted twice
+			SCOPED_TIMER("Test::Main");
+		}
+	}
+
+	RunWorkerTimers();
+
+	// nothing reaches the profile before the merge
+	BOOST_CHECK(!HaveProfile("Test::Main"));
+	BOOST_CHECK(!HaveProfile("Test::Worker"));
+
+	profiler.MergeTimes();
+
+	BOOST_CHECK(HaveProfile("Test::Main"));
+	BOOST_CHECK(HaveProfile("Test::Worker"));
+
+	profiler.SetEnabled(false);
+}
+
+BOOST_AUTO_TEST_CASE(DisabledSpecialTimers)
+{
+	profiler.ResetState();
+
+	{
+		SCOPED_TIMER("Test::Regular");
+	}
+	{
+		SCOPED_SPECIAL_TIMER("Test::Special");
+	}
+
+	profiler.MergeTimes();
+
+	BOOST_CHECK(!HaveProfile("Test::Regular"));
+	BOOST_CHECK(HaveProfile("Test::Special"));
+}
+
+BOOST_AUTO_TEST_CASE(TraceExport)
+{
+	profiler.ResetState();
+
+	BOOST_CHECK(profiler.StartTrace(TRACE_FILE_NAME));
+	BOOST_CHECK(profiler.IsTracing());
+
+	{
+		SCOPED_TIMER("Test::\"Quoted\"");
+	}
+
+	RunWorkerTimers();
+	profiler.MergeTimes();
+
+	{
+		SCOPED_TIMER("Test::Main");
+	}
+
+	profiler.StopTrace();
+
+	BOOST_CHECK(!profiler.IsTracing());
+	// tracing does not enable profiling
+	BOOST_CHECK(!HaveProfile("Test::Main"));
+
+	std::ifstream file(TRACE_FILE_NAME);
+	std::stringstream trace;
+	trace << file.rdbuf();
+
+	const std::string& str = trace.str();
+
+	BOOST_CHECK(str.find("{\"traceEvents\":[") == 0);
+	BOOST_CHECK(str.rfind("]}") == (str.size() - 3));
+
+	BOOST_CHECK(CountSubstrings(str, "\"name\":\"Test::Worker\",\"ph\":\"X\"") == (NUM_THREADS * NUM_TIMERS));
+	BOOST_CHECK(CountSubstrings(str, "\"name\":\"Test::Main\",\"ph\":\"X\"") == 1);
+	BOOST_CHECK(CountSubstrings(str, "\"name\":\"Test::\\\"Quoted\\\"\"") == 1);
+	BOOST_CHECK(CountSubstrings(str, "\"name\":\"Frame\"") == 2);
+
+	std::remove(TRACE_FILE_NAME);
+}